@@ -1,51 +1,135 @@
 #version 330 core
 
+// Compile-time permutations (defines injected by shader_cache.cpp):
+//  USE_TEXTURES, USE_NORMAL_MAP, USE_FOG, USE_SHADOW_MAP, PLANAR_SHADOW
+//  SHADOW_VSM / SHADOW_EVSM = shadowMap[] holds prefiltered moments (shadow_moments.frag) instead of depth
+//  SHADOW_LIGHT_COUNT = number of shadow-mapped lights (1..4)
+//  MATERIAL_ARRAY_GROUPS = number of texture arrays (see materials.hpp)
+//  LEGACY_STEAM_NOISE = per-fragment hash noise for steam (steam fill benchmark only)
+#ifndef SHADOW_LIGHT_COUNT
+#define SHADOW_LIGHT_COUNT 3
+#endif
+#ifndef MATERIAL_ARRAY_GROUPS
+#define MATERIAL_ARRAY_GROUPS 6
+#endif
+
+// material flags (MaterialFlags in materials.hpp)
+#define MAT_ALPHA_TEST 1
+#define MAT_BLACK_KEY  2
+#define MAT_STEAM      4
+
 in vec3 vColor;
 in vec3 vFragPos;
 in vec2 vUV;
-flat in int vTexId;
-in mat3 vTBN;
-
-// shadow mapping (3 lights)
-in vec4 vLightPosLS[3];
-
-out vec4 out_Color;
-
-uniform vec3 viewPos;
-uniform vec3 lightPos[3];
-uniform vec3 lightColor[3];
-uniform int codCol;
-
-// albedo textures
-uniform sampler2D texAsphalt;
-uniform sampler2D texWall;
-uniform sampler2D texSign;
-
-// normal maps
-uniform sampler2D texAsphaltN;
-uniform sampler2D texWallN;
+flat in int vMaterialId;
+
+// world-space normal + tangent (w = handedness), interpolated => renormalized here
+in vec3 vNormal;
+in vec4 vTangent;
+
+out vec4 out_Color;     // linear HDR (RGBA16F target)
+
+// shared std140 blocks (bindings set by BindUniformBlocks in main.cpp)
+layout(std140) uniform FrameData {
+    float timeSec;
+    float exposure;
+    float gammaValue;
+    float framePad0;
+};
+
+layout(std140) uniform ViewData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    ivec3 clusterDims;
+    vec2 clusterTileSize;   // pixels per tile
+    vec2 clusterSlice;      // slice = log(viewZ) * x - y
+    vec2 fogSlice;          // same, for the fog volume
+};
+
+#ifdef USE_SHADOW_MAP
+// light-space positions are rebuilt from vFragPos, only for lights that actually shade the fragment
+layout(std140) uniform LightData {
+    mat4 lightSpace[SHADOW_LIGHT_COUNT];
+    mat4 matrUmbra;
+};
+#endif
+
+// clustered lights (see clustered_lights.hpp)
+uniform samplerBuffer lightData;       // 2 texels per light: (pos, radius), (color, shadowIndex)
+uniform usamplerBuffer clusterGrid;    // (offset, count) per froxel
+uniform usamplerBuffer lightIndexList; // light indices grouped per froxel
+
+// materials: table (2 texels per material) + albedo/normal layers in one array per resolution
+uniform samplerBuffer materialTable;
+uniform sampler2DArray materialArrays[MATERIAL_ARRAY_GROUPS];
+
+// fog volume (see fog_volume.hpp): in-scattered light per froxel, and the integrated
+// (in-scatter, transmittance) from the camera
+uniform sampler3D fogScatter;
+uniform sampler3D fogIntegrated;
+
+// tileable value noise for the steam (noise_volume.hpp), GL_REPEAT
+uniform sampler3D steamNoiseVolume;
+
+#ifdef USE_SHADOW_MAP
+// shadow maps: one per light (depth, or mipmapped moments with SHADOW_VSM / SHADOW_EVSM)
+uniform sampler2D shadowMap[SHADOW_LIGHT_COUNT];
+#endif
+
+// -------- clustered lights ----------
+uvec2 clusterRange()
+{
+    float viewZ = -(view * vec4(vFragPos, 1.0)).z;
+    int slice = int(max(log(max(viewZ, 1e-4)) * clusterSlice.x - clusterSlice.y, 0.0));
+    slice = min(slice, clusterDims.z - 1);
 
-uniform int useTextures;
-uniform int useNormalMap;
-uniform vec3 texTiling;
+    ivec2 tile = ivec2(gl_FragCoord.xy / clusterTileSize);
+    tile = clamp(tile, ivec2(0), clusterDims.xy - 1);
 
-// sign helper
-uniform int signBlackKey;
+    int c = tile.x + clusterDims.x * (tile.y + clusterDims.y * slice);
+    return texelFetch(clusterGrid, c).xy;
+}
 
-// tone mapping + gamma
-uniform float exposure;
-uniform float gammaValue;
+void fetchLight(int idx, out vec3 pos, out float radius, out vec3 color, out int shadowIdx)
+{
+    vec4 a = texelFetch(lightData, idx * 2 + 0);
+    vec4 b = texelFetch(lightData, idx * 2 + 1);
+    pos = a.xyz;
+    radius = a.w;
+    color = b.rgb;
+    shadowIdx = int(b.w);
+}
 
-// time (seconds)
-uniform float timeSec;
+// smooth cut-off so every light has a finite range
+float rangeWindow(float d, float radius)
+{
+    float x = d / radius;
+    float w = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+    return w * w;
+}
 
-// fog toggle (0/1)
-uniform int useFog;
+// -------- fog volume ----------
+// screen position + continuous depth slice, normalized (froxel centers sit at (k + 0.5) / z)
+vec3 fogCoord()
+{
+    float viewZ = -(view * vec4(vFragPos, 1.0)).z;
+    float slice = log(max(viewZ, 1e-4)) * fogSlice.x - fogSlice.y;
+    vec2 screen = gl_FragCoord.xy / (clusterTileSize * vec2(clusterDims.xy));
+    return vec3(screen, slice / float(textureSize(fogIntegrated, 0).z));
+}
 
-// shadow maps: one per light
-uniform sampler2D shadowMap[3];
-uniform int useShadowMap;
+vec3 applyFog(vec3 c)
+{
+    // integrated slice k holds the fog up to the far edge of slice k: half a slice back
+    vec3 uvw = fogCoord();
+    uvw.z -= 0.5 / float(textureSize(fogIntegrated, 0).z);
+    vec4 f = texture(fogIntegrated, uvw);
+    // as with the old distance fog, far walls never fade out completely
+    return c * max(f.a, 0.22) + f.rgb;
+}
 
+#ifdef LEGACY_STEAM_NOISE
 // -------- robust tiny noise (no overloads) ----------
 float steamHash(vec2 p)
 {
@@ -67,74 +151,122 @@ float steamNoise(vec2 p)
     vec2 u = f * f * (3.0 - 2.0 * f);
     return mix(a, b, u.x) + (c - a) * u.y * (1.0 - u.x) + (d - b) * u.x * u.y;
 }
-
-// -------- color ops ----------
-vec3 toneMapReinhard(vec3 c)
+#endif
+
+// -------- materials ----------
+struct Material {
+    int albedoGroup;    // -1 = vertex color only
+    float albedoLayer;
+    int normalGroup;    // -1 = geometric normal
+    float normalLayer;
+    float tiling;
+    int flags;
+    float emissive;
+};
+
+Material fetchMaterial(int id)
 {
-    c *= max(exposure, 0.0);
-    return c / (vec3(1.0) + c);
+    vec4 a = texelFetch(materialTable, id * 2 + 0);
+    vec4 b = texelFetch(materialTable, id * 2 + 1);
+
+    Material m;
+    m.albedoGroup = int(a.x);
+    m.albedoLayer = a.y;
+    m.normalGroup = int(a.z);
+    m.normalLayer = a.w;
+    m.tiling = b.x;
+    m.flags = int(b.y);
+    m.emissive = b.z;
+    return m;
 }
 
-vec3 applyGamma(vec3 c)
+// array lookup with constant sampler indices (group comes from the material table)
+vec4 sampleMaterialArray(int g, vec3 uvLayer)
 {
-    float g = max(gammaValue, 1e-4);
-    return pow(max(c, vec3(0.0)), vec3(1.0 / g));
+#if MATERIAL_ARRAY_GROUPS > 1
+    if (g == 1) return texture(materialArrays[1], uvLayer);
+#endif
+#if MATERIAL_ARRAY_GROUPS > 2
+    if (g == 2) return texture(materialArrays[2], uvLayer);
+#endif
+#if MATERIAL_ARRAY_GROUPS > 3
+    if (g == 3) return texture(materialArrays[3], uvLayer);
+#endif
+#if MATERIAL_ARRAY_GROUPS > 4
+    if (g == 4) return texture(materialArrays[4], uvLayer);
+#endif
+#if MATERIAL_ARRAY_GROUPS > 5
+    if (g == 5) return texture(materialArrays[5], uvLayer);
+#endif
+#if MATERIAL_ARRAY_GROUPS > 6
+#error "sampleMaterialArray handles up to 6 texture arrays"
+#endif
+    return texture(materialArrays[0], uvLayer);
 }
 
-// -------- existing surface sampling ----------
-vec4 sampleSurface()
+vec4 sampleSurface(Material mat)
 {
-    if (useTextures == 0) return vec4(vColor, 1.0);
-
-    if (vTexId == 0) {
-        vec2 uv = vUV * texTiling.x;
-        return vec4(texture(texAsphalt, uv).rgb * vColor, 1.0);
-    }
-    if (vTexId == 1) {
-        vec2 uv = vUV * texTiling.y;
-        return vec4(texture(texWall, uv).rgb * vColor, 1.0);
-    }
-
-    // IMPORTANT: steam is not an albedo-textured surface
-    if (vTexId == 3) {
-        return vec4(vColor, 1.0);
-    }
-
-    // sign
-    vec2 uv = vUV * texTiling.z;
-    vec4 s = texture(texSign, uv);
-    s.rgb *= vColor;
-
-    if (signBlackKey == 1) {
-        float lum = dot(s.rgb, vec3(0.299, 0.587, 0.114));
-        if (lum < 0.05) s.a = 0.0;
+#ifdef USE_TEXTURES
+    if (mat.albedoGroup >= 0) {
+        vec4 s = sampleMaterialArray(mat.albedoGroup, vec3(vUV * mat.tiling, mat.albedoLayer));
+        s.rgb *= vColor;
+
+        if ((mat.flags & MAT_BLACK_KEY) != 0) {
+            float lum = dot(s.rgb, vec3(0.299, 0.587, 0.114));
+            if (lum < 0.05) s.a = 0.0;
+        }
+        return s;
     }
-    return s;
+#endif
+    return vec4(vColor, 1.0);
 }
 
-vec3 sampleNormalWS()
+vec3 sampleNormalWS(Material mat)
 {
-    vec3 N = normalize(vTBN[2]);
-
-    if (useNormalMap == 0) return N;
-    if (vTexId == 2) return N; // sign
-    if (vTexId == 3) return N; // steam
-
-    vec2 uv = vUV * (vTexId == 0 ? texTiling.x : texTiling.y);
+    vec3 N = normalize(vNormal);
+
+#if !defined(USE_NORMAL_MAP) || !defined(USE_TEXTURES)
+    return N;
+#else
+    if (mat.normalGroup < 0) return N;
+
+    // only X,Y are used (BC5 stores just those); Z is rebuilt, the map is unit length
+    vec2 nXY = sampleMaterialArray(mat.normalGroup, vec3(vUV * mat.tiling, mat.normalLayer)).xy * 2.0 - 1.0;
+    vec3 nTS = vec3(nXY, sqrt(max(1.0 - dot(nXY, nXY), 0.0)));
+
+    // Gram-Schmidt: interpolated T is no longer orthogonal to N
+    vec3 T = normalize(vTangent.xyz - dot(vTangent.xyz, N) * N);
+    vec3 B = cross(N, T) * vTangent.w;
+    return normalize(mat3(T, B, N) * nTS);
+#endif
+}
 
-    vec3 nTS;
-    if (vTexId == 0)
-        nTS = texture(texAsphaltN, uv).xyz * 2.0 - 1.0;
-    else
-        nTS = texture(texWallN, uv).xyz * 2.0 - 1.0;
+#ifdef USE_SHADOW_MAP
+#if SHADOW_LIGHT_COUNT > 4
+#error "sampleShadowMap handles up to 4 shadowed lights"
+#endif
 
-    return normalize(vTBN * nTS);
+// shadow map lookup with constant sampler indices (li comes from the light buffer)
+float sampleShadowMap(int li, vec2 uv)
+{
+#if SHADOW_LIGHT_COUNT > 1
+    if (li == 1) return texture(shadowMap[1], uv).r;
+#endif
+#if SHADOW_LIGHT_COUNT > 2
+    if (li == 2) return texture(shadowMap[2], uv).r;
+#endif
+#if SHADOW_LIGHT_COUNT > 3
+    if (li == 3) return texture(shadowMap[3], uv).r;
+#endif
+    return texture(shadowMap[0], uv).r;
 }
 
 // return 0 = fully lit, 1 = fully shadowed for light index li
 float shadowFactorPCF(int li, vec3 N, vec3 L)
 {
-    vec3 proj = vLightPosLS[li].xyz / max(vLightPosLS[li].w, 1e-6);
+    vec4 ls = lightSpace[li] * vec4(vFragPos, 1.0);
+
+    vec3 proj = ls.xyz / max(ls.w, 1e-6);
     proj = proj * 0.5 + 0.5;
 
     // outside => lit
@@ -143,13 +275,13 @@ float shadowFactorPCF(int li, vec3 N, vec3 L)
 
     float bias = max(0.0015 * (1.0 - dot(N, L)), 0.0006);
 
-    vec2 texel = 1.0 / vec2(textureSize(shadowMap[li], 0));
+    vec2 texel = 1.0 / vec2(textureSize(shadowMap[0], 0)); // all shadow maps share SHADOW_RES
     float shadow = 0.0;
 
     for (int y = -1; y <= 1; y++)
     for (int x = -1; x <= 1; x++)
     {
-        float closest = texture(shadowMap[li], proj.xy + vec2(x, y) * texel).r;
+        float closest = sampleShadowMap(li, proj.xy + vec2(x, y) * texel);
         float current = proj.z - bias;
         shadow += (current > closest) ? 1.0 : 0.0;
     }
@@ -158,69 +290,113 @@ float shadowFactorPCF(int li, vec3 N, vec3 L)
     return shadow;
 }
 
+#if defined(SHADOW_VSM) || defined(SHADOW_EVSM)
+// must match shadow_moments.frag
+const float EVSM_POS = 40.0;
+const float EVSM_NEG = 5.0;
+
+// explicit gradients: called from the light loop, where implicit derivatives are undefined
+vec4 sampleShadowMoments(int li, vec2 uv, vec2 dx, vec2 dy)
+{
+#if SHADOW_LIGHT_COUNT > 1
+    if (li == 1) return textureGrad(shadowMap[1], uv, dx, dy);
+#endif
+#if SHADOW_LIGHT_COUNT > 2
+    if (li == 2) return textureGrad(shadowMap[2], uv, dx, dy);
+#endif
+#if SHADOW_LIGHT_COUNT > 3
+    if (li == 3) return textureGrad(shadowMap[3], uv, dx, dy);
+#endif
+    return textureGrad(shadowMap[0], uv, dx, dy);
+}
+
+// upper bound of the lit fraction (Chebyshev); the low end is cut off against light bleeding
+float chebyshevLit(vec2 m, float t, float minVariance)
+{
+    if (t <= m.x) return 1.0;
+    float variance = max(m.y - m.x * m.x, minVariance);
+    float d = t - m.x;
+    float pMax = variance / (variance + d * d);
+    return clamp((pMax - 0.25) / 0.75, 0.0, 1.0);
+}
+
+// same contract as shadowFactorPCF (0 = lit, 1 = shadowed), one filtered fetch;
+// dPdx/dPdy = screen derivatives of vFragPos, taken in uniform control flow
+float shadowFactorMoments(int li, vec3 dPdx, vec3 dPdy)
+{
+    vec4 ls = lightSpace[li] * vec4(vFragPos, 1.0);
+    vec3 proj = ls.xyz / max(ls.w, 1e-6) * 0.5 + 0.5;
+
+    if (proj.x < 0.0 || proj.x > 1.0 || proj.y < 0.0 || proj.y > 1.0 || proj.z < 0.0 || proj.z > 1.0)
+        return 0.0;
+
+    // light projections are orthographic: derivatives transform linearly
+    vec2 dx = (lightSpace[li] * vec4(dPdx, 0.0)).xy * 0.5;
+    vec2 dy = (lightSpace[li] * vec4(dPdy, 0.0)).xy * 0.5;
+    vec4 m = sampleShadowMoments(li, proj.xy, dx, dy);
+
+    float z = proj.z - 0.0008;
+#ifdef SHADOW_EVSM
+    float d = 2.0 * z - 1.0;
+    float p = exp(EVSM_POS * d);
+    float n = -exp(-EVSM_NEG * d);
+    // depth epsilon scaled by the slope of each warp
+    float pVar = 1e-4 * EVSM_POS * p;
+    float nVar = 1e-4 * EVSM_NEG * n;
+    float lit = min(chebyshevLit(m.xy, p, pVar * pVar), chebyshevLit(m.zw, n, nVar * nVar));
+#else
+    float lit = chebyshevLit(m.xy, z, 1e-5);
+#endif
+    return 1.0 - lit;
+}
+#endif
+#endif
+
 void main()
 {
-    if (codCol == 1) {
-        out_Color = vec4(0.0, 0.0, 0.0, 1.0);
-        return;
-    }
+#ifdef PLANAR_SHADOW
+    out_Color = vec4(0.0, 0.0, 0.0, 1.0);
+    return;
+#endif
+
+    Material mat = fetchMaterial(vMaterialId);
 
     // ----------------------------
-    // STEAM (texId == 3)  (restored)
+    // STEAM (MAT_STEAM)
     // ----------------------------
-    if (vTexId == 3)
+    // particles (steam_particles.cpp): the motion is simulated on the CPU, so a sprite is a
+    // soft disc broken up by noise; vColor.r = opacity, vColor.g = seed
+    if ((mat.flags & MAT_STEAM) != 0)
     {
         vec2 uv = vUV;              // 0..1
         vec2 p = uv * 2.0 - 1.0;    // -1..1
 
         float r2 = dot(p, p);
-        float baseMask = smoothstep(1.35, 0.10, r2);
-        float edgeSoft = smoothstep(1.0, 0.65, sqrt(r2));
-
-        float t = timeSec;
-
-        vec2 drift = vec2(0.18 * sin(t * 0.6), 1.10) * t;
-
-        float n1 = steamNoise(uv * 5.5  + drift * vec2(0.25, 0.55));
-        float n2 = steamNoise(uv * 11.0 + drift * vec2(0.35, 0.85) + vec2(2.3, 1.7));
-        float n3 = steamNoise(uv * 22.0 + drift * vec2(0.55, 1.15) + vec2(5.1, 3.9));
-
-        float turb = 0.55 * n1 + 0.30 * n2 + 0.15 * n3;
-
-        float bottom = smoothstep(0.00, 0.12, uv.y);
-        float topFade = smoothstep(1.0, 0.20, uv.y);
-        float column = bottom * topFade;
-
-        float holes = smoothstep(0.25, 0.8, turb);
-        float streaks = smoothstep(0.15, 0.95, steamNoise(vec2(uv.x * 3.0 + turb, uv.y * 14.0 - t * 0.9)));
+        float baseMask = smoothstep(1.0, 0.05, r2);
+
+#ifdef LEGACY_STEAM_NOISE
+        float holes = smoothstep(0.2, 0.8, steamNoise(uv * 3.0 + vColor.g * 37.0));
+#else
+        // two fetches from the noise volume, drifting through it in opposite directions;
+        // the seed picks a different region per particle
+        vec3 q = vec3(uv * 0.75 + vColor.g * vec2(7.31, 3.17), vColor.g * 5.71);
+        float n = 0.65 * texture(steamNoiseVolume, q + vec3(0.0, 0.0, timeSec * 0.12)).r
+                + 0.35 * texture(steamNoiseVolume, q * 2.0 - vec3(0.0, 0.0, timeSec * 0.21)).r;
+        float holes = smoothstep(0.2, 0.8, n);
+#endif
 
         float intensity = clamp(vColor.r, 0.0, 1.0);
 
-        float alpha = baseMask * edgeSoft * column;
-        alpha *= (0.70 + 0.50 * holes);
-        alpha *= (0.75 + 0.25 * streaks);
-        alpha *= (0.70 * intensity);
-
-        alpha *= 1.0 - smoothstep(0.25, 1.0, abs(p.x));
+        float alpha = baseMask * (0.55 + 0.60 * holes) * intensity;
 
-        if (alpha < 0.012) discard;
+        if (alpha < 0.004) discard;
 
         vec3 V = normalize(viewPos - vFragPos);
 
         float rim = pow(1.0 - max(dot(V, normalize(vec3(0,0,1))), 0.0), 2.0);
 
-        vec3 lightAcc = vec3(0.0);
-        for (int i = 0; i < 3; i++)
-        {
-            vec3 Lvec = lightPos[i] - vFragPos;
-            float d = length(Lvec);
-            vec3 L = Lvec / max(d, 1e-4);
-
-            float scatter = pow(max(dot(L, -V), 0.0), 2.0);
-            float att = 1.0 / (1.0 + 0.18 * d + 0.08 * d * d);
-
-            lightAcc += lightColor[i] * scatter * att;
-        }
+        // light reaching the steam: the fog volume already has it (shadowed, forward scattered)
+        vec3 lightAcc = texture(fogScatter, fogCoord()).rgb;
 
         vec3 baseCol = vec3(0.78, 0.82, 0.88);
         vec3 col = baseCol * (0.25 + 1.35 * dot(lightAcc, vec3(0.333)));
@@ -228,8 +404,9 @@ void main()
         col += (0.35 * rim) * (0.6 + 1.4 * dot(lightAcc, vec3(0.333)));
 
         col = clamp(col, vec3(0.0), vec3(8.0));
-        col = applyGamma(toneMapReinhard(col));
-
+#ifdef USE_FOG
+        col = applyFog(col);
+#endif
         out_Color = vec4(col, alpha);
         return;
     }
@@ -237,15 +414,21 @@ void main()
     // ----------------------------
     // normal surfaces
     // ----------------------------
-    vec4 surf = sampleSurface();
+#if defined(USE_SHADOW_MAP) && (defined(SHADOW_VSM) || defined(SHADOW_EVSM))
+    vec3 dPdx = dFdx(vFragPos);
+    vec3 dPdy = dFdy(vFragPos);
+#endif
 
-    if (vTexId == 2 && surf.a < 0.05)
+    vec4 surf = sampleSurface(mat);
+
+    // alpha-tested pass: blending is off, so a texel is either in or out
+    if ((mat.flags & MAT_ALPHA_TEST) != 0 && surf.a < 0.5)
         discard;
 
     vec3 albedo = surf.rgb;
     float alphaOut = surf.a;
 
-    vec3 N = sampleNormalWS();
+    vec3 N = sampleNormalWS(mat);
     vec3 V = normalize(viewPos - vFragPos);
 
     vec3 result = 0.05 * albedo;
@@ -254,47 +437,45 @@ void main()
     float shininess = 64.0;
     float specStrength = 0.50;
 
-    for (int i = 0; i < 3; i++)
+    uvec2 range = clusterRange();
+    for (uint k = 0u; k < range.y; k++)
     {
-        vec3 Lvec = lightPos[i] - vFragPos;
+        vec3 lPos; float lRadius; vec3 lColor; int lShadow;
+        fetchLight(int(texelFetch(lightIndexList, int(range.x + k)).r), lPos, lRadius, lColor, lShadow);
+
+        vec3 Lvec = lPos - vFragPos;
         float dist = length(Lvec);
         vec3 L = normalize(Lvec);
 
-        float attenuation = 1.0 / (1.0 + 0.10*dist + 0.06*dist*dist);
+        float attenuation = rangeWindow(dist, lRadius) / (1.0 + 0.10*dist + 0.06*dist*dist);
 
         float diff = max(dot(N, L), 0.0);
         vec3 R = reflect(-L, N);
         float spec = pow(max(dot(V, R), 0.0), shininess);
 
-        vec3 diffuse  = diff * albedo * lightColor[i] * lightBoost;
-        vec3 specular = specStrength * spec * lightColor[i] * lightBoost;
+        vec3 diffuse  = diff * albedo * lColor * lightBoost;
+        vec3 specular = specStrength * spec * lColor * lightBoost;
 
         float shadow = 0.0;
-        if (useShadowMap == 1)
-            shadow = shadowFactorPCF(i, N, L);
+#ifdef USE_SHADOW_MAP
+        if (lShadow >= 0)
+#if defined(SHADOW_VSM) || defined(SHADOW_EVSM)
+            shadow = shadowFactorMoments(lShadow, dPdx, dPdy);
+#else
+            shadow = shadowFactorPCF(lShadow, N, L);
+#endif
+#endif
 
         result += attenuation * ((1.0 - shadow) * (diffuse + specular));
     }
 
-    if (vTexId == 2) {
-        result += albedo * 1.2;
-    }
-
-    if (useFog == 1) {
-        float fogDensity = 0.075;
-        vec3 fogColor = vec3(0.045, 0.03, 0.07);
+    // emissive materials (signs)
+    result += albedo * mat.emissive;
 
-        float dFog = length(viewPos - vFragPos);
-
-        float fogFactor = exp(-fogDensity * dFog);
-        fogFactor = clamp(fogFactor, 0.0, 1.0);
-
-        fogFactor = pow(fogFactor, 1.35);
-        fogFactor = max(fogFactor, 0.22);
-
-        result = mix(fogColor, result, fogFactor);
-    }
+#ifdef USE_FOG
+    result = applyFog(result);
+#endif
 
-    result = applyGamma(toneMapReinhard(result));
+    // linear HDR: exposure, tone mapping and gamma are applied once per pixel (post_tonemap.frag)
     out_Color = vec4(result, alphaOut);
 }
\ No newline at end of file
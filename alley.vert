@@ -1,61 +1,94 @@
 #version 330 core
 
+// Compile-time permutations (defines injected by shader_cache.cpp):
+//  USE_TEXTURES, USE_NORMAL_MAP, USE_FOG, USE_SHADOW_MAP, PLANAR_SHADOW
+//  SHADOW_LIGHT_COUNT = number of shadow-mapped lights (1..4)
+//  MATERIAL_ARRAY_GROUPS = number of texture arrays (see materials.hpp)
+//  LEGACY_VERTEX_PATH = old per-vertex normal matrix + light-space outputs (vertex benchmark only)
+#ifndef SHADOW_LIGHT_COUNT
+#define SHADOW_LIGHT_COUNT 3
+#endif
+
 layout(location=0) in vec4 in_Position;
 layout(location=1) in vec3 in_Color;
 layout(location=2) in vec3 in_Normal;
 layout(location=3) in vec2 in_TexCoord;
-layout(location=4) in float in_TexId;
-layout(location=5) in vec3 in_Tangent;
-layout(location=6) in vec3 in_Bitangent;
+layout(location=4) in float in_MaterialId;
+layout(location=5) in vec4 in_Tangent;  // xyz = tangent, w = handedness (+1 / -1)
+
+// shared std140 blocks (bindings set by BindUniformBlocks in main.cpp)
+layout(std140) uniform FrameData {
+    float timeSec;
+    float exposure;
+    float gammaValue;
+    float framePad0;
+};
+
+layout(std140) uniform ViewData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    ivec3 clusterDims;
+    vec2 clusterTileSize;   // pixels per tile
+    vec2 clusterSlice;      // slice = log(viewZ) * x - y
+    vec2 fogSlice;          // same, for the fog volume
+};
 
-uniform mat4 matrUmbra;
-uniform mat4 myMatrix;
-uniform mat4 view;
-uniform mat4 projection;
-uniform int codCol;
+// shadow mapping: one matrix per shadowed light
+layout(std140) uniform LightData {
+    mat4 lightSpace[SHADOW_LIGHT_COUNT];
+    mat4 matrUmbra;
+};
 
-// shadow mapping: 3 lights
-uniform mat4 lightSpace[3];
+// normalMatrix = transpose(inverse(mat3(myMatrix))), computed on the CPU per draw
+layout(std140) uniform ObjectData {
+    mat4 myMatrix;
+    mat3 normalMatrix;
+};
+
+// the depth prepass (shadow_depth.vert + DEPTH_PREPASS) must produce the same depth
+invariant gl_Position;
 
 out vec3 vColor;
 out vec3 vFragPos;
 out vec2 vUV;
-flat out int vTexId;
+flat out int vMaterialId;
 
-// TBN in world space
+#ifndef LEGACY_VERTEX_PATH
+// compact TBN in world space: B = cross(N, T) * vTangent.w in the fragment shader
+out vec3 vNormal;
+out vec4 vTangent;
+#else
 out mat3 vTBN;
-
-// positions in each light clip space
-out vec4 vLightPosLS[3];
+out vec4 vLightPosLS[SHADOW_LIGHT_COUNT];
+#endif
 
 void main()
 {
     vec4 worldPos = myMatrix * in_Position;
     vFragPos = worldPos.xyz;
 
+#ifndef LEGACY_VERTEX_PATH
+    vNormal = normalMatrix * in_Normal;
+    vTangent = vec4(normalMatrix * in_Tangent.xyz, in_Tangent.w);
+#else
+    // reference for the vertex benchmark: what alley.vert used to do for every vertex
     mat3 normalMat = transpose(inverse(mat3(myMatrix)));
-
     vec3 N = normalize(normalMat * in_Normal);
-    vec3 T = normalize(normalMat * in_Tangent);
-    vec3 B = normalize(normalMat * in_Bitangent);
-
-    // re-orthonormalize
+    vec3 T = normalize(normalMat * in_Tangent.xyz);
     T = normalize(T - dot(T, N) * N);
-    B = normalize(cross(N, T));
-
-    vTBN = mat3(T, B, N);
+    vTBN = mat3(T, normalize(cross(N, T)) * in_Tangent.w, N);
+    for (int i = 0; i < SHADOW_LIGHT_COUNT; i++)
+        vLightPosLS[i] = lightSpace[i] * worldPos;
+#endif
 
     vColor = in_Color;
     vUV = in_TexCoord;
-    vTexId = int(in_TexId + 0.5);
-
-    // compute clip-space positions for each light
-    vLightPosLS[0] = lightSpace[0] * worldPos;
-    vLightPosLS[1] = lightSpace[1] * worldPos;
-    vLightPosLS[2] = lightSpace[2] * worldPos;
+    vMaterialId = int(in_MaterialId + 0.5);
 
-    if (codCol == 0)
-        gl_Position = projection * view * worldPos;
-    else
-        gl_Position = projection * view * matrUmbra * worldPos;
+#ifdef PLANAR_SHADOW
+    gl_Position = projection * view * matrUmbra * worldPos;
+#else
+    gl_Position = projection * view * worldPos;
+#endif
 }
\ No newline at end of file
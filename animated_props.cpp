@@ -0,0 +1,69 @@
+// Animated props through a persistently mapped vertex ring (see animated_props.hpp).
+
+#include <stdio.h>
+
+#include "animated_props.hpp"
+#include "gpu_profiler.hpp"
+
+bool AnimatedProps::Init(const std::vector<SceneCable>& c, int frames)
+{
+    Destroy();
+
+    cables = c;
+
+    firstVertex.clear();
+    totalVertices = 0;
+    for (const SceneCable& cable : cables) {
+        firstVertex.push_back(totalVertices);
+        totalVertices += CableVertexCount(cable);
+    }
+
+    if (totalVertices == 0) return true;
+
+    // whole vertices per region, so a region's byte offset converts to a first vertex
+    if (!ring.Init(GL_ARRAY_BUFFER, BytesPerFrame(), frames)) return false;
+
+    printf("Animated props: %zu cables, %d vertices, %.1f KB/frame\n",
+        cables.size(), totalVertices, BytesPerFrame() / 1024.0);
+    return true;
+}
+
+void AnimatedProps::Destroy()
+{
+    ring.Destroy();
+    active = false;
+    frameData = nullptr;
+}
+
+void AnimatedProps::Begin(float t, JobSystem& jobs)
+{
+    active = false;
+    if (totalVertices == 0) return;
+
+    ring.BeginFrame();
+    frameData = (Vtx*)ring.Alloc(BytesPerFrame(), 4, frameOffset);
+    if (!frameData) return;
+
+    int count = (int)firstVertex.size();
+    for (int begin = 0; begin < count; begin += ANIMATED_PROPS_PER_JOB) {
+        int end = begin + ANIMATED_PROPS_PER_JOB < count ? begin + ANIMATED_PROPS_PER_JOB : count;
+        jobs.Spawn("animated props", [this, t, begin, end]
+            {
+                for (int i = begin; i < end; i++) WriteCable(cables[i], t, frameData + firstVertex[i]);
+            }, &written);
+    }
+    active = true;
+}
+
+void AnimatedProps::Finish(JobSystem& jobs)
+{
+    jobs.Wait(written);
+    if (active) ring.Commit(frameOffset, BytesPerFrame());
+}
+
+void AnimatedProps::DrawCables() const
+{
+    if (!active) return;
+    glDrawArrays(GL_TRIANGLES, (GLint)(frameOffset / sizeof(Vtx)), totalVertices);
+    GpuCountDraw(totalVertices);
+}
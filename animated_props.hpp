@@ -0,0 +1,54 @@
+#ifndef ANIMATED_PROPS_H
+#define ANIMATED_PROPS_H
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "scene.hpp"
+#include "gpu_ring.hpp"
+#include "job_system.hpp"
+
+// Per-frame procedural geometry: cables swaying in the wind (steam is steam_particles.hpp).
+// Static geometry stays in the immutable scene buffers; these are regenerated every frame by
+// jobs straight into a persistently mapped, fenced vertex ring (gpu_ring.hpp), so animating
+// them costs only their own bytes per frame and never touches the static buffers.
+// Every cable has a fixed slot, so the jobs write disjoint ranges and all of them are one
+// glDrawArrays from the current frame's region.
+//
+// Per frame (main thread):
+//   props.Begin(t, jobs);   // ring region + one job per batch of props
+//   ...                     // other CPU work
+//   props.Finish(jobs);     // waits for the jobs (usually done), commits on the fallback path
+//   draw: bind a VAO over Buffer() (layout of Vtx), DrawCables()
+//   props.EndFrame();       // after the last draw that reads this frame's region
+
+static const int ANIMATED_PROPS_PER_JOB = 4;
+
+class AnimatedProps {
+public:
+    bool Init(const std::vector<SceneCable>& cables, int frames = 3);
+    void Destroy();
+
+    void Begin(float t, JobSystem& jobs);
+    void Finish(JobSystem& jobs);
+    void EndFrame() { ring.EndFrame(); }
+
+    void DrawCables() const;
+
+    GLuint Buffer() const { return ring.Buffer(); }
+    size_t BytesPerFrame() const { return (size_t)totalVertices * sizeof(Vtx); }
+    double WaitMs() const { return ring.WaitMs(); }
+
+private:
+    std::vector<SceneCable> cables;
+    std::vector<int> firstVertex;   // per cable
+    int totalVertices = 0;
+
+    GpuRing ring;
+    JobCounter written;
+    Vtx* frameData = nullptr;
+    GLintptr frameOffset = 0;
+    bool active = false;            // this frame's region holds valid vertices
+};
+
+#endif
@@ -0,0 +1,177 @@
+// Memory-mapped asset pack reader + writer (see asset_pack.hpp).
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "asset_pack.hpp"
+
+// ---------------- AssetPack ----------------
+bool AssetPack::Open(const char* path, unsigned int vertexSize)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (f == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER len;
+    if (!GetFileSizeEx(f, &len) || len.QuadPart < (LONGLONG)sizeof(PackHeader)) {
+        CloseHandle(f);
+        return false;
+    }
+
+    HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+    void* view = m ? MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!view) {
+        if (m) CloseHandle(m);
+        CloseHandle(f);
+        return false;
+    }
+    file = f;
+    mapping = m;
+    base = (const unsigned char*)view;
+    size = (size_t)len.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(PackHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file alive
+    if (view == MAP_FAILED) return false;
+
+    // the whole file is about to be read once: start paging it in now
+    madvise(view, (size_t)st.st_size, MADV_WILLNEED);
+
+    base = (const unsigned char*)view;
+    size = (size_t)st.st_size;
+#endif
+
+    PackHeader h;
+    memcpy(&h, base, sizeof(h));
+    size_t tableEnd = sizeof(PackHeader) + (size_t)h.sectionCount * sizeof(PackSection);
+
+    bool ok = h.magic == ASSET_PACK_MAGIC && h.fileSize == size && tableEnd <= size;
+    if (ok && (h.version != ASSET_PACK_VERSION || h.vertexSize != vertexSize)) {
+        printf("WARN: %s is version %u / vertex %u bytes, expected %u / %u (run the bundler again)\n",
+            path, h.version, h.vertexSize, ASSET_PACK_VERSION, vertexSize);
+        ok = false;
+    }
+
+    if (ok) {
+        sections.resize(h.sectionCount);
+        if (h.sectionCount) memcpy(sections.data(), base + sizeof(PackHeader), (size_t)h.sectionCount * sizeof(PackSection));
+        for (const PackSection& s : sections) {
+            if (s.offset > size || s.size > size - s.offset || s.name[sizeof(s.name) - 1] != 0) { ok = false; break; }
+        }
+        if (!ok) printf("WARN: %s is damaged\n", path);
+    }
+
+    if (!ok) Close();
+    return ok;
+}
+
+void AssetPack::Close()
+{
+#ifdef _WIN32
+    if (base) UnmapViewOfFile(base);
+    if (mapping) CloseHandle((HANDLE)mapping);
+    if (file) CloseHandle((HANDLE)file);
+    mapping = nullptr;
+    file = nullptr;
+#else
+    if (base) munmap((void*)base, size);
+#endif
+    base = nullptr;
+    size = 0;
+    sections.clear();
+}
+
+const PackSection* AssetPack::Find(unsigned int type, const char* name) const
+{
+    for (const PackSection& s : sections) {
+        if (s.type == type && (!name || strcmp(s.name, name) == 0)) return &s;
+    }
+    return nullptr;
+}
+
+// ---------------- AssetPackWriter ----------------
+void AssetPackWriter::Add(unsigned int type, const char* name, const void* data, size_t bytes)
+{
+    Entry e;
+    memset(&e.section, 0, sizeof(e.section));
+    e.section.type = type;
+    e.section.size = bytes;
+    snprintf(e.section.name, sizeof(e.section.name), "%s", name ? name : "");
+    e.data.assign((const unsigned char*)data, (const unsigned char*)data + bytes);
+    entries.push_back(std::move(e));
+}
+
+static unsigned long long alignUp(unsigned long long v)
+{
+    return (v + ASSET_PACK_ALIGN - 1) / ASSET_PACK_ALIGN * ASSET_PACK_ALIGN;
+}
+
+bool AssetPackWriter::Write(const char* path, unsigned int vertexSize) const
+{
+    std::vector<PackSection> table;
+    unsigned long long offset = alignUp(sizeof(PackHeader) + entries.size() * sizeof(PackSection));
+    for (const Entry& e : entries) {
+        PackSection s = e.section;
+        s.offset = offset;
+        table.push_back(s);
+        offset = alignUp(offset + s.size);
+    }
+
+    PackHeader h;
+    h.magic = ASSET_PACK_MAGIC;
+    h.version = ASSET_PACK_VERSION;
+    h.sectionCount = (unsigned int)entries.size();
+    h.vertexSize = vertexSize;
+    h.fileSize = offset;
+
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        printf("Nu am putut scrie: %s\n", path);
+        return false;
+    }
+
+    static const unsigned char zeros[ASSET_PACK_ALIGN] = { 0 };
+    auto padTo = [&](unsigned long long pos)
+        {
+            long cur = ftell(f);
+            if (cur >= 0 && (unsigned long long)cur < pos) fwrite(zeros, 1, (size_t)(pos - (unsigned long long)cur), f);
+        };
+
+    fwrite(&h, sizeof(h), 1, f);
+    if (!table.empty()) fwrite(table.data(), sizeof(PackSection), table.size(), f);
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        padTo(table[i].offset);
+        if (!entries[i].data.empty()) fwrite(entries[i].data.data(), 1, entries[i].data.size(), f);
+    }
+    padTo(h.fileSize);
+
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
@@ -0,0 +1,94 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <string>
+#include <vector>
+
+// Whole-scene asset pack (alley.pack), written offline by the bundler (bundle.cpp):
+// the final vertex/index buffers, draw ranges, instance table, animated prop descriptions,
+// KTX textures, the steam noise volume and program binaries, each in its own section. The game maps the file read-only and hands pointers
+// into the mapping straight to GL, so startup does no OBJ parsing, decoding or copying.
+//
+// Layout (little endian):
+//  page 0     PackHeader, then sectionCount x PackSection
+//  page 1..   section data, every section starts on an ASSET_PACK_ALIGN boundary
+//
+// A pack with another version or vertex size is rejected and the game builds the scene itself.
+
+static const unsigned int ASSET_PACK_MAGIC = 0x4B505941;    // "AYPK"
+static const unsigned int ASSET_PACK_VERSION = 4;     // 2: cables + steam moved to their own sections, 3: steam emitters, 4: batches
+static const unsigned int ASSET_PACK_ALIGN = 4096;
+
+enum PackSectionType {
+    PACK_VERTICES = 1,      // Vtx[]
+    PACK_INDICES = 2,       // unsigned int[]
+    PACK_RANGES = 3,        // SceneRanges
+    PACK_INSTANCES = 4,     // SceneInstance[]
+    PACK_TEXTURE = 5,       // KTX file; name = image path used by the materials
+    PACK_SHADER_BINARY = 6, // shader cache entry; name = cache key (16 hex digits)
+    PACK_CABLES = 7,        // SceneCable[] (animated, not in the buffers)
+    PACK_STEAM = 8,         // SceneSteam[] (particle emitters)
+    PACK_BATCHES = 9,       // SceneBatch[] (per-pass sorting)
+    PACK_NOISE = 10         // NoiseVolumeHeader + voxels (steam noise volume)
+};
+
+struct PackHeader {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int sectionCount;
+    unsigned int vertexSize;        // sizeof(Vtx) when written
+    unsigned long long fileSize;
+};
+
+struct PackSection {
+    unsigned int type;
+    unsigned int reserved;
+    unsigned long long offset;      // from the start of the file
+    unsigned long long size;
+    char name[104];
+};
+
+static_assert(sizeof(PackHeader) == 24, "pack header layout");
+static_assert(sizeof(PackSection) == 128, "pack section layout");
+
+class AssetPack {
+public:
+    ~AssetPack() { Close(); }
+
+    // maps the whole file read-only and checks header + section bounds
+    bool Open(const char* path, unsigned int vertexSize);
+    void Close();
+    bool IsOpen() const { return base != nullptr; }
+
+    // first section of that type (and name, if given); nullptr if missing
+    const PackSection* Find(unsigned int type, const char* name = nullptr) const;
+    const unsigned char* Data(const PackSection& s) const { return base + s.offset; }
+
+    int SectionCount() const { return (int)sections.size(); }
+    size_t FileSize() const { return size; }
+
+private:
+    const unsigned char* base = nullptr;
+    size_t size = 0;
+    std::vector<PackSection> sections;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
+
+// used by the bundler; sections are kept in memory until Write
+class AssetPackWriter {
+public:
+    void Add(unsigned int type, const char* name, const void* data, size_t bytes);
+    bool Write(const char* path, unsigned int vertexSize) const;
+
+private:
+    struct Entry {
+        PackSection section;
+        std::vector<unsigned char> data;
+    };
+    std::vector<Entry> entries;
+};
+
+#endif
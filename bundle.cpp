@@ -0,0 +1,145 @@
+// bundle: offline asset bundler -> alley.pack (asset_pack.hpp), mapped by the game at startup.
+//  - runs BuildAlley (OBJ props included) and stores the welded vertex/index buffers,
+//    the draw ranges, the per-pass batches, the prop instance table and the animated cables/steam
+//  - textures: the .ktx next to each image if texpack made one, otherwise compressed here
+//  - the steam noise volume (noise_volume.hpp), so the game does not generate it at startup
+//  - program binaries: every <shader_cache>/<key>.bin the game wrote on this machine
+//    (run the game once and toggle the variants you care about before bundling; other
+//    drivers simply miss them and compile from source)
+//
+// Usage: bundle [out.pack] [--shaders dir]     (defaults: alley.pack, shader_cache)
+//
+// Time to first frame, cold vs warm (the game prints it and exits with --ttff):
+//  cold: drop the OS file cache (Linux: sync; echo 3 > /proc/sys/vm/drop_caches) then run once
+//  warm: run again right away
+//  compare `alley --ttff` (pack) with `alley --ttff --no-pack` (OBJ + SOIL/KTX + BuildAlley)
+//
+// Excluded from the game build (this file is empty without BUILD_BUNDLE):
+// Build (g++): g++ -std=c++17 -DBUILD_BUNDLE -O2 bundle.cpp asset_pack.cpp scene.cpp resources.cpp objloader.cpp texture_compress.cpp texture_loader.cpp job_system.cpp noise_volume.cpp cpu_profiler.cpp -lSOIL -lGLEW -lGL -pthread -o bundle
+#ifdef BUILD_BUNDLE
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+
+#include "asset_pack.hpp"
+#include "scene.hpp"
+#include "texture_compress.hpp"
+#include "resources.hpp"
+#include "noise_volume.hpp"
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& out)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    bool ok = len > 0;
+    if (ok) {
+        out.resize((size_t)len);
+        ok = fread(out.data(), 1, out.size(), f) == out.size();
+    }
+    fclose(f);
+    return ok;
+}
+
+static bool addTexture(AssetPackWriter& pack, const SceneTexture& t)
+{
+    std::vector<unsigned char> bytes;
+    KtxView view;
+    std::string ktxPath = KtxPathFor(t.path);
+
+    if (readFile(ktxPath, bytes) && ParseKTX(bytes.data(), bytes.size(), view)) {
+        printf("  %-16s <- %s\n", t.path, ktxPath.c_str());
+    }
+    else {
+        KtxImage ktx;
+        if (!CompressImageFile(t.path, t.normalMap, ktx)) return false;
+        SerializeKTX(ktx, bytes);
+        printf("  %-16s compressed (%dx%d, %zu mips)\n", t.path, ktx.width, ktx.height, ktx.levels.size());
+    }
+
+    pack.Add(PACK_TEXTURE, t.path, bytes.data(), bytes.size());
+    return true;
+}
+
+// cache entries are named <16 hex digits>.bin, the name is the lookup key in the pack
+static int addShaderBinaries(AssetPackWriter& pack, const std::string& dir)
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    int count = 0;
+
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        const fs::path& p = it->path();
+        std::string key = p.stem().string();
+        if (p.extension() != ".bin" || key.size() != 16 || key.find_first_not_of("0123456789abcdef") != std::string::npos) continue;
+
+        std::vector<unsigned char> bytes;
+        if (!readFile(p.string(), bytes)) continue;
+        pack.Add(PACK_SHADER_BINARY, key.c_str(), bytes.data(), bytes.size());
+        count++;
+    }
+    return count;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* outPath = "alley.pack";
+    std::string shaderDir = "shader_cache";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--shaders") == 0 && i + 1 < argc) shaderDir = argv[++i];
+        else outPath = argv[i];
+    }
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    AssetPackWriter pack;
+
+    MeshCache meshes;
+    InitMeshCache(meshes, 0);   // nothing is kept after the build
+    SceneData scene;
+    BuildAlley(scene, meshes, true);
+    pack.Add(PACK_VERTICES, "vertices", scene.vertices.data(), scene.vertices.size() * sizeof(Vtx));
+    pack.Add(PACK_INDICES, "indices", scene.indices.data(), scene.indices.size() * sizeof(unsigned int));
+    pack.Add(PACK_RANGES, "ranges", &scene.ranges, sizeof(SceneRanges));
+    pack.Add(PACK_INSTANCES, "instances", scene.instances.data(), scene.instances.size() * sizeof(SceneInstance));
+    pack.Add(PACK_BATCHES, "batches", scene.batches.data(), scene.batches.size() * sizeof(SceneBatch));
+    pack.Add(PACK_CABLES, "cables", scene.cables.data(), scene.cables.size() * sizeof(SceneCable));
+    pack.Add(PACK_STEAM, "steam", scene.steam.data(), scene.steam.size() * sizeof(SceneSteam));
+    printf("Scene: %zu vertices, %zu indices, %zu instances, %zu cables, %zu steam puffs\n",
+        scene.vertices.size(), scene.indices.size(), scene.instances.size(), scene.cables.size(), scene.steam.size());
+
+    printf("Textures:\n");
+    int failed = 0;
+    for (int i = 0; i < SCENE_TEXTURE_COUNT; i++) {
+        if (!addTexture(pack, SCENE_TEXTURES[i])) failed++;
+    }
+
+    NoiseVolumeHeader noise = { NOISE_VOLUME_SIZE, NOISE_VOLUME_PERIOD, NOISE_VOLUME_OCTAVES, NOISE_VOLUME_SEED };
+    std::vector<unsigned char> voxels;
+    GenerateNoiseVolume(noise, voxels, nullptr);
+    std::vector<unsigned char> noiseData((const unsigned char*)&noise, (const unsigned char*)&noise + sizeof(noise));
+    noiseData.insert(noiseData.end(), voxels.begin(), voxels.end());
+    pack.Add(PACK_NOISE, "steam_noise", noiseData.data(), noiseData.size());
+    printf("Steam noise: %d^3, %d octaves\n", noise.size, noise.octaves);
+
+    int shaders = addShaderBinaries(pack, shaderDir);
+    printf("Program binaries: %d from %s/\n", shaders, shaderDir.c_str());
+
+    if (!pack.Write(outPath, sizeof(Vtx))) return 1;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+    printf("%s written (%.1f ms)%s\n", outPath, ms, failed ? ", some textures are missing" : "");
+    return failed ? 1 : 0;
+}
+
+#endif // BUILD_BUNDLE
@@ -0,0 +1,315 @@
+// Clustered light culling (CPU) + texture buffer upload.
+// - lights are transformed to view space and bounded 4 at a time with SSE (scalar fallback)
+// - each light is inserted into every froxel of its conservative screen/depth range
+// - froxel lists are built with a count / prefix-sum / fill pass (no per-froxel allocations)
+// - with a job system and enough lights, bounds run in chunks of lights and count/fill in
+//   chunks of depth slices
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLUSTER_USE_SSE 1
+#endif
+
+#include "clustered_lights.hpp"
+
+bool LightClusters::Init()
+{
+    glGenBuffers(1, &lightBuf);
+    glGenBuffers(1, &gridBuf);
+    glGenBuffers(1, &indexBuf);
+
+    glGenTextures(1, &lightTex);
+    glGenTextures(1, &gridTex);
+    glGenTextures(1, &indexTex);
+
+    // grid has a fixed size
+    glBindBuffer(GL_TEXTURE_BUFFER, gridBuf);
+    glBufferData(GL_TEXTURE_BUFFER, CLUSTER_COUNT * 2 * sizeof(unsigned int), NULL, GL_STREAM_DRAW);
+
+    glBindTexture(GL_TEXTURE_BUFFER, gridTex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, gridBuf);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    grid.assign(CLUSTER_COUNT * 2, 0);
+    cursor.assign(CLUSTER_COUNT, 0);
+    return true;
+}
+
+void LightClusters::Destroy()
+{
+    if (lightTex) glDeleteTextures(1, &lightTex);
+    if (gridTex) glDeleteTextures(1, &gridTex);
+    if (indexTex) glDeleteTextures(1, &indexTex);
+    if (lightBuf) glDeleteBuffers(1, &lightBuf);
+    if (gridBuf) glDeleteBuffers(1, &gridBuf);
+    if (indexBuf) glDeleteBuffers(1, &indexBuf);
+    lightTex = gridTex = indexTex = 0;
+    lightBuf = gridBuf = indexBuf = 0;
+    lightCapacity = indexCapacity = 0;
+}
+
+// view-space depth range + NDC xy bounds of a light sphere
+struct LightBounds {
+    float zmin, zmax;
+    float xl, xh, yl, yh;
+};
+
+static inline void boundsScalar(const PointLight& L, const glm::mat4& V, float p00, float p11, float zNear, LightBounds& b)
+{
+    float vx = V[0][0] * L.pos.x + V[1][0] * L.pos.y + V[2][0] * L.pos.z + V[3][0];
+    float vy = V[0][1] * L.pos.x + V[1][1] * L.pos.y + V[2][1] * L.pos.z + V[3][1];
+    float vz = V[0][2] * L.pos.x + V[1][2] * L.pos.y + V[2][2] * L.pos.z + V[3][2];
+
+    float d = -vz;
+    b.zmin = d - L.radius;
+    b.zmax = d + L.radius;
+
+    if (b.zmin <= zNear) {
+        // sphere crosses the near plane => conservative full screen
+        b.xl = b.yl = -1.0f;
+        b.xh = b.yh = 1.0f;
+        return;
+    }
+
+    float r = L.radius;
+    b.xl = std::min((vx - r) / b.zmin, (vx - r) / b.zmax) * p00;
+    b.xh = std::max((vx + r) / b.zmin, (vx + r) / b.zmax) * p00;
+    b.yl = std::min((vy - r) / b.zmin, (vy - r) / b.zmax) * p11;
+    b.yh = std::max((vy + r) / b.zmin, (vy + r) / b.zmax) * p11;
+}
+
+static inline int tileOf(float ndc, int count)
+{
+    int t = (int)floorf((ndc * 0.5f + 0.5f) * (float)count);
+    if (t < 0) t = 0;
+    if (t > count - 1) t = count - 1;
+    return t;
+}
+
+static inline void rangeOf(const LightBounds& b, float zNear, float zFar, float sliceScale, float sliceBias,
+    int& x0, int& x1, int& y0, int& y1, int& z0, int& z1)
+{
+    bool visible = b.zmax > zNear && b.zmin < zFar &&
+        b.xh >= -1.0f && b.xl <= 1.0f && b.yh >= -1.0f && b.yl <= 1.0f;
+    if (!visible) {
+        x0 = 1; x1 = 0; // empty
+        return;
+    }
+
+    float zs = std::max(b.zmin, zNear);
+    float ze = std::min(b.zmax, zFar);
+
+    z0 = std::max(0, (int)floorf(logf(zs) * sliceScale - sliceBias));
+    z1 = std::min(CLUSTER_Z - 1, (int)floorf(logf(ze) * sliceScale - sliceBias));
+
+    x0 = tileOf(b.xl, CLUSTER_X); x1 = tileOf(b.xh, CLUSTER_X);
+    y0 = tileOf(b.yl, CLUSTER_Y); y1 = tileOf(b.yh, CLUSTER_Y);
+}
+
+// lights [begin, end); begin is a multiple of 4 when called in chunks
+void LightClusters::ComputeRanges(const std::vector<PointLight>& lights, size_t begin, size_t end,
+    const glm::mat4& V, float p00, float p11, float zNear, float zFar)
+{
+    size_t i = begin;
+
+#ifdef CLUSTER_USE_SSE
+    const __m128 m00 = _mm_set1_ps(V[0][0]), m10 = _mm_set1_ps(V[1][0]), m20 = _mm_set1_ps(V[2][0]), m30 = _mm_set1_ps(V[3][0]);
+    const __m128 m01 = _mm_set1_ps(V[0][1]), m11 = _mm_set1_ps(V[1][1]), m21 = _mm_set1_ps(V[2][1]), m31 = _mm_set1_ps(V[3][1]);
+    const __m128 m02 = _mm_set1_ps(V[0][2]), m12 = _mm_set1_ps(V[1][2]), m22 = _mm_set1_ps(V[2][2]), m32 = _mm_set1_ps(V[3][2]);
+    const __m128 vp00 = _mm_set1_ps(p00), vp11 = _mm_set1_ps(p11);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (; i + 4 <= end; i += 4) {
+        const PointLight* L = &lights[i];
+
+        // AoS -> SoA
+        __m128 px = _mm_setr_ps(L[0].pos.x, L[1].pos.x, L[2].pos.x, L[3].pos.x);
+        __m128 py = _mm_setr_ps(L[0].pos.y, L[1].pos.y, L[2].pos.y, L[3].pos.y);
+        __m128 pz = _mm_setr_ps(L[0].pos.z, L[1].pos.z, L[2].pos.z, L[3].pos.z);
+        __m128 r = _mm_setr_ps(L[0].radius, L[1].radius, L[2].radius, L[3].radius);
+
+        __m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m10, py)), _mm_add_ps(_mm_mul_ps(m20, pz), m30));
+        __m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, px), _mm_mul_ps(m11, py)), _mm_add_ps(_mm_mul_ps(m21, pz), m31));
+        __m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, px), _mm_mul_ps(m12, py)), _mm_add_ps(_mm_mul_ps(m22, pz), m32));
+
+        __m128 d = _mm_sub_ps(zero, vz);
+        __m128 zmin = _mm_sub_ps(d, r);
+        __m128 zmax = _mm_add_ps(d, r);
+
+        // lanes crossing the near plane are patched to full screen below; avoid div by ~0 here
+        __m128 safeMin = _mm_max_ps(zmin, _mm_set1_ps(1e-4f));
+        __m128 invMin = _mm_div_ps(_mm_set1_ps(1.0f), safeMin);
+        __m128 invMax = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(zmax, _mm_set1_ps(1e-4f)));
+
+        __m128 xlo = _mm_sub_ps(vx, r), xhi = _mm_add_ps(vx, r);
+        __m128 ylo = _mm_sub_ps(vy, r), yhi = _mm_add_ps(vy, r);
+
+        __m128 xl = _mm_mul_ps(_mm_min_ps(_mm_mul_ps(xlo, invMin), _mm_mul_ps(xlo, invMax)), vp00);
+        __m128 xh = _mm_mul_ps(_mm_max_ps(_mm_mul_ps(xhi, invMin), _mm_mul_ps(xhi, invMax)), vp00);
+        __m128 yl = _mm_mul_ps(_mm_min_ps(_mm_mul_ps(ylo, invMin), _mm_mul_ps(ylo, invMax)), vp11);
+        __m128 yh = _mm_mul_ps(_mm_max_ps(_mm_mul_ps(yhi, invMin), _mm_mul_ps(yhi, invMax)), vp11);
+
+        alignas(16) float a_zmin[4], a_zmax[4], a_xl[4], a_xh[4], a_yl[4], a_yh[4];
+        _mm_store_ps(a_zmin, zmin); _mm_store_ps(a_zmax, zmax);
+        _mm_store_ps(a_xl, xl); _mm_store_ps(a_xh, xh);
+        _mm_store_ps(a_yl, yl); _mm_store_ps(a_yh, yh);
+
+        for (int k = 0; k < 4; k++) {
+            LightBounds b;
+            b.zmin = a_zmin[k]; b.zmax = a_zmax[k];
+            if (b.zmin <= zNear) {
+                b.xl = b.yl = -1.0f;
+                b.xh = b.yh = 1.0f;
+            }
+            else {
+                b.xl = a_xl[k]; b.xh = a_xh[k];
+                b.yl = a_yl[k]; b.yh = a_yh[k];
+            }
+            Range& rg = ranges[i + k];
+            rangeOf(b, zNear, zFar, sliceScale, sliceBias, rg.x0, rg.x1, rg.y0, rg.y1, rg.z0, rg.z1);
+        }
+    }
+#endif
+
+    for (; i < end; i++) {
+        LightBounds b;
+        boundsScalar(lights[i], V, p00, p11, zNear, b);
+        Range& rg = ranges[i];
+        rangeOf(b, zNear, zFar, sliceScale, sliceBias, rg.x0, rg.x1, rg.y0, rg.y1, rg.z0, rg.z1);
+    }
+}
+
+// count (fill = false) or fill the froxels of depth slices [zBegin, zEnd); slices are disjoint
+// between jobs, and lights are visited in order, so the lists match the serial build exactly
+void LightClusters::Scatter(int zBegin, int zEnd, bool fill)
+{
+    for (size_t li = 0; li < ranges.size(); li++) {
+        const Range& rg = ranges[li];
+        if (rg.x0 > rg.x1) continue;
+
+        int z0 = std::max(rg.z0, zBegin);
+        int z1 = std::min(rg.z1, zEnd - 1);
+        for (int z = z0; z <= z1; z++)
+            for (int y = rg.y0; y <= rg.y1; y++)
+                for (int x = rg.x0; x <= rg.x1; x++) {
+                    unsigned int& c = cursor[x + CLUSTER_X * (y + CLUSTER_Y * z)];
+                    if (fill) indices[c] = (unsigned int)li;
+                    c++;
+                }
+    }
+}
+
+void LightClusters::SliceParams(float zNear, float zFar, float& scale, float& bias)
+{
+    scale = (float)CLUSTER_Z / logf(zFar / zNear);
+    bias = logf(zNear) * scale;
+}
+
+void LightClusters::Build(const std::vector<PointLight>& lights, const glm::mat4& view,
+    float p00, float p11, float zNear, float zFar, JobSystem* jobs)
+{
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    SliceParams(zNear, zFar, sliceScale, sliceBias);
+
+    // few lights: the jobs would cost more than the work
+    if ((int)lights.size() < CLUSTER_PARALLEL_MIN_LIGHTS) jobs = nullptr;
+    auto parallelFor = [jobs](const char* name, int count, int grain, const std::function<void(int, int)>& fn)
+        {
+            if (jobs) jobs->ParallelFor(name, count, grain, fn);
+            else fn(0, count);
+        };
+
+    ranges.resize(lights.size());
+    parallelFor("cluster bounds", (int)lights.size(), CLUSTER_LIGHTS_PER_JOB, [&](int b, int e)
+        {
+            ComputeRanges(lights, (size_t)b, (size_t)e, view, p00, p11, zNear, zFar);
+        });
+
+    // 1) count
+    std::fill(cursor.begin(), cursor.end(), 0u);
+    parallelFor("cluster count", CLUSTER_Z, CLUSTER_SLICES_PER_JOB, [&](int z0, int z1) { Scatter(z0, z1, false); });
+
+    // 2) prefix sum
+    unsigned int total = 0;
+    maxPerCluster = 0;
+    for (int c = 0; c < CLUSTER_COUNT; c++) {
+        unsigned int cnt = cursor[c];
+        grid[c * 2 + 0] = total;
+        grid[c * 2 + 1] = cnt;
+        cursor[c] = total;
+        total += cnt;
+        if ((int)cnt > maxPerCluster) maxPerCluster = (int)cnt;
+    }
+
+    // 3) fill
+    indices.resize(total);
+    parallelFor("cluster fill", CLUSTER_Z, CLUSTER_SLICES_PER_JOB, [&](int z0, int z1) { Scatter(z0, z1, true); });
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    buildMs = std::chrono::duration<float, std::milli>(t1 - t0).count();
+}
+
+// upload into a buffer that only grows (capacity doubles); returns true if reallocated
+static bool uploadGrowable(GLuint buf, size_t& capacity, const void* data, size_t bytes)
+{
+    bool realloc = false;
+    glBindBuffer(GL_TEXTURE_BUFFER, buf);
+
+    if (bytes > capacity || capacity == 0) {
+        size_t cap = capacity ? capacity : 4096;
+        while (cap < bytes) cap *= 2;
+        glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)cap, NULL, GL_STREAM_DRAW);
+        capacity = cap;
+        realloc = true;
+    }
+    else {
+        // orphan so we never wait on last frame's reads
+        glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)capacity, NULL, GL_STREAM_DRAW);
+    }
+
+    if (bytes) glBufferSubData(GL_TEXTURE_BUFFER, 0, (GLsizeiptr)bytes, data);
+    return realloc;
+}
+
+void LightClusters::Upload(const std::vector<PointLight>& lights)
+{
+    packedLights.resize(lights.size() * 8);
+    for (size_t i = 0; i < lights.size(); i++) {
+        const PointLight& L = lights[i];
+        float* p = &packedLights[i * 8];
+        p[0] = L.pos.x; p[1] = L.pos.y; p[2] = L.pos.z; p[3] = L.radius;
+        p[4] = L.color.x; p[5] = L.color.y; p[6] = L.color.z; p[7] = (float)L.shadowIndex;
+    }
+
+    if (uploadGrowable(lightBuf, lightCapacity, packedLights.data(), packedLights.size() * sizeof(float))) {
+        glBindTexture(GL_TEXTURE_BUFFER, lightTex);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightBuf);
+    }
+
+    if (uploadGrowable(indexBuf, indexCapacity, indices.data(), indices.size() * sizeof(unsigned int))) {
+        glBindTexture(GL_TEXTURE_BUFFER, indexTex);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, indexBuf);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, gridBuf);
+    glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)(grid.size() * sizeof(unsigned int)), grid.data(), GL_STREAM_DRAW);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::Bind(int unitBase) const
+{
+    glActiveTexture(GL_TEXTURE0 + unitBase + 0); glBindTexture(GL_TEXTURE_BUFFER, lightTex);
+    glActiveTexture(GL_TEXTURE0 + unitBase + 1); glBindTexture(GL_TEXTURE_BUFFER, gridTex);
+    glActiveTexture(GL_TEXTURE0 + unitBase + 2); glBindTexture(GL_TEXTURE_BUFFER, indexTex);
+}
@@ -0,0 +1,85 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <vector>
+#include <GL/glew.h>
+#include "glm/glm.hpp"
+#include "job_system.hpp"
+
+// Clustered forward shading: the view frustum is split into CLUSTER_X * CLUSTER_Y screen tiles
+// and CLUSTER_Z exponential depth slices ("froxels"). Every frame the CPU assigns each light to
+// the froxels its sphere of influence overlaps; the fragment shader then only loops over the
+// lights of its own froxel.
+//
+// GPU data lives in texture buffers (works with #version 330):
+//  - lightData      RGBA32F, 2 texels per light: (pos.xyz, radius), (color.rgb, shadowIndex or -1)
+//  - clusterGrid    RG32UI,  1 texel per froxel: (offset into lightIndexList, count)
+//  - lightIndexList R32UI,   light indices, grouped per froxel
+
+static const int CLUSTER_X = 16;
+static const int CLUSTER_Y = 9;
+static const int CLUSTER_Z = 24;
+static const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+// parallel build (below this many lights it stays on the calling thread)
+static const int CLUSTER_PARALLEL_MIN_LIGHTS = 256;
+static const int CLUSTER_LIGHTS_PER_JOB = 256;  // multiple of 4 (SSE batches)
+static const int CLUSTER_SLICES_PER_JOB = 2;
+
+struct PointLight {
+    glm::vec3 pos;
+    float radius;       // influence radius (attenuation is windowed to 0 here)
+    glm::vec3 color;
+    int shadowIndex;    // shadow map slot, -1 = no shadow
+};
+
+class LightClusters {
+public:
+    bool Init();
+    void Destroy();
+
+    // CPU culling: fills the per-froxel light lists for the given camera.
+    // p00/p11 are projection[0][0] and projection[1][1]. No GL calls (may run as a job).
+    void Build(const std::vector<PointLight>& lights, const glm::mat4& view,
+        float p00, float p11, float zNear, float zFar, JobSystem* jobs = nullptr);
+
+    // Upload lights + froxel lists (buffers grow as needed, never shrink).
+    void Upload(const std::vector<PointLight>& lights);
+
+    // Bind the three texture buffers to consecutive texture units starting at unitBase.
+    void Bind(int unitBase) const;
+
+    // shader parameters: slice = log(viewZ) * scale - bias
+    static void SliceParams(float zNear, float zFar, float& scale, float& bias);
+
+    float LastBuildMs() const { return buildMs; }
+    size_t IndexCount() const { return indices.size(); }
+    int MaxLightsInCluster() const { return maxPerCluster; }
+
+private:
+    struct Range { int x0, x1, y0, y1, z0, z1; };
+
+    void ComputeRanges(const std::vector<PointLight>& lights, size_t begin, size_t end,
+        const glm::mat4& view, float p00, float p11, float zNear, float zFar);
+    void Scatter(int zBegin, int zEnd, bool fill);
+
+    GLuint lightBuf = 0, lightTex = 0;
+    GLuint gridBuf = 0, gridTex = 0;
+    GLuint indexBuf = 0, indexTex = 0;
+
+    size_t lightCapacity = 0;   // bytes
+    size_t indexCapacity = 0;   // bytes
+
+    float sliceScale = 0.0f, sliceBias = 0.0f;
+
+    std::vector<Range> ranges;
+    std::vector<unsigned int> grid;     // offset,count pairs
+    std::vector<unsigned int> indices;
+    std::vector<unsigned int> cursor;   // scratch for the fill pass
+    std::vector<float> packedLights;    // scratch for upload
+
+    float buildMs = 0.0f;
+    int maxPerCluster = 0;
+};
+
+#endif
@@ -0,0 +1,186 @@
+// Per-thread CPU event buffers + Trace Event JSON (see cpu_profiler.hpp).
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include "cpu_profiler.hpp"
+
+#ifndef NO_CPU_PROFILER
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+static const int CPU_EVENTS_PER_BLOCK = 4096;
+
+struct CpuEvent {
+    const char* name;
+    uint64_t start;     // ns
+    uint64_t end;       // zones
+    double value;       // counters
+    char phase;         // 'X' zone, 'C' counter
+};
+
+struct CpuEventBlock {
+    CpuEvent events[CPU_EVENTS_PER_BLOCK];
+    std::atomic<int> count{ 0 };
+    std::atomic<CpuEventBlock*> next{ nullptr };   // kept across captures, reused
+};
+
+struct CpuThreadBuffer {
+    int tid = 0;
+    char name[32] = {};
+    std::atomic<unsigned int> epoch{ 0 };   // capture the contents belong to
+    CpuEventBlock* head = nullptr;
+    CpuEventBlock* tail = nullptr;          // owner thread only
+};
+
+std::atomic<bool> gCpuCapture{ false };
+
+// buffers live until the process ends: a thread may still hold its pointer after a capture
+static std::mutex gBuffersM;
+static std::vector<CpuThreadBuffer*> gBuffers;
+static std::atomic<unsigned int> gEpoch{ 0 };
+static thread_local CpuThreadBuffer* tBuffer = nullptr;
+
+static const std::chrono::steady_clock::time_point gStart = std::chrono::steady_clock::now();
+
+uint64_t CpuProfilerNow()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - gStart).count() + 1;
+}
+
+static CpuThreadBuffer* registerThread()
+{
+    CpuThreadBuffer* b = new CpuThreadBuffer();
+    b->head = b->tail = new CpuEventBlock();
+    std::lock_guard<std::mutex> lk(gBuffersM);
+    b->tid = (int)gBuffers.size() + 1;
+    gBuffers.push_back(b);
+    return b;
+}
+
+// the calling thread's buffer, cleared if it still holds an earlier capture
+static CpuThreadBuffer* threadBuffer()
+{
+    CpuThreadBuffer* b = tBuffer;
+    if (!b) b = tBuffer = registerThread();
+
+    unsigned int e = gEpoch.load(std::memory_order_acquire);
+    if (b->epoch.load(std::memory_order_relaxed) != e) {
+        for (CpuEventBlock* blk = b->head; blk; blk = blk->next.load(std::memory_order_relaxed)) {
+            blk->count.store(0, std::memory_order_relaxed);
+        }
+        b->tail = b->head;
+        b->epoch.store(e, std::memory_order_release);   // the writer sees the empty blocks first
+    }
+    return b;
+}
+
+static void record(const CpuEvent& ev)
+{
+    CpuThreadBuffer* b = threadBuffer();
+    CpuEventBlock* blk = b->tail;
+    int n = blk->count.load(std::memory_order_relaxed);
+    if (n == CPU_EVENTS_PER_BLOCK) {
+        CpuEventBlock* next = blk->next.load(std::memory_order_acquire);
+        if (!next) {
+            next = new CpuEventBlock();
+            blk->next.store(next, std::memory_order_release);
+        }
+        b->tail = blk = next;
+        n = 0;
+    }
+    blk->events[n] = ev;
+    blk->count.store(n + 1, std::memory_order_release);
+}
+
+void CpuProfilerRecordZone(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    record({ name, startNs, endNs, 0.0, 'X' });
+}
+
+void CpuProfilerRecordCounter(const char* name, double value)
+{
+    record({ name, CpuProfilerNow(), 0, value, 'C' });
+}
+
+void CpuProfilerThreadName(const char* name)
+{
+    if (!tBuffer) tBuffer = registerThread();
+    std::lock_guard<std::mutex> lk(gBuffersM);
+    snprintf(tBuffer->name, sizeof(tBuffer->name), "%s", name);
+}
+
+void CpuProfilerStart()
+{
+    gEpoch.fetch_add(1, std::memory_order_acq_rel);
+    gCpuCapture.store(true, std::memory_order_release);
+}
+
+void CpuProfilerStop()
+{
+    gCpuCapture.store(false, std::memory_order_release);
+}
+
+static void writeString(FILE* f, const char* s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+bool CpuProfilerWriteTrace(const char* path)
+{
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        printf("Nu am putut scrie: %s\n", path);
+        return false;
+    }
+
+    // threads may keep recording: only what they published (count, acquire) is read
+    std::lock_guard<std::mutex> lk(gBuffersM);
+    unsigned int e = gEpoch.load(std::memory_order_acquire);
+    size_t events = 0;
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (const CpuThreadBuffer* b : gBuffers) {
+        if (b->name[0]) {
+            fprintf(f, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", first ? "" : ",\n", b->tid);
+            writeString(f, b->name);
+            fprintf(f, "}}");
+            first = false;
+        }
+        if (b->epoch.load(std::memory_order_acquire) != e) continue;
+
+        for (const CpuEventBlock* blk = b->head; blk; blk = blk->next.load(std::memory_order_acquire)) {
+            int n = blk->count.load(std::memory_order_acquire);
+            for (int i = 0; i < n; i++) {
+                const CpuEvent& ev = blk->events[i];
+                fprintf(f, "%s{\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"name\":", first ? "" : ",\n", ev.phase, b->tid);
+                writeString(f, ev.name);
+                if (ev.phase == 'X') fprintf(f, ",\"ts\":%.3f,\"dur\":%.3f}", ev.start / 1000.0, (ev.end - ev.start) / 1000.0);
+                else fprintf(f, ",\"ts\":%.3f,\"args\":{\"value\":%g}}", ev.start / 1000.0, ev.value);
+                first = false;
+                events++;
+            }
+            if (n < CPU_EVENTS_PER_BLOCK) break;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+
+    printf("CPU trace: %zu events from %zu threads written to %s\n", events, gBuffers.size(), path);
+    return true;
+}
+
+#endif
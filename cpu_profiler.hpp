@@ -0,0 +1,80 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+// CPU zones and counters, dumped as Trace Event JSON for flame views of startup and of frames
+// (chrome://tracing, ui.perfetto.dev):
+//  - CPU_ZONE("name") times the rest of the enclosing scope (RAII); CPU_ZONE_BEGIN(var, "name")
+//    + CPU_ZONE_END(var) a stretch of code inside one; CPU_COUNTER("name", value) records a
+//    value; names are string literals (kept as pointers)
+//  - every thread appends to its own buffer (blocks of events, the count published with a
+//    release store): no locks while recording, a thread takes a mutex once to register
+//  - outside of a capture a zone costs one relaxed atomic load
+//  - a new capture drops the last one; each thread clears its own buffer at its first event
+// Building with NO_CPU_PROFILER compiles it all out: the macros expand to nothing and the
+// functions below are empty inlines.
+
+#ifndef NO_CPU_PROFILER
+
+#include <stdint.h>
+#include <atomic>
+
+extern std::atomic<bool> gCpuCapture;
+
+void CpuProfilerStart();
+void CpuProfilerStop();
+inline bool CpuProfilerCapturing() { return gCpuCapture.load(std::memory_order_relaxed); }
+
+// events of the current / last capture; false if the file cannot be written
+bool CpuProfilerWriteTrace(const char* path);
+
+// name of the calling thread in the trace (copied)
+void CpuProfilerThreadName(const char* name);
+
+// used by the macros
+uint64_t CpuProfilerNow();      // ns since startup, > 0
+void CpuProfilerRecordZone(const char* name, uint64_t startNs, uint64_t endNs);
+void CpuProfilerRecordCounter(const char* name, double value);
+
+class CpuZone {
+public:
+    explicit CpuZone(const char* n) : name(n), start(CpuProfilerCapturing() ? CpuProfilerNow() : 0) {}
+    ~CpuZone() { End(); }
+
+    void End()
+    {
+        if (start) CpuProfilerRecordZone(name, start, CpuProfilerNow());
+        start = 0;
+    }
+
+    CpuZone(const CpuZone&) = delete;
+    CpuZone& operator=(const CpuZone&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;     // 0 = not captured
+};
+
+#define CPU_ZONE_CAT2(a, b) a##b
+#define CPU_ZONE_CAT(a, b) CPU_ZONE_CAT2(a, b)
+#define CPU_ZONE(name) CpuZone CPU_ZONE_CAT(cpuZone, __LINE__)(name)
+#define CPU_ZONE_BEGIN(var, name) CpuZone var(name)
+#define CPU_ZONE_END(var) var.End()
+#define CPU_COUNTER(name, value) \
+    do { if (CpuProfilerCapturing()) CpuProfilerRecordCounter(name, (double)(value)); } while (0)
+
+#else
+
+inline void CpuProfilerStart() {}
+inline void CpuProfilerStop() {}
+inline bool CpuProfilerCapturing() { return false; }
+inline bool CpuProfilerWriteTrace(const char*) { return false; }
+inline void CpuProfilerThreadName(const char*) {}
+
+#define CPU_ZONE(name) do {} while (0)
+#define CPU_ZONE_BEGIN(var, name) do {} while (0)
+#define CPU_ZONE_END(var) do {} while (0)
+#define CPU_COUNTER(name, value) do {} while (0)
+
+#endif
+
+#endif
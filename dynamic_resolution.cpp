@@ -0,0 +1,41 @@
+// Main pass resolution from the GPU busy time (see dynamic_resolution.hpp).
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+#include "dynamic_resolution.hpp"
+
+static const float DRS_HEADROOM = 0.95f;    // aim a bit under the target
+static const float DRS_DEAD_BAND = 0.02f;   // smaller scale changes are ignored
+static const float DRS_MAX_STEP = 0.05f;    // per frame
+static const float DRS_DAMPING = 0.3f;
+
+void DynamicResolution::Adjust(float ms)
+{
+    gpuMs = gpuMs > 0.0f ? gpuMs * 0.8f + 0.2f * ms : ms;
+    if (!enabled || gpuMs <= 0.0f) return;
+
+    float desired = scale * sqrtf(targetMs * DRS_HEADROOM / gpuMs);
+    desired = std::min(std::max(desired, minScale), maxScale);
+
+    float step = (desired - scale) * DRS_DAMPING;
+    if (fabsf(desired - scale) < DRS_DEAD_BAND) return;
+    step = std::min(std::max(step, -DRS_MAX_STEP), DRS_MAX_STEP);
+    scale = std::min(std::max(scale + step, minScale), maxScale);
+    adjustments++;
+}
+
+void DynamicResolution::RenderSize(int fullW, int fullH, int& w, int& h) const
+{
+    float s = Scale();
+    w = std::max(1, (int)(fullW * s + 0.5f));
+    h = std::max(1, (int)(fullH * s + 0.5f));
+}
+
+void DynamicResolution::PrintStats() const
+{
+    printf("\nDynamic resolution: %s, target %.1f ms, scale %.2f (%.0f%% of the pixels, %.2f..%.2f)\n",
+        enabled ? "on" : "off", targetMs, Scale(), 100.0f * Scale() * Scale(), minScale, maxScale);
+    printf("  GPU busy %.2f ms per frame (averaged), %d scale changes\n", gpuMs, adjustments);
+}
@@ -0,0 +1,40 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+// Dynamic resolution: picks the main pass resolution (a scale of the window size, per axis) from
+// the GPU busy time of whole frames, so the frame stays under targetMs.
+//  - busy time = the sum of the frame's top level GPU profiler scopes (shadow passes, fog, main
+//    pass, post), fed in by the caller once per frame read back (AddGpuSample); the gaps where
+//    the GPU waits for the CPU do not count: a lower resolution cannot make a CPU bound frame
+//    any faster, it would only cost quality
+//  - the pixel cost goes with scale^2: the next scale is scale * sqrt(target / measured), damped,
+//    with a dead band so it does not hunt around the target
+// The post pipeline upsamples the result (TAA, or bilinear without it).
+
+class DynamicResolution {
+public:
+    // GPU busy time of one frame (a few frames late is fine)
+    void AddGpuSample(float ms) { Adjust(ms); }
+
+    // main pass size for a window of fullW x fullH
+    void RenderSize(int fullW, int fullH, int& w, int& h) const;
+
+    float Scale() const { return enabled ? scale : 1.0f; }
+    float GpuMs() const { return gpuMs; }
+
+    float targetMs = 16.6f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    bool enabled = true;
+
+    void PrintStats() const;
+
+private:
+    void Adjust(float ms);
+
+    float scale = 1.0f;
+    float gpuMs = 0.0f;
+    int adjustments = 0;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#version 330 core
+
+// Fog volume, step 2 (see fog_volume.hpp): for slice fogSliceIndex, march the froxel column
+// from the camera to the far edge of that slice.
+//  rgb = light scattered towards the camera along the way (already attenuated)
+//  a   = transmittance from the camera
+// Surfaces apply it as color * a + rgb.
+//
+// Defines (main.cpp): FOG_GRID_X/Y/Z
+#ifndef FOG_GRID_X
+#define FOG_GRID_X 160
+#endif
+#ifndef FOG_GRID_Y
+#define FOG_GRID_Y 90
+#endif
+#ifndef FOG_GRID_Z
+#define FOG_GRID_Z 64
+#endif
+
+out vec4 out_Integrated;
+
+layout(std140) uniform ViewData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    ivec3 clusterDims;
+    vec2 clusterTileSize;   // pixels per tile
+    vec2 clusterSlice;      // slice = log(viewZ) * x - y
+    vec2 fogSlice;          // same, for the fog volume
+};
+
+uniform sampler3D fogScatter;
+uniform int fogSliceIndex;
+
+// ambient light of the fog itself (the old distance fog color): far away everything fades to it
+const vec3 FOG_AMBIENT = vec3(0.045, 0.03, 0.07);
+// how much of the light reaching the fog is scattered back (fog albedo, tuned by eye)
+const float FOG_LIGHT_SCATTER = 0.35;
+
+void main()
+{
+    ivec2 cell = ivec2(gl_FragCoord.xy);
+
+    // slices are measured along -z in view space: the ray is longer off-center
+    vec2 ndc = gl_FragCoord.xy / vec2(FOG_GRID_X, FOG_GRID_Y) * 2.0 - 1.0;
+    float rayScale = length(vec3(ndc.x / projection[0][0], ndc.y / projection[1][1], 1.0));
+
+    vec3 acc = vec3(0.0);
+    float T = 1.0;
+    float zPrev = 0.0;  // from the camera: the first slice also covers [0, near]
+
+    for (int k = 0; k <= fogSliceIndex; k++)
+    {
+        vec4 s = texelFetch(fogScatter, ivec3(cell, k), 0);
+        float zNext = exp((float(k) + 1.0 + fogSlice.y) / fogSlice.x);
+        float len = (zNext - zPrev) * rayScale;
+        zPrev = zNext;
+
+        // exact over a froxel with constant density and light: S * (1 - e^(-sigma * len))
+        float sliceT = exp(-s.a * len);
+        vec3 S = FOG_AMBIENT + FOG_LIGHT_SCATTER * s.rgb;
+        acc += T * S * (1.0 - sliceT);
+        T *= sliceT;
+    }
+
+    out_Integrated = vec4(acc, T);
+}
@@ -0,0 +1,166 @@
+#version 330 core
+
+// Fog volume, step 1 (see fog_volume.hpp): one fragment per froxel of slice fogSliceIndex.
+//  rgb = light scattered towards the camera at the froxel center, per unit of scattering
+//        (cluster lights, one shadow tap per shadowed light)
+//  a   = extinction coefficient (1/m)
+//
+// Defines (main.cpp): SHADOW_LIGHT_COUNT, FOG_GRID_X/Y
+#ifndef SHADOW_LIGHT_COUNT
+#define SHADOW_LIGHT_COUNT 3
+#endif
+#ifndef FOG_GRID_X
+#define FOG_GRID_X 160
+#endif
+#ifndef FOG_GRID_Y
+#define FOG_GRID_Y 90
+#endif
+
+out vec4 out_Scatter;
+
+layout(std140) uniform ViewData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    ivec3 clusterDims;
+    vec2 clusterTileSize;   // pixels per tile
+    vec2 clusterSlice;      // slice = log(viewZ) * x - y
+    vec2 fogSlice;          // same, for the fog volume
+};
+
+layout(std140) uniform LightData {
+    mat4 lightSpace[SHADOW_LIGHT_COUNT];
+    mat4 matrUmbra;
+};
+
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer lightIndexList;
+
+uniform sampler2D shadowMap[SHADOW_LIGHT_COUNT];
+uniform int useShadowMaps;
+uniform int shadowFilter;   // 0 = depth maps, 1 = VSM moments, 2 = EVSM moments (shadow_moments.frag)
+
+uniform int fogSliceIndex;
+uniform mat4 invView;
+
+// ground fog: base density + a layer that thickens towards the asphalt (z up)
+const float FOG_DENSITY = 0.06;
+const float FOG_HEIGHT_DENSITY = 0.09;
+const float FOG_HEIGHT_FALLOFF = 0.6;
+const float FOG_PHASE_G = 0.35;     // forward scattering: halos around lights in front of the camera
+
+void fetchLight(int idx, out vec3 pos, out float radius, out vec3 color, out int shadowIdx)
+{
+    vec4 a = texelFetch(lightData, idx * 2 + 0);
+    vec4 b = texelFetch(lightData, idx * 2 + 1);
+    pos = a.xyz;
+    radius = a.w;
+    color = b.rgb;
+    shadowIdx = int(b.w);
+}
+
+float rangeWindow(float d, float radius)
+{
+    float x = d / radius;
+    float w = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+    return w * w;
+}
+
+// Henyey-Greenstein without the 1/4pi (1 for g = 0)
+float phaseHG(float cosTheta, float g)
+{
+    float g2 = g * g;
+    return (1.0 - g2) / pow(1.0 + g2 - 2.0 * g * cosTheta, 1.5);
+}
+
+#if SHADOW_LIGHT_COUNT > 4
+#error "sampleShadowMap handles up to 4 shadowed lights"
+#endif
+
+// explicit lod: called from the light loop (moment maps are mipmapped, depth maps are not)
+vec4 sampleShadowMap(int li, vec2 uv, float lod)
+{
+#if SHADOW_LIGHT_COUNT > 1
+    if (li == 1) return textureLod(shadowMap[1], uv, lod);
+#endif
+#if SHADOW_LIGHT_COUNT > 2
+    if (li == 2) return textureLod(shadowMap[2], uv, lod);
+#endif
+#if SHADOW_LIGHT_COUNT > 3
+    if (li == 3) return textureLod(shadowMap[3], uv, lod);
+#endif
+    return textureLod(shadowMap[0], uv, lod);
+}
+
+// moments: Chebyshev bound, no light bleeding reduction (the fog may as well be soft)
+float chebyshevLit(vec2 m, float t, float minVariance)
+{
+    if (t <= m.x) return 1.0;
+    float variance = max(m.y - m.x * m.x, minVariance);
+    float d = t - m.x;
+    return variance / (variance + d * d);
+}
+
+// one tap: the volume is blurred by the trilinear lookups anyway
+float visibility(int li, vec3 p)
+{
+    vec4 ls = lightSpace[li] * vec4(p, 1.0);
+    vec3 proj = ls.xyz / max(ls.w, 1e-6) * 0.5 + 0.5;
+
+    if (proj.x < 0.0 || proj.x > 1.0 || proj.y < 0.0 || proj.y > 1.0 || proj.z < 0.0 || proj.z > 1.0)
+        return 1.0;
+
+    if (shadowFilter == 1)
+        return chebyshevLit(sampleShadowMap(li, proj.xy, 1.0).xy, proj.z - 0.002, 1e-5);
+    if (shadowFilter == 2) {
+        // positive warp only (EVSM_POS in shadow_moments.frag)
+        float w = exp(40.0 * (2.0 * (proj.z - 0.002) - 1.0));
+        return chebyshevLit(sampleShadowMap(li, proj.xy, 1.0).xy, w, 1.6e-5 * w * w);
+    }
+    return (proj.z - 0.002 > sampleShadowMap(li, proj.xy, 0.0).r) ? 0.0 : 1.0;
+}
+
+void main()
+{
+    // froxel center: view ray through the cell center, depth halfway through the slice (in log space)
+    vec2 uv = gl_FragCoord.xy / vec2(FOG_GRID_X, FOG_GRID_Y);
+    float viewZ = exp((float(fogSliceIndex) + 0.5 + fogSlice.y) / fogSlice.x);
+
+    vec2 ndc = uv * 2.0 - 1.0;
+    vec3 posVS = vec3(ndc.x / projection[0][0], ndc.y / projection[1][1], -1.0) * viewZ;
+    vec3 pos = (invView * vec4(posVS, 1.0)).xyz;
+
+    vec3 V = normalize(viewPos - pos);
+
+    // the cluster this froxel falls in (same mapping as clusterRange() in alley.frag)
+    int slice = int(max(log(max(viewZ, 1e-4)) * clusterSlice.x - clusterSlice.y, 0.0));
+    slice = min(slice, clusterDims.z - 1);
+    ivec2 tile = ivec2(uv * vec2(clusterDims.xy));
+    tile = clamp(tile, ivec2(0), clusterDims.xy - 1);
+    uvec2 range = texelFetch(clusterGrid, tile.x + clusterDims.x * (tile.y + clusterDims.y * slice)).xy;
+
+    vec3 inScatter = vec3(0.0);
+    for (uint k = 0u; k < range.y; k++)
+    {
+        vec3 lPos; float lRadius; vec3 lColor; int lShadow;
+        fetchLight(int(texelFetch(lightIndexList, int(range.x + k)).r), lPos, lRadius, lColor, lShadow);
+
+        vec3 Lvec = lPos - pos;
+        float d = length(Lvec);
+        vec3 L = Lvec / max(d, 1e-4);
+
+        float att = rangeWindow(d, lRadius) / (1.0 + 0.18 * d + 0.08 * d * d);
+        if (att <= 0.0) continue;
+
+        float vis = 1.0;
+        if (useShadowMaps != 0 && lShadow >= 0)
+            vis = visibility(lShadow, pos);
+
+        inScatter += lColor * att * vis * phaseHG(dot(L, -V), FOG_PHASE_G);
+    }
+
+    float density = FOG_DENSITY + FOG_HEIGHT_DENSITY * exp(-max(pos.z, 0.0) * FOG_HEIGHT_FALLOFF);
+
+    out_Scatter = vec4(inScatter, density);
+}
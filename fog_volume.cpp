@@ -0,0 +1,156 @@
+// Froxel fog volume: textures, per-slice framebuffers and the two fullscreen steps
+// (see fog_volume.hpp).
+
+#include <stdio.h>
+#include <math.h>
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include "fog_volume.hpp"
+#include "gpu_profiler.hpp"
+
+static GLuint CreateVolume()
+{
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_3D, tex);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, FOG_GRID_X, FOG_GRID_Y, FOG_GRID_Z, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    return tex;
+}
+
+// one framebuffer per layer: cheaper to switch than re-attaching every slice
+static bool CreateLayerFbos(GLuint tex, GLuint* fbos)
+{
+    glGenFramebuffers(FOG_GRID_Z, fbos);
+    for (int z = 0; z < FOG_GRID_Z; z++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbos[z]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, tex, 0, z);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        glReadBuffer(GL_NONE);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            printf("Fog volume: framebuffer incomplete (slice %d)\n", z);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            return false;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return true;
+}
+
+bool FogVolume::Init()
+{
+    scatterTex = CreateVolume();
+    integratedTex = CreateVolume();
+
+    if (!CreateLayerFbos(scatterTex, scatterFbo) || !CreateLayerFbos(integratedTex, integratedFbo)) {
+        Destroy();
+        return false;
+    }
+
+    glGenVertexArrays(1, &vao);
+    glGenQueries(QUERY_COUNT, queries);
+    return true;
+}
+
+void FogVolume::Destroy()
+{
+    if (scatterFbo[0]) glDeleteFramebuffers(FOG_GRID_Z, scatterFbo);
+    if (integratedFbo[0]) glDeleteFramebuffers(FOG_GRID_Z, integratedFbo);
+    if (scatterTex) glDeleteTextures(1, &scatterTex);
+    if (integratedTex) glDeleteTextures(1, &integratedTex);
+    if (vao) glDeleteVertexArrays(1, &vao);
+    if (queries[0]) glDeleteQueries(QUERY_COUNT, queries);
+
+    for (int z = 0; z < FOG_GRID_Z; z++) scatterFbo[z] = integratedFbo[z] = 0;
+    for (int i = 0; i < QUERY_COUNT; i++) { queries[i] = 0; pending[i] = false; }
+    scatterTex = integratedTex = 0;
+    vao = 0;
+}
+
+void FogVolume::SliceParams(float zNear, float zFar, float& scale, float& bias)
+{
+    scale = (float)FOG_GRID_Z / logf(zFar / zNear);
+    bias = logf(zNear) * scale;
+}
+
+void FogVolume::DrawSlices(GLuint program, const GLuint* fbos)
+{
+    glUseProgram(program);
+    GLint sliceLoc = glGetUniformLocation(program, "fogSliceIndex");
+
+    for (int z = 0; z < FOG_GRID_Z; z++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbos[z]);
+        glUniform1i(sliceLoc, z);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        GpuCountDraw(3);
+    }
+}
+
+void FogVolume::Render(GLuint scatterProgram, GLuint integrateProgram, const glm::mat4& invView, int unitBase)
+{
+    if (!scatterTex || !scatterProgram || !integrateProgram) return;
+
+    // results of earlier frames (never waits)
+    for (int i = 0; i < QUERY_COUNT; i++) {
+        if (!pending[i]) continue;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &ns);
+        gpuMs = gpuMs > 0.0f ? gpuMs * 0.9f + 0.1f * (float)(ns / 1.0e6) : (float)(ns / 1.0e6);
+        pending[i] = false;
+    }
+
+    int q = nextQuery;
+    bool timed = !pending[q];
+    if (timed) glBeginQuery(GL_TIME_ELAPSED, queries[q]);
+
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glViewport(0, 0, FOG_GRID_X, FOG_GRID_Y);
+    glBindVertexArray(vao);
+
+    // neither volume may stay bound while it is a render target
+    glActiveTexture(GL_TEXTURE0 + unitBase);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glActiveTexture(GL_TEXTURE0 + unitBase + 1);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    glUseProgram(scatterProgram);
+    glUniformMatrix4fv(glGetUniformLocation(scatterProgram, "invView"), 1, GL_FALSE, glm::value_ptr(invView));
+    DrawSlices(scatterProgram, scatterFbo);
+
+    glActiveTexture(GL_TEXTURE0 + unitBase);
+    glBindTexture(GL_TEXTURE_3D, scatterTex);
+    DrawSlices(integrateProgram, integratedFbo);
+
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+
+    Bind(unitBase);
+
+    if (timed) {
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[q] = true;
+        nextQuery = (q + 1) % QUERY_COUNT;
+    }
+}
+
+void FogVolume::Bind(int unitBase) const
+{
+    glActiveTexture(GL_TEXTURE0 + unitBase);
+    glBindTexture(GL_TEXTURE_3D, scatterTex);
+    glActiveTexture(GL_TEXTURE0 + unitBase + 1);
+    glBindTexture(GL_TEXTURE_3D, integratedTex);
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,65 @@
+#ifndef FOG_VOLUME_H
+#define FOG_VOLUME_H
+
+#include <GL/glew.h>
+#include "glm/glm.hpp"
+
+// Volumetric fog in a low resolution, frustum aligned grid ("froxels", like the light clusters
+// but finer), rebuilt once per frame after the shadow maps and the light clusters:
+//  1) scatter    (fog_scatter.frag):   per froxel, the light scattered towards the camera by the
+//                                      froxel's cluster lights (one shadow tap per shadowed light)
+//                                      + the fog extinction at that point (height falloff)
+//  2) integrate  (fog_integrate.frag): front to back along each froxel column: accumulated
+//                                      in-scatter + transmittance from the camera to every slice
+// Surfaces and steam then apply fog with one 3D lookup (color * a + rgb), so the cost no longer
+// grows with overdraw or with the number of lights per pixel.
+//
+// GL 3.3 has no compute shaders: both steps are fullscreen triangles over FOG_GRID_X * FOG_GRID_Y,
+// one draw per depth slice into one layer of an RGBA16F 3D texture. The integrate step reads
+// the scatter volume only, so nothing is sampled while it is written.
+//
+// Depth slices are exponential between the near plane and FOG_FAR: slice = log(viewZ) * x - y.
+
+static const int FOG_GRID_X = 160;
+static const int FOG_GRID_Y = 90;
+static const int FOG_GRID_Z = 64;
+static const float FOG_FAR = 64.0f;   // beyond it the last slice is used
+
+class FogVolume {
+public:
+    ~FogVolume() { Destroy(); }
+
+    bool Init();
+    void Destroy();
+
+    // programs: fullscreen.vert + fog_scatter.frag / fog_integrate.frag, with the uniform blocks and
+    // the shadow/cluster sampler units already set up (SetupMainProgram in main.cpp).
+    // The scatter volume is read by the integrate step from texture unit `unitBase`.
+    // Leaves framebuffer 0 bound, the viewport at the grid size and both volumes bound (Bind).
+    void Render(GLuint scatterProgram, GLuint integrateProgram, const glm::mat4& invView, int unitBase);
+
+    // scatter volume -> unitBase (steam lighting), integrated volume -> unitBase + 1
+    void Bind(int unitBase) const;
+
+    // shader parameters: slice = log(viewZ) * scale - bias
+    static void SliceParams(float zNear, float zFar, float& scale, float& bias);
+
+    // GPU time of both steps, a few frames late (0 until the first query returns)
+    float GpuMs() const { return gpuMs; }
+
+private:
+    void DrawSlices(GLuint program, const GLuint* fbos);
+
+    GLuint scatterTex = 0, integratedTex = 0;
+    GLuint scatterFbo[FOG_GRID_Z] = {};
+    GLuint integratedFbo[FOG_GRID_Z] = {};
+    GLuint vao = 0;     // empty: the fullscreen triangle comes from gl_VertexID
+
+    static const int QUERY_COUNT = 4;
+    GLuint queries[QUERY_COUNT] = {};
+    bool pending[QUERY_COUNT] = {};
+    int nextQuery = 0;
+    float gpuMs = 0.0f;
+};
+
+#endif
@@ -0,0 +1,88 @@
+// Render on demand (see frame_scheduler.hpp).
+
+#include <stdio.h>
+
+#include "frame_scheduler.hpp"
+
+// package energy counter in joules, -1 when there is none we may read
+static double readEnergyJ()
+{
+#ifdef __linux__
+    FILE* f = fopen("/sys/class/powercap/intel-rapl:0/energy_uj", "r");
+    if (!f) return -1.0;
+    unsigned long long uj = 0;
+    int ok = fscanf(f, "%llu", &uj);
+    fclose(f);
+    return ok == 1 ? (double)uj * 1.0e-6 : -1.0;
+#else
+    return -1.0;
+#endif
+}
+
+void FrameScheduler::Invalidate(unsigned int flags)
+{
+    dirty |= flags;
+    if (flags & FRAME_DIRTY_ALL) settleLeft = FRAME_SETTLE_FRAMES;
+}
+
+FrameKind FrameScheduler::Next(bool animating, bool busy) const
+{
+    if (!onDemand || busy || (dirty & FRAME_DIRTY_ALL) || settleLeft > 0) return FRAME_FULL;
+    if (animating || (dirty & FRAME_DIRTY_EXPOSE)) return FRAME_STEAM;
+    return FRAME_NONE;
+}
+
+void FrameScheduler::EndFrame(FrameKind kind, double ms)
+{
+    if (kind == FRAME_FULL) {
+        // flags raised while the frame was built are already in it
+        dirty = 0;
+        if (settleLeft > 0) settleLeft--;
+    }
+    else {
+        dirty &= ~FRAME_DIRTY_EXPOSE;
+    }
+    frames[kind]++;
+    frameMs[kind] += ms;
+}
+
+void FrameScheduler::ResetStats()
+{
+    statsStart = Clock::now();
+    cpuStart = std::clock();
+    energyStartJ = readEnergyJ();
+    for (int k = 0; k < FRAME_KIND_COUNT; k++) {
+        frames[k] = 0;
+        frameMs[k] = 0.0;
+    }
+}
+
+void FrameScheduler::PrintStats() const
+{
+    double wallMs = std::chrono::duration<double, std::milli>(Clock::now() - statsStart).count();
+    if (wallMs <= 0.0) return;
+    // process time of every thread on POSIX (wall time on Windows, where it is not meaningful)
+    double cpuMs = 1000.0 * (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    double busyMs = frameMs[FRAME_FULL] + frameMs[FRAME_STEAM];
+
+    auto avg = [&](int k) { return frames[k] ? frameMs[k] / (double)frames[k] : 0.0; };
+
+    printf("\nFrame scheduler: %s, %.1f s, %lld full + %lld steam-only frames (%.1f frames/s)\n",
+        onDemand ? "on demand" : "continuous", wallMs / 1000.0, frames[FRAME_FULL], frames[FRAME_STEAM],
+        1000.0 * (double)(frames[FRAME_FULL] + frames[FRAME_STEAM]) / wallMs);
+    printf("  main thread in frames %.0f%% of the time (continuous: ~100%%), full %.2f ms, steam-only %.2f ms per frame\n",
+        100.0 * busyMs / wallMs, avg(FRAME_FULL), avg(FRAME_STEAM));
+    if (frames[FRAME_STEAM] > 0 && frames[FRAME_FULL] > 0) {
+        printf("  steam-only frames saved %.1f s of main thread time over full ones\n",
+            (avg(FRAME_FULL) - avg(FRAME_STEAM)) * (double)frames[FRAME_STEAM] / 1000.0);
+    }
+    printf("  process CPU %.0f%% of one core, idle %.1f s\n", 100.0 * cpuMs / wallMs, (wallMs - busyMs) / 1000.0);
+
+    double energyJ = readEnergyJ();
+    if (energyStartJ >= 0.0 && energyJ >= energyStartJ) {
+        printf("  package power %.1f W (RAPL)\n", (energyJ - energyStartJ) * 1000.0 / wallMs);
+    }
+    else {
+        printf("  package power: n/a (no readable RAPL counter)\n");
+    }
+}
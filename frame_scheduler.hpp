@@ -0,0 +1,72 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <chrono>
+#include <ctime>
+
+// Render on demand: decides per GLUT idle/display callback what kind of frame, if any, is needed.
+//  - input and toggles set dirty flags; any of them (or the renderer still streaming textures /
+//    world cells) asks for full frames, and a few more after the last one so shadow slicing,
+//    dynamic resolution and the TAA history settle on the new view
+//  - when only the steam moves, a steam-only frame: the opaque + static transparent result of
+//    the last full frame (color + depth) is copied back in the steam's screen rectangle and only
+//    the steam is drawn there, scissored (post still runs over the whole frame)
+//  - nothing moving: no frame at all; GLUT's idle callback is removed and the main loop sleeps
+//    until the next event (expose events present one steam-only frame from the cache)
+// Cables would dirty the opaque pass and all shadow maps every frame, so on demand they keep
+// the pose they had when it was switched on.
+//
+// Stats: frames of each kind, main thread time inside frames vs. wall time (continuous mode
+// keeps it near 100%), process CPU time (all threads) and, where the RAPL counter is readable
+// (Linux, Intel/AMD), the average package power over the same period.
+
+enum FrameDirty {
+    FRAME_DIRTY_CAMERA = 1 << 0,
+    FRAME_DIRTY_LIGHTS = 1 << 1,
+    FRAME_DIRTY_SETTINGS = 1 << 2,      // toggles, benchmarks, anything that changes GL state
+    FRAME_DIRTY_EXPOSE = 1 << 3,        // window contents lost: present again, no new content
+    FRAME_DIRTY_ALL = FRAME_DIRTY_CAMERA | FRAME_DIRTY_LIGHTS | FRAME_DIRTY_SETTINGS
+};
+
+enum FrameKind {
+    FRAME_NONE = 0,
+    FRAME_STEAM,        // cached scene + steam in its rectangle
+    FRAME_FULL,
+    FRAME_KIND_COUNT
+};
+
+static const int FRAME_SETTLE_FRAMES = 24;  // full frames after the last change (TAA: 0.88^24 < 5%)
+
+class FrameScheduler {
+public:
+    FrameScheduler() { ResetStats(); }
+
+    void Invalidate(unsigned int flags);
+
+    // animating: something moves without input (steam); busy: the renderer wants full frames
+    // (resources still streaming in). Does not change any state.
+    FrameKind Next(bool animating, bool busy) const;
+
+    // after a frame of that kind was rendered in frameMs (main thread)
+    void EndFrame(FrameKind kind, double frameMs);
+
+    bool onDemand = true;
+
+    void ResetStats();
+    void PrintStats() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    unsigned int dirty = FRAME_DIRTY_ALL;
+    int settleLeft = FRAME_SETTLE_FRAMES;
+
+    // stats since ResetStats
+    Clock::time_point statsStart;
+    std::clock_t cpuStart = 0;
+    double energyStartJ = -1.0;
+    long long frames[FRAME_KIND_COUNT] = {};
+    double frameMs[FRAME_KIND_COUNT] = {};
+};
+
+#endif
@@ -0,0 +1,9 @@
+#version 330 core
+
+// fullscreen triangle, no vertex buffer: draw 3 vertices with any VAO bound
+// (fog volume slices, shadow moment prefiltering)
+void main()
+{
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
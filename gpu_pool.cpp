@@ -0,0 +1,113 @@
+// Fixed-size sub-allocated GL buffer (see gpu_pool.hpp).
+
+#include <iterator>
+
+#include "gpu_pool.hpp"
+
+bool GpuPool::Init(size_t bytes)
+{
+    Destroy();
+
+    glGenBuffers(1, &buf);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buf);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)bytes, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    capacity = bytes;
+    freeRanges[0] = bytes;
+    return buf != 0;
+}
+
+void GpuPool::Destroy()
+{
+    if (buf) glDeleteBuffers(1, &buf);
+    buf = 0;
+    capacity = 0;
+    used = peak = 0;
+    failures = 0;
+    freeRanges.clear();
+    allocated.clear();
+    retired.clear();
+}
+
+bool GpuPool::Alloc(size_t bytes, size_t align, size_t& outOffset)
+{
+    if (align == 0) align = 1;
+
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        size_t start = it->first;
+        size_t offset = (start + align - 1) / align * align;
+        size_t end = offset + bytes;
+        if (end > start + it->second) continue;
+
+        size_t rangeEnd = start + it->second;
+        freeRanges.erase(it);
+        if (rangeEnd > end) freeRanges[end] = rangeEnd - end;
+
+        Block b = { start, end - start };
+        allocated[offset] = b;
+        used += b.bytes;
+        if (used > peak) peak = used;
+        outOffset = offset;
+        return true;
+    }
+
+    failures++;
+    return false;
+}
+
+void GpuPool::Free(size_t offset)
+{
+    auto it = allocated.find(offset);
+    if (it == allocated.end()) return;
+
+    retired.push_back({ it->second, GPU_POOL_RETIRE_FRAMES });
+    allocated.erase(it);
+}
+
+void GpuPool::EndFrame()
+{
+    for (size_t i = 0; i < retired.size();) {
+        if (--retired[i].framesLeft > 0) { i++; continue; }
+        Release(retired[i].block);
+        retired[i] = retired.back();
+        retired.pop_back();
+    }
+}
+
+// back into the free list, merged with its neighbours
+void GpuPool::Release(const Block& b)
+{
+    size_t start = b.start, bytes = b.bytes;
+    used -= bytes;
+
+    auto next = freeRanges.lower_bound(start);
+    if (next != freeRanges.end() && start + bytes == next->first) {
+        bytes += next->second;
+        next = freeRanges.erase(next);
+    }
+    if (next != freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == start) {
+            prev->second += bytes;
+            return;
+        }
+    }
+    freeRanges[start] = bytes;
+}
+
+size_t GpuPool::LargestFree() const
+{
+    size_t best = 0;
+    for (const auto& r : freeRanges) {
+        if (r.second > best) best = r.second;
+    }
+    return best;
+}
+
+void GpuPool::Upload(size_t offset, const void* data, size_t bytes)
+{
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buf);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)offset, (GLsizeiptr)bytes, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
@@ -0,0 +1,59 @@
+#ifndef GPU_POOL_H
+#define GPU_POOL_H
+
+#include <map>
+#include <vector>
+#include <GL/glew.h>
+
+// One GL buffer of fixed size, created once and sub-allocated on the CPU side, so streaming
+// geometry in and out never reallocates (or re-specifies) the buffer.
+// - first fit over an offset-sorted free list; neighbours are merged back on Free
+// - a freed range is retired for GPU_POOL_RETIRE_FRAMES EndFrame calls before it can be handed
+//   out again (the GPU may still be drawing from it; same depth as the uniform ring)
+// - data goes in with glBufferSubData through GL_COPY_WRITE_BUFFER, so uploading never
+//   touches the element array binding of whatever VAO is bound
+
+static const int GPU_POOL_RETIRE_FRAMES = 3;
+
+class GpuPool {
+public:
+    bool Init(size_t bytes);
+    void Destroy();
+
+    // offset of `bytes` bytes aligned to `align` (any value, e.g. sizeof(Vtx)); false if full
+    bool Alloc(size_t bytes, size_t align, size_t& outOffset);
+    void Free(size_t offset);
+    void EndFrame();
+
+    void Upload(size_t offset, const void* data, size_t bytes);
+
+    GLuint Buffer() const { return buf; }
+    size_t Capacity() const { return capacity; }
+    size_t Used() const { return used; }
+    size_t Peak() const { return peak; }
+    size_t LargestFree() const;
+    int Failures() const { return failures; }
+
+private:
+    struct Block {
+        size_t start, bytes;    // includes the alignment padding in front of the returned offset
+    };
+
+    struct Retired {
+        Block block;
+        int framesLeft;
+    };
+
+    void Release(const Block& b);
+
+    GLuint buf = 0;
+    size_t capacity = 0;
+    size_t used = 0, peak = 0;
+    int failures = 0;
+
+    std::map<size_t, size_t> freeRanges;    // offset -> bytes
+    std::map<size_t, Block> allocated;      // returned offset -> block
+    std::vector<Retired> retired;
+};
+
+#endif
@@ -0,0 +1,298 @@
+// GPU scopes, draw counters, overlay + CSV (see gpu_profiler.hpp).
+
+#include <string.h>
+
+#include "gpu_profiler.hpp"
+
+#include <GL/freeglut.h>   // after GLEW
+
+// counters of the frame being recorded; GpuCountDraw is a no-op outside of one
+struct DrawCounters {
+    int drawCalls;
+    long long triangles;
+    int stateChanges;
+    GLint program, vao, fbo;    // bound at the previous draw
+};
+
+static DrawCounters gCounters;
+static bool gCounting = false;
+
+void GpuCountDraw(GLsizei count)
+{
+    if (!gCounting) return;
+    gCounters.drawCalls++;
+    gCounters.triangles += count / 3;
+
+    // bound objects come from the driver's client side state: no round trip to the GPU
+    GLint program = 0, vao = 0, fbo = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+    gCounters.stateChanges += (program != gCounters.program) + (vao != gCounters.vao) + (fbo != gCounters.fbo);
+    gCounters.program = program;
+    gCounters.vao = vao;
+    gCounters.fbo = fbo;
+}
+
+bool GpuProfiler::Init()
+{
+    GLint bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+    timers = bits > 0;
+    if (!timers) printf("GPU profiler: no timer queries, counters only\n");
+
+    for (int f = 0; f < GPU_PROFILER_FRAMES; f++) {
+        Frame& fr = frames[f];
+        fr.scopeCount = 0;
+        fr.pending = false;
+        if (!timers) continue;
+        glGenQueries(2, fr.frameQueries);
+        for (int s = 0; s < GPU_PROFILER_MAX_SCOPES; s++) glGenQueries(2, fr.scopes[s].queries);
+    }
+    current = 0;
+    depth = 0;
+    return true;
+}
+
+void GpuProfiler::Destroy()
+{
+    StopCsv();
+    for (int f = 0; f < GPU_PROFILER_FRAMES; f++) {
+        Frame& fr = frames[f];
+        if (fr.frameQueries[0]) {
+            glDeleteQueries(2, fr.frameQueries);
+            for (int s = 0; s < GPU_PROFILER_MAX_SCOPES; s++) glDeleteQueries(2, fr.scopes[s].queries);
+        }
+        fr.frameQueries[0] = fr.frameQueries[1] = 0;
+        fr.pending = false;
+    }
+    timers = false;
+    inFrame = false;
+    gCounting = false;
+}
+
+GpuScopeStats* GpuProfiler::FindStats(const char* name, int d)
+{
+    for (int i = 0; i < statsCount; i++) {
+        if (stats[i].depth == d && (stats[i].name == name || strcmp(stats[i].name, name) == 0)) return &stats[i];
+    }
+    if (statsCount == GPU_PROFILER_MAX_SCOPES) return nullptr;
+    GpuScopeStats& s = stats[statsCount++];
+    s.name = name;
+    s.depth = d;
+    s.ms = -1.0f;
+    return &s;
+}
+
+void GpuProfiler::Collect(Frame& f)
+{
+    float ms[GPU_PROFILER_MAX_SCOPES];
+    float total = -1.0f;
+
+    if (f.timed) {
+        GLint available = 0;
+        glGetQueryObjectiv(f.frameQueries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return;
+
+        // the frame's end query was issued last: everything before it is in too
+        GLuint64 t0 = 0, t1 = 0;
+        glGetQueryObjectui64v(f.frameQueries[0], GL_QUERY_RESULT, &t0);
+        glGetQueryObjectui64v(f.frameQueries[1], GL_QUERY_RESULT, &t1);
+        total = (float)((t1 - t0) / 1.0e6);
+        for (int s = 0; s < f.scopeCount; s++) {
+            glGetQueryObjectui64v(f.scopes[s].queries[0], GL_QUERY_RESULT, &t0);
+            glGetQueryObjectui64v(f.scopes[s].queries[1], GL_QUERY_RESULT, &t1);
+            ms[s] = (float)((t1 - t0) / 1.0e6);
+        }
+    }
+    else {
+        for (int s = 0; s < f.scopeCount; s++) ms[s] = -1.0f;
+    }
+    f.pending = false;
+
+    frameDrawCalls = f.drawCalls;
+    frameTriangles = f.triangles;
+    frameStateChanges = f.stateChanges;
+    if (total >= 0.0f) {
+        frameMs = frameMs > 0.0f ? frameMs * 0.9f + 0.1f * total : total;
+        float busy = 0.0f;
+        for (int s = 0; s < f.scopeCount; s++) {
+            if (f.scopes[s].depth == 0) busy += ms[s];
+        }
+        lastBusyMs = busy;
+        busySamples++;
+    }
+
+    for (int s = 0; s < f.scopeCount; s++) {
+        const Scope& sc = f.scopes[s];
+        GpuScopeStats* st = FindStats(sc.name, sc.depth);
+        if (!st) continue;
+        if (ms[s] >= 0.0f) st->ms = st->ms >= 0.0f ? st->ms * 0.9f + 0.1f * ms[s] : ms[s];
+        st->drawCalls = sc.drawCalls;
+        st->triangles = sc.triangles;
+        st->stateChanges = sc.stateChanges;
+
+        if (csv) fprintf(csv, "%u,%s,%d,%.4f,%d,%lld,%d\n", f.index, sc.name, sc.depth, ms[s],
+            sc.drawCalls, sc.triangles, sc.stateChanges);
+    }
+    if (csv) fprintf(csv, "%u,frame,0,%.4f,%d,%lld,%d\n", f.index, total, f.drawCalls, f.triangles, f.stateChanges);
+}
+
+void GpuProfiler::BeginFrame()
+{
+    // oldest first, so the CSV stays in frame order
+    for (int k = 1; k <= GPU_PROFILER_FRAMES; k++) {
+        Frame& f = frames[(current + k) % GPU_PROFILER_FRAMES];
+        if (f.pending) Collect(f);
+    }
+
+    Frame& f = frames[current];
+    depth = overflow = 0;
+    inFrame = !f.pending;   // GPU too far behind: this frame is not recorded
+    if (!inFrame) return;
+
+    f.scopeCount = 0;
+    f.timed = timers;
+    f.index = frameIndex;
+    if (f.timed) glQueryCounter(f.frameQueries[0], GL_TIMESTAMP);
+
+    // counting costs a few glGets per draw: only while somebody looks at the numbers
+    gCounting = overlay || csv;
+    memset(&gCounters, 0, sizeof(gCounters));
+    gCounters.program = gCounters.vao = gCounters.fbo = -1;
+}
+
+void GpuProfiler::EndFrame()
+{
+    frameIndex++;
+    if (!inFrame) return;
+    while (depth > 0) End();
+
+    Frame& f = frames[current];
+    if (f.timed) glQueryCounter(f.frameQueries[1], GL_TIMESTAMP);
+    f.pending = true;
+    f.drawCalls = gCounters.drawCalls;
+    f.triangles = gCounters.triangles;
+    f.stateChanges = gCounters.stateChanges;
+
+    current = (current + 1) % GPU_PROFILER_FRAMES;
+    inFrame = false;
+    gCounting = false;
+}
+
+void GpuProfiler::Begin(const char* name)
+{
+    if (depth == GPU_PROFILER_MAX_DEPTH) {
+        overflow++;
+        return;
+    }
+    Frame& f = frames[current];
+    if (!inFrame || f.scopeCount == GPU_PROFILER_MAX_SCOPES) {
+        stack[depth++] = -1;
+        return;
+    }
+
+    int s = f.scopeCount++;
+    Scope& sc = f.scopes[s];
+    sc.name = name;
+    sc.depth = depth;
+    // counters hold the values at Begin until End turns them into differences
+    sc.drawCalls = gCounters.drawCalls;
+    sc.triangles = gCounters.triangles;
+    sc.stateChanges = gCounters.stateChanges;
+    if (f.timed) glQueryCounter(sc.queries[0], GL_TIMESTAMP);
+    stack[depth++] = s;
+}
+
+void GpuProfiler::End()
+{
+    if (overflow > 0) {
+        overflow--;
+        return;
+    }
+    if (depth == 0) return;
+    int s = stack[--depth];
+    if (s < 0) return;
+
+    Frame& f = frames[current];
+    Scope& sc = f.scopes[s];
+    if (f.timed) glQueryCounter(sc.queries[1], GL_TIMESTAMP);
+    sc.drawCalls = gCounters.drawCalls - sc.drawCalls;
+    sc.triangles = gCounters.triangles - sc.triangles;
+    sc.stateChanges = gCounters.stateChanges - sc.stateChanges;
+}
+
+bool GpuProfiler::StartCsv(const char* path)
+{
+    StopCsv();
+    csv = fopen(path, "w");
+    if (!csv) {
+        printf("Nu am putut scrie: %s\n", path);
+        return false;
+    }
+    fprintf(csv, "frame,scope,depth,gpu_ms,draw_calls,triangles,state_changes\n");
+    return true;
+}
+
+void GpuProfiler::StopCsv()
+{
+    if (csv) fclose(csv);
+    csv = nullptr;
+}
+
+static void formatMs(char* out, size_t size, float ms)
+{
+    if (ms < 0.0f) snprintf(out, size, "    n/a");
+    else snprintf(out, size, "%7.3f", ms);
+}
+
+void GpuProfiler::DrawOverlay(int width, int height) const
+{
+    // fixed function raster text on top of the finished frame
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+    glUseProgram(0);
+    glBindVertexArray(0);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    const int lineHeight = 15;
+    int y = height - 20;
+    char line[160], ms[16];
+
+    formatMs(ms, sizeof(ms), frameMs > 0.0f ? frameMs : -1.0f);
+    snprintf(line, sizeof(line), "GPU frame %s ms  %5d draws  %8lld tris  %5d state changes%s",
+        ms, frameDrawCalls, frameTriangles, frameStateChanges, csv ? "  [csv]" : "");
+    glColor3f(1.0f, 0.9f, 0.4f);
+    glWindowPos2i(10, y);
+    glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)line);
+
+    glColor3f(0.85f, 0.95f, 1.0f);
+    for (int i = 0; i < statsCount; i++) {
+        const GpuScopeStats& s = stats[i];
+        y -= lineHeight;
+        formatMs(ms, sizeof(ms), s.ms);
+        snprintf(line, sizeof(line), "%*s%-*s %s ms  %5d draws  %8lld tris  %5d states", s.depth * 2, "",
+            18 - s.depth * 2, s.name, ms, s.drawCalls, s.triangles, s.stateChanges);
+        glWindowPos2i(10, y);
+        glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)line);
+    }
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+void GpuProfiler::PrintStats() const
+{
+    char ms[16];
+    formatMs(ms, sizeof(ms), frameMs > 0.0f ? frameMs : -1.0f);
+    printf("\nGPU profile (averaged, read back %d frames late at most)\n", GPU_PROFILER_FRAMES - 1);
+    printf("  %-20s %s ms  %5d draws  %8lld tris  %5d state changes\n", "frame", ms,
+        frameDrawCalls, frameTriangles, frameStateChanges);
+    for (int i = 0; i < statsCount; i++) {
+        const GpuScopeStats& s = stats[i];
+        formatMs(ms, sizeof(ms), s.ms);
+        printf("  %*s%-*s %s ms  %5d draws  %8lld tris  %5d state changes\n", s.depth * 2, "",
+            20 - s.depth * 2, s.name, ms, s.drawCalls, s.triangles, s.stateChanges);
+    }
+    if (frameDrawCalls == 0) printf("  (draws are counted while the overlay or the CSV log is on)\n");
+}
@@ -0,0 +1,115 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <stdio.h>
+#include <GL/glew.h>
+
+// Where the GPU frame goes: named scopes (shadow pass per light, fog, main pass, post, ...)
+// timed with GL_TIMESTAMP queries at Begin/End.
+//  - timestamps, not GL_TIME_ELAPSED: those cannot overlap, and the passes keep their own
+//  - a ring of GPU_PROFILER_FRAMES frames of queries; a frame is read back once its last query
+//    is available, GPU_PROFILER_FRAMES - 1 frames late at most, never waited on (a frame whose
+//    slot is still pending is simply not timed)
+//  - per scope also draw calls, triangles and state changes (program / VAO / framebuffer
+//    different from the previous draw), counted by GpuCountDraw in the draw paths
+//  - text overlay (glutBitmapString: needs the compatibility context freeglut gives by default)
+//    and an optional CSV log, one row per scope per frame
+// Without timer queries (GL_QUERY_COUNTER_BITS = 0, some software implementations) the times
+// read "n/a" and the counters still work.
+
+static const int GPU_PROFILER_FRAMES = 4;
+static const int GPU_PROFILER_MAX_SCOPES = 32;
+static const int GPU_PROFILER_MAX_DEPTH = 4;
+
+// every draw call goes through here (count = vertices, or indices)
+void GpuCountDraw(GLsizei count);
+
+struct GpuScopeStats {
+    const char* name = nullptr;     // string literal
+    int depth = 0;
+    float ms = 0.0f;                // running average; < 0 = not timed
+    int drawCalls = 0;              // last frame read back
+    long long triangles = 0;
+    int stateChanges = 0;
+};
+
+class GpuProfiler {
+public:
+    ~GpuProfiler() { Destroy(); }
+
+    bool Init();
+    void Destroy();
+
+    // BeginFrame reads back finished frames; scopes go between the two
+    void BeginFrame();
+    void EndFrame();
+
+    // name: a string literal (kept as a pointer); scopes may nest
+    void Begin(const char* name);
+    void End();
+
+    // overlay in the top left corner of a width x height framebuffer 0
+    void DrawOverlay(int width, int height) const;
+
+    // log one row per scope of every frame read back from now on
+    bool StartCsv(const char* path);
+    void StopCsv();
+    bool Logging() const { return csv != nullptr; }
+
+    bool overlay = false;
+
+    // sum of the top level scopes of the last frame read back (the GPU busy time, without the
+    // gaps between passes); BusySamples counts the frames read back with timings
+    float LastBusyMs() const { return lastBusyMs; }
+    unsigned int BusySamples() const { return busySamples; }
+
+    void PrintStats() const;
+
+private:
+    struct Scope {
+        const char* name;
+        int depth;
+        GLuint queries[2];          // begin, end (timestamps)
+        int drawCalls;
+        long long triangles;
+        int stateChanges;
+    };
+
+    struct Frame {
+        Scope scopes[GPU_PROFILER_MAX_SCOPES];
+        int scopeCount = 0;
+        int drawCalls = 0;
+        long long triangles = 0;
+        int stateChanges = 0;
+        GLuint frameQueries[2] = {};
+        bool timed = false;
+        bool pending = false;
+        unsigned int index = 0;
+    };
+
+    void Collect(Frame& f);
+    GpuScopeStats* FindStats(const char* name, int depth);
+
+    bool timers = false;            // timer queries available
+    Frame frames[GPU_PROFILER_FRAMES];
+    int current = 0;
+    bool inFrame = false;
+    unsigned int frameIndex = 0;
+
+    int stack[GPU_PROFILER_MAX_DEPTH];
+    int depth = 0;
+    int overflow = 0;               // Begin calls past GPU_PROFILER_MAX_DEPTH
+
+    GpuScopeStats stats[GPU_PROFILER_MAX_SCOPES];
+    int statsCount = 0;
+    float frameMs = 0.0f;
+    float lastBusyMs = 0.0f;
+    unsigned int busySamples = 0;
+    int frameDrawCalls = 0;
+    long long frameTriangles = 0;
+    int frameStateChanges = 0;
+
+    FILE* csv = nullptr;
+};
+
+#endif
@@ -0,0 +1,122 @@
+// Persistently mapped per-frame ring buffer (see gpu_ring.hpp).
+
+#include <stdio.h>
+#include <chrono>
+
+#include "gpu_ring.hpp"
+
+bool GpuRing::Init(GLenum tgt, size_t bytesPerFrame, int frames)
+{
+    if (frames < 1) frames = 1;
+    if (frames > GPU_RING_MAX_FRAMES) frames = GPU_RING_MAX_FRAMES;
+
+    target = tgt;
+    frameSize = bytesPerFrame;
+    frameCount = frames;
+    frameIdx = 0;
+    head = 0;
+
+    GLsizeiptr total = (GLsizeiptr)(frameSize * frameCount);
+
+    glGenBuffers(1, &buf);
+    glBindBuffer(target, buf);
+
+    persistent = GLEW_ARB_buffer_storage != 0;
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, total, NULL, flags);
+        mapped = (unsigned char*)glMapBufferRange(target, 0, total, flags);
+        if (!mapped) {
+            printf("WARN: GpuRing persistent map failed, using glBufferSubData fallback\n");
+            glDeleteBuffers(1, &buf);
+            glGenBuffers(1, &buf);
+            glBindBuffer(target, buf);
+            persistent = false;
+        }
+    }
+
+    if (!persistent) {
+        glBufferData(target, total, NULL, GL_DYNAMIC_DRAW);
+        staging.resize(frameSize);
+    }
+
+    glBindBuffer(target, 0);
+
+    printf("GpuRing: %d x %zu bytes (%s)\n", frameCount, frameSize, persistent ? "persistent" : "fallback");
+    return true;
+}
+
+void GpuRing::Destroy()
+{
+    for (int i = 0; i < GPU_RING_MAX_FRAMES; i++) {
+        if (fences[i]) glDeleteSync(fences[i]);
+        fences[i] = 0;
+    }
+
+    if (buf) {
+        if (mapped) {
+            glBindBuffer(target, buf);
+            glUnmapBuffer(target);
+            glBindBuffer(target, 0);
+        }
+        glDeleteBuffers(1, &buf);
+    }
+
+    buf = 0;
+    mapped = nullptr;
+    staging.clear();
+}
+
+void GpuRing::BeginFrame()
+{
+    frameIdx = (frameIdx + 1) % frameCount;
+    head = 0;
+
+    GLsync& f = fences[frameIdx];
+    if (!f) return;
+
+    // fast path: already signalled
+    GLenum r = glClientWaitSync(f, 0, 0);
+    if (r != GL_ALREADY_SIGNALED && r != GL_CONDITION_SATISFIED) {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        do {
+            r = glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+        } while (r == GL_TIMEOUT_EXPIRED);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        waitMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+    }
+
+    glDeleteSync(f);
+    f = 0;
+}
+
+void GpuRing::EndFrame()
+{
+    GLsync& f = fences[frameIdx];
+    if (f) glDeleteSync(f);
+    f = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void* GpuRing::Alloc(size_t bytes, size_t align, GLintptr& outOffset)
+{
+    size_t start = (head + align - 1) & ~(align - 1);
+    if (start + bytes > frameSize) {
+        printf("WARN: GpuRing region full (%zu + %zu > %zu)\n", start, bytes, frameSize);
+        return nullptr;
+    }
+
+    head = start + bytes;
+    outOffset = (GLintptr)(frameIdx * frameSize + start);
+
+    return persistent ? (void*)(mapped + outOffset) : (void*)(staging.data() + start);
+}
+
+void GpuRing::Commit(GLintptr offset, size_t bytes)
+{
+    if (persistent || bytes == 0) return;
+
+    size_t local = (size_t)offset - frameIdx * frameSize;
+    glBindBuffer(target, buf);
+    glBufferSubData(target, offset, (GLsizeiptr)bytes, staging.data() + local);
+    glBindBuffer(target, 0);
+}
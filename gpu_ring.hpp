@@ -0,0 +1,62 @@
+#ifndef GPU_RING_H
+#define GPU_RING_H
+
+#include <vector>
+#include <GL/glew.h>
+
+// Persistently mapped, fenced ring buffer split into N per-frame regions (default: triple buffering).
+// The CPU writes the current frame's region while the GPU still reads the previous ones;
+// BeginFrame() waits on the fence of the region it is about to reuse (normally already signalled).
+//
+// With GL 4.4 / ARB_buffer_storage the buffer is mapped once (PERSISTENT | COHERENT).
+// Without it the ring falls back to a CPU staging copy that Commit() uploads with glBufferSubData.
+//
+// Usage per frame:
+//   ring.BeginFrame();
+//   GLintptr off; T* p = (T*)ring.Alloc(sizeof(T), align, off); *p = ...; ring.Commit(off, sizeof(T));
+//   glBindBufferRange(GL_UNIFORM_BUFFER, binding, ring.Buffer(), off, sizeof(T));
+//   ... draw ...
+//   ring.EndFrame();
+
+static const int GPU_RING_MAX_FRAMES = 4;
+
+class GpuRing {
+public:
+    bool Init(GLenum target, size_t bytesPerFrame, int frames = 3);
+    void Destroy();
+
+    void BeginFrame();
+    void EndFrame();
+
+    // returns a CPU pointer for `bytes` bytes aligned to `align` (power of two) in the current region,
+    // or NULL if the region is full
+    void* Alloc(size_t bytes, size_t align, GLintptr& outOffset);
+
+    // makes the bytes written at offset visible to the GPU (no-op when persistently mapped)
+    void Commit(GLintptr offset, size_t bytes);
+
+    GLuint Buffer() const { return buf; }
+    bool IsPersistent() const { return persistent; }
+    size_t FrameSize() const { return frameSize; }
+    size_t UsedThisFrame() const { return head; }
+
+    // total time spent blocked on fences (ms) - should stay ~0
+    double WaitMs() const { return waitMs; }
+
+private:
+    GLuint buf = 0;
+    GLenum target = GL_UNIFORM_BUFFER;
+    size_t frameSize = 0;
+    int frameCount = 0;
+    int frameIdx = 0;
+    size_t head = 0;
+
+    bool persistent = false;
+    unsigned char* mapped = nullptr;
+    std::vector<unsigned char> staging; // fallback path only
+
+    GLsync fences[GPU_RING_MAX_FRAMES] = {};
+    double waitMs = 0.0;
+};
+
+#endif
@@ -0,0 +1,117 @@
+// Surfaceless EGL context (see headless.hpp).
+
+#include <stdio.h>
+#include <string.h>
+
+#include "headless.hpp"
+
+#ifdef __linux__
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static bool hasExtension(const char* list, const char* name)
+{
+    if (!list) return false;
+    size_t n = strlen(name);
+    for (const char* p = strstr(list, name); p; p = strstr(p + n, name)) {
+        if ((p == list || p[-1] == ' ') && (p[n] == ' ' || p[n] == '\0')) return true;
+    }
+    return false;
+}
+
+bool HeadlessContext::Create()
+{
+    Destroy();
+
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+    const char* clientExt = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (hasExtension(clientExt, "EGL_MESA_platform_surfaceless")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (dpy == EGL_NO_DISPLAY) dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major = 0, minor = 0;
+    if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, &major, &minor)) {
+        printf("Headless: no EGL display\n");
+        return false;
+    }
+    display = dpy;
+
+    const char* ext = eglQueryString(dpy, EGL_EXTENSIONS);
+    if (!hasExtension(ext, "EGL_KHR_surfaceless_context")) {
+        printf("Headless: EGL %d.%d without EGL_KHR_surfaceless_context\n", major, minor);
+        Destroy();
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        printf("Headless: EGL without desktop OpenGL\n");
+        Destroy();
+        return false;
+    }
+
+    // any OpenGL capable config: nothing is ever drawn to an EGL surface
+    const EGLint configAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = 0;
+    EGLint configs = 0;
+    if (!eglChooseConfig(dpy, configAttribs, &config, 1, &configs) || configs == 0) {
+        if (!hasExtension(ext, "EGL_KHR_no_config_context")) {
+            printf("Headless: no EGL config for OpenGL\n");
+            Destroy();
+            return false;
+        }
+        config = (EGLConfig)0;  // EGL_NO_CONFIG_KHR
+    }
+
+    // same kind of context freeglut gives the windowed app: 3.3+, compatibility profile
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, contextAttribs);
+    if (ctx == EGL_NO_CONTEXT) {
+        printf("Headless: eglCreateContext failed (0x%x)\n", eglGetError());
+        Destroy();
+        return false;
+    }
+    context = ctx;
+
+    if (!eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+        printf("Headless: eglMakeCurrent failed (0x%x)\n", eglGetError());
+        Destroy();
+        return false;
+    }
+
+    printf("Headless: EGL %d.%d, %s\n", major, minor, eglQueryString(dpy, EGL_VENDOR));
+    return true;
+}
+
+void HeadlessContext::Destroy()
+{
+    EGLDisplay dpy = (EGLDisplay)display;
+    if (dpy != EGL_NO_DISPLAY && display) {
+        eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context) eglDestroyContext(dpy, (EGLContext)context);
+        eglTerminate(dpy);
+    }
+    display = nullptr;
+    context = nullptr;
+}
+
+#else
+
+bool HeadlessContext::Create()
+{
+    printf("Headless: needs EGL (Linux only)\n");
+    return false;
+}
+
+void HeadlessContext::Destroy()
+{
+}
+
+#endif
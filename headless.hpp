@@ -0,0 +1,25 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// Offscreen GL context for the headless benchmark: no window, no display server.
+// EGL on Mesa's surfaceless platform (EGL_MESA_platform_surfaceless, falling back to the
+// default display), desktop OpenGL >= 3.3 compatibility profile, made current without any
+// surface (EGL_KHR_surfaceless_context). There is no default framebuffer: the frame goes into
+// an FBO (main.cpp hands it to the post pipeline as its output).
+// Runs on a GPU-less box with Mesa's software rasterizer (llvmpipe), e.g. LIBGL_ALWAYS_SOFTWARE=1.
+// Linux (EGL) only; elsewhere Create fails with a message.
+
+class HeadlessContext {
+public:
+    ~HeadlessContext() { Destroy(); }
+
+    // current on the calling thread
+    bool Create();
+    void Destroy();
+
+private:
+    void* display = nullptr;    // EGLDisplay
+    void* context = nullptr;    // EGLContext
+};
+
+#endif
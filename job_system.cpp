@@ -0,0 +1,345 @@
+// Work-stealing job system (see job_system.hpp).
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <chrono>
+
+#include "job_system.hpp"
+#include "cpu_profiler.hpp"
+
+// which system/lane the current thread works for (several systems may coexist, e.g. benchmarks)
+static thread_local const JobSystem* tSystem = nullptr;
+static thread_local int tLane = -1;
+
+bool JobSystem::Init(int count)
+{
+    Shutdown();
+
+    if (count <= 0) {
+        count = (int)std::thread::hardware_concurrency() - 1;
+        if (count < 1) count = 1;
+    }
+
+    epoch = std::chrono::steady_clock::now();
+    mainThreadId = std::this_thread::get_id();
+    quit = false;
+
+    for (int i = 0; i < count; i++) workers.emplace_back(new Lane());
+    for (int i = 0; i < count; i++) workers[i]->thread = std::thread(&JobSystem::WorkerLoop, this, i);
+    return true;
+}
+
+void JobSystem::Shutdown()
+{
+    if (workers.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lk(sleepM);
+        quit = true;
+    }
+    wake.notify_all();
+
+    for (auto& w : workers) {
+        if (w->thread.joinable()) w->thread.join();
+    }
+    workers.clear();
+
+    PumpMainThread();
+}
+
+double JobSystem::NowUs() const
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+int JobSystem::CurrentLane() const
+{
+    return tSystem == this ? tLane : -1;
+}
+
+// ---------------- Queues ----------------
+void JobSystem::Push(Job&& job)
+{
+    if (workers.empty()) {
+        // not started (or shut down): run inline so nothing is lost
+        Execute(job, -1);
+        return;
+    }
+
+    int lane = CurrentLane();
+    if (lane < 0) lane = (int)(nextLane.fetch_add(1) % workers.size());
+
+    {
+        std::lock_guard<std::mutex> lk(workers[lane]->m);
+        workers[lane]->jobs.push_back(std::move(job));
+    }
+
+    // a sleeper re-checks `queued` under sleepM, so taking it here cannot lose the wake-up
+    queued.fetch_add(1);
+    if (sleeping.load() > 0) {
+        { std::lock_guard<std::mutex> lk(sleepM); }
+        wake.notify_one();
+    }
+}
+
+bool JobSystem::PopOwn(int lane, Job& out)
+{
+    Lane& l = *workers[lane];
+    std::lock_guard<std::mutex> lk(l.m);
+    if (l.jobs.empty()) return false;
+    out = std::move(l.jobs.back());
+    l.jobs.pop_back();
+    queued.fetch_sub(1);
+    return true;
+}
+
+bool JobSystem::Steal(int thief, Job& out, bool takeBackground)
+{
+    int n = (int)workers.size();
+    int start = thief >= 0 ? thief + 1 : (int)(nextLane.load() % n);
+
+    for (int k = 0; k < n; k++) {
+        int victim = (start + k) % n;
+        if (victim == thief) continue;
+
+        Lane& l = *workers[victim];
+        std::unique_lock<std::mutex> lk(l.m, std::try_to_lock);
+        if (!lk.owns_lock() || l.jobs.empty()) continue;
+
+        auto it = l.jobs.begin();
+        if (!takeBackground) {
+            while (it != l.jobs.end() && it->background) ++it;
+            if (it == l.jobs.end()) continue;
+        }
+
+        out = std::move(*it);
+        l.jobs.erase(it);
+        queued.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+// ---------------- Execution ----------------
+void JobSystem::Execute(Job& job, int lane)
+{
+    CPU_ZONE(job.name);
+    if (tracing.load()) {
+        double t0 = NowUs();
+        job.fn();
+        double t1 = NowUs();
+        if (lane >= 0 || std::this_thread::get_id() == mainThreadId) {
+            std::lock_guard<std::mutex> lk(traceM);
+            (lane >= 0 ? *workers[lane] : mainLane).trace.push_back({ job.name, t0, t1 });
+        }
+    }
+    else {
+        job.fn();
+    }
+    Finish(job.counter);
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+    if (!counter) return;
+
+    // Done() stays false until the continuations are dispatched, so a waiter never returns
+    // (and frees a counter on its stack) while this is still using it
+    counter->finishing.fetch_add(1);
+    if (counter->value.fetch_sub(1) == 1) {
+        std::vector<JobCounter::Continuation> ready;
+        {
+            std::lock_guard<std::mutex> lk(counter->m);
+            ready.swap(counter->continuations);
+        }
+        for (auto& c : ready) {
+            if (c.mainThread) RunOnMainThread(c.name, std::move(c.fn));
+            else Spawn(c.name, std::move(c.fn));
+        }
+    }
+    counter->finishing.fetch_sub(1);
+}
+
+void JobSystem::WorkerLoop(int index)
+{
+    tSystem = this;
+    tLane = index;
+
+    char name[32];
+    snprintf(name, sizeof(name), "worker %d", index);
+    CpuProfilerThreadName(name);
+
+    for (;;) {
+        Job job;
+        if (PopOwn(index, job) || Steal(index, job, true)) {
+            Execute(job, index);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lk(sleepM);
+        sleeping.fetch_add(1);
+        wake.wait(lk, [this] { return quit || queued.load() > 0; });
+        sleeping.fetch_sub(1);
+        if (quit && queued.load() == 0) return;
+    }
+}
+
+// ---------------- API ----------------
+void JobSystem::Spawn(const char* name, JobFn fn, JobCounter* counter)
+{
+    if (counter) counter->value.fetch_add(1);
+
+    Job job;
+    job.name = name;
+    job.fn = std::move(fn);
+    job.counter = counter;
+    Push(std::move(job));
+}
+
+void JobSystem::SpawnBackground(const char* name, JobFn fn, JobCounter* counter)
+{
+    if (counter) counter->value.fetch_add(1);
+
+    Job job;
+    job.name = name;
+    job.fn = std::move(fn);
+    job.counter = counter;
+    job.background = true;
+    Push(std::move(job));
+}
+
+void JobSystem::Then(JobCounter& counter, const char* name, JobFn fn, bool mainThread)
+{
+    {
+        // Finish takes the list under the same lock after the count hits 0, so a continuation
+        // is either seen by it or sees the 0 here
+        std::lock_guard<std::mutex> lk(counter.m);
+        if (counter.value.load() != 0) {
+            counter.continuations.push_back({ name, std::move(fn), mainThread });
+            return;
+        }
+    }
+    if (mainThread) RunOnMainThread(name, std::move(fn));
+    else Spawn(name, std::move(fn));
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    bool onMain = std::this_thread::get_id() == mainThreadId;
+    int lane = CurrentLane();
+
+    while (!counter.Done()) {
+        if (onMain) PumpMainThread();
+        if (workers.empty()) break; // everything ran inline
+
+        Job job;
+        // workers take anything; other threads (main) only short foreground jobs
+        if ((lane >= 0 && PopOwn(lane, job)) || Steal(lane, job, lane >= 0)) Execute(job, lane);
+        else std::this_thread::yield();
+    }
+}
+
+void JobSystem::ParallelFor(const char* name, int count, int grain, const std::function<void(int, int)>& fn)
+{
+    if (count <= 0) return;
+    if (grain < 1) grain = 1;
+
+    if (count <= grain || workers.empty()) {
+        fn(0, count);
+        return;
+    }
+
+    JobCounter done;
+    for (int begin = 0; begin < count; begin += grain) {
+        int end = begin + grain < count ? begin + grain : count;
+        Spawn(name, [&fn, begin, end] { fn(begin, end); }, &done);
+    }
+    Wait(done);
+}
+
+void JobSystem::RunOnMainThread(const char* name, JobFn fn)
+{
+    Job job;
+    job.name = name;
+    job.fn = std::move(fn);
+
+    std::lock_guard<std::mutex> lk(mainQueueM);
+    mainQueue.push_back(std::move(job));
+}
+
+int JobSystem::PumpMainThread()
+{
+    std::vector<Job> jobs;
+    {
+        std::lock_guard<std::mutex> lk(mainQueueM);
+        jobs.swap(mainQueue);
+    }
+    for (Job& j : jobs) Execute(j, -1);
+    return (int)jobs.size();
+}
+
+// ---------------- Trace ----------------
+void JobSystem::SetTracing(bool on)
+{
+    if (on && !tracing.load()) {
+        std::lock_guard<std::mutex> lk(traceM);
+        for (auto& w : workers) w->trace.clear();
+        mainLane.trace.clear();
+    }
+    tracing = on;
+}
+
+void JobSystem::PrintTraceSummary() const
+{
+    std::lock_guard<std::mutex> lk(traceM);
+
+    double t0 = 1e300, t1 = 0.0;
+    auto span = [&](const Lane& l)
+        {
+            for (const TraceEvent& e : l.trace) {
+                if (e.startUs < t0) t0 = e.startUs;
+                if (e.endUs > t1) t1 = e.endUs;
+            }
+        };
+    for (const auto& w : workers) span(*w);
+    span(mainLane);
+
+    double wall = t1 > t0 ? t1 - t0 : 0.0;
+    printf("\nJob trace: %.2f ms\n  lane | jobs   | busy ms  | busy %%\n", wall * 1e-3);
+
+    auto row = [&](const char* name, const Lane& l)
+        {
+            double busy = 0.0;
+            for (const TraceEvent& e : l.trace) busy += e.endUs - e.startUs;
+            printf("  %-4s | %6zu | %8.3f | %5.1f\n", name, l.trace.size(), busy * 1e-3, wall > 0.0 ? 100.0 * busy / wall : 0.0);
+        };
+    for (size_t i = 0; i < workers.size(); i++) {
+        char name[24];
+        snprintf(name, sizeof(name), "w%zu", i);
+        row(name, *workers[i]);
+    }
+    row("main", mainLane);
+}
+
+bool JobSystem::WriteTrace(const char* path) const
+{
+    std::lock_guard<std::mutex> lk(traceM);
+
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        printf("Nu am putut scrie: %s\n", path);
+        return false;
+    }
+
+    fprintf(f, "lane,job,start_us,end_us\n");
+    for (size_t i = 0; i < workers.size(); i++) {
+        for (const TraceEvent& e : workers[i]->trace) fprintf(f, "w%zu,%s,%.1f,%.1f\n", i, e.name, e.startUs, e.endUs);
+    }
+    for (const TraceEvent& e : mainLane.trace) fprintf(f, "main,%s,%.1f,%.1f\n", e.name, e.startUs, e.endUs);
+
+    fclose(f);
+    return true;
+}
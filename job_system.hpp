@@ -0,0 +1,127 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+// Work-stealing job system.
+// - one deque per worker: the owner pushes and pops at the back (LIFO, data still in cache),
+//   idle workers steal from the front of the others (oldest = usually the biggest piece)
+// - jobs spawned from a non-worker thread (the main thread) are dealt out round-robin
+// - JobCounter is the dependency counter: +1 per job spawned against it, -1 when the job ends;
+//   continuations attached with Then are spawned when it reaches 0 (on a worker, or on the
+//   main thread queue for anything that touches GL)
+// - Wait never just blocks: the waiting thread runs queued jobs (and, on the main thread,
+//   the main thread queue) until the counter reaches 0; background jobs (long file/decode
+//   work) are left to the workers so a waiting frame never picks one up
+// - optional per-worker trace of every job (name, start, end)
+
+typedef std::function<void()> JobFn;
+
+class JobCounter {
+public:
+    // 0 and nobody is still dispatching its continuations (after that it may be destroyed)
+    bool Done() const { return value.load() == 0 && finishing.load() == 0; }
+    int Pending() const { return value.load(); }
+
+private:
+    friend class JobSystem;
+    struct Continuation {
+        const char* name;
+        JobFn fn;
+        bool mainThread;
+    };
+
+    std::atomic<int> value{ 0 };
+    std::atomic<int> finishing{ 0 };   // jobs between their decrement and their last access
+    std::mutex m;
+    std::vector<Continuation> continuations;
+};
+
+class JobSystem {
+public:
+    ~JobSystem() { Shutdown(); }
+
+    // workers = 0: hardware threads - 1 (the main thread helps while it waits)
+    bool Init(int workers = 0);
+    void Shutdown();
+    int WorkerCount() const { return (int)workers.size(); }
+
+    // name must be a string literal (kept as is for the trace)
+    void Spawn(const char* name, JobFn fn, JobCounter* counter = nullptr);
+    void SpawnBackground(const char* name, JobFn fn, JobCounter* counter = nullptr);
+
+    // fn is spawned once counter reaches 0 (right away if it already is)
+    void Then(JobCounter& counter, const char* name, JobFn fn, bool mainThread = false);
+
+    void Wait(JobCounter& counter);
+
+    // fn(begin, end) over [0, count) in chunks of `grain` items; returns when all are done
+    void ParallelFor(const char* name, int count, int grain, const std::function<void(int, int)>& fn);
+
+    // GL work produced by jobs; PumpMainThread runs it on the thread that called Init
+    void RunOnMainThread(const char* name, JobFn fn);
+    int PumpMainThread();
+
+    // trace: one lane per worker + one for the main thread
+    void SetTracing(bool on);
+    bool Tracing() const { return tracing.load(); }
+    void PrintTraceSummary() const;
+    bool WriteTrace(const char* path) const;    // CSV: lane,job,start_us,end_us
+
+private:
+    struct Job {
+        const char* name = nullptr;
+        JobFn fn;
+        JobCounter* counter = nullptr;
+        bool background = false;
+    };
+
+    struct TraceEvent {
+        const char* name;
+        double startUs, endUs;
+    };
+
+    struct Lane {
+        std::mutex m;
+        std::deque<Job> jobs;           // unused for the main thread lane
+        std::vector<TraceEvent> trace;  // under traceM
+        std::thread thread;
+    };
+
+    void WorkerLoop(int index);
+    void Push(Job&& job);
+    bool PopOwn(int lane, Job& out);
+    bool Steal(int thief, Job& out, bool takeBackground);
+    void Execute(Job& job, int lane);
+    void Finish(JobCounter* counter);
+    int CurrentLane() const;
+    double NowUs() const;
+
+    std::vector<std::unique_ptr<Lane> > workers;
+    Lane mainLane;
+    std::thread::id mainThreadId;
+
+    std::mutex mainQueueM;
+    std::vector<Job> mainQueue;
+
+    std::mutex sleepM;
+    std::condition_variable wake;
+    std::atomic<int> queued{ 0 };
+    std::atomic<int> sleeping{ 0 };
+    std::atomic<unsigned int> nextLane{ 0 };
+    bool quit = false;
+
+    std::atomic<bool> tracing{ false };
+    mutable std::mutex traceM;
+    std::chrono::steady_clock::time_point epoch;
+};
+
+#endif
@@ -1,28 +1,75 @@
-// Cyberpunk Alley + NORMAL MAPPING + STEAM + Fog + REAL SHADOW MAPPING (3 lights, 2D shadow maps)
+// Cyberpunk Alley + NORMAL MAPPING + STEAM + Fog + REAL SHADOW MAPPING (3 lights, 2D shadow maps) + HDR/bloom
+//  + dynamic resolution with temporal upsampling (TAA)
 // Texturi langa exe/cpp:
 //  - asphalt.jpg
 //  - asphalt_n.jpg (sau .png)
 //  - wall.jpg
 //  - wall_n.jpg
 //  - sign3.png
+//  (optional: asphalt.ktx, wall_n.ktx, ... made by texpack are loaded instead, already compressed)
+//  (optional: alley.pack made by the bundler replaces all of the above + the OBJs + BuildAlley;
+//   --no-pack ignores it, --ttff prints the time to first frame and exits)
 //
 // Controale:
 //  sageti = orbit (cuaternioni), +/- zoom
 //  i/j/k/l = muta lightPos[0] (key light) pe Y/Z
 //  n = toggle normal mapping
-//  f = toggle fog
+//  f = toggle fog (volumetric: froxel grid lit by the clustered lights, see fog_volume.hpp) + fog GPU ms
 //  m = toggle shadow mapping
-
+//  q = cycle shadow filtering: PCF 3x3 / VSM / EVSM (prefiltered moment maps); p and x give the A/B timings
+//  u = cycle shadow update budget (1 map / 2 maps / unlimited / 0.5 ms per frame)
+//  p = print shadow scheduler stats (staleness per light)
+//  [ / ] = halve / double the number of small neon lights (clustered shading)
+//  c = light-count benchmark (3 .. 4096 lights); also: --bench-lights on the command line
+//  x = shader variant report (compile/link/cache time, GPU cost per variant)
+//  v = vertex throughput benchmark (old vs current alley.vert); also: --bench-vertex
+//  t = start / stop the job trace (per-worker summary + job_trace.csv)
+//  b = job system benchmark (spawn overhead, scaling with workers); also: --bench-jobs
+//  r = resident resources (mesh + image caches: state, refs, size, hits, evictions)
+//  w/a/s/d = move the camera target; neighbouring alley blocks stream in around the camera
+//  g = streaming stats (cells, pools, frame-time spikes while streaming)
+//  h = cycle streaming budget (builds in flight + upload bytes per frame)
+//  e = cycle steam particle target (2k / 20k / 100k) + particle stats (CPU ms vs budget)
+//  o = overdraw report + switch between sorted passes and the old single blended draw
+//  y = toggle bloom + post stats (GPU ms per stage: taa, bloom down / up, tone map)
+//  z = steam fill-rate benchmark (hash noise vs 3D noise volume); also: --bench-steam
+//  1 = toggle dynamic resolution + stats (main pass scale, GPU busy time per frame)
+//  2 = cycle the frame time target (16.6 / 11.1 / 8.3 / 33.3 ms)
+//  3 = toggle TAA (off: the lower resolution scene is upscaled bilinearly)
+//  4 = cycle the depth prepass: auto (on while opaque overdraw is high) / on / off + overdraw report
+//  5 = GPU profiler overlay (ms per pass, draw calls, triangles, state changes) + stats in the console
+//  6 = start / stop logging the GPU profile to gpu_profile.csv; also: --gpu-csv
+//  7 = start / stop a CPU trace (zones + counters of every thread -> cpu_trace.json, for
+//      chrome://tracing or Perfetto); --cpu-trace captures from startup (with --ttff: startup only)
+//  8 = start / stop recording the camera + key light path to camera_path.txt (one line per frame)
+//  9 = toggle render on demand (default on; see frame_scheduler.hpp) + power / CPU stats of the
+//      period that just ended; continuous mode redraws everything every frame, as before
+//  0 = pause / resume the animation (steam, and the cables in continuous mode): on demand, a
+//      static scene then stops drawing altogether
+//
+// Headless benchmark (no window; EGL surfaceless, e.g. Mesa llvmpipe on a GPU-less box):
+//  --headless N          render N frames offscreen at a fixed 60 Hz time step and print the
+//                        average / p50 / p95 / p99 CPU and GPU frame times + throughput
+//  --camera-path FILE    fly a recorded path (8) instead of the scripted one
+//  --dump DIR            write frames to DIR/frame_NNNNN.ppm for image diffs (every 60th frame
+//                        and the last one; --dump-every K to change)
+//  --size WxH            frame size (default 1200x900)
+
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <vector>
+#include <algorithm>
 #include <math.h>
+#include <string.h>
+#include <chrono>
 
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 
-#include "loadShaders.h"
+#include "shader_cache.hpp"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
@@ -30,11 +77,65 @@
 #include "glm/gtc/quaternion.hpp"
 #include "glm/gtx/quaternion.hpp"
 
-#include "SOIL.h"
-
 // OBJ loader
 #include "objloader.hpp"
 
+// time-sliced shadow updates
+#include "shadow_scheduler.hpp"
+
+// clustered forward lighting
+#include "clustered_lights.hpp"
+
+// persistently mapped per-frame uniform ring
+#include "gpu_ring.hpp"
+
+// material table + texture arrays
+#include "materials.hpp"
+
+// work-stealing jobs (texture decode, scene build, light culling)
+#include "job_system.hpp"
+
+// alley geometry + the prebuilt asset pack
+#include "scene.hpp"
+#include "asset_pack.hpp"
+#include "texture_compress.hpp"
+
+// shared, deduplicated asset caches (OBJ meshes, decoded images)
+#include "resources.hpp"
+
+// alley blocks streamed in around the camera
+#include "world_stream.hpp"
+
+// cables regenerated every frame into a vertex ring
+#include "animated_props.hpp"
+
+// steam: CPU particles, sorted back to front
+#include "steam_particles.hpp"
+
+// volumetric fog: froxel grid of in-scattered light, integrated once per frame
+#include "fog_volume.hpp"
+
+// tileable 3D noise for the steam, generated at startup or taken from the pack
+#include "noise_volume.hpp"
+
+// HDR target, TAA, bloom chain, tone mapping
+#include "post_process.hpp"
+
+// main pass resolution from the GPU busy time
+#include "dynamic_resolution.hpp"
+
+// GPU time, draws and state changes per pass (timestamp queries, overlay, CSV)
+#include "gpu_profiler.hpp"
+
+// CPU zones per thread -> Chrome trace JSON (compiled out with NO_CPU_PROFILER)
+#include "cpu_profiler.hpp"
+
+// offscreen context for --headless
+#include "headless.hpp"
+
+// render on demand: dirty flags, steam-only redraws, idle when static
+#include "frame_scheduler.hpp"
+
 // ---------------- Globals / constants ----------------
 static const float PI = 3.1415926535f;
 
@@ -43,64 +144,227 @@ static const int LIGHT_COUNT = 3;
 
 // shadow map (depth)
 static const int SHADOW_RES = 2048;
-static const int SHADOW_TEX_UNIT_BASE = 5; // we will use 5,6,7
+static const int SHADOW_TEX_UNIT_BASE = 7; // we will use 7,8,9
+
+// prefiltered shadows (VSM/EVSM): RGBA32F moments at half the depth map resolution
+static const int SHADOW_MOMENT_DOWNSAMPLE = 2;
+static const int SHADOW_MOMENT_RES = SHADOW_RES / SHADOW_MOMENT_DOWNSAMPLE;
+
+// radius used to estimate how much of the screen a light influences (shadow priority)
+static const float LIGHT_SHADOW_RADIUS = 6.0f;
+
+// clustered lights: texture buffers on units 10,11,12
+static const int CLUSTER_TEX_UNIT_BASE = 10;
+static const float MAIN_LIGHT_RADIUS = 14.0f; // the 3 shadowed lights light the whole alley
+static const int MAX_LIGHTS = 4096;
+
+// materials: texture arrays on units 0..5, material table on unit 6
+static const int MATERIAL_TEX_UNIT_BASE = 0;
+
+// fog volume: scatter on unit 13, integrated on unit 14
+static const int FOG_TEX_UNIT_BASE = 13;
+
+// steam noise volume on unit 15
+static const int NOISE_TEX_UNIT = 15;
 
 // ---------------- OpenGL ids ----------------
-GLuint ProgramId = 0;          // main shading program
+GLuint ProgramId = 0;          // main shading program (variant for the current toggles)
 GLuint ShadowProgramId = 0;    // depth-only program
+GLuint DepthPrepassProgramId = 0;  // the same, with the camera's matrices (DEPTH_PREPASS)
+GLuint ShadowMomentProgramId[2] = { 0, 0 }; // depth -> blurred moments: VSM, EVSM (shadow_moments.frag)
+GLuint FogScatterProgramId = 0;   // fog volume, step 1 (fog_scatter.frag)
+GLuint FogIntegrateProgramId = 0; // fog volume, step 2 (fog_integrate.frag)
+static PostPrograms gPostPrograms;  // bloom down / up, tone map (post_*.frag)
+
+// compile-time permutations of alley.vert/alley.frag; bit i <=> MAIN_SHADER_DEFINES[i]
+enum MainShaderFeature {
+    SF_TEXTURES = 1 << 0,
+    SF_NORMAL_MAP = 1 << 1,
+    SF_FOG = 1 << 2,
+    SF_SHADOW_MAP = 1 << 3,
+    SF_PLANAR_SHADOW = 1 << 4,
+    SF_SHADOW_VSM = 1 << 5,
+    SF_SHADOW_EVSM = 1 << 6
+};
+static const std::vector<const char*> MAIN_SHADER_DEFINES = {
+    "USE_TEXTURES", "USE_NORMAL_MAP", "USE_FOG", "USE_SHADOW_MAP", "PLANAR_SHADOW", "SHADOW_VSM", "SHADOW_EVSM"
+};
+static ShaderPermutations gMainShaders;
+static unsigned int gMainFeatures = 0;
+
+// GPU time of the main pass, attributed to the variant that drew it (small query ring, no stalls)
+static const int MAIN_QUERY_COUNT = 4;
+GLuint MainTimeQuery[MAIN_QUERY_COUNT] = { 0, 0, 0, 0 };
+static unsigned int gMainQueryFeatures[MAIN_QUERY_COUNT];
+static bool gMainQueryPending[MAIN_QUERY_COUNT] = { false, false, false, false };
+static int gMainQueryNext = 0;
+
+// main pass structure ('o'): sorted opaque / alpha-tested / transparent passes, or everything in
+// buffer order with blending on (the old way, kept to measure against)
+enum PassMode { PASS_MODE_SORTED = 0, PASS_MODE_SINGLE = 1 };
+static int gPassMode = PASS_MODE_SORTED;
+static const char* PASS_MODE_NAMES[] = { "sorted passes", "single blended draw" };
+
+// depth prepass ('4'): opaque geometry depth-only first, then shaded with GL_EQUAL (sorted passes
+// only). Auto turns it on while the opaque pass shades more than PREPASS_OVERDRAW_ON fragments
+// per pixel, off again under PREPASS_OVERDRAW_OFF; with it on, every PREPASS_PROBE_FRAMES frames
+// one frame goes without it to measure the overdraw again.
+enum PrepassMode { PREPASS_AUTO = 0, PREPASS_ON = 1, PREPASS_OFF = 2 };
+static int gPrepassMode = PREPASS_AUTO;
+static const char* PREPASS_MODE_NAMES[] = { "auto", "on", "off" };
+static const double PREPASS_OVERDRAW_ON = 1.3;
+static const double PREPASS_OVERDRAW_OFF = 1.1;
+static const int PREPASS_PROBE_FRAMES = 240;
+static bool gPrepassAutoOn = false;
+static int gPrepassProbe = 0;
+
+// fragments that passed the depth test, per pass (GL_SAMPLES_PASSED), on the same slots as
+// MainTimeQuery; the single draw uses only the first one
+GLuint MainSampleQuery[MAIN_QUERY_COUNT][SCENE_PASS_COUNT];
+static int gMainQueryMode[MAIN_QUERY_COUNT];
+static double gMainQueryPixels[MAIN_QUERY_COUNT];    // main pass viewport size (dynamic resolution)
+// stats per pass mode, + sorted passes with the depth prepass
+static const int PASS_STAT_PREPASS = 2;
+static const char* PASS_STAT_NAMES[] = { "sorted passes", "single blended draw", "sorted + depth prepass" };
+static double gOverdraw[3][SCENE_PASS_COUNT];   // fragments per pixel, running average per mode
+static double gLastOpaqueOverdraw[3];           // last frame's, for the auto prepass
+static double gMainPassMs[3];
+static int gOverdrawFrames[3] = { 0, 0, 0 };
+
+GLuint SceneVaoId = 0, SceneVboId = 0, SceneIboId = 0;
+GLuint StreamVaoId = 0;        // over the streamer's vertex/index pools
+GLuint PropsVaoId = 0;         // over the animated props ring
+GLuint SteamVaoId = 0;         // over the steam particle ring
+
+// materials (ids are the per-vertex material ids used by BuildAlley)
+static MaterialLibrary gMaterials;
+
+// loaded assets, one copy each (resources.hpp); unreferenced ones are kept up to the budget
+static const size_t MESH_CACHE_BUDGET = 16 * 1024 * 1024;
+static const size_t IMAGE_CACHE_BUDGET = 32 * 1024 * 1024;
+static TextureDecoder gDecoder;
+static MeshCache gMeshes;
+static ImageCache gImages;
+
+// streamed world around the startup block; pools are sized once, streaming never reallocates
+static const size_t STREAM_VERTEX_POOL_BYTES = 64 * 1024 * 1024;
+static const size_t STREAM_INDEX_POOL_BYTES = 16 * 1024 * 1024;
+static WorldStreamer gWorld;
+static int gStreamBudgetMode = 1;
+static const StreamBudget STREAM_BUDGETS[] = {
+    { 1, 256 * 1024 }, { 2, 1024 * 1024 }, { 4, 4 * 1024 * 1024 }, { 8, 0 } // 0 = unlimited
+};
+static const char* STREAM_BUDGET_NAMES[] = { "1 build, 256 KB/frame", "2 builds, 1 MB/frame", "4 builds, 4 MB/frame", "8 builds, unlimited" };
 
-GLuint SceneVaoId = 0, SceneVboId = 0;
+// steam particle targets ('e'); the CPU budget may hold the live count lower
+static const int STEAM_TARGETS[] = { 2000, 20000, 100000 };
+static int gSteamTargetMode = 1;
 
-// textures (albedo)
-GLuint texAsphalt = 0;
-GLuint texWall = 0;
-GLuint texSign = 0;
+// prebuilt scene (bundler output); without it everything is built from the source assets
+static const char* ASSET_PACK_PATH = "alley.pack";
+static AssetPack gPack;
+static int gUsePack = 1;        // --no-pack
+static int gExitAfterFirstFrame = 0; // --ttff
 
-// textures (normal maps)
-GLuint texAsphaltN = 0;
-GLuint texWallN = 0;
+// jobs: the main thread keeps GL, everything else may run on the workers
+static JobSystem gJobs;
+static const char* JOB_TRACE_PATH = "job_trace.csv";
+
+// time to first frame, from the start of main()
+typedef std::chrono::high_resolution_clock Clock;
+static Clock::time_point gStartTime;
+static double gSceneSetupMs = 0.0;
+static bool gFirstFrameDone = false;
+static Clock::time_point gLastFrameStart;  // frame-to-frame time, for the streaming spike metric
 
 // shadow maps (3 lights)
 GLuint ShadowFBO[LIGHT_COUNT] = { 0, 0, 0 };
 GLuint ShadowDepthTex[LIGHT_COUNT] = { 0, 0, 0 };
 
-// uniforms (main)
-GLuint myMatrixLocation = 0, viewLocation = 0, projLocation = 0;
-GLuint matrUmbraLocation = 0; // legacy planar shadow matrix (still kept; not required for shadow mapping)
-GLuint viewPosLocation = 0, codColLocation = 0;
-GLuint exposureLocation = 0;
-GLuint gammaLocation = 0;
-GLuint timeSecLocation = 0;
+// moment maps (created on the first switch to VSM/EVSM) + the shared horizontal blur target
+GLuint ShadowMomentFBO[LIGHT_COUNT] = { 0, 0, 0 };
+GLuint ShadowMomentTex[LIGHT_COUNT] = { 0, 0, 0 };
+GLuint ShadowBlurFBO = 0, ShadowBlurTex = 0;
+GLuint ShadowMomentVao = 0;     // empty, for the fullscreen triangle
+
+// steam noise (R8 3D, tiles)
+GLuint SteamNoiseTexId = 0;
+
+// ---------------- Uniform blocks ----------------
+// std140 blocks shared by the main and the depth-only program, written once per frame
+// (per light / per draw where needed) into a persistently mapped triple-buffered ring.
+enum UniformBinding {
+    UBO_FRAME = 0,       // FrameData: time, post params
+    UBO_VIEW = 1,        // ViewData: camera + cluster params
+    UBO_LIGHTS = 2,      // LightData: light-space matrices
+    UBO_OBJECT = 3,      // ObjectData: model matrix
+    UBO_SHADOW_PASS = 4  // ShadowPassData: matrix of the shadow map being rendered
+};
+
+struct FrameDataStd140 {
+    float timeSec, exposure, gammaValue, pad0;
+};
 
-// shadow mapping uniforms (main)
-GLuint lightSpaceLocation_Main = 0;   // mat4 lightSpace[3]
-GLuint shadowMapLocation_Main = 0;    // sampler2D shadowMap[3]
-GLuint useShadowMapLocation = 0;
+struct ViewDataStd140 {
+    glm::mat4 view;
+    glm::mat4 projection;
+    float viewPos[3]; float pad0;
+    int clusterDims[3]; int pad1;
+    float clusterTileSize[2];
+    float clusterSlice[2];
+    float fogSlice[2]; float pad2[2];
+};
 
-// lights
-GLuint lightPosLocation = 0, lightColorLocation = 0;
+struct LightDataStd140 {
+    glm::mat4 lightSpace[LIGHT_COUNT];
+    glm::mat4 matrUmbra;
+};
+
+struct ObjectDataStd140 {
+    glm::mat4 myMatrix;
+    float normalMatrix[3][4]; // std140 mat3 = 3 vec4 columns
+};
 
-// texture uniforms
-GLuint texAsphaltLoc = 0, texWallLoc = 0, texSignLoc = 0;
-GLuint texAsphaltNLoc = 0, texWallNLoc = 0;
+struct ShadowPassDataStd140 {
+    glm::mat4 lampLightSpace;
+};
+
+static_assert(sizeof(FrameDataStd140) == 16, "FrameData std140 layout");
+static_assert(sizeof(ViewDataStd140) == 192, "ViewData std140 layout");
+static_assert(sizeof(ObjectDataStd140) == 112, "ObjectData std140 layout");
 
-GLuint useTexLocation = 0;
-GLuint useNormalMapLocation = 0;
-GLuint texTilingLocation = 0;
+static GpuRing gUniformRing;
+static GLint gUboAlign = 256;
 
-// sign helper
-GLuint signBlackKeyLocation = 0;
+// frame settings (FrameData) and shader toggles (select the main program variant)
+static float gExposure = 1.15f;
+static float gGamma = 2.2f;
+static int gUseTextures = 1;
+static int gUseNormalMap = 1;
+
+// material settings (moved from FrameData/permutations into the material table)
+static float gTexTiling[3] = { 1.0f, 1.0f, 1.0f }; // asphalt, wall, sign
+static int gSignBlackKey = 0;
 
 // fog
-GLuint useFogLocation = 0;
 static int gUseFog = 1;
 
 // shadow mapping toggle
 static int gUseShadowMap = 1;
 
-// uniforms (shadow program)
-GLuint myMatrixLocation_Shadow = 0;
-GLuint lightSpaceLocation_Shadow = 0; // mat4 lampLightSpace (reused per light)
+// shadow filtering ('q'): PCF on the depth maps, or one fetch from prefiltered moment maps
+enum ShadowFilter { SHADOW_FILTER_PCF = 0, SHADOW_FILTER_VSM = 1, SHADOW_FILTER_EVSM = 2 };
+static int gShadowFilter = SHADOW_FILTER_PCF;
+static const char* SHADOW_FILTER_NAMES[] = { "PCF 3x3", "VSM", "EVSM" };
+
+// shadow update scheduling (per-frame budget)
+static ShadowScheduler gShadowScheduler;
+static int gShadowBudgetMode = 0;
+static const char* SHADOW_BUDGET_NAMES[] = { "1 map/frame", "2 maps/frame", "unlimited", "0.5 ms/frame" };
+
+// GPU time of each shadow pass (read back one frame later, never waited on)
+GLuint ShadowTimeQuery[LIGHT_COUNT] = { 0, 0, 0 };
+static bool gShadowQueryPending[LIGHT_COUNT] = { false, false, false };
 
 // ---------------- Camera ----------------
 // camera orbit
@@ -123,7 +387,7 @@ glm::mat4 view;
 glm::mat4 projection;
 
 // projection
-float width = 1200, height = 900, dNear = 0.2f, fov = 60.f * PI / 180.f;
+float width = 1200, height = 900, dNear = 0.2f, dFar = 100.0f, fov = 60.f * PI / 180.f;
 
 // ---------------- Lighting data ----------------
 glm::vec3 lightPos[LIGHT_COUNT] = {
@@ -138,35 +402,117 @@ glm::vec3 lightColor[LIGHT_COUNT] = {
     glm::vec3(0.25f, 1.20f, 0.35f)  // green-ish
 };
 
+// all lights fed to the clustered shader: [0..LIGHT_COUNT) are the shadowed lights above,
+// the rest are small neon lights (signs, windows, vents)
+static LightClusters gClusters;
+static std::vector<PointLight> gLights;
+static std::vector<PointLight> gNeonLights;
+static int gNeonLightCount = 61; // 64 lights total
+
+// in-scattered light + fog, rebuilt every frame after the shadow maps and clusters
+static FogVolume gFog;
+
+// the main pass renders into its HDR target; bloom + tone mapping turn it into the frame
+static PostPipeline gPost;
+
+// main pass at gRenderW x gRenderH (dynamic resolution), jittered every frame for the TAA pass
+static DynamicResolution gDynRes;
+static const float DRS_TARGETS[] = { 16.6f, 11.1f, 8.3f, 33.3f };
+static int gDrsTargetMode = 0;
+static unsigned int gDrsSamples = 0;    // GPU profiler frames already fed to gDynRes
+static int gRenderW = 1200, gRenderH = 900;
+static bool gTaa = true;
+static unsigned int gTaaFrame = 0;
+static glm::mat4 gPrevViewProj;     // without jitter
+static bool gHavePrevViewProj = false;
+
+// per pass GPU timings of every frame, read back a few frames late
+static GpuProfiler gGpuProfiler;
+static const char* GPU_PROFILE_CSV_PATH = "gpu_profile.csv";
+static const char* CPU_TRACE_PATH = "cpu_trace.json";
+
+// headless benchmark (--headless N): offscreen context + FBO, fixed time step, camera path
+static bool gHeadless = false;
+static double gFixedTimeSec = -1.0;     // >= 0: the animations' time, instead of the clock
+static GLuint gOffscreenFbo = 0, gOffscreenColor = 0;
+static FILE* gCameraRecord = nullptr;   // '8'
+static const char* CAMERA_PATH_PATH = "camera_path.txt";
+
+// render on demand ('9') and the animation pause ('0')
+static FrameScheduler gFrameScheduler;
+static FrameKind gFrameKind = FRAME_FULL;  // what RenderFunction draws (benchmarks: always full)
+static bool gAnimPaused = false;
+static float gPausedAtSec = 0.0f, gPausedSec = 0.0f;   // clock at the pause, total time paused
+static float gPropsTimeSec = 0.0f;          // cables: frozen while rendering on demand
+static glm::vec2 gSavedJitter(0.0f);        // TAA jitter of the saved scene
+static int gSteamRect[4] = { 0, 0, 0, 0 };  // last steam rectangle (render pixels): x, y, w, h
+static bool gSaveScene = false;             // this frame saves the scene for steam-only frames
+
+// seconds driving the animations (props, steam, flicker)
+static float SceneTimeSec()
+{
+    if (gFixedTimeSec >= 0.0) return (float)gFixedTimeSec;
+    if (gAnimPaused) return gPausedAtSec;
+    return 0.001f * (float)glutGet(GLUT_ELAPSED_TIME) - gPausedSec;
+}
+static const char* SHADOW_SCOPE_NAMES[] = { "shadow L0", "shadow L1", "shadow L2" };
+static_assert(sizeof(SHADOW_SCOPE_NAMES) / sizeof(SHADOW_SCOPE_NAMES[0]) == LIGHT_COUNT, "a scope name per shadowed light");
+
 int codCol = 0;
 
 // legacy planar shadow matrix (still available)
 float matrUmbra[4][4];
 
 // ---------------- Mesh data ----------------
-struct Vtx {
-    glm::vec4 pos;   // 0
-    glm::vec3 col;   // 1
-    glm::vec3 nrm;   // 2
-    glm::vec2 uv;    // 3
-    float texId;     // 4 (0=asphalt,1=wall,2=sign,3=steam)
-    glm::vec3 tan;   // 5
-    glm::vec3 bit;   // 6
-};
-
-std::vector<Vtx> gVertices;
-
-// draw ranges
-GLint groundFirst = 0;
-GLsizei groundCount = 0;
-
-GLint castersFirst = 0;
-GLsizei castersCount = 0;
+// built by BuildAlley (scene.cpp) or mapped from the asset pack; only the ranges stay on the CPU
+static SceneRanges gRanges;
+static GLsizei gIndexCount = 0;
+static std::vector<SceneInstance> gInstances;
+static std::vector<SceneBatch> gBatches;
+static std::vector<int> gPassOrder[SCENE_PASS_COUNT];   // batch indices, sorted every frame
+
+// animated (not in the scene buffers): written every frame by jobs into their own rings
+static std::vector<SceneCable> gCables;
+static std::vector<SceneSteam> gSteam;     // emitters
+static AnimatedProps gProps;
+static SteamParticles gSteamParticles;
+
+static void ApplyShadowBudget();
+static void GenerateNeonLights(int count);
+static void BenchmarkLightCounts();
+static void BenchmarkVertexThroughput();
+static void BenchmarkJobs();
+static void BenchmarkSteamFill();
+static void CreateShadowMomentMaps();
+static void PrintOverdraw();
+static void IdleFunction();
+
+// after input: the scheduler decides how much to redraw (dirty = 0: nothing on screen changed,
+// but the idle callback may be needed again, e.g. the animation resumed)
+static void RequestFrame(unsigned int dirty)
+{
+    if (dirty) {
+        gFrameScheduler.Invalidate(dirty);
+        glutPostRedisplay();
+    }
+    glutIdleFunc(IdleFunction);
+}
 
-// steam range + shadow casters range (casters without steam)
-GLint steamFirst = 0;
-GLsizei steamCount = 0;
-GLsizei shadowCastersCount = 0;
+static unsigned int KeyDirtyFlags(unsigned char key)
+{
+    switch (key) {
+    case '+': case '-': case 'w': case 'a': case 's': case 'd':
+        return FRAME_DIRTY_CAMERA;
+    case 'i': case 'j': case 'k': case 'l': case '[': case ']':
+        return FRAME_DIRTY_LIGHTS;
+    // reports, traces, logs and budgets: the picture stays the same
+    case 'p': case 'x': case 't': case 'r': case 'g': case 'h': case 'u':
+    case '6': case '7': case '8': case '9': case '0':
+        return 0;
+    default:
+        return FRAME_DIRTY_SETTINGS;
+    }
+}
 
 // ---------------- Input ----------------
 void processNormalKeys(unsigned char key, int x, int y)
@@ -181,36 +527,207 @@ void processNormalKeys(unsigned char key, int x, int y)
     case 'k': lightPos[0].z -= 0.2f; break;
 
     case 'n':
-    {
-        static int enabled = 1;
-        enabled = 1 - enabled;
-        glUseProgram(ProgramId);
-        glUniform1i(useNormalMapLocation, enabled);
-        printf("Normal mapping: %s\n", enabled ? "ON" : "OFF");
-    }
-    break;
+        gUseNormalMap = 1 - gUseNormalMap;
+        printf("Normal mapping: %s\n", gUseNormalMap ? "ON" : "OFF");
+        break;
 
     case 'f': // toggle fog
-    {
         gUseFog = 1 - gUseFog;
-        glUseProgram(ProgramId);
-        glUniform1i(useFogLocation, gUseFog);
-        printf("Fog: %s\n", gUseFog ? "ON" : "OFF");
-    }
-    break;
+        printf("Fog: %s (volume %dx%dx%d up to %.0f m, %.2f ms GPU)\n", gUseFog ? "ON" : "OFF",
+            FOG_GRID_X, FOG_GRID_Y, FOG_GRID_Z, FOG_FAR, gFog.GpuMs());
+        break;
 
     case 'm': // toggle shadow mapping
-    {
         gUseShadowMap = 1 - gUseShadowMap;
-        glUseProgram(ProgramId);
-        glUniform1i(useShadowMapLocation, gUseShadowMap);
         printf("Shadow mapping: %s\n", gUseShadowMap ? "ON" : "OFF");
+        break;
+
+    case 'u': // cycle shadow update budget
+    {
+        gShadowBudgetMode = (gShadowBudgetMode + 1) % 4;
+        ApplyShadowBudget();
+        printf("Shadow budget: %s\n", SHADOW_BUDGET_NAMES[gShadowBudgetMode]);
+    }
+    break;
+
+    case 'q': // cycle shadow filtering
+        gShadowFilter = (gShadowFilter + 1) % 3;
+        if (gShadowFilter != SHADOW_FILTER_PCF && !ShadowMomentTex[0]) CreateShadowMomentMaps();
+        // the moment maps (or the depth maps) are out of date: re-render everything
+        gShadowScheduler.InvalidateAll();
+        printf("Shadow filtering: %s\n", SHADOW_FILTER_NAMES[gShadowFilter]);
+        break;
+
+    case 'p': // shadow staleness stats
+        gShadowScheduler.PrintStats();
+        break;
+
+    case '[':
+    case ']':
+    {
+        int n = (key == ']') ? gNeonLightCount * 2 + 1 : gNeonLightCount / 2;
+        if (n > MAX_LIGHTS - LIGHT_COUNT) n = MAX_LIGHTS - LIGHT_COUNT;
+        GenerateNeonLights(n);
+        printf("Lights: %d\n", LIGHT_COUNT + gNeonLightCount);
     }
     break;
+
+    case 'c':
+        BenchmarkLightCounts();
+        break;
+
+    case 'x':
+        gMainShaders.PrintReport();
+        break;
+
+    case 'v':
+        BenchmarkVertexThroughput();
+        break;
+
+    case 't':
+        if (!gJobs.Tracing()) {
+            gJobs.SetTracing(true);
+            printf("Job trace: ON (t again to stop)\n");
+        }
+        else {
+            gJobs.SetTracing(false);
+            gJobs.PrintTraceSummary();
+            if (gJobs.WriteTrace(JOB_TRACE_PATH)) printf("Job trace written to %s\n", JOB_TRACE_PATH);
+        }
+        break;
+
+    case 'b':
+        BenchmarkJobs();
+        break;
+
+    case 'y': // toggle bloom
+        gPost.bloom = !gPost.bloom;
+        gPost.PrintStats();
+        break;
+
+    case '1':
+        gDynRes.enabled = !gDynRes.enabled;
+        gDynRes.PrintStats();
+        gPost.PrintStats();
+        break;
+
+    case '2':
+        gDrsTargetMode = (gDrsTargetMode + 1) % 4;
+        gDynRes.targetMs = DRS_TARGETS[gDrsTargetMode];
+        printf("Frame time target: %.1f ms\n", gDynRes.targetMs);
+        break;
+
+    case '3':
+        gTaa = !gTaa;
+        gPost.ResetHistory();
+        printf("TAA: %s\n", gTaa ? "ON" : "OFF (bilinear upscale)");
+        break;
+
+    case '5':
+        gGpuProfiler.overlay = !gGpuProfiler.overlay;
+        gGpuProfiler.PrintStats();
+        break;
+
+    case '6':
+        if (!gGpuProfiler.Logging()) {
+            if (gGpuProfiler.StartCsv(GPU_PROFILE_CSV_PATH)) printf("GPU profile: logging to %s (6 again to stop)\n", GPU_PROFILE_CSV_PATH);
+        }
+        else {
+            gGpuProfiler.StopCsv();
+            printf("GPU profile written to %s\n", GPU_PROFILE_CSV_PATH);
+        }
+        break;
+
+    case '7':
+        if (!CpuProfilerCapturing()) {
+            CpuProfilerStart();
+            printf("CPU trace: ON (7 again to stop)\n");
+        }
+        else {
+            CpuProfilerStop();
+            CpuProfilerWriteTrace(CPU_TRACE_PATH);
+        }
+        break;
+
+    case '8':
+        if (!gCameraRecord) {
+            gCameraRecord = fopen(CAMERA_PATH_PATH, "w");
+            if (!gCameraRecord) printf("Nu am putut scrie: %s\n", CAMERA_PATH_PATH);
+            else {
+                fprintf(gCameraRecord, "# ref.x ref.y ref.z dist rot.w rot.x rot.y rot.z light.x light.y light.z\n");
+                printf("Camera path: recording to %s (8 again to stop)\n", CAMERA_PATH_PATH);
+            }
+        }
+        else {
+            fclose(gCameraRecord);
+            gCameraRecord = nullptr;
+            printf("Camera path written to %s\n", CAMERA_PATH_PATH);
+        }
+        break;
+
+    case 'z':
+        BenchmarkSteamFill();
+        break;
+
+    case 'r':
+        gMeshes.Print();
+        gImages.Print();
+        break;
+
+    // camera target along / across the alleys (the world streams in around the camera)
+    case 'w': refY += 1.5f; break;
+    case 's': refY -= 1.5f; break;
+    case 'a': refX -= 1.5f; break;
+    case 'd': refX += 1.5f; break;
+
+    case 'g':
+        gWorld.PrintStats();
+        break;
+
+    case 'h':
+        gStreamBudgetMode = (gStreamBudgetMode + 1) % 4;
+        gWorld.SetBudget(STREAM_BUDGETS[gStreamBudgetMode]);
+        printf("Streaming budget: %s\n", STREAM_BUDGET_NAMES[gStreamBudgetMode]);
+        break;
+
+    case 'e':
+        gSteamTargetMode = (gSteamTargetMode + 1) % 3;
+        gSteamParticles.SetTarget(STEAM_TARGETS[gSteamTargetMode]);
+        gSteamParticles.PrintStats();
+        printf("Steam target: %d particles\n", STEAM_TARGETS[gSteamTargetMode]);
+        break;
+
+    case 'o':
+        PrintOverdraw();
+        gPassMode = gPassMode == PASS_MODE_SORTED ? PASS_MODE_SINGLE : PASS_MODE_SORTED;
+        printf("Main pass: %s\n", PASS_MODE_NAMES[gPassMode]);
+        break;
+
+    case '4':
+        PrintOverdraw();
+        gPrepassMode = (gPrepassMode + 1) % 3;
+        gPrepassAutoOn = false;
+        printf("Depth prepass: %s\n", PREPASS_MODE_NAMES[gPrepassMode]);
+        break;
+
+    case '9':
+        gFrameScheduler.PrintStats();
+        gFrameScheduler.onDemand = !gFrameScheduler.onDemand;
+        gFrameScheduler.ResetStats();
+        if (!gFrameScheduler.onDemand) gPost.ReleaseSavedScene();
+        printf("Rendering: %s\n", gFrameScheduler.onDemand ? "on demand" : "continuous");
+        break;
+
+    case '0':
+        if (!gAnimPaused) gPausedAtSec = SceneTimeSec();
+        else gPausedSec = 0.001f * (float)glutGet(GLUT_ELAPSED_TIME) - gPausedAtSec;
+        gAnimPaused = !gAnimPaused;
+        printf("Animation: %s\n", gAnimPaused ? "paused" : "running");
+        break;
     }
 
     if (key == 27) exit(0);
-    glutPostRedisplay();
+    RequestFrame(KeyDirtyFlags(key));
 }
 
 void processSpecialKeys(int key, int xx, int yy)
@@ -246,987 +763,2085 @@ void processSpecialKeys(int key, int xx, int yy)
         camRot = glm::normalize(qPitch * camRot);
     }
 
-    glutPostRedisplay();
+    RequestFrame(FRAME_DIRTY_CAMERA);
 }
 
-// ---------------- Texture loader (SOIL) ----------------
-static GLuint LoadTexture2D_SOIL(const char* path)
+// ---------------- Materials ----------------
+// texture lookups of the material library, from the worker threads: KTX sections of the pack
+static bool PackImageSource(const std::string& path, DecodedImage& img)
 {
-    int w, h, ch;
-    unsigned char* img = SOIL_load_image(path, &w, &h, &ch, SOIL_LOAD_AUTO);
-    if (!img) {
-        printf("Nu am putut incarca textura: %s\nSOIL: %s\n", path, SOIL_last_result());
-        return 0;
-    }
-
-    GLenum format = (ch == 4) ? GL_RGBA : GL_RGB;
-
-    GLuint tex = 0;
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, format, GL_UNSIGNED_BYTE, img);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    SOIL_free_image_data(img);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    printf("Textura OK: %s (%dx%d, ch=%d)\n", path, w, h, ch);
-    return tex;
+    const PackSection* s = gPack.Find(PACK_TEXTURE, path.c_str());
+    KtxView ktx;
+    if (!s || !ParseKTX(gPack.Data(*s), (size_t)s->size, ktx)) return false;
+
+    img.path = std::string(ASSET_PACK_PATH) + ":" + path;
+    img.format = ktx.format;
+    img.width = ktx.width;
+    img.height = ktx.height;
+    img.extLevels.swap(ktx.levels);
+    img.extSizes.swap(ktx.sizes);
+    return true;
 }
 
-// ---------------- Geometry helpers ----------------
-static void pushTri(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2,
-    const glm::vec3& n, const glm::vec3& col,
-    const glm::vec2& uv0, const glm::vec2& uv1, const glm::vec2& uv2,
-    float texId,
-    const glm::vec3& tan, const glm::vec3& bit)
+// one table entry per surface type, added in SceneMaterial order (the ids BuildAlley writes);
+// images of the same size share a texture array
+static void CreateMaterials()
 {
-    gVertices.push_back({ glm::vec4(p0, 1.0f), col, n, uv0, texId, tan, bit });
-    gVertices.push_back({ glm::vec4(p1, 1.0f), col, n, uv1, texId, tan, bit });
-    gVertices.push_back({ glm::vec4(p2, 1.0f), col, n, uv2, texId, tan, bit });
+    MaterialDesc asphalt;
+    asphalt.albedo = "asphalt.jpg";
+    asphalt.normal = "asphalt_n.jpg";
+    asphalt.tiling = gTexTiling[0];
+    gMaterials.Add(asphalt); // SCENE_MAT_ASPHALT
+
+    MaterialDesc wall;
+    wall.albedo = "wall.jpg";
+    wall.normal = "wall_n.jpg";
+    wall.tiling = gTexTiling[1];
+    gMaterials.Add(wall); // SCENE_MAT_WALL
+
+    MaterialDesc sign;
+    sign.albedo = "sign3.png";
+    sign.tiling = gTexTiling[2];
+    sign.flags = MAT_ALPHA_TEST | (gSignBlackKey ? MAT_BLACK_KEY : 0);
+    sign.emissive = 1.2f;
+    gMaterials.Add(sign); // SCENE_MAT_SIGN
+
+    MaterialDesc steam;
+    steam.flags = MAT_STEAM;
+    gMaterials.Add(steam); // SCENE_MAT_STEAM
+
+    gMaterials.Build(gJobs, gImages);
 }
 
-static void computeTBN(
-    const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2,
-    const glm::vec2& uv0, const glm::vec2& uv1, const glm::vec2& uv2,
-    glm::vec3& outT, glm::vec3& outB)
+// the pack's volume if it was made with the same parameters, otherwise generated on the jobs
+static void CreateSteamNoise()
 {
-    glm::vec3 e1 = p1 - p0;
-    glm::vec3 e2 = p2 - p0;
-    glm::vec2 dUV1 = uv1 - uv0;
-    glm::vec2 dUV2 = uv2 - uv0;
+    NoiseVolumeHeader params = { NOISE_VOLUME_SIZE, NOISE_VOLUME_PERIOD, NOISE_VOLUME_OCTAVES, NOISE_VOLUME_SEED };
+    size_t voxelBytes = (size_t)params.size * params.size * params.size;
 
-    float denom = (dUV1.x * dUV2.y - dUV2.x * dUV1.y);
-    if (fabsf(denom) < 1e-20f) {
-        outT = glm::vec3(1, 0, 0);
-        outB = glm::vec3(0, 1, 0);
-        return;
-    }
+    const unsigned char* voxels = nullptr;
+    std::vector<unsigned char> generated;
+    auto t0 = Clock::now();
 
-    float f = 1.0f / denom;
-    outT = f * (e1 * dUV2.y - e2 * dUV1.y);
-    outB = f * (-e1 * dUV2.x + e2 * dUV1.x);
-
-    outT = glm::normalize(outT);
-    outB = glm::normalize(outB);
+    const PackSection* s = gPack.IsOpen() ? gPack.Find(PACK_NOISE) : nullptr;
+    if (s && s->size == sizeof(params) + voxelBytes && memcmp(gPack.Data(*s), &params, sizeof(params)) == 0) {
+        voxels = gPack.Data(*s) + sizeof(params);
+    }
+    else {
+        GenerateNoiseVolume(params, generated, &gJobs);
+        voxels = generated.data();
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+
+    glGenTextures(1, &SteamNoiseTexId);
+    glBindTexture(GL_TEXTURE_3D, SteamNoiseTexId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, params.size, params.size, params.size, 0, GL_RED, GL_UNSIGNED_BYTE, voxels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_3D);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    printf("Steam noise: %d^3 %s (%.2f ms)\n", params.size, voxels == generated.data() ? "generated" : "from pack", ms);
 }
 
-static void appendQuad(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3,
-    const glm::vec3& n, const glm::vec3& col,
-    const glm::vec2& uv0, const glm::vec2& uv1, const glm::vec2& uv2, const glm::vec2& uv3,
-    float texId)
+// ---------------- VBO/VAO ----------------
+// Vtx layout over existing buffers (the scene's, or the streamer's pools)
+static GLuint CreateVtxVao(GLuint vbo, GLuint ibo)
 {
-    glm::vec3 T1, B1;
-    computeTBN(p0, p1, p2, uv0, uv1, uv2, T1, B1);
-    pushTri(p0, p1, p2, n, col, uv0, uv1, uv2, texId, T1, B1);
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
 
-    glm::vec3 T2, B2;
-    computeTBN(p0, p2, p3, uv0, uv2, uv3, T2, B2);
-    pushTri(p0, p2, p3, n, col, uv0, uv2, uv3, texId, T2, B2);
-}
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 
-// Steam billboards (texIdSteam = 3)
-static void appendSteamPuff(const glm::vec3& center, float height, float radius, float texIdSteam, float intensity)
-{
-    glm::vec3 col(intensity, intensity, intensity); // intensity packed in vColor.r
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, pos));
 
-    auto addBillboard = [&](float ang)
-        {
-            glm::vec3 right = glm::vec3(cosf(ang), sinf(ang), 0.0f) * radius;
-            glm::vec3 up = glm::vec3(0.0f, 0.0f, height);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, col));
 
-            glm::vec3 p0 = center - right;
-            glm::vec3 p1 = center + right;
-            glm::vec3 p2 = center + right + up;
-            glm::vec3 p3 = center - right + up;
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, nrm));
 
-            glm::vec3 n(0, 1, 0);
-            glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, uv));
 
-            glm::vec3 T(1, 0, 0), B(0, 0, 1);
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, texId));
 
-            pushTri(p0, p1, p2, n, col, uv0, uv1, uv2, texIdSteam, T, B);
-            pushTri(p0, p2, p3, n, col, uv0, uv2, uv3, texIdSteam, T, B);
-        };
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, tan));
 
-    addBillboard(0.0f);
-    addBillboard(PI * 0.5f);
-    addBillboard(PI * 0.25f);
+    glBindVertexArray(0);
+    return vao;
 }
 
-// OBJ mesh append
-static void appendObjMesh(const ObjMesh& m, const glm::mat4& M, const glm::vec3& col, float texId, bool forceUpNormals = false)
+static void CreateSceneBuffers(const void* vertices, size_t vertexBytes, const void* indices, size_t indexBytes)
 {
-    glm::mat3 Nmat = glm::transpose(glm::inverse(glm::mat3(M)));
-
-    size_t triCount = m.positions.size() / 3;
-    for (size_t i = 0; i < triCount; i++) {
-        glm::vec3 p0 = glm::vec3(M * glm::vec4(m.positions[i * 3 + 0], 1.0f));
-        glm::vec3 p1 = glm::vec3(M * glm::vec4(m.positions[i * 3 + 1], 1.0f));
-        glm::vec3 p2 = glm::vec3(M * glm::vec4(m.positions[i * 3 + 2], 1.0f));
+    CPU_ZONE("CreateSceneBuffers");
+    glGenBuffers(1, &SceneVboId);
+    glBindBuffer(GL_ARRAY_BUFFER, SceneVboId);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexBytes, vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-        glm::vec3 n0 = glm::normalize(Nmat * m.normals[i * 3 + 0]);
-        glm::vec3 n1 = glm::normalize(Nmat * m.normals[i * 3 + 1]);
-        glm::vec3 n2 = glm::normalize(Nmat * m.normals[i * 3 + 2]);
+    glGenBuffers(1, &SceneIboId);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, SceneIboId);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)indexBytes, indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 
-        if (forceUpNormals) {
-            n0 = n1 = n2 = glm::vec3(0, 0, 1);
-        }
+    SceneVaoId = CreateVtxVao(SceneVboId, SceneIboId);
+}
 
-        glm::vec2 uv0(0, 0), uv1(0, 0), uv2(0, 0);
-        if (m.uvs.size() == m.positions.size()) {
-            uv0 = m.uvs[i * 3 + 0];
-            uv1 = m.uvs[i * 3 + 1];
-            uv2 = m.uvs[i * 3 + 2];
-        }
+// the pack's buffers go to GL straight from the mapping; no pack => BuildAlley
+static bool CreateSceneFromPack()
+{
+    const PackSection* vtx = gPack.Find(PACK_VERTICES);
+    const PackSection* idx = gPack.Find(PACK_INDICES);
+    const PackSection* rng = gPack.Find(PACK_RANGES);
+    const PackSection* inst = gPack.Find(PACK_INSTANCES);
+    const PackSection* bat = gPack.Find(PACK_BATCHES);
+    const PackSection* cab = gPack.Find(PACK_CABLES);
+    const PackSection* st = gPack.Find(PACK_STEAM);
+    if (!vtx || !idx || !rng || rng->size != sizeof(SceneRanges)) return false;
+
+    // whole structs in every section, and every index range inside the index section
+    auto whole = [](const PackSection* s, size_t elem) { return !s || s->size % elem == 0; };
+    bool ok = whole(vtx, sizeof(Vtx)) && whole(idx, sizeof(unsigned int)) && whole(inst, sizeof(SceneInstance)) &&
+        whole(bat, sizeof(SceneBatch)) && whole(cab, sizeof(SceneCable)) && whole(st, sizeof(SceneSteam));
+
+    size_t indexCount = (size_t)(idx->size / sizeof(unsigned int));
+    auto inside = [&](int first, int count) { return first >= 0 && count >= 0 && (size_t)first + (size_t)count <= indexCount; };
+
+    SceneRanges r;
+    memcpy(&r, gPack.Data(*rng), sizeof(SceneRanges));
+    ok = ok && inside(r.groundFirst, r.groundCount) && inside(r.castersFirst, r.castersCount) &&
+        inside(r.alphaTestFirst, r.alphaTestCount) && inside(r.steamFirst, r.steamCount) &&
+        inside(r.castersFirst, r.shadowCastersCount);
+
+    const SceneInstance* instances = inst ? (const SceneInstance*)gPack.Data(*inst) : nullptr;
+    size_t instanceCount = inst ? (size_t)(inst->size / sizeof(SceneInstance)) : 0;
+    for (size_t i = 0; i < instanceCount && ok; i++) ok = inside(instances[i].first, instances[i].count);
+
+    const SceneBatch* batches = bat ? (const SceneBatch*)gPack.Data(*bat) : nullptr;
+    size_t batchCount = bat ? (size_t)(bat->size / sizeof(SceneBatch)) : 0;
+    for (size_t i = 0; i < batchCount && ok; i++) {
+        ok = inside(batches[i].first, batches[i].count) && batches[i].pass >= 0 && batches[i].pass < SCENE_PASS_COUNT;
+    }
 
-        glm::vec3 t0(1, 0, 0), b0(0, 1, 0);
-        if (m.tangents.size() == m.positions.size() && m.bitangents.size() == m.positions.size()) {
-            t0 = glm::normalize(Nmat * m.tangents[i * 3 + 0]);
-            b0 = glm::normalize(Nmat * m.bitangents[i * 3 + 0]);
-        }
+    // and every index inside the vertex section
+    const unsigned int* indices = (const unsigned int*)gPack.Data(*idx);
+    size_t vertexCount = (size_t)(vtx->size / sizeof(Vtx));
+    for (size_t i = 0; i < indexCount && ok; i++) ok = indices[i] < vertexCount;
 
-        pushTri(p0, p1, p2, n0, col, uv0, uv1, uv2, texId, t0, b0);
+    if (!ok) {
+        printf("WARN: %s: the scene sections do not fit together (run the bundler again)\n", ASSET_PACK_PATH);
+        return false;
     }
-}
 
-// --- forward decls for wall/pipe/ladder/cable helpers ---
-static void appendThinPipePrism(
-    float xPlane, float yCenter, float z0, float z1, float r, bool onLeftWall,
-    const glm::vec3& col, float texIdWall);
+    gRanges = r;
+    gIndexCount = (GLsizei)indexCount;
+    gInstances.assign(instances, instances + instanceCount);
+    gBatches.assign(batches, batches + batchCount);
 
-static void appendWallBox(
-    float xPlane, float yCenter, float zCenter,
-    float sx, float sy, float sz, bool onLeftWall,
-    const glm::vec3& col, float texIdWall);
-
-static void appendWallLadder(
-    float xPlane, float yCenter, float z0,
-    float height, float width, bool onLeftWall,
-    const glm::vec3& col, float texIdWall);
+    gCables.clear();
+    gSteam.clear();
+    if (cab) {
+        const SceneCable* p = (const SceneCable*)gPack.Data(*cab);
+        gCables.assign(p, p + cab->size / sizeof(SceneCable));
+    }
+    if (st) {
+        const SceneSteam* p = (const SceneSteam*)gPack.Data(*st);
+        gSteam.assign(p, p + st->size / sizeof(SceneSteam));
+    }
 
-static void appendWallVent(
-    float xPlane, float yCenter, float zCenter,
-    float w, float h, bool onLeftWall,
-    const glm::vec3& col, float texIdWall);
+    CreateSceneBuffers(gPack.Data(*vtx), (size_t)vtx->size, gPack.Data(*idx), (size_t)idx->size);
+    printf("Scene from %s: %zu vertices, %d indices, %zu instances\n", ASSET_PACK_PATH,
+        (size_t)(vtx->size / sizeof(Vtx)), (int)gIndexCount, gInstances.size());
+    return true;
+}
 
-static void appendCable(
-    const glm::vec3& pA, const glm::vec3& pB,
-    float sag, int segments, float halfWidth,
-    const glm::vec3& col, float texIdWall);
+// without a pack: BuildAlley runs as a job while the main thread creates programs, shadow maps
+// and materials; the upload is its continuation on the main thread
+static JobCounter gSceneBuild;
+static SceneData gBuiltScene;
+static double gSceneBuildMs = 0.0;
 
-// ----------------------------
-// Helpers implementations (same as your version)
-// ----------------------------
-static void appendThinPipePrism(
-    float xPlane,
-    float yCenter,
-    float z0, float z1,
-    float r,
-    bool onLeftWall,
-    const glm::vec3& col,
-    float texIdWall)
+static void UploadBuiltScene()
 {
-    float xIn = xPlane + (onLeftWall ? +0.01f : -0.01f);
+    gRanges = gBuiltScene.ranges;
+    gIndexCount = (GLsizei)gBuiltScene.indices.size();
+    gInstances = gBuiltScene.instances;
+    gBatches = gBuiltScene.batches;
+    gCables = gBuiltScene.cables;
+    gSteam = gBuiltScene.steam;
+
+    CreateSceneBuffers(gBuiltScene.vertices.data(), gBuiltScene.vertices.size() * sizeof(Vtx),
+        gBuiltScene.indices.data(), gBuiltScene.indices.size() * sizeof(unsigned int));
+    printf("Scene built: %zu vertices, %d indices, %zu instances (%.1f ms on a worker)\n",
+        gBuiltScene.vertices.size(), (int)gIndexCount, gInstances.size(), gSceneBuildMs);
+
+    std::vector<Vtx>().swap(gBuiltScene.vertices);
+    std::vector<unsigned int>().swap(gBuiltScene.indices);
+}
 
-    float x0 = xIn - (onLeftWall ? 0.0f : r);
-    float x1 = xIn + (onLeftWall ? r : 0.0f);
+static void StartScene()
+{
+    auto t0 = Clock::now();
+    bool fromPack = gPack.IsOpen() && CreateSceneFromPack();
+    gSceneSetupMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+    if (fromPack) return;
 
-    float y0 = yCenter - r;
-    float y1 = yCenter + r;
+    gJobs.Spawn("BuildAlley", []
+        {
+            auto b0 = Clock::now();
+            BuildAlley(gBuiltScene, gMeshes, true);
+            gSceneBuildMs = std::chrono::duration<double, std::milli>(Clock::now() - b0).count();
+        }, &gSceneBuild);
+    gJobs.Then(gSceneBuild, "scene upload", UploadBuiltScene, true);
+}
 
-    glm::vec3 A(x0, y0, z0);
-    glm::vec3 B(x0, y1, z0);
-    glm::vec3 C(x0, y1, z1);
-    glm::vec3 D(x0, y0, z1);
+static void FinishScene()
+{
+    auto t0 = Clock::now();
+    gJobs.Wait(gSceneBuild);
+    gJobs.PumpMainThread(); // the upload continuation (no-op with a pack)
+    gSceneSetupMs += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
 
-    glm::vec3 E(x1, y0, z0);
-    glm::vec3 F(x1, y1, z0);
-    glm::vec3 G(x1, y1, z1);
-    glm::vec3 H(x1, y0, z1);
+// indexed draw of a scene range
+static void DrawSceneRange(GLint first, GLsizei count)
+{
+    glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (const GLvoid*)((size_t)first * sizeof(unsigned int)));
+    GpuCountDraw(count);
+}
 
-    glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+static void DestroyScene()
+{
+    gProps.Destroy();
+    if (PropsVaoId) glDeleteVertexArrays(1, &PropsVaoId);
+    PropsVaoId = 0;
 
-    appendQuad(A, B, C, D, glm::vec3(-1, 0, 0), col, uv0, uv1, uv2, uv3, texIdWall);
-    appendQuad(E, H, G, F, glm::vec3(1, 0, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+    gSteamParticles.Destroy();
+    if (SteamVaoId) glDeleteVertexArrays(1, &SteamVaoId);
+    SteamVaoId = 0;
 
-    appendQuad(A, D, H, E, glm::vec3(0, -1, 0), col, uv0, uv1, uv2, uv3, texIdWall);
-    appendQuad(B, F, G, C, glm::vec3(0, 1, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+    gWorld.Destroy();
+    if (StreamVaoId) glDeleteVertexArrays(1, &StreamVaoId);
+    StreamVaoId = 0;
 
-    appendQuad(A, E, F, B, glm::vec3(0, 0, -1), col, uv0, uv1, uv2, uv3, texIdWall);
-    appendQuad(D, C, G, H, glm::vec3(0, 0, 1), col, uv0, uv1, uv2, uv3, texIdWall);
+    if (SceneIboId) glDeleteBuffers(1, &SceneIboId);
+    if (SceneVboId) glDeleteBuffers(1, &SceneVboId);
+    if (SceneVaoId) glDeleteVertexArrays(1, &SceneVaoId);
+    SceneIboId = 0; SceneVboId = 0; SceneVaoId = 0;
 }
 
-static void appendWallBox(
-    float xPlane,
-    float yCenter,
-    float zCenter,
-    float sx, float sy, float sz,
-    bool onLeftWall,
-    const glm::vec3& col,
-    float texIdWall)
+// ---------------- Shadow map init ----------------
+static void CreateShadowMaps()
 {
-    float xIn = xPlane + (onLeftWall ? +0.03f : -0.03f);
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        glGenFramebuffers(1, &ShadowFBO[i]);
+        glBindFramebuffer(GL_FRAMEBUFFER, ShadowFBO[i]);
 
-    float x0 = xIn - (onLeftWall ? 0.0f : sx);
-    float x1 = xIn + (onLeftWall ? sx : 0.0f);
+        glGenTextures(1, &ShadowDepthTex[i]);
+        glBindTexture(GL_TEXTURE_2D, ShadowDepthTex[i]);
 
-    float y0 = yCenter - sy;
-    float y1 = yCenter + sy;
-    float z0 = zCenter - sz;
-    float z1 = zCenter + sz;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SHADOW_RES, SHADOW_RES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 
-    glm::vec3 A(x0, y0, z0);
-    glm::vec3 B(x0, y1, z0);
-    glm::vec3 C(x0, y1, z1);
-    glm::vec3 D(x0, y0, z1);
+        // filtering (PCF is in shader; keep this stable)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-    glm::vec3 E(x1, y0, z0);
-    glm::vec3 F(x1, y1, z0);
-    glm::vec3 G(x1, y1, z1);
-    glm::vec3 H(x1, y0, z1);
+        // outside -> lit
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        float borderCol[4] = { 1.f, 1.f, 1.f, 1.f };
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderCol);
 
-    glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, ShadowDepthTex[i], 0);
 
-    appendQuad(A, B, C, D, glm::vec3(-1, 0, 0), col, uv0, uv1, uv2, uv3, texIdWall);
-    appendQuad(E, H, G, F, glm::vec3(1, 0, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
 
-    appendQuad(A, D, H, E, glm::vec3(0, -1, 0), col, uv0, uv1, uv2, uv3, texIdWall);
-    appendQuad(B, F, G, C, glm::vec3(0, 1, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            printf("ERROR: ShadowFBO[%d] incomplete, status=0x%x\n", i, status);
+        }
+    }
 
-    appendQuad(A, E, F, B, glm::vec3(0, 0, -1), col, uv0, uv1, uv2, uv3, texIdWall);
-    appendQuad(D, C, G, H, glm::vec3(0, 0, 1), col, uv0, uv1, uv2, uv3, texIdWall);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-static void appendWallLadder(
-    float xPlane,
-    float yCenter,
-    float z0,
-    float height,
-    float width,
-    bool onLeftWall,
-    const glm::vec3& col,
-    float texIdWall)
+static GLuint CreateMomentTarget(GLuint tex, bool mipmapped)
 {
-    float railR = 0.02f;
-    float stepR = 0.015f;
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, SHADOW_MOMENT_RES, SHADOW_MOMENT_RES, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mipmapped ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (mipmapped) glGenerateMipmap(GL_TEXTURE_2D);
+
+    GLuint fbo = 0;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glReadBuffer(GL_NONE);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("ERROR: shadow moment FBO incomplete, status=0x%x\n", status);
+    }
+    return fbo;
+}
 
-    float yL = yCenter - width * 0.5f;
-    float yR = yCenter + width * 0.5f;
+// VSM/EVSM targets: ~21 MB per light with mips, so only made when a moment mode is picked
+static void CreateShadowMomentMaps()
+{
+    glGenTextures(LIGHT_COUNT, ShadowMomentTex);
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        ShadowMomentFBO[i] = CreateMomentTarget(ShadowMomentTex[i], true);
+    }
+    glGenTextures(1, &ShadowBlurTex);
+    ShadowBlurFBO = CreateMomentTarget(ShadowBlurTex, false);
+    glGenVertexArrays(1, &ShadowMomentVao);
 
-    appendThinPipePrism(xPlane, yL, z0, z0 + height, railR, onLeftWall, col, texIdWall);
-    appendThinPipePrism(xPlane, yR, z0, z0 + height, railR, onLeftWall, col, texIdWall);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-    int steps = (int)(height / 0.35f);
-    if (steps < 3) steps = 3;
+static void DestroyShadowMaps()
+{
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        if (ShadowDepthTex[i]) glDeleteTextures(1, &ShadowDepthTex[i]);
+        if (ShadowFBO[i]) glDeleteFramebuffers(1, &ShadowFBO[i]);
+        if (ShadowMomentTex[i]) glDeleteTextures(1, &ShadowMomentTex[i]);
+        if (ShadowMomentFBO[i]) glDeleteFramebuffers(1, &ShadowMomentFBO[i]);
+        ShadowDepthTex[i] = 0;
+        ShadowFBO[i] = 0;
+        ShadowMomentTex[i] = 0;
+        ShadowMomentFBO[i] = 0;
+    }
+    if (ShadowBlurTex) glDeleteTextures(1, &ShadowBlurTex);
+    if (ShadowBlurFBO) glDeleteFramebuffers(1, &ShadowBlurFBO);
+    if (ShadowMomentVao) glDeleteVertexArrays(1, &ShadowMomentVao);
+    ShadowBlurTex = ShadowBlurFBO = ShadowMomentVao = 0;
+}
 
-    float xIn = xPlane + (onLeftWall ? +0.03f : -0.03f);
-    float x0 = xIn - (onLeftWall ? 0.0f : stepR);
-    float x1 = xIn + (onLeftWall ? stepR : 0.0f);
+// ---------------- Shaders ----------------
+// binds the shared std140 blocks of a program to their fixed binding points
+static void BindUniformBlocks(GLuint prog)
+{
+    static const struct { const char* name; GLuint binding; } blocks[] = {
+        { "FrameData", UBO_FRAME },
+        { "ViewData", UBO_VIEW },
+        { "LightData", UBO_LIGHTS },
+        { "ObjectData", UBO_OBJECT },
+        { "ShadowPassData", UBO_SHADOW_PASS }
+    };
 
-    for (int i = 0; i <= steps; i++) {
-        float z = z0 + (height * (float)i / (float)steps);
+    for (const auto& b : blocks) {
+        GLuint idx = glGetUniformBlockIndex(prog, b.name);
+        if (idx != GL_INVALID_INDEX) glUniformBlockBinding(prog, idx, b.binding);
+    }
+}
 
-        float y0 = yL;
-        float y1 = yR;
+// one-time setup of every main program variant: block bindings + fixed texture units
+static void SetupMainProgram(GLuint prog)
+{
+    BindUniformBlocks(prog);
 
-        float z0s = z - stepR;
-        float z1s = z + stepR;
+    glUseProgram(prog);
 
-        glm::vec3 A(x0, y0, z0s);
-        glm::vec3 B(x0, y1, z0s);
-        glm::vec3 C(x0, y1, z1s);
-        glm::vec3 D(x0, y0, z1s);
+    // material arrays -> units 0..5, material table -> unit 6
+    GLint arrayUnits[MATERIAL_ARRAY_GROUPS];
+    for (int i = 0; i < MATERIAL_ARRAY_GROUPS; i++) arrayUnits[i] = MATERIAL_TEX_UNIT_BASE + i;
+    GLint arraysLoc = glGetUniformLocation(prog, "materialArrays");
+    if (arraysLoc >= 0) glUniform1iv(arraysLoc, MATERIAL_ARRAY_GROUPS, arrayUnits);
+    glUniform1i(glGetUniformLocation(prog, "materialTable"), MATERIAL_TEX_UNIT_BASE + MATERIAL_ARRAY_GROUPS);
 
-        glm::vec3 E(x1, y0, z0s);
-        glm::vec3 F(x1, y1, z0s);
-        glm::vec3 G(x1, y1, z1s);
-        glm::vec3 H(x1, y0, z1s);
+    // shadow map sampler array -> texture units 7,8,9
+    GLint shadowUnits[LIGHT_COUNT];
+    for (int i = 0; i < LIGHT_COUNT; i++) shadowUnits[i] = SHADOW_TEX_UNIT_BASE + i;
+    GLint shadowMapLoc = glGetUniformLocation(prog, "shadowMap");
+    if (shadowMapLoc >= 0) glUniform1iv(shadowMapLoc, LIGHT_COUNT, shadowUnits);
 
-        glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+    // clustered light buffers -> texture units 10,11,12
+    glUniform1i(glGetUniformLocation(prog, "lightData"), CLUSTER_TEX_UNIT_BASE + 0);
+    glUniform1i(glGetUniformLocation(prog, "clusterGrid"), CLUSTER_TEX_UNIT_BASE + 1);
+    glUniform1i(glGetUniformLocation(prog, "lightIndexList"), CLUSTER_TEX_UNIT_BASE + 2);
 
-        appendQuad(A, B, C, D, glm::vec3(-1, 0, 0), col, uv0, uv1, uv2, uv3, texIdWall);
-        appendQuad(E, H, G, F, glm::vec3(1, 0, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+    // fog volume -> texture units 13,14
+    glUniform1i(glGetUniformLocation(prog, "fogScatter"), FOG_TEX_UNIT_BASE + 0);
+    glUniform1i(glGetUniformLocation(prog, "fogIntegrated"), FOG_TEX_UNIT_BASE + 1);
 
-        appendQuad(A, D, H, E, glm::vec3(0, -1, 0), col, uv0, uv1, uv2, uv3, texIdWall);
-        appendQuad(B, F, G, C, glm::vec3(0, 1, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+    // steam noise -> texture unit 15
+    glUniform1i(glGetUniformLocation(prog, "steamNoiseVolume"), NOISE_TEX_UNIT);
 
-        appendQuad(A, E, F, B, glm::vec3(0, 0, -1), col, uv0, uv1, uv2, uv3, texIdWall);
-        appendQuad(D, C, G, H, glm::vec3(0, 0, 1), col, uv0, uv1, uv2, uv3, texIdWall);
-    }
+    glUseProgram(0);
 }
 
-static void appendWallVent(
-    float xPlane,
-    float yCenter,
-    float zCenter,
-    float w, float h,
-    bool onLeftWall,
-    const glm::vec3& col,
-    float texIdWall)
+static unsigned int CurrentShaderFeatures()
 {
-    float x = xPlane + (onLeftWall ? +0.02f : -0.02f);
-    glm::vec3 n = onLeftWall ? glm::vec3(1, 0, 0) : glm::vec3(-1, 0, 0);
+    unsigned int f = 0;
+    if (gUseTextures) f |= SF_TEXTURES;
+    if (gUseNormalMap) f |= SF_NORMAL_MAP;
+    if (gUseFog) f |= SF_FOG;
+    if (gUseShadowMap) f |= SF_SHADOW_MAP;
+    if (codCol) f |= SF_PLANAR_SHADOW;
+    if (gUseShadowMap && gShadowFilter == SHADOW_FILTER_VSM) f |= SF_SHADOW_VSM;
+    if (gUseShadowMap && gShadowFilter == SHADOW_FILTER_EVSM) f |= SF_SHADOW_EVSM;
+    return f;
+}
 
-    glm::vec3 p0(x, yCenter - w * 0.5f, zCenter - h * 0.5f);
-    glm::vec3 p1(x, yCenter + w * 0.5f, zCenter - h * 0.5f);
-    glm::vec3 p2(x, yCenter + w * 0.5f, zCenter + h * 0.5f);
-    glm::vec3 p3(x, yCenter - w * 0.5f, zCenter + h * 0.5f);
+static void CreateShaders()
+{
+    CPU_ZONE("CreateShaders");
+    // main shader: variants are built on first use (and loaded from shader_cache/ next time)
+    char common[128];
+    snprintf(common, sizeof(common), "#define SHADOW_LIGHT_COUNT %d\n#define MATERIAL_ARRAY_GROUPS %d\n",
+        LIGHT_COUNT, MATERIAL_ARRAY_GROUPS);
+    gMainShaders.Init("alley.vert", "alley.frag", MAIN_SHADER_DEFINES, common, SetupMainProgram);
+
+    gMainFeatures = CurrentShaderFeatures();
+    ProgramId = gMainShaders.Get(gMainFeatures);
+
+    // depth-only shader (per-light matrix comes from ShadowPassData)
+    ProgramBuildInfo info;
+    ShadowProgramId = LoadProgramCached("shadow_depth.vert", "shadow_depth.frag", "", &info);
+    BindUniformBlocks(ShadowProgramId);
+    printf("Shadow program: %s, compile %.2f ms, link/load %.2f ms\n",
+        info.fromCache ? "binary cache" : "source", info.compileMs, info.linkMs);
+    DepthPrepassProgramId = LoadProgramCached("shadow_depth.vert", "shadow_depth.frag", "#define DEPTH_PREPASS\n");
+    if (DepthPrepassProgramId) BindUniformBlocks(DepthPrepassProgramId);
+
+    // fog volume: same blocks and shadow/cluster units as the main program
+    char fogDefines[160];
+    snprintf(fogDefines, sizeof(fogDefines), "#define SHADOW_LIGHT_COUNT %d\n#define FOG_GRID_X %d\n#define FOG_GRID_Y %d\n#define FOG_GRID_Z %d\n",
+        LIGHT_COUNT, FOG_GRID_X, FOG_GRID_Y, FOG_GRID_Z);
+    // moment prefiltering (VSM, EVSM): reads the depth map / blur target on unit 0
+    char momentDefines[64];
+    snprintf(momentDefines, sizeof(momentDefines), "#define SHADOW_MOMENT_DOWNSAMPLE %d\n", SHADOW_MOMENT_DOWNSAMPLE);
+    for (int k = 0; k < 2; k++) {
+        std::string defines = std::string(momentDefines) + (k == 1 ? "#define SHADOW_EVSM\n" : "");
+        ShadowMomentProgramId[k] = LoadProgramCached("fullscreen.vert", "shadow_moments.frag", defines);
+        if (!ShadowMomentProgramId[k]) continue;
+        glUseProgram(ShadowMomentProgramId[k]);
+        glUniform1i(glGetUniformLocation(ShadowMomentProgramId[k], "source"), 0);
+        glUseProgram(0);
+    }
 
-    glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
-    appendQuad(p0, p1, p2, p3, n, col, uv0, uv1, uv2, uv3, texIdWall);
+    // post: fullscreen passes, only the tone map reads a block (FrameData: exposure, gamma)
+    gPostPrograms.taa = LoadProgramCached("fullscreen.vert", "post_taa.frag", "");
+    gPostPrograms.bloomDown = LoadProgramCached("fullscreen.vert", "post_bloom_down.frag", "");
+    gPostPrograms.bloomUp = LoadProgramCached("fullscreen.vert", "post_bloom_up.frag", "");
+    gPostPrograms.tonemap = LoadProgramCached("fullscreen.vert", "post_tonemap.frag", "");
+    if (gPostPrograms.tonemap) BindUniformBlocks(gPostPrograms.tonemap);
+
+    FogScatterProgramId = LoadProgramCached("fullscreen.vert", "fog_scatter.frag", fogDefines, &info);
+    if (FogScatterProgramId) SetupMainProgram(FogScatterProgramId);
+    FogIntegrateProgramId = LoadProgramCached("fullscreen.vert", "fog_integrate.frag", fogDefines);
+    if (FogIntegrateProgramId) SetupMainProgram(FogIntegrateProgramId);
+}
 
-    float r = 0.015f;
-    appendThinPipePrism(xPlane, yCenter - w * 0.5f, zCenter - h * 0.5f, zCenter + h * 0.5f, r, onLeftWall, col, texIdWall);
-    appendThinPipePrism(xPlane, yCenter + w * 0.5f, zCenter - h * 0.5f, zCenter + h * 0.5f, r, onLeftWall, col, texIdWall);
+static void DestroyShaders()
+{
+    gMainShaders.Destroy();
+    if (ShadowProgramId) glDeleteProgram(ShadowProgramId);
+    if (DepthPrepassProgramId) glDeleteProgram(DepthPrepassProgramId);
+    for (int k = 0; k < 2; k++) {
+        if (ShadowMomentProgramId[k]) glDeleteProgram(ShadowMomentProgramId[k]);
+        ShadowMomentProgramId[k] = 0;
+    }
+    if (gPostPrograms.taa) glDeleteProgram(gPostPrograms.taa);
+    if (gPostPrograms.bloomDown) glDeleteProgram(gPostPrograms.bloomDown);
+    if (gPostPrograms.bloomUp) glDeleteProgram(gPostPrograms.bloomUp);
+    if (gPostPrograms.tonemap) glDeleteProgram(gPostPrograms.tonemap);
+    gPostPrograms = PostPrograms();
+    if (FogScatterProgramId) glDeleteProgram(FogScatterProgramId);
+    if (FogIntegrateProgramId) glDeleteProgram(FogIntegrateProgramId);
+    ProgramId = 0;
+    ShadowProgramId = DepthPrepassProgramId = 0;
+    FogScatterProgramId = FogIntegrateProgramId = 0;
 }
 
-static void appendCable(
-    const glm::vec3& pA,
-    const glm::vec3& pB,
-    float sag,
-    int segments,
-    float halfWidth,
-    const glm::vec3& col,
-    float texIdWall)
+// ---------------- Camera + lighting ----------------
+static void UpdateCameraMatrices()
 {
-    auto pointAt = [&](float t) -> glm::vec3 {
-        glm::vec3 p = (1.0f - t) * pA + t * pB;
-        float s = 4.0f * t * (1.0f - t);
-        p.z -= sag * s;
-        return p;
-        };
+    CPU_ZONE("UpdateCameraMatrices");
+    glm::vec3 ref(refX, refY, refZ);
+
+    glm::vec3 baseOffset(0.0f, -dist, 0.0f);
+    glm::vec3 offset = camRot * baseOffset;
+    glm::vec3 obs = ref + offset;
+
+    obsX = obs.x; obsY = obs.y; obsZ = obs.z;
 
     glm::vec3 up(0, 0, 1);
 
-    for (int i = 0; i < segments; i++) {
-        float t0 = (float)i / (float)segments;
-        float t1 = (float)(i + 1) / (float)segments;
+    view = glm::lookAt(obs, ref, up);
+    projection = glm::perspective(fov, width / height, dNear, dFar);
+}
 
-        glm::vec3 a = pointAt(t0);
-        glm::vec3 b = pointAt(t1);
+// ---------------- Camera path ----------------
+// one frame of a recorded ('8') or scripted path: the orbit camera + the key light
+struct CameraKey {
+    glm::vec3 ref;
+    float dist;
+    glm::quat rot;
+    glm::vec3 light;
+};
 
-        glm::vec3 dir = b - a;
-        float len2 = glm::dot(dir, dir);
-        if (len2 < 1e-10f) continue;
-        dir = glm::normalize(dir);
+static CameraKey CurrentCameraKey()
+{
+    CameraKey k;
+    k.ref = glm::vec3(refX, refY, refZ);
+    k.dist = dist;
+    k.rot = camRot;
+    k.light = lightPos[0];
+    return k;
+}
 
-        glm::vec3 side = glm::cross(dir, up);
-        float s2 = glm::dot(side, side);
-        if (s2 < 1e-10f) side = glm::vec3(1, 0, 0);
-        else side = glm::normalize(side);
+static void ApplyCameraKey(const CameraKey& k)
+{
+    refX = k.ref.x; refY = k.ref.y; refZ = k.ref.z;
+    dist = k.dist;
+    camRot = k.rot;
+    lightPos[0] = k.light;
+}
 
-        glm::vec3 o = side * halfWidth;
+static void WriteCameraKey(FILE* f, const CameraKey& k)
+{
+    fprintf(f, "%.5f %.5f %.5f %.5f %.6f %.6f %.6f %.6f %.5f %.5f %.5f\n",
+        k.ref.x, k.ref.y, k.ref.z, k.dist, k.rot.w, k.rot.x, k.rot.y, k.rot.z, k.light.x, k.light.y, k.light.z);
+}
 
-        glm::vec3 p0 = a - o;
-        glm::vec3 p1 = a + o;
-        glm::vec3 p2 = b + o;
-        glm::vec3 p3 = b - o;
+// the file written by '8'; lines starting with # are skipped
+static bool LoadCameraPath(const char* path, std::vector<CameraKey>& keys)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        printf("Nu am putut deschide: %s\n", path);
+        return false;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') continue;
+        CameraKey k;
+        if (sscanf(line, "%f %f %f %f %f %f %f %f %f %f %f",
+            &k.ref.x, &k.ref.y, &k.ref.z, &k.dist, &k.rot.w, &k.rot.x, &k.rot.y, &k.rot.z,
+            &k.light.x, &k.light.y, &k.light.z) != 11) continue;
+        k.rot = glm::normalize(k.rot);
+        keys.push_back(k);
+    }
+    fclose(f);
+    if (keys.empty()) printf("Camera path %s: no keys\n", path);
+    return !keys.empty();
+}
 
-        glm::vec3 n = glm::normalize(glm::cross(p1 - p0, p3 - p0));
-        if (glm::dot(n, n) < 1e-10f) n = glm::vec3(0, 1, 0);
+// deterministic fly-through at 60 Hz: a slow orbit with a dolly in and out, the look-at point
+// sweeping along the alley, the key light swinging over it (shadow updates, light clusters)
+static CameraKey ScriptedCameraKey(int frame)
+{
+    float t = (float)frame / 60.0f;
+    float yaw = 0.35f * t;
+    float pitch = PI / 10.0f + 0.12f * sinf(0.5f * t);
+
+    CameraKey k;
+    k.ref = glm::vec3(0.0f, 3.0f * sinf(0.21f * t), 1.2f);
+    k.dist = 8.0f + 4.0f * sinf(0.4f * t);
+    k.rot = glm::normalize(
+        glm::angleAxis(beta + PI / 2.0f + yaw, glm::vec3(0, 0, 1)) *
+        glm::angleAxis(-pitch, glm::vec3(1, 0, 0)));
+    k.light = glm::vec3(-1.5f, -4.7f + 3.0f * sinf(0.3f * t), 0.3f + 1.5f * (0.5f + 0.5f * sinf(0.7f * t)));
+    return k;
+}
 
-        glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
-        appendQuad(p0, p1, p2, p3, n, col, uv0, uv1, uv2, uv3, texIdWall);
+// ---------------- Uniform ring ----------------
+// copies a std140 block into the current frame's ring region and binds it
+template <typename T>
+static bool PushUniformBlock(GLuint binding, const T& data)
+{
+    GLintptr off = 0;
+    void* p = gUniformRing.Alloc(sizeof(T), (size_t)gUboAlign, off);
+    if (!p) return false;
+
+    memcpy(p, &data, sizeof(T));
+    gUniformRing.Commit(off, sizeof(T));
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, gUniformRing.Buffer(), off, sizeof(T));
+    return true;
+}
 
-        glm::vec3 side2 = glm::normalize(glm::cross(dir, side));
-        glm::vec3 o2 = side2 * halfWidth;
+static void PushFrameData(float t)
+{
+    FrameDataStd140 f;
+    f.timeSec = t;
+    f.exposure = gExposure;
+    f.gammaValue = gGamma;
+    f.pad0 = 0.0f;
+    PushUniformBlock(UBO_FRAME, f);
+}
 
-        glm::vec3 q0 = a - o2;
-        glm::vec3 q1 = a + o2;
-        glm::vec3 q2 = b + o2;
-        glm::vec3 q3 = b - o2;
+// renderW x renderH: the viewport the blocks are used with (screen space cluster tiles)
+static void PushViewData(int renderW, int renderH)
+{
+    ViewDataStd140 v;
+    v.view = view;
+    v.projection = projection;
+    v.viewPos[0] = obsX; v.viewPos[1] = obsY; v.viewPos[2] = obsZ; v.pad0 = 0.0f;
+    v.clusterDims[0] = CLUSTER_X; v.clusterDims[1] = CLUSTER_Y; v.clusterDims[2] = CLUSTER_Z; v.pad1 = 0;
+    v.clusterTileSize[0] = renderW / (float)CLUSTER_X;
+    v.clusterTileSize[1] = renderH / (float)CLUSTER_Y;
+    // from the clip planes, not gClusters: the cluster build may still be running
+    LightClusters::SliceParams(dNear, dFar, v.clusterSlice[0], v.clusterSlice[1]);
+    FogVolume::SliceParams(dNear, FOG_FAR, v.fogSlice[0], v.fogSlice[1]);
+    v.pad2[0] = v.pad2[1] = 0.0f;
+    PushUniformBlock(UBO_VIEW, v);
+}
 
-        glm::vec3 n2 = glm::normalize(glm::cross(q1 - q0, q3 - q0));
-        if (glm::dot(n2, n2) < 1e-10f) n2 = glm::vec3(1, 0, 0);
+static void PushLightData(const glm::mat4* lightSpace)
+{
+    LightDataStd140 l;
+    for (int i = 0; i < LIGHT_COUNT; i++) l.lightSpace[i] = lightSpace[i];
+    memcpy(&l.matrUmbra, matrUmbra, sizeof(matrUmbra));
+    PushUniformBlock(UBO_LIGHTS, l);
+}
 
-        appendQuad(q0, q1, q2, q3, n2, col, uv0, uv1, uv2, uv3, texIdWall);
+static void PushObjectData(const glm::mat4& model)
+{
+    ObjectDataStd140 o;
+    o.myMatrix = model;
+
+    glm::mat3 n = glm::transpose(glm::inverse(glm::mat3(model)));
+    for (int c = 0; c < 3; c++) {
+        o.normalMatrix[c][0] = n[c][0];
+        o.normalMatrix[c][1] = n[c][1];
+        o.normalMatrix[c][2] = n[c][2];
+        o.normalMatrix[c][3] = 0.0f;
     }
+    PushUniformBlock(UBO_OBJECT, o);
 }
 
-// ---------------- Build scene ----------------
-static void BuildAlley()
+// ---------------- Clustered lights ----------------
+// small neon lights scattered along both walls; radius shrinks as the count grows so the
+// number of lights per froxel stays roughly constant (like a denser, larger district)
+static void GenerateNeonLights(int count)
 {
-    gVertices.clear();
-    gVertices.reserve(200000);
+    static const glm::vec3 palette[5] = {
+        glm::vec3(1.00f, 0.15f, 0.60f), // pink
+        glm::vec3(0.10f, 0.85f, 1.00f), // cyan
+        glm::vec3(0.65f, 0.20f, 1.00f), // purple
+        glm::vec3(1.00f, 0.55f, 0.10f), // orange
+        glm::vec3(0.30f, 1.00f, 0.35f)  // green
+    };
 
-    float halfW = 2.2f;
-    float len = 10.0f;
-    float wallH = 6.0f;
+    gNeonLightCount = count < 0 ? 0 : count;
+    gNeonLights.clear();
+    gNeonLights.reserve(gNeonLightCount);
 
-    glm::vec3 tint(1.0f, 1.0f, 1.0f);
+    float radius = 1.6f * sqrtf(64.0f / (float)(gNeonLightCount > 64 ? gNeonLightCount : 64));
+    if (radius < 0.3f) radius = 0.3f;
 
-    const float TEX_ASPHALT = 0.0f;
-    const float TEX_WALL = 1.0f;
-    const float TEX_SIGN = 2.0f;
-    const float TEX_STEAM = 3.0f;
+    unsigned int seed = 1234567u;
+    auto rnd = [&]() -> float {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / 16777216.0f;
+        };
 
-    // ground
-    groundFirst = (GLint)gVertices.size();
-    {
-        glm::vec3 p0(-halfW, -len * 0.5f, 0.0f);
-        glm::vec3 p1(halfW, -len * 0.5f, 0.0f);
-        glm::vec3 p2(halfW, len * 0.5f, 0.0f);
-        glm::vec3 p3(-halfW, len * 0.5f, 0.0f);
+    // alley: halfW = 2.2, len = 10, wallH = 6 (see BuildAlley)
+    for (int i = 0; i < gNeonLightCount; i++) {
+        PointLight L;
+        bool left = (i & 1) == 0;
+        L.pos = glm::vec3(left ? -2.05f : 2.05f, -4.8f + 9.6f * rnd(), 0.3f + 5.2f * rnd());
+        L.radius = radius * (0.75f + 0.5f * rnd());
+        L.color = palette[i % 5] * 0.6f;
+        L.shadowIndex = -1;
+        gNeonLights.push_back(L);
+    }
+}
 
-        glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
-        appendQuad(p0, p1, p2, p3, glm::vec3(0, 0, 1), tint, uv0, uv1, uv2, uv3, TEX_ASPHALT);
+// light culling runs as a job (itself split over the workers with many lights) while the
+// main thread submits the shadow passes; the upload waits for it right before the main pass
+static void StartClusterBuild(JobCounter& done)
+{
+    gLights.resize(LIGHT_COUNT + gNeonLights.size());
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        gLights[i].pos = lightPos[i];
+        gLights[i].radius = MAIN_LIGHT_RADIUS;
+        gLights[i].color = lightColor[i];
+        gLights[i].shadowIndex = i;
     }
-    groundCount = (GLsizei)gVertices.size() - groundFirst;
+    std::copy(gNeonLights.begin(), gNeonLights.end(), gLights.begin() + LIGHT_COUNT);
+    gWorld.AppendLights(gLights);
 
-    // everything after this is considered "casters"
-    castersFirst = (GLint)gVertices.size();
+    glm::mat4 v = view;
+    float p00 = projection[0][0], p11 = projection[1][1];
+    gJobs.Spawn("cluster build", [v, p00, p11]
+        {
+            gClusters.Build(gLights, v, p00, p11, dNear, dFar, &gJobs);
+        }, &done);
+}
 
-    // walls + end wall
-    {
-        glm::vec3 p0(-halfW, -len * 0.5f, 0.0f);
-        glm::vec3 p1(-halfW, len * 0.5f, 0.0f);
-        glm::vec3 p2(-halfW, len * 0.5f, wallH);
-        glm::vec3 p3(-halfW, -len * 0.5f, wallH);
-        glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
-        appendQuad(p0, p1, p2, p3, glm::vec3(1, 0, 0), tint, uv0, uv1, uv2, uv3, TEX_WALL);
-    }
-    {
-        glm::vec3 p0(halfW, len * 0.5f, 0.0f);
-        glm::vec3 p1(halfW, -len * 0.5f, 0.0f);
-        glm::vec3 p2(halfW, -len * 0.5f, wallH);
-        glm::vec3 p3(halfW, len * 0.5f, wallH);
-        glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
-        appendQuad(p0, p1, p2, p3, glm::vec3(-1, 0, 0), tint, uv0, uv1, uv2, uv3, TEX_WALL);
-    }
-    {
-        float y = len * 0.5f;
-        glm::vec3 p0(-halfW, y, 0.0f);
-        glm::vec3 p1(halfW, y, 0.0f);
-        glm::vec3 p2(halfW, y, wallH);
-        glm::vec3 p3(-halfW, y, wallH);
-        glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
-        appendQuad(p0, p1, p2, p3, glm::vec3(0, -1, 0), tint, uv0, uv1, uv2, uv3, TEX_WALL);
-    }
+static void FinishClusterBuild(JobCounter& done)
+{
+    gJobs.Wait(done);
+    gClusters.Upload(gLights);
+}
 
-    // signs
-    auto addSignLeft = [&](float y, float z, float w, float h)
-        {
-            float x = -halfW + 0.02f;
-            glm::vec3 p0(x, y - w * 0.5f, z - h * 0.5f);
-            glm::vec3 p1(x, y + w * 0.5f, z - h * 0.5f);
-            glm::vec3 p2(x, y + w * 0.5f, z + h * 0.5f);
-            glm::vec3 p3(x, y - w * 0.5f, z + h * 0.5f);
-            glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
-            appendQuad(p0, p1, p2, p3, glm::vec3(1, 0, 0), tint, uv0, uv1, uv2, uv3, TEX_SIGN);
-        };
+// legacy planar shadow matrix (kept)
+static void UpdatePlanarShadowMatrix(float D)
+{
+    float xL = lightPos[0].x;
+    float yL = lightPos[0].y;
+    float zL = lightPos[0].z;
 
-    auto addSignRight = [&](float y, float z, float w, float h)
-        {
-            float x = halfW - 0.02f;
-            glm::vec3 p0(x, y + w * 0.5f, z - h * 0.5f);
-            glm::vec3 p1(x, y - w * 0.5f, z - h * 0.5f);
-            glm::vec3 p2(x, y - w * 0.5f, z + h * 0.5f);
-            glm::vec3 p3(x, y + w * 0.5f, z + h * 0.5f);
-            glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
-            appendQuad(p0, p1, p2, p3, glm::vec3(-1, 0, 0), tint, uv0, uv1, uv2, uv3, TEX_SIGN);
-        };
+    matrUmbra[0][0] = zL + D;  matrUmbra[0][1] = 0;       matrUmbra[0][2] = 0;       matrUmbra[0][3] = 0;
+    matrUmbra[1][0] = 0;       matrUmbra[1][1] = zL + D;  matrUmbra[1][2] = 0;       matrUmbra[1][3] = 0;
+    matrUmbra[2][0] = -xL;     matrUmbra[2][1] = -yL;     matrUmbra[2][2] = D;       matrUmbra[2][3] = -1;
+    matrUmbra[3][0] = -D * xL; matrUmbra[3][1] = -D * yL; matrUmbra[3][2] = -D * zL; matrUmbra[3][3] = zL;
+    // uploaded with LightData (PushLightData)
+}
 
-    addSignLeft(-2.0f, 2.6f, 1.6f, 0.7f);
-    addSignLeft(1.5f, 1.8f, 1.2f, 0.6f);
-    addSignRight(0.5f, 2.2f, 1.8f, 0.8f);
+// compute light-space matrix for shadow map (2D) for a given light index
+static glm::mat4 ComputeLightSpace(int li)
+{
+    CPU_ZONE("ComputeLightSpace");
+    // Stable "directional-ish" shadow: look from light position to a fixed target
+    glm::vec3 target(0.0f, 0.0f, 1.6f);
 
-    // props (trash + manhole)
-    ObjMesh trashMesh, manholeMesh;
-    if (!loadOBJ2("trashcan.obj", trashMesh, true)) printf("WARN: could not load trashcan.obj\n");
-    if (!loadOBJ2("manhole.obj", manholeMesh, true)) printf("WARN: could not load manhole.obj\n");
+    glm::vec3 up(0, 0, 1);
+    glm::vec3 L = lightPos[li];
 
-    const float TRASH_SCALE = 1.8f;
+    if (fabs(glm::dot(glm::normalize(target - L), up)) > 0.98f) {
+        up = glm::vec3(0, 1, 0);
+    }
 
-    auto placeTrash = [&](glm::vec3 pos, float rotZ, glm::vec3 col)
-        {
-            if (trashMesh.positions.empty()) return;
-            glm::mat4 M =
-                glm::translate(glm::mat4(1.0f), pos) *
-                glm::rotate(glm::mat4(1.0f), rotZ, glm::vec3(0, 0, 1)) *
-                glm::scale(glm::mat4(1.0f), glm::vec3(TRASH_SCALE));
-            appendObjMesh(trashMesh, M, col, TEX_ASPHALT);
-        };
+    glm::mat4 lightView = glm::lookAt(L, target, up);
 
-    placeTrash(glm::vec3(-1.35f, -3.2f, 0.0f), 0.6f, glm::vec3(0.95f));
-    placeTrash(glm::vec3(1.25f, 1.3f, 0.0f), 2.9f, glm::vec3(0.95f));
+    // orthographic volume (tune if needed)
+    float orthoHalfX = 4.0f;
+    float orthoHalfY = 7.0f;
+    float nearZ = 0.1f;
+    float farZ = 25.0f;
 
-    auto placeManhole = [&](glm::vec3 pos, float rotZ)
-        {
-            if (manholeMesh.positions.empty()) return;
-            glm::mat4 M =
-                glm::translate(glm::mat4(1.0f), pos) *
-                glm::rotate(glm::mat4(1.0f), rotZ, glm::vec3(0, 0, 1)) *
-                glm::scale(glm::mat4(1.0f), glm::vec3(1.0f));
-            appendObjMesh(manholeMesh,
-                glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, 0.002f)) * M,
-                tint, TEX_ASPHALT, true);
-        };
+    glm::mat4 lightProj = glm::ortho(-orthoHalfX, orthoHalfX, -orthoHalfY, orthoHalfY, nearZ, farZ);
+    return lightProj * lightView;
+}
 
-    placeManhole(glm::vec3(0.2f, -2.6f, 0.0f), 0.4f);
-    placeManhole(glm::vec3(-0.6f, 0.2f, 0.0f), 1.0f);
+// ---------------- Shadow scheduling ----------------
+static void ApplyShadowBudget()
+{
+    int trisPerMap = gRanges.shadowCastersCount / 3;
+
+    ShadowBudget b;
+    switch (gShadowBudgetMode) {
+    case 0: b.maxTriangles = trisPerMap; break;
+    case 1: b.maxTriangles = trisPerMap * 2; break;
+    case 2: break; // unlimited
+    case 3: b.maxMs = 0.5f; break;
+    }
+    gShadowScheduler.SetBudget(b);
+}
 
-    // ------------------------------------------------------------
-    // ADD ALL OTHER GEOMETRY THAT SHOULD CAST SHADOWS (including cables)
-    // ------------------------------------------------------------
-    {
-        glm::vec3 pipeCol(0.82f, 0.88f, 0.95f);
+// fraction of the screen covered by the light's sphere of influence (uses current view/projection)
+static float EstimateLightCoverage(const glm::vec3& L)
+{
+    glm::vec4 vs = view * glm::vec4(L, 1.0f);
+    float depth = -vs.z;
 
-        float rThin = 0.03f;
-        float rMed = 0.05f;
+    // camera inside the sphere (or sphere crossing the near plane) => whole screen
+    if (depth <= LIGHT_SHADOW_RADIUS) return 1.0f;
 
-        appendThinPipePrism(-halfW, -3.8f, 0.0f, 3.7f, rThin, true, pipeCol, TEX_WALL);
-        appendThinPipePrism(-halfW, -0.5f, 0.0f, 4.0f, rThin, true, pipeCol, TEX_WALL);
-        appendThinPipePrism(-halfW, 2.2f, 0.2f, 3.2f, rThin, true, pipeCol, TEX_WALL);
+    float rPixels = LIGHT_SHADOW_RADIUS * projection[1][1] / depth * (height * 0.5f);
+    float area = PI * rPixels * rPixels;
+    float cov = area / (width * height);
+    return cov > 1.0f ? 1.0f : cov;
+}
 
-        appendThinPipePrism(halfW, -2.4f, 0.0f, 3.6f, rThin, false, pipeCol, TEX_WALL);
-        appendThinPipePrism(halfW, 0.8f, 0.0f, 4.1f, rThin, false, pipeCol, TEX_WALL);
+// collect finished shadow pass timings without stalling
+static void CollectShadowTimings()
+{
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        if (!gShadowQueryPending[i]) continue;
 
-        glm::vec3 boxCol(0.65f, 0.7f, 0.75f);
-        for (int i = 0; i < 6; i++) {
-            appendWallBox(-halfW, -1.5f + i * 0.35f, 3.2f, 0.04f, 0.12f, 0.04f, true, boxCol, TEX_WALL);
-        }
-        appendWallBox(-halfW, 0.7f, 3.2f, 0.06f, 0.10f, 0.06f, true, boxCol, TEX_WALL);
+        GLint available = 0;
+        glGetQueryObjectiv(ShadowTimeQuery[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
 
-        appendThinPipePrism(halfW, -0.8f, 0.3f, 3.9f, rMed, false, pipeCol, TEX_WALL);
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(ShadowTimeQuery[i], GL_QUERY_RESULT, &ns);
+        gShadowScheduler.ReportGpuMs(i, (float)ns * 1e-6f);
+        gShadowQueryPending[i] = false;
     }
+}
 
-    {
-        glm::vec3 boxCol(0.40f, 0.42f, 0.45f);
-        appendWallBox(-halfW, -3.0f, 2.8f, 0.10f, 0.18f, 0.16f, true, boxCol, TEX_WALL);
-        appendWallBox(-halfW, 1.1f, 2.2f, 0.09f, 0.15f, 0.14f, true, boxCol, TEX_WALL);
+// ---------------- Init / Render ----------------
+// program binaries of the pack are named by their shader cache key
+static bool PackShaderSource(unsigned long long key, const unsigned char** data, size_t* size)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", key);
+    const PackSection* s = gPack.Find(PACK_SHADER_BINARY, name);
+    if (!s) return false;
+    *data = gPack.Data(*s);
+    *size = (size_t)s->size;
+    return true;
+}
 
-        appendWallBox(halfW, -1.7f, 2.6f, 0.10f, 0.16f, 0.16f, false, boxCol, TEX_WALL);
-        appendWallBox(halfW, 2.0f, 2.9f, 0.08f, 0.14f, 0.12f, false, boxCol, TEX_WALL);
-    }
+// inverse of the tone map + gamma of post_tonemap.frag, for one channel
+static float DisplayToLinear(float d)
+{
+    float y = powf(d, gGamma);
+    return y / (gExposure * (1.0f - y));
+}
 
-    {
-        glm::vec3 ventCol(0.55f, 0.55f, 0.58f);
-        appendWallVent(-halfW, -0.2f, 1.1f, 0.9f, 0.45f, true, ventCol, TEX_WALL);
-        appendWallVent(halfW, 1.5f, 1.4f, 0.7f, 0.35f, false, ventCol, TEX_WALL);
-    }
+void Initialize()
+{
+    CPU_ZONE("Initialize");
+    // the clear color goes through tone mapping + gamma now: (0.02, 0.02, 0.03) on screen
+    glClearColor(DisplayToLinear(0.02f), DisplayToLinear(0.02f), DisplayToLinear(0.03f), 1.0f);
+    glEnable(GL_DEPTH_TEST);
 
-    {
-        glm::vec3 ladderCol(0.35f, 0.37f, 0.40f);
-        appendWallLadder(-halfW, 3.4f, 0.4f, 3.3f, 0.55f, true, ladderCol, TEX_WALL);
-    }
+    // blending is enabled only around the transparent pass
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    {
-        glm::vec3 metalCol(0.30f, 0.32f, 0.35f);
-        appendWallBox(halfW, 0.25f, 1.75f, 0.05f, 0.08f, 0.03f, false, metalCol, TEX_WALL);
-        appendWallBox(halfW, 0.75f, 1.75f, 0.05f, 0.08f, 0.03f, false, metalCol, TEX_WALL);
-        appendWallBox(halfW, 0.50f, 1.65f, 0.05f, 0.18f, 0.03f, false, metalCol, TEX_WALL);
+    gJobs.Init();
+
+    // program binaries, textures and geometry all come from the pack when there is one
+    if (gUsePack && gPack.Open(ASSET_PACK_PATH, sizeof(Vtx))) {
+        printf("Asset pack: %s (%d sections, %.1f MB mapped)\n", ASSET_PACK_PATH, gPack.SectionCount(),
+            gPack.FileSize() / (1024.0 * 1024.0));
+        ShaderCache_SetBlobSource(PackShaderSource);
+        gDecoder.SetSource(PackImageSource);
     }
 
-    {
-        glm::vec3 cableCol(0.22f, 0.22f, 0.25f);
-        float xL = -halfW + 0.08f;
-        float xR = halfW - 0.08f;
+    InitMeshCache(gMeshes, MESH_CACHE_BUDGET);
+    InitImageCache(gImages, gDecoder, IMAGE_CACHE_BUDGET);
+
+    StartScene();
+
+    CreateShaders();
+    CreateShadowMaps();
+    CreateMaterials();
+    CreateSteamNoise();
 
-        float hw = 0.022f;
+    FinishScene();
 
-        appendCable(glm::vec3(xL, -1.8f, 3.3f), glm::vec3(xR, -1.2f, 3.1f), 0.55f, 18, hw, cableCol, TEX_WALL);
-        appendCable(glm::vec3(xL, 0.4f, 3.8f), glm::vec3(xR, 0.9f, 3.7f), 0.45f, 18, hw, cableCol, TEX_WALL);
-        appendCable(glm::vec3(xL, 2.6f, 3.0f), glm::vec3(xR, 2.2f, 3.2f), 0.40f, 16, hw, cableCol, TEX_WALL);
+    gWorld.Init(gJobs, gMeshes, STREAM_VERTEX_POOL_BYTES, STREAM_INDEX_POOL_BYTES);
+    gWorld.SetBudget(STREAM_BUDGETS[gStreamBudgetMode]);
+    StreamVaoId = CreateVtxVao(gWorld.VertexBuffer(), gWorld.IndexBuffer());
 
-        appendCable(glm::vec3(xL, -3.2f, 3.9f), glm::vec3(xR, -2.8f, 3.8f), 0.35f, 16, hw, cableCol, TEX_WALL);
-        appendCable(glm::vec3(xL, 1.8f, 3.95f), glm::vec3(xR, 1.5f, 3.9f), 0.30f, 14, hw, cableCol, TEX_WALL);
+    gProps.Init(gCables);
+    PropsVaoId = CreateVtxVao(gProps.Buffer(), 0);
 
-        appendCable(glm::vec3(xL, -3.0f, 2.8f), glm::vec3(xL + 0.4f, -3.2f, 0.6f), 0.25f, 12, hw * 0.9f, cableCol, TEX_WALL);
-        appendCable(glm::vec3(xR, -1.7f, 2.6f), glm::vec3(xR - 0.35f, -1.9f, 0.7f), 0.25f, 12, hw * 0.9f, cableCol, TEX_WALL);
-    }
+    gSteamParticles.SetTarget(STEAM_TARGETS[gSteamTargetMode]);
+    gSteamParticles.Init(gSteam);
+    SteamVaoId = gSteamParticles.CreateVao();
 
-    // ------------------------------------------------------------
-    // NOW CLOSE SHADOW CASTERS RANGE (everything so far casts shadows)
-    // ------------------------------------------------------------
-    shadowCastersCount = (GLsizei)gVertices.size() - castersFirst;
+    gShadowScheduler.Init(LIGHT_COUNT);
+    ApplyShadowBudget();
+    glGenQueries(LIGHT_COUNT, ShadowTimeQuery);
 
-    // ------------------------------------------------------------
-    // Steam (excluded from shadow casters)
-    // ------------------------------------------------------------
-    steamFirst = (GLint)gVertices.size();
-    appendSteamPuff(glm::vec3(0.2f, -2.6f, 0.03f), 2.2f, 0.28f, TEX_STEAM, 1.0f);
-    appendSteamPuff(glm::vec3(-0.6f, 0.2f, 0.03f), 1.8f, 0.34f, TEX_STEAM, 0.9f);
-    steamCount = (GLsizei)gVertices.size() - steamFirst;
+    gClusters.Init();
+    if (!gFog.Init()) printf("Fog volume: not available\n");
+    if (!gPost.Init((int)width, (int)height)) printf("Post: not available, drawing straight to the window\n");
+    gGpuProfiler.Init();
+    GenerateNeonLights(gNeonLightCount);
 
-    castersCount = (GLsizei)gVertices.size() - castersFirst;
+    // uniform blocks: FrameData + ViewData + LightData + ObjectData + LIGHT_COUNT x ShadowPassData
+    // per frame, each aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT; 16 KB leaves plenty of headroom
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &gUboAlign);
+    if (gUboAlign < 16) gUboAlign = 16;
+    gUniformRing.Init(GL_UNIFORM_BUFFER, 16 * 1024, 3);
+
+    glGenQueries(MAIN_QUERY_COUNT, MainTimeQuery);
+    glGenQueries(MAIN_QUERY_COUNT * SCENE_PASS_COUNT, &MainSampleQuery[0][0]);
 }
 
-// ---------------- VBO/VAO ----------------
-static void CreateSceneVBO()
+// per-variant main pass cost: read finished queries, never wait
+static void CollectMainPassTimings()
 {
-    BuildAlley();
-
-    glGenVertexArrays(1, &SceneVaoId);
-    glBindVertexArray(SceneVaoId);
+    for (int i = 0; i < MAIN_QUERY_COUNT; i++) {
+        if (!gMainQueryPending[i]) continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(MainTimeQuery[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(MainTimeQuery[i], GL_QUERY_RESULT, &ns);
+        gMainShaders.ReportGpuMs(gMainQueryFeatures[i], (float)ns * 1e-6f);
+        gMainQueryPending[i] = false;
+
+        // the sample queries ended before the time query, so they are in too
+        int mode = gMainQueryMode[i];
+        int passes = mode == PASS_MODE_SINGLE ? 1 : SCENE_PASS_COUNT;
+        double pixels = gMainQueryPixels[i];
+        double k = gOverdrawFrames[mode] == 0 ? 1.0 : 0.05;
+        for (int p = 0; p < passes; p++) {
+            GLuint samples = 0;
+            glGetQueryObjectuiv(MainSampleQuery[i][p], GL_QUERY_RESULT, &samples);
+            gOverdraw[mode][p] += (samples / pixels - gOverdraw[mode][p]) * k;
+            if (p == SCENE_PASS_OPAQUE) gLastOpaqueOverdraw[mode] = samples / pixels;
+        }
+        gMainPassMs[mode] += (ns * 1e-6 - gMainPassMs[mode]) * k;
+        gOverdrawFrames[mode]++;
+    }
+}
 
-    glGenBuffers(1, &SceneVboId);
-    glBindBuffer(GL_ARRAY_BUFFER, SceneVboId);
-    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(gVertices.size() * sizeof(Vtx)), gVertices.data(), GL_STATIC_DRAW);
+static void PrintOverdraw()
+{
+    printf("\nMain pass: fragments passing the depth test per pixel, GPU time (running averages)\n");
+    for (int m = 0; m < 3; m++) {
+        if (gOverdrawFrames[m] == 0) {
+            printf("  %-22s | no frames yet\n", PASS_STAT_NAMES[m]);
+            continue;
+        }
+        double total = 0.0;
+        for (int p = 0; p < SCENE_PASS_COUNT; p++) total += gOverdraw[m][p];
+        if (m != PASS_MODE_SINGLE) {
+            printf("  %-22s | %.2f (opaque %.2f, alpha-tested %.2f, transparent %.2f) | %.3f ms\n", PASS_STAT_NAMES[m],
+                total, gOverdraw[m][SCENE_PASS_OPAQUE], gOverdraw[m][SCENE_PASS_ALPHA_TEST], gOverdraw[m][SCENE_PASS_TRANSPARENT],
+                gMainPassMs[m]);
+        }
+        else {
+            printf("  %-22s | %.2f | %.3f ms\n", PASS_STAT_NAMES[m], total, gMainPassMs[m]);
+        }
+    }
+    printf("  depth prepass: %s%s (auto: on above %.2f opaque fragments per pixel, off below %.2f)\n",
+        PREPASS_MODE_NAMES[gPrepassMode], gPrepassMode == PREPASS_AUTO ? (gPrepassAutoOn ? ", now on" : ", now off") : "",
+        PREPASS_OVERDRAW_ON, PREPASS_OVERDRAW_OFF);
+}
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, pos));
+// depth prepass for this frame (see PrepassMode)
+static bool UseDepthPrepass()
+{
+    if (gPassMode != PASS_MODE_SORTED || !DepthPrepassProgramId || (gMainFeatures & SF_PLANAR_SHADOW)) return false;
+    if (gPrepassMode != PREPASS_AUTO) return gPrepassMode == PREPASS_ON;
+
+    if (gOverdrawFrames[PASS_MODE_SORTED] > 0) {
+        double opaque = gLastOpaqueOverdraw[PASS_MODE_SORTED];
+        if (!gPrepassAutoOn && opaque > PREPASS_OVERDRAW_ON) {
+            gPrepassAutoOn = true;
+            gPrepassProbe = 0;
+            printf("Depth prepass: auto on (opaque pass %.2f fragments per pixel)\n", opaque);
+        }
+        else if (gPrepassAutoOn && opaque < PREPASS_OVERDRAW_OFF) {
+            gPrepassAutoOn = false;
+            printf("Depth prepass: auto off (opaque pass %.2f fragments per pixel)\n", opaque);
+        }
+    }
 
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, col));
+    // the overdraw without the prepass changes with the camera: measure it again now and then
+    if (gPrepassAutoOn && ++gPrepassProbe >= PREPASS_PROBE_FRAMES) {
+        gPrepassProbe = 0;
+        return false;
+    }
+    return gPrepassAutoOn;
+}
 
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, nrm));
+// batches of every pass by view depth: opaque and alpha-tested front to back (nearest point of
+// the bounds), transparent back to front (center)
+static void SortBatches(const glm::vec3& eye, const glm::vec3& fwd)
+{
+    for (int p = 0; p < SCENE_PASS_COUNT; p++) gPassOrder[p].clear();
+    for (int i = 0; i < (int)gBatches.size(); i++) gPassOrder[gBatches[i].pass].push_back(i);
+
+    auto depth = [&](int i) { return glm::dot(gBatches[i].center - eye, fwd); };
+    for (int p = SCENE_PASS_OPAQUE; p <= SCENE_PASS_ALPHA_TEST; p++) {
+        std::sort(gPassOrder[p].begin(), gPassOrder[p].end(), [&](int a, int b)
+            {
+                return depth(a) - gBatches[a].radius < depth(b) - gBatches[b].radius;
+            });
+    }
+    std::sort(gPassOrder[SCENE_PASS_TRANSPARENT].begin(), gPassOrder[SCENE_PASS_TRANSPARENT].end(),
+        [&](int a, int b) { return depth(a) > depth(b); });
+}
 
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, uv));
+// SceneVaoId bound
+static void DrawBatches(int pass)
+{
+    if (gBatches.empty()) {
+        int first, count;
+        ScenePassRange(gRanges, pass, first, count);
+        DrawSceneRange(first, count);
+        return;
+    }
+    for (int i : gPassOrder[pass]) DrawSceneRange(gBatches[i].first, gBatches[i].count);
+}
 
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, texId));
+// state shared by all shadow passes of a frame is set once
+static void BeginShadowPasses()
+{
+    glViewport(0, 0, SHADOW_RES, SHADOW_RES);
 
-    glEnableVertexAttribArray(5);
-    glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, tan));
+    // reduce peter-panning via polygon offset in shadow pass
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
 
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(Vtx), (GLvoid*)offsetof(Vtx, bit));
+    glUseProgram(ShadowProgramId);
+    glBindVertexArray(SceneVaoId);
+}
 
+static void EndShadowPasses()
+{
     glBindVertexArray(0);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-static void DestroyScene()
+// depth map -> moments + horizontal blur (blur target) -> vertical blur (moment map) -> mips;
+// restores the shadow pass state afterwards
+static void PrefilterShadowMoments(int li)
 {
-    if (SceneVboId) glDeleteBuffers(1, &SceneVboId);
-    if (SceneVaoId) glDeleteVertexArrays(1, &SceneVaoId);
-    SceneVboId = 0; SceneVaoId = 0;
+    GLuint prog = ShadowMomentProgramId[gShadowFilter == SHADOW_FILTER_EVSM ? 1 : 0];
+    if (!prog || !ShadowMomentTex[li]) return;
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glViewport(0, 0, SHADOW_MOMENT_RES, SHADOW_MOMENT_RES);
+    glUseProgram(prog);
+    glBindVertexArray(ShadowMomentVao);
+    glActiveTexture(GL_TEXTURE0);
+    GLint passLoc = glGetUniformLocation(prog, "blurPass");
+
+    glBindFramebuffer(GL_FRAMEBUFFER, ShadowBlurFBO);
+    glBindTexture(GL_TEXTURE_2D, ShadowDepthTex[li]);
+    glUniform1i(passLoc, 0);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    GpuCountDraw(3);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, ShadowMomentFBO[li]);
+    glBindTexture(GL_TEXTURE_2D, ShadowBlurTex);
+    glUniform1i(passLoc, 1);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    GpuCountDraw(3);
+
+    glBindTexture(GL_TEXTURE_2D, ShadowMomentTex[li]);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glViewport(0, 0, SHADOW_RES, SHADOW_RES);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glUseProgram(ShadowProgramId);
+    glBindVertexArray(SceneVaoId);
 }
 
-// ---------------- Shadow map init ----------------
-static void CreateShadowMaps()
+static void RenderShadowPass(const glm::mat4& lightSpace, int li)
 {
-    for (int i = 0; i < LIGHT_COUNT; i++) {
-        glGenFramebuffers(1, &ShadowFBO[i]);
-        glBindFramebuffer(GL_FRAMEBUFFER, ShadowFBO[i]);
+    gGpuProfiler.Begin(SHADOW_SCOPE_NAMES[li]);
+    glBindFramebuffer(GL_FRAMEBUFFER, ShadowFBO[li]);
+    glClear(GL_DEPTH_BUFFER_BIT);
 
-        glGenTextures(1, &ShadowDepthTex[i]);
-        glBindTexture(GL_TEXTURE_2D, ShadowDepthTex[i]);
+    ShadowPassDataStd140 sp;
+    sp.lampLightSpace = lightSpace;
+    PushUniformBlock(UBO_SHADOW_PASS, sp);
 
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SHADOW_RES, SHADOW_RES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    // only one query in flight per light; skip timing if last result is not back yet
+    bool timed = !gShadowQueryPending[li];
+    if (timed) glBeginQuery(GL_TIME_ELAPSED, ShadowTimeQuery[li]);
 
-        // filtering (PCF is in shader; keep this stable)
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Draw ONLY shadow casters (exclude steam)
+    DrawSceneRange(gRanges.castersFirst, gRanges.shadowCastersCount);
+    glBindVertexArray(PropsVaoId);
+    gProps.DrawCables();
+    glBindVertexArray(SceneVaoId);
 
-        // outside -> lit
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        float borderCol[4] = { 1.f, 1.f, 1.f, 1.f };
-        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderCol);
+    // VSM/EVSM: prefilter this map now (inside the timed range: the A/B cost includes it)
+    if (gShadowFilter != SHADOW_FILTER_PCF) PrefilterShadowMoments(li);
 
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, ShadowDepthTex[i], 0);
+    if (timed) {
+        glEndQuery(GL_TIME_ELAPSED);
+        gShadowQueryPending[li] = true;
+    }
+    gGpuProfiler.End();
+}
 
-        glDrawBuffer(GL_NONE);
-        glReadBuffer(GL_NONE);
+// opaque, alpha-tested and transparent passes of a full frame, into the bound scene target.
+// Render on demand saves the scene right before the steam (SaveScene), so steam-only frames
+// can put it back under the steam.
+static void DrawMainPass()
+{
+    CollectMainPassTimings();
+    int q = gMainQueryNext;
+    bool timed = !gMainQueryPending[q];
+    if (timed) glBeginQuery(GL_TIME_ELAPSED, MainTimeQuery[q]);
+
+    int mode = gPassMode;
+    bool prepass = UseDepthPrepass();
+    auto beginSamples = [&](int pass) { if (timed) glBeginQuery(GL_SAMPLES_PASSED, MainSampleQuery[q][pass]); };
+    auto endSamples = [&]() { if (timed) glEndQuery(GL_SAMPLES_PASSED); };
+
+    if (mode == PASS_MODE_SORTED) {
+        glm::vec3 eye(obsX, obsY, obsZ);
+        SortBatches(eye, glm::vec3(-view[0][2], -view[1][2], -view[2][2]));
+
+        auto drawOpaque = [&]() {
+            glBindVertexArray(SceneVaoId);
+            DrawBatches(SCENE_PASS_OPAQUE);
+            glBindVertexArray(PropsVaoId);
+            gProps.DrawCables();
+            glBindVertexArray(StreamVaoId);
+            gWorld.DrawPass(SCENE_PASS_OPAQUE, eye);
+        };
 
-        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-        if (status != GL_FRAMEBUFFER_COMPLETE) {
-            printf("ERROR: ShadowFBO[%d] incomplete, status=0x%x\n", i, status);
+        // opaque: no blending, nearest first so early-z rejects what is hidden behind
+        glDisable(GL_BLEND);
+        if (prepass) {
+            // depth only, then every visible opaque pixel is shaded exactly once
+            glUseProgram(DepthPrepassProgramId);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            drawOpaque();
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glUseProgram(ProgramId);
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+        }
+        beginSamples(SCENE_PASS_OPAQUE);
+        drawOpaque();
+        endSamples();
+        if (prepass) {
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
         }
+
+        // alpha-tested (signs): discard, still no blending, depth written
+        beginSamples(SCENE_PASS_ALPHA_TEST);
+        glBindVertexArray(SceneVaoId);
+        DrawBatches(SCENE_PASS_ALPHA_TEST);
+        glBindVertexArray(StreamVaoId);
+        gWorld.DrawPass(SCENE_PASS_ALPHA_TEST, eye);
+        endSamples();
+
+        // transparent: blended, farthest first, tested against the depth buffer but not written to it
+        gSteamParticles.Finish(gJobs);
+        glEnable(GL_BLEND);
+        glDepthMask(GL_FALSE);
+        beginSamples(SCENE_PASS_TRANSPARENT);
+        glBindVertexArray(StreamVaoId);
+        gWorld.DrawPass(SCENE_PASS_TRANSPARENT, eye);
+        glBindVertexArray(SceneVaoId);
+        DrawBatches(SCENE_PASS_TRANSPARENT);
+        if (gSaveScene) gPost.SaveScene(gRenderW, gRenderH);
+        glBindVertexArray(SteamVaoId);
+        gSteamParticles.Draw();
+        endSamples();
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+    }
+    else {
+        // the old way: buffer order, blending on for everything (steam still last)
+        gSteamParticles.Finish(gJobs);
+        glEnable(GL_BLEND);
+        beginSamples(SCENE_PASS_OPAQUE);
+        glBindVertexArray(SceneVaoId);
+        DrawSceneRange(0, gIndexCount);
+        glBindVertexArray(PropsVaoId);
+        gProps.DrawCables();
+        glBindVertexArray(StreamVaoId);
+        gWorld.Draw();
+        glDepthMask(GL_FALSE);
+        if (gSaveScene) gPost.SaveScene(gRenderW, gRenderH);
+        glBindVertexArray(SteamVaoId);
+        gSteamParticles.Draw();
+        glDepthMask(GL_TRUE);
+        endSamples();
+        glDisable(GL_BLEND);
     }
+    glBindVertexArray(0);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    if (timed) {
+        glEndQuery(GL_TIME_ELAPSED);
+        gMainQueryFeatures[q] = gMainFeatures;
+        gMainQueryMode[q] = prepass ? PASS_STAT_PREPASS : mode;
+        gMainQueryPixels[q] = (double)gRenderW * (double)gRenderH;
+        gMainQueryPending[q] = true;
+        gMainQueryNext = (q + 1) % MAIN_QUERY_COUNT;
+    }
 }
 
-static void DestroyShadowMaps()
+// screen rectangle of this frame's steam in render pixels (empty: none on screen)
+static void UpdateSteamRect(const glm::mat4& viewProj)
 {
-    for (int i = 0; i < LIGHT_COUNT; i++) {
-        if (ShadowDepthTex[i]) glDeleteTextures(1, &ShadowDepthTex[i]);
-        if (ShadowFBO[i]) glDeleteFramebuffers(1, &ShadowFBO[i]);
-        ShadowDepthTex[i] = 0;
-        ShadowFBO[i] = 0;
+    for (int i = 0; i < 4; i++) gSteamRect[i] = 0;
+    glm::vec3 lo, hi;
+    if (!gSteamParticles.Bounds(lo, hi)) return;
+
+    glm::vec2 ndcLo(1.0f), ndcHi(-1.0f);
+    for (int c = 0; c < 8; c++) {
+        glm::vec4 p = viewProj * glm::vec4(c & 1 ? hi.x : lo.x, c & 2 ? hi.y : lo.y, c & 4 ? hi.z : lo.z, 1.0f);
+        if (p.w < dNear) {
+            // the box reaches behind the near plane: no useful bound
+            ndcLo = glm::vec2(-1.0f);
+            ndcHi = glm::vec2(1.0f);
+            break;
+        }
+        glm::vec2 ndc(p.x / p.w, p.y / p.w);
+        ndcLo = glm::min(ndcLo, ndc);
+        ndcHi = glm::max(ndcHi, ndc);
     }
+    if (ndcLo.x >= 1.0f || ndcLo.y >= 1.0f || ndcHi.x <= -1.0f || ndcHi.y <= -1.0f) return;
+
+    // + 2 pixels: the TAA neighbourhood and the jitter
+    int x0 = std::max((int)floorf((ndcLo.x * 0.5f + 0.5f) * gRenderW) - 2, 0);
+    int y0 = std::max((int)floorf((ndcLo.y * 0.5f + 0.5f) * gRenderH) - 2, 0);
+    int x1 = std::min((int)ceilf((ndcHi.x * 0.5f + 0.5f) * gRenderW) + 2, gRenderW);
+    int y1 = std::min((int)ceilf((ndcHi.y * 0.5f + 0.5f) * gRenderH) + 2, gRenderH);
+    if (x1 <= x0 || y1 <= y0) return;
+    gSteamRect[0] = x0;
+    gSteamRect[1] = y0;
+    gSteamRect[2] = x1 - x0;
+    gSteamRect[3] = y1 - y0;
 }
 
-// ---------------- Shaders ----------------
-static void CreateShaders()
+// steam-only frame: the saved scene goes back over last frame's and this frame's steam
+// rectangles, then the steam is drawn there alone, scissored
+static void DrawSteamOnly(const glm::mat4& viewProj)
 {
-    // main shader
-    ProgramId = LoadShaders("alley.vert", "alley.frag");
-    glUseProgram(ProgramId);
+    gSteamParticles.Finish(gJobs);
+
+    int prev[4] = { gSteamRect[0], gSteamRect[1], gSteamRect[2], gSteamRect[3] };
+    UpdateSteamRect(viewProj);
+    int x0 = gRenderW, y0 = gRenderH, x1 = 0, y1 = 0;
+    const int* rects[2] = { prev, gSteamRect };
+    for (const int* r : rects) {
+        if (r[2] <= 0 || r[3] <= 0) continue;
+        x0 = std::min(x0, r[0]);
+        y0 = std::min(y0, r[1]);
+        x1 = std::max(x1, r[0] + r[2]);
+        y1 = std::max(y1, r[1] + r[3]);
+    }
+    if (x1 <= x0 || y1 <= y0) return;
 
-    myMatrixLocation = glGetUniformLocation(ProgramId, "myMatrix");
-    matrUmbraLocation = glGetUniformLocation(ProgramId, "matrUmbra");
-    viewLocation = glGetUniformLocation(ProgramId, "view");
-    projLocation = glGetUniformLocation(ProgramId, "projection");
+    if (!gPost.RestoreScene(x0, y0, x1 - x0, y1 - y0)) return;    // RenderFunction checks SceneSaved
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x0, y0, x1 - x0, y1 - y0);
+    glEnable(GL_BLEND);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(SteamVaoId);
+    gSteamParticles.Draw();
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+}
 
-    lightPosLocation = glGetUniformLocation(ProgramId, "lightPos");
-    lightColorLocation = glGetUniformLocation(ProgramId, "lightColor");
-    viewPosLocation = glGetUniformLocation(ProgramId, "viewPos");
-    codColLocation = glGetUniformLocation(ProgramId, "codCol");
+void RenderFunction()
+{
+    CPU_ZONE_BEGIN(frameZone, "frame");
 
-    texAsphaltLoc = glGetUniformLocation(ProgramId, "texAsphalt");
-    texWallLoc = glGetUniformLocation(ProgramId, "texWall");
-    texSignLoc = glGetUniformLocation(ProgramId, "texSign");
-    texAsphaltNLoc = glGetUniformLocation(ProgramId, "texAsphaltN");
-    texWallNLoc = glGetUniformLocation(ProgramId, "texWallN");
+    if (gCameraRecord) WriteCameraKey(gCameraRecord, CurrentCameraKey());
 
-    useTexLocation = glGetUniformLocation(ProgramId, "useTextures");
-    useNormalMapLocation = glGetUniformLocation(ProgramId, "useNormalMap");
-    texTilingLocation = glGetUniformLocation(ProgramId, "texTiling");
+    // time
+    float t = SceneTimeSec();
+    if (!gFrameScheduler.onDemand || gHeadless) gPropsTimeSec = t;
 
-    signBlackKeyLocation = glGetUniformLocation(ProgramId, "signBlackKey");
+    // steam only: everything but the steam is the scene saved by the last full frame, with the
+    // same view, render size and jitter; shadows, clusters, fog and streaming are left as they are
+    bool steamOnly = gFrameKind == FRAME_STEAM && gPost.SceneSaved();
 
-    exposureLocation = glGetUniformLocation(ProgramId, "exposure");
-    gammaLocation = glGetUniformLocation(ProgramId, "gammaValue");
-    timeSecLocation = glGetUniformLocation(ProgramId, "timeSec");
+    // model
+    glm::mat4 model(1.0f);
 
-    useFogLocation = glGetUniformLocation(ProgramId, "useFog");
+    // this frame's uniform region (waits only if the GPU is 3 frames behind)
+    gUniformRing.BeginFrame();
+    gGpuProfiler.BeginFrame();
 
-    // shadow mapping uniforms (main) - arrays
-    lightSpaceLocation_Main = glGetUniformLocation(ProgramId, "lightSpace");
-    shadowMapLocation_Main = glGetUniformLocation(ProgramId, "shadowMap");
-    useShadowMapLocation = glGetUniformLocation(ProgramId, "useShadowMap");
+    // dynamic resolution follows the GPU busy time of the frames the profiler read back
+    if (!steamOnly && gGpuProfiler.BusySamples() != gDrsSamples) {
+        gDrsSamples = gGpuProfiler.BusySamples();
+        gDynRes.AddGpuSample(gGpuProfiler.LastBusyMs());
+    }
 
-    // depth-only shader
-    ShadowProgramId = LoadShaders("shadow_depth.vert", "shadow_depth.frag");
-    glUseProgram(ShadowProgramId);
-    myMatrixLocation_Shadow = glGetUniformLocation(ShadowProgramId, "myMatrix");
-    lightSpaceLocation_Shadow = glGetUniformLocation(ShadowProgramId, "lampLightSpace");
+    // GL work queued by jobs since the last frame
+    gJobs.PumpMainThread();
 
-    glUseProgram(0);
-}
+    // cables for this frame, written by jobs while the main thread carries on
+    gProps.Begin(gPropsTimeSec, gJobs);
 
-static void DestroyShaders()
-{
-    if (ProgramId) glDeleteProgram(ProgramId);
-    if (ShadowProgramId) glDeleteProgram(ShadowProgramId);
-    ProgramId = 0;
-    ShadowProgramId = 0;
-}
+    // camera first: shadow priorities, streaming, light clusters and steam sorting use the current view
+    UpdateCameraMatrices();
+    gSteamParticles.Begin(t, view, gJobs);
+
+    // main pass resolution for this frame; with TAA, a sub-pixel jitter on the projection
+    // (the reprojection uses the matrices without it)
+    bool post = gPost.Available();
+    if (!steamOnly) {
+        if (post) gDynRes.RenderSize((int)width, (int)height, gRenderW, gRenderH);
+        else { gRenderW = (int)width; gRenderH = (int)height; }
+    }
+    glm::mat4 viewProj = projection * view;
+    glm::vec2 jitter(0.0f);
+    if (steamOnly) jitter = gSavedJitter;
+    else if (post && gTaa) jitter = TaaJitter(gTaaFrame++);
+    if (post && gTaa) projection = JitterProjection(projection, jitter, gRenderW, gRenderH);
+    gSavedJitter = jitter;
+
+    JobCounter clustersBuilt;
+    if (!steamOnly) {
+        auto frameStart = Clock::now();
+        double lastFrameMs = gFirstFrameDone ? std::chrono::duration<double, std::milli>(frameStart - gLastFrameStart).count() : 0.0;
+        gLastFrameStart = frameStart;
+        gWorld.Update(glm::vec3(obsX, obsY, obsZ), lastFrameMs);
+        StartClusterBuild(clustersBuilt);
+    }
 
-// ---------------- Camera + lighting ----------------
-static void UpdateCameraMatrices()
-{
-    glUseProgram(ProgramId);
+    // per-frame / per-view / per-object blocks are shared by both programs
+    codCol = 0; // normal render
+    PushFrameData(t);
+    PushViewData(gRenderW, gRenderH);
+    PushObjectData(model);
 
-    glm::vec3 ref(refX, refY, refZ);
+    // compute light-space matrices
+    glm::mat4 lightSpace[LIGHT_COUNT];
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        lightSpace[i] = ComputeLightSpace(i);
+    }
 
-    glm::vec3 baseOffset(0.0f, -dist, 0.0f);
-    glm::vec3 offset = camRot * baseOffset;
-    glm::vec3 obs = ref + offset;
+    // cables cast shadows: their vertices must be in before the first pass
+    gProps.Finish(gJobs);
 
-    obsX = obs.x; obsY = obs.y; obsZ = obs.z;
+    // 1) Shadow passes (depth only), time-sliced under the per-frame budget
+    if (gUseShadowMap && !steamOnly) {
+        CPU_ZONE("shadow passes");
+        CollectShadowTimings();
 
-    glm::vec3 up(0, 0, 1);
+        float coverage[LIGHT_COUNT];
+        for (int i = 0; i < LIGHT_COUNT; i++) {
+            coverage[i] = EstimateLightCoverage(lightPos[i]);
+        }
 
-    view = glm::lookAt(obs, ref, up);
-    glUniformMatrix4fv(viewLocation, 1, GL_FALSE, glm::value_ptr(view));
+        int order[LIGHT_COUNT];
+        int updates = gShadowScheduler.Plan(lightSpace, lightPos, coverage, gRanges.shadowCastersCount / 3, order);
+
+        if (updates > 0) {
+            BeginShadowPasses();
+            for (int k = 0; k < updates; k++) {
+                int li = order[k];
+                RenderShadowPass(lightSpace[li], li);
+                gShadowScheduler.MarkRendered(li, lightSpace[li], lightPos[li]);
+            }
+            EndShadowPasses();
+        }
+    }
 
-    projection = glm::perspective(fov, width / height, dNear, 100.0f);
-    glUniformMatrix4fv(projLocation, 1, GL_FALSE, glm::value_ptr(projection));
+    // stale maps are sampled with the matrix they were rendered with
+    if (gUseShadowMap) {
+        for (int i = 0; i < LIGHT_COUNT; i++) {
+            lightSpace[i] = gShadowScheduler.RenderedMatrix(i);
+        }
+    }
 
-    glUniform3f(viewPosLocation, obsX, obsY, obsZ);
+    PushLightData(lightSpace);
 
-    glUniform3fv(lightPosLocation, LIGHT_COUNT, glm::value_ptr(lightPos[0]));
-    glUniform3fv(lightColorLocation, LIGHT_COUNT, glm::value_ptr(lightColor[0]));
-}
+    // bind shadow maps to units 7,8,9 (depth for PCF, prefiltered moments for VSM/EVSM)
+    bool moments = gShadowFilter != SHADOW_FILTER_PCF && ShadowMomentTex[0];
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        glActiveTexture(GL_TEXTURE0 + SHADOW_TEX_UNIT_BASE + i);
+        glBindTexture(GL_TEXTURE_2D, moments ? ShadowMomentTex[i] : ShadowDepthTex[i]);
+    }
 
-// legacy planar shadow matrix (kept)
-static void UpdatePlanarShadowMatrix(float D)
-{
+    // clustered light buffers
+    if (!steamOnly) FinishClusterBuild(clustersBuilt);
+    gClusters.Bind(CLUSTER_TEX_UNIT_BASE);
+
+    // 2) Fog volume: lights + shadows scattered into the froxel grid, integrated front to back
+    //    (steam is lit from it even with fog off)
+    if (FogScatterProgramId) {
+        glUseProgram(FogScatterProgramId);
+        glUniform1i(glGetUniformLocation(FogScatterProgramId, "useShadowMaps"), gUseShadowMap);
+        glUniform1i(glGetUniformLocation(FogScatterProgramId, "shadowFilter"), moments ? gShadowFilter : SHADOW_FILTER_PCF);
+    }
+    CPU_ZONE_BEGIN(fogZone, "fog volume");
+    if (steamOnly) gFog.Bind(FOG_TEX_UNIT_BASE);
+    else {
+        gGpuProfiler.Begin("fog volume");
+        gFog.Render(FogScatterProgramId, FogIntegrateProgramId, glm::inverse(view), FOG_TEX_UNIT_BASE);
+        gGpuProfiler.End();
+    }
+    CPU_ZONE_END(fogZone);
+
+    // 3) Main pass, into the HDR target (lower left gRenderW x gRenderH of it)
+    CPU_ZONE_BEGIN(mainZone, steamOnly ? "steam redraw" : "main pass");
+    gGpuProfiler.Begin(steamOnly ? "steam redraw" : "main pass");
+    glViewport(0, 0, (GLsizei)gRenderW, (GLsizei)gRenderH);
+    gPost.BeginScene(gRenderW, gRenderH);
+    if (!steamOnly) glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // pick the specialized program for the current toggles
+    gMainFeatures = CurrentShaderFeatures();
+    ProgramId = gMainShaders.Get(gMainFeatures);
     glUseProgram(ProgramId);
 
-    float xL = lightPos[0].x;
-    float yL = lightPos[0].y;
-    float zL = lightPos[0].z;
+    // material arrays + table (streams pending texture data under the per-frame budget)
+    gMaterials.Update();
+    gMaterials.Bind(MATERIAL_TEX_UNIT_BASE);
 
-    matrUmbra[0][0] = zL + D;  matrUmbra[0][1] = 0;       matrUmbra[0][2] = 0;       matrUmbra[0][3] = 0;
-    matrUmbra[1][0] = 0;       matrUmbra[1][1] = zL + D;  matrUmbra[1][2] = 0;       matrUmbra[1][3] = 0;
-    matrUmbra[2][0] = -xL;     matrUmbra[2][1] = -yL;     matrUmbra[2][2] = D;       matrUmbra[2][3] = -1;
-    matrUmbra[3][0] = -D * xL; matrUmbra[3][1] = -D * yL; matrUmbra[3][2] = -D * zL; matrUmbra[3][3] = zL;
+    glActiveTexture(GL_TEXTURE0 + NOISE_TEX_UNIT);
+    glBindTexture(GL_TEXTURE_3D, SteamNoiseTexId);
+    glActiveTexture(GL_TEXTURE0);
 
-    glUniformMatrix4fv(matrUmbraLocation, 1, GL_FALSE, &matrUmbra[0][0]);
+    if (steamOnly) DrawSteamOnly(projection * view);
+    else {
+        DrawMainPass();
+        UpdateSteamRect(projection * view);
+    }
+    gGpuProfiler.End();
+    CPU_ZONE_END(mainZone);
+
+    // 4) Post: TAA (upsampling to the window size), bloom chain, tone map + gamma into the window
+    PostFrame pf;
+    pf.renderW = gRenderW;
+    pf.renderH = gRenderH;
+    pf.taa = gTaa;
+    pf.jitter = jitter;
+    pf.invViewProj = glm::inverse(viewProj);
+    pf.prevViewProj = gHavePrevViewProj ? gPrevViewProj : viewProj;
+    CPU_ZONE_BEGIN(postZone, "post");
+    gGpuProfiler.Begin("post");
+    gPost.Run(gPostPrograms, pf);
+    gGpuProfiler.End();
+    CPU_ZONE_END(postZone);
+    gPrevViewProj = viewProj;
+    gHavePrevViewProj = true;
+
+    gGpuProfiler.EndFrame();
+    if (gGpuProfiler.overlay) gGpuProfiler.DrawOverlay((int)width, (int)height);
+    gUniformRing.EndFrame();
+    gProps.EndFrame();
+    gSteamParticles.EndFrame();
+
+    CPU_ZONE_BEGIN(swapZone, "swap");
+    if (!gHeadless) glutSwapBuffers();
+    glFlush();
+    CPU_ZONE_END(swapZone);
+
+    CPU_COUNTER("lights", gLights.size());
+    CPU_COUNTER("render scale", gDynRes.Scale());
+    CPU_ZONE_END(frameZone);
+
+    if (!gFirstFrameDone) {
+        // glFinish only once: the number should include the GPU work of the first frame
+        glFinish();
+        gFirstFrameDone = true;
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - gStartTime).count();
+        printf("Time to first frame: %.1f ms (scene %s: %.1f ms)\n", ms,
+            gPack.IsOpen() ? "from pack" : "built", gSceneSetupMs);
+        if (gExitAfterFirstFrame) {
+            if (CpuProfilerCapturing()) CpuProfilerWriteTrace(CPU_TRACE_PATH);
+            exit(0);
+        }
+    }
 }
 
-// compute light-space matrix for shadow map (2D) for a given light index
-static glm::mat4 ComputeLightSpace(int li)
+// ---------------- Frame scheduling ----------------
+static FrameKind NextFrameKind()
 {
-    // Stable "directional-ish" shadow: look from light position to a fixed target
-    glm::vec3 target(0.0f, 0.0f, 1.6f);
-
-    glm::vec3 up(0, 0, 1);
-    glm::vec3 L = lightPos[li];
+    bool animating = !gAnimPaused && !gSteam.empty();
+    bool busy = !gMaterials.Resident() || gWorld.Busy();
+    FrameKind kind = gFrameScheduler.Next(animating, busy);
+    // no saved scene (post not available, or none yet): steam cannot be redrawn on its own
+    if (kind == FRAME_STEAM && !gPost.SceneSaved()) kind = FRAME_FULL;
+    return kind;
+}
 
-    if (fabs(glm::dot(glm::normalize(target - L), up)) > 0.98f) {
-        up = glm::vec3(0, 1, 0);
+// GLUT display callback: the frame the scheduler asks for (see frame_scheduler.hpp)
+static void DisplayFunction()
+{
+    FrameKind kind = NextFrameKind();
+    if (kind == FRAME_NONE) {
+        // expose: nothing changed, the window only needs the picture again
+        gFrameScheduler.Invalidate(FRAME_DIRTY_EXPOSE);
+        kind = gPost.SceneSaved() ? FRAME_STEAM : FRAME_FULL;
     }
 
-    glm::mat4 lightView = glm::lookAt(L, target, up);
-
-    // orthographic volume (tune if needed)
-    float orthoHalfX = 4.0f;
-    float orthoHalfY = 7.0f;
-    float nearZ = 0.1f;
-    float farZ = 25.0f;
-
-    glm::mat4 lightProj = glm::ortho(-orthoHalfX, orthoHalfX, -orthoHalfY, orthoHalfY, nearZ, farZ);
-    return lightProj * lightView;
+    gFrameKind = kind;
+    gSaveScene = gFrameScheduler.onDemand && kind == FRAME_FULL;
+    auto t0 = Clock::now();
+    RenderFunction();
+    gFrameScheduler.EndFrame(kind, std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+    gFrameKind = FRAME_FULL;
+    gSaveScene = false;
 }
 
-// ---------------- Init / Render ----------------
-void Initialize()
+static void IdleFunction()
 {
-    glClearColor(0.02f, 0.02f, 0.03f, 1.0f);
-    glEnable(GL_DEPTH_TEST);
+    if (NextFrameKind() != FRAME_NONE) DisplayFunction();
+    else glutIdleFunc(nullptr);     // static scene: glutMainLoop sleeps until the next event
+}
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+// Sweeps the light count and reports frame time (glFinish'ed, so disable vsync for real numbers)
+// together with the CPU cluster build time and the worst froxel list length.
+static void BenchmarkLightCounts()
+{
+    static const int counts[] = { 3, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+    const int warmup = 5;
+    const int frames = 40;
+
+    int savedNeon = gNeonLightCount;
+
+    printf("\n  lights | frame ms | cluster build ms | indices | max/froxel\n");
+    for (int c : counts) {
+        GenerateNeonLights(c - LIGHT_COUNT);
+
+        for (int f = 0; f < warmup; f++) { RenderFunction(); glFinish(); }
+
+        double frameMs = 0.0, buildMs = 0.0;
+        for (int f = 0; f < frames; f++) {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            RenderFunction();
+            glFinish();
+            auto t1 = std::chrono::high_resolution_clock::now();
+            frameMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+            buildMs += gClusters.LastBuildMs();
+        }
 
-    CreateShaders();
-    CreateShadowMaps();
-    CreateSceneVBO();
+        printf("  %6d | %8.3f | %16.3f | %7zu | %d\n", c, frameMs / frames, buildMs / frames,
+            gClusters.IndexCount(), gClusters.MaxLightsInCluster());
+    }
 
-    texAsphalt = LoadTexture2D_SOIL("asphalt.jpg");
-    texWall = LoadTexture2D_SOIL("wall.jpg");
-    texSign = LoadTexture2D_SOIL("sign3.png");
+    GenerateNeonLights(savedNeon);
+}
 
-    texAsphaltN = LoadTexture2D_SOIL("asphalt_n.jpg");
-    texWallN = LoadTexture2D_SOIL("wall_n.jpg");
+// Vertex stage cost in isolation: the whole scene is drawn with rasterization disabled,
+// once with the old alley.vert path (per-vertex inverse + light-space outputs) and once
+// with the current one. vertex_bench.frag consumes all varyings so nothing is optimized out.
+static void BenchmarkVertexThroughput()
+{
+    const int warmup = 5;
+    const int frames = 40;
+    const int drawsPerFrame = 20;
 
-    glUseProgram(ProgramId);
+    char common[64];
+    snprintf(common, sizeof(common), "#define SHADOW_LIGHT_COUNT %d\n", LIGHT_COUNT);
 
-    glUniform1i(texAsphaltLoc, 0);
-    glUniform1i(texWallLoc, 1);
-    glUniform1i(texSignLoc, 2);
-    glUniform1i(texAsphaltNLoc, 3);
-    glUniform1i(texWallNLoc, 4);
-
-    // shadow map sampler array -> texture units 5,6,7
-    GLint shadowUnits[LIGHT_COUNT] = {
-        SHADOW_TEX_UNIT_BASE + 0,
-        SHADOW_TEX_UNIT_BASE + 1,
-        SHADOW_TEX_UNIT_BASE + 2
+    struct { const char* name; std::string defines; } paths[] = {
+        { "old (per-vertex inverse, 3x light space)", std::string(common) + "#define LEGACY_VERTEX_PATH\n" },
+        { "current (CPU normal matrix, N + T.w)", std::string(common) }
     };
-    glUniform1iv(shadowMapLocation_Main, LIGHT_COUNT, shadowUnits);
 
-    glUniform1i(useTexLocation, 1);
-    glUniform1i(useNormalMapLocation, 1);
+    GLuint query = 0;
+    glGenQueries(1, &query);
 
-    glUniform3f(texTilingLocation, 1.0f, 1.0f, 1.0f);
-    glUniform1i(signBlackKeyLocation, 0);
-
-    glUniform1f(exposureLocation, 1.15f);
-    glUniform1f(gammaLocation, 2.2f);
-    glUniform1f(timeSecLocation, 0.0f);
+    // matrices for the blocks the vertex shader reads
+    gUniformRing.BeginFrame();
+    UpdateCameraMatrices();
+    PushViewData((int)width, (int)height);
+    PushObjectData(glm::mat4(1.0f));
+    glm::mat4 lightSpace[LIGHT_COUNT];
+    for (int i = 0; i < LIGHT_COUNT; i++) lightSpace[i] = ComputeLightSpace(i);
+    PushLightData(lightSpace);
 
-    glUniform1i(useFogLocation, gUseFog);
-    glUniform1i(useShadowMapLocation, gUseShadowMap);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(SceneVaoId);
 
-    glUseProgram(0);
-}
+    GLsizei vertexCount = gIndexCount; // indexed: counts every index, post-transform cache hits included
+    printf("\nVertex throughput (%d indices x %d draws, rasterizer discard)\n", vertexCount, drawsPerFrame);
 
-static void RenderShadowPass(const glm::mat4& model, const glm::mat4& lightSpace, int li)
-{
-    glViewport(0, 0, SHADOW_RES, SHADOW_RES);
-    glBindFramebuffer(GL_FRAMEBUFFER, ShadowFBO[li]);
-    glClear(GL_DEPTH_BUFFER_BIT);
+    for (const auto& path : paths) {
+        GLuint prog = LoadProgramCached("alley.vert", "vertex_bench.frag", path.defines);
+        if (!prog) continue;
+        BindUniformBlocks(prog);
+        glUseProgram(prog);
 
-    // reduce peter-panning via polygon offset in shadow pass
-    glEnable(GL_POLYGON_OFFSET_FILL);
-    glPolygonOffset(2.0f, 4.0f);
+        double gpuMs = 0.0;
+        for (int f = 0; f < warmup + frames; f++) {
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            for (int d = 0; d < drawsPerFrame; d++) DrawSceneRange(0, vertexCount);
+            glEndQuery(GL_TIME_ELAPSED);
 
-    glUseProgram(ShadowProgramId);
-    glUniformMatrix4fv(myMatrixLocation_Shadow, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(lightSpaceLocation_Shadow, 1, GL_FALSE, glm::value_ptr(lightSpace));
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns); // blocking is fine here
+            if (f >= warmup) gpuMs += (double)ns * 1e-6;
+        }
 
-    glBindVertexArray(SceneVaoId);
+        double msPerDraw = gpuMs / (frames * drawsPerFrame);
+        double mvps = msPerDraw > 0.0 ? (double)vertexCount / (msPerDraw * 1e3) : 0.0;
+        printf("  %-42s %8.4f ms/draw  %8.1f Mverts/s\n", path.name, msPerDraw, mvps);
 
-    // Draw ONLY shadow casters (exclude steam)
-    glDrawArrays(GL_TRIANGLES, castersFirst, shadowCastersCount);
+        glUseProgram(0);
+        glDeleteProgram(prog);
+    }
 
     glBindVertexArray(0);
-    glUseProgram(0);
-
-    glDisable(GL_POLYGON_OFFSET_FILL);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    gUniformRing.EndFrame();
+    glDeleteQueries(1, &query);
 }
 
-void RenderFunction()
+// Steam fill rate: a stack of screen-filling steam sprites in front of the camera, drawn back to
+// front with blending like the transparent pass, once with the old per-fragment hash noise
+// (LEGACY_STEAM_NOISE) and once with the noise volume. Same program variant as the current toggles.
+static void BenchmarkSteamFill()
 {
-    // time
-    float t = 0.001f * (float)glutGet(GLUT_ELAPSED_TIME);
+    const int warmup = 5;
+    const int frames = 30;
+    const int layers = 48;
 
-    // model
-    glm::mat4 model(1.0f);
+    UpdateCameraMatrices();
+    glm::vec3 eye(obsX, obsY, obsZ);
+    glm::vec3 right(view[0][0], view[1][0], view[2][0]);
+    glm::vec3 up(view[0][1], view[1][1], view[2][1]);
+    glm::vec3 fwd(-view[0][2], -view[1][2], -view[2][2]);
+
+    // layer l sits between 3 m and 1 m, a little larger than the view there
+    std::vector<ParticleVtx> quads;
+    static const float corners[6][2] = { {0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1} };
+    for (int l = 0; l < layers; l++) {
+        float d = 3.0f - 2.0f * (float)l / (float)layers;
+        float hw = 1.05f * d / projection[0][0];
+        float hh = 1.05f * d / projection[1][1];
+        glm::vec3 c = eye + fwd * d;
+        for (const auto& k : corners) {
+            ParticleVtx v;
+            v.pos = c + right * ((k[0] * 2.0f - 1.0f) * hw) + up * ((k[1] * 2.0f - 1.0f) * hh);
+            v.col = glm::vec2(1.0f, (float)l * 0.137f);
+            v.uv = glm::vec2(k[0], k[1]);
+            quads.push_back(v);
+        }
+    }
 
-    // compute light-space matrices
+    GLuint vbo = 0, vao = 0, query = 0;
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, quads.size() * sizeof(ParticleVtx), quads.data(), GL_STATIC_DRAW);
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleVtx), (GLvoid*)offsetof(ParticleVtx, pos));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleVtx), (GLvoid*)offsetof(ParticleVtx, col));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleVtx), (GLvoid*)offsetof(ParticleVtx, uv));
+    glVertexAttrib3f(2, 0.0f, 0.0f, 1.0f);
+    glVertexAttrib1f(4, (float)SCENE_MAT_STEAM);
+    glVertexAttrib4f(5, 1.0f, 0.0f, 0.0f, 1.0f);
+    glGenQueries(1, &query);
+
+    // blocks + textures the steam branch reads
+    gUniformRing.BeginFrame();
+    PushFrameData(SceneTimeSec());
+    PushViewData((int)width, (int)height);
+    PushObjectData(glm::mat4(1.0f));
     glm::mat4 lightSpace[LIGHT_COUNT];
-    for (int i = 0; i < LIGHT_COUNT; i++) {
-        lightSpace[i] = ComputeLightSpace(i);
+    for (int i = 0; i < LIGHT_COUNT; i++) lightSpace[i] = ComputeLightSpace(i);
+    PushLightData(lightSpace);
+    gMaterials.Bind(MATERIAL_TEX_UNIT_BASE);
+    gClusters.Bind(CLUSTER_TEX_UNIT_BASE);
+    gFog.Bind(FOG_TEX_UNIT_BASE);
+    glActiveTexture(GL_TEXTURE0 + NOISE_TEX_UNIT);
+    glBindTexture(GL_TEXTURE_3D, SteamNoiseTexId);
+    glActiveTexture(GL_TEXTURE0);
+
+    char common[128];
+    snprintf(common, sizeof(common), "#define SHADOW_LIGHT_COUNT %d\n#define MATERIAL_ARRAY_GROUPS %d\n",
+        LIGHT_COUNT, MATERIAL_ARRAY_GROUPS);
+    std::string features;
+    unsigned int mask = CurrentShaderFeatures();
+    for (size_t i = 0; i < MAIN_SHADER_DEFINES.size(); i++) {
+        if (mask & (1u << i)) features += std::string("#define ") + MAIN_SHADER_DEFINES[i] + "\n";
     }
 
-    // 1) Shadow passes (depth only)
-    if (gUseShadowMap) {
-        for (int i = 0; i < LIGHT_COUNT; i++) {
-            RenderShadowPass(model, lightSpace[i], i);
+    struct { const char* name; std::string defines; } paths[] = {
+        { "hash noise (per fragment)", std::string(common) + features + "#define LEGACY_STEAM_NOISE\n" },
+        { "3D noise volume (2 fetches)", std::string(common) + features }
+    };
+
+    double pixels = (double)width * height * layers;
+    printf("\nSteam fill rate (%d screen-filling layers, %.0fx%.0f)\n", layers, width, height);
+
+    glViewport(0, 0, (GLsizei)width, (GLsizei)height);
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+
+    double firstMs = 0.0;
+    for (const auto& path : paths) {
+        GLuint prog = LoadProgramCached("alley.vert", "alley.frag", path.defines);
+        if (!prog) continue;
+        SetupMainProgram(prog);
+        glUseProgram(prog);
+
+        double gpuMs = 0.0;
+        for (int f = 0; f < warmup + frames; f++) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            glDrawArrays(GL_TRIANGLES, 0, (GLsizei)quads.size());
+            glEndQuery(GL_TIME_ELAPSED);
+
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns); // blocking is fine here
+            if (f >= warmup) gpuMs += (double)ns * 1e-6;
         }
+
+        double ms = gpuMs / frames;
+        if (firstMs == 0.0) firstMs = ms;
+        printf("  %-30s %8.3f ms  %8.1f Mpix/s  x%.2f\n", path.name, ms,
+            ms > 0.0 ? pixels / (ms * 1e3) : 0.0, ms > 0.0 ? firstMs / ms : 0.0);
+
+        glUseProgram(0);
+        glDeleteProgram(prog);
     }
 
-    // 2) Main pass
-    glViewport(0, 0, (GLsizei)width, (GLsizei)height);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_BLEND);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gUniformRing.EndFrame();
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    glDeleteQueries(1, &query);
+}
 
-    glUseProgram(ProgramId);
+// Job system cost and scaling, each row on a fresh JobSystem with that many workers (the
+// waiting main thread helps too): empty jobs give the spawn + run + wait overhead, the cluster
+// build at MAX_LIGHTS is the real per-frame workload.
+static void BenchmarkJobs()
+{
+    const int emptyJobs = 100000;
+    const int builds = 20;
 
-    glUniform1f(timeSecLocation, t);
+    int hw = (int)std::thread::hardware_concurrency();
+    if (hw < 1) hw = 1;
 
+    int savedNeon = gNeonLightCount;
+    GenerateNeonLights(MAX_LIGHTS - LIGHT_COUNT);
     UpdateCameraMatrices();
+    JobCounter fill;
+    StartClusterBuild(fill); // also fills gLights
+    gJobs.Wait(fill);
 
-    // bind textures
-    glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_2D, texAsphalt);
-    glActiveTexture(GL_TEXTURE1); glBindTexture(GL_TEXTURE_2D, texWall);
-    glActiveTexture(GL_TEXTURE2); glBindTexture(GL_TEXTURE_2D, texSign);
-    glActiveTexture(GL_TEXTURE3); glBindTexture(GL_TEXTURE_2D, texAsphaltN);
-    glActiveTexture(GL_TEXTURE4); glBindTexture(GL_TEXTURE_2D, texWallN);
+    auto buildMs = [&](JobSystem* js)
+        {
+            auto t0 = Clock::now();
+            for (int k = 0; k < builds; k++) {
+                gClusters.Build(gLights, view, projection[0][0], projection[1][1], dNear, dFar, js);
+            }
+            return std::chrono::duration<double, std::milli>(Clock::now() - t0).count() / builds;
+        };
 
-    // bind shadow maps to units 5,6,7
-    glActiveTexture(GL_TEXTURE5); glBindTexture(GL_TEXTURE_2D, ShadowDepthTex[0]);
-    glActiveTexture(GL_TEXTURE6); glBindTexture(GL_TEXTURE_2D, ShadowDepthTex[1]);
-    glActiveTexture(GL_TEXTURE7); glBindTexture(GL_TEXTURE_2D, ShadowDepthTex[2]);
+    double serialMs = buildMs(nullptr);
+    printf("\nJob system (%d hardware threads), cluster build of %zu lights: %.3f ms serial\n",
+        hw, gLights.size(), serialMs);
+    printf("  workers | ns/empty job | cluster build ms | speedup\n");
 
-    glUniformMatrix4fv(myMatrixLocation, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(lightSpaceLocation_Main, LIGHT_COUNT, GL_FALSE, glm::value_ptr(lightSpace[0]));
-    glUniform1i(useShadowMapLocation, gUseShadowMap);
+    for (int w = 1; ; w = w * 2 < hw ? w * 2 : hw) {
+        JobSystem js;
+        js.Init(w);
 
-    // normal render (codCol = 0)
-    codCol = 0;
-    glUniform1i(codColLocation, codCol);
+        auto t0 = Clock::now();
+        JobCounter done;
+        for (int i = 0; i < emptyJobs; i++) js.Spawn("empty", [] {}, &done);
+        js.Wait(done);
+        double nsPerJob = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / emptyJobs;
 
-    glBindVertexArray(SceneVaoId);
-    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)gVertices.size());
-    glBindVertexArray(0);
+        double ms = buildMs(&js);
+        printf("  %7d | %12.1f | %16.3f | %6.2fx\n", w, nsPerJob, ms, ms > 0.0 ? serialMs / ms : 0.0);
 
-    glutSwapBuffers();
-    glFlush();
+        js.Shutdown();
+        if (w >= hw) break;
+    }
+
+    GenerateNeonLights(savedNeon);
+}
+
+// ---------------- Headless benchmark ----------------
+// RGBA8 color the tone map writes instead of the window (depth lives in the HDR target)
+static bool CreateOffscreenTarget(int w, int h)
+{
+    glGenTextures(1, &gOffscreenColor);
+    glBindTexture(GL_TEXTURE_2D, gOffscreenColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &gOffscreenFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, gOffscreenFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gOffscreenColor, 0);
+    // without the HDR target the main pass renders here directly and needs a depth buffer
+    GLuint depth = 0;
+    if (!gPost.Available()) {
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    }
+    bool ok = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (depth) glDeleteRenderbuffers(1, &depth);   // stays alive while attached
+    if (!ok) {
+        printf("Headless: offscreen framebuffer incomplete\n");
+        return false;
+    }
+    gPost.output = gOffscreenFbo;
+    return true;
+}
+
+// binary PPM, top row first; lossless and readable by every image diff tool
+static bool DumpFrame(const char* dir, int frame, int w, int h)
+{
+    std::vector<unsigned char> pixels((size_t)w * h * 3);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, gOffscreenFbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/frame_%05d.ppm", dir, frame);
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        printf("Nu am putut scrie: %s\n", path);
+        return false;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", w, h);
+    for (int y = h - 1; y >= 0; y--) fwrite(&pixels[(size_t)y * w * 3], 1, (size_t)w * 3, f);
+    fclose(f);
+    return true;
+}
+
+static const int HEADLESS_WARMUP_FRAMES = 10;          // on the first key, not measured
+static const int HEADLESS_MAX_SETTLE_FRAMES = 10000;   // waiting for streaming before them
+
+struct HeadlessOptions {
+    int frames = 600;
+    const char* cameraPath = nullptr;   // null: ScriptedCameraKey
+    const char* dumpDir = nullptr;
+    int dumpEvery = 60;
+};
+
+static double Percentile(std::vector<double> v, double p)
+{
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t)(p * (double)(v.size() - 1) + 0.5);
+    return v[std::min(i, v.size() - 1)];
+}
+
+// Flies the camera path for opts.frames frames into the offscreen target and reports CPU time
+// (RenderFunction, submission only) and GPU time (timestamps around it) per frame.
+// Nothing that is drawn may follow this machine's speed, so frame n shows the same image on
+// every run and machine and the dumps can be diffed between builds:
+//  - the animations run on a fixed 60 Hz clock and dynamic resolution is off
+//  - the steam has no CPU budget: the particle count stays at the target
+//  - textures and the cells around the first camera key are all in before the first frame, and
+//    a cell the path reaches later is built in the frame that starts it (its build time shows
+//    up in that frame's CPU time)
+//  - TAA history and jitter start over after those streaming frames
+static int RunHeadless(const HeadlessOptions& opts)
+{
+    std::vector<CameraKey> recorded;
+    if (opts.cameraPath && !LoadCameraPath(opts.cameraPath, recorded)) return 1;
+    int frames = std::max(opts.frames, 1);
+    int warmup = HEADLESS_WARMUP_FRAMES;
+    auto cameraKey = [&](int n) { return recorded.empty() ? ScriptedCameraKey(n) : recorded[n % recorded.size()]; };
+
+    gDynRes.enabled = false;
+    gSteamParticles.SetBudgetMs(0.0f);
+    gWorld.SetWaitForBuilds(true);
+
+    // frames on the first key until everything has streamed in
+    gFixedTimeSec = 0.0;
+    ApplyCameraKey(cameraKey(0));
+    int settle = 0;
+    while ((!gMaterials.Resident() || gWorld.Busy()) && settle < HEADLESS_MAX_SETTLE_FRAMES) {
+        RenderFunction();
+        glFinish();
+        settle++;
+    }
+    if (!gMaterials.Resident() || gWorld.Busy()) {
+        printf("Headless: streaming not finished after %d frames, frames may differ between runs\n", settle);
+    }
+    gPost.ResetHistory();
+    gTaaFrame = 0;
+    gHavePrevViewProj = false;
+
+    GLint timerBits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &timerBits);
+    std::vector<GLuint> queries;
+    if (timerBits > 0) {
+        queries.resize((size_t)frames * 2);
+        glGenQueries((GLsizei)queries.size(), queries.data());
+    }
+
+    printf("\nHeadless: %d frames (+%d warm-up, %d streaming) at %dx%d, camera %s%s%s\n", frames, warmup, settle,
+        (int)width, (int)height, opts.cameraPath ? opts.cameraPath : "scripted",
+        opts.dumpDir ? ", frames to " : "", opts.dumpDir ? opts.dumpDir : "");
+
+    std::vector<double> cpuMs;
+    cpuMs.reserve(frames);
+    int dumped = 0;
+    Clock::time_point runStart;
+    for (int i = -warmup; i < frames; i++) {
+        if (i == 0) {
+            glFinish();
+            runStart = Clock::now();
+        }
+        int n = std::max(i, 0);
+        gFixedTimeSec = (double)n / 60.0;
+        ApplyCameraKey(cameraKey(n));
+
+        bool measured = i >= 0;
+        if (measured && timerBits > 0) glQueryCounter(queries[(size_t)i * 2], GL_TIMESTAMP);
+        auto t0 = Clock::now();
+        RenderFunction();
+        if (measured) cpuMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+        if (measured && timerBits > 0) glQueryCounter(queries[(size_t)i * 2 + 1], GL_TIMESTAMP);
+
+        // the readback stalls the pipeline: the frame after a dump runs a little slow
+        if (measured && opts.dumpDir && (i % std::max(opts.dumpEvery, 1) == 0 || i == frames - 1)) {
+            if (DumpFrame(opts.dumpDir, i, (int)width, (int)height)) dumped++;
+        }
+    }
+    glFinish();
+    double wallMs = std::chrono::duration<double, std::milli>(Clock::now() - runStart).count();
+    gFixedTimeSec = -1.0;
+
+    std::vector<double> gpuMs;
+    if (timerBits > 0) {
+        gpuMs.reserve(frames);
+        for (int i = 0; i < frames; i++) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(queries[(size_t)i * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(queries[(size_t)i * 2 + 1], GL_QUERY_RESULT, &end);
+            gpuMs.push_back(end > begin ? (double)(end - begin) / 1.0e6 : 0.0);
+        }
+        glDeleteQueries((GLsizei)queries.size(), queries.data());
+    }
+
+    auto average = [](const std::vector<double>& v)
+        {
+            double sum = 0.0;
+            for (double x : v) sum += x;
+            return v.empty() ? 0.0 : sum / (double)v.size();
+        };
+    auto row = [&](const char* name, const std::vector<double>& v)
+        {
+            if (v.empty()) {
+                printf("  %-3s |      n/a |      n/a |      n/a |      n/a\n", name);
+                return;
+            }
+            printf("  %-3s | %8.3f | %8.3f | %8.3f | %8.3f\n", name,
+                average(v), Percentile(v, 0.50), Percentile(v, 0.95), Percentile(v, 0.99));
+        };
+
+    double fps = wallMs > 0.0 ? 1000.0 * frames / wallMs : 0.0;
+    double mpix = fps * (double)width * (double)height / 1.0e6;
+    printf("        |  avg ms  |  p50 ms  |  p95 ms  |  p99 ms\n");
+    row("cpu", cpuMs);
+    row("gpu", gpuMs);
+    printf("  throughput: %.1f frames/s, %.1f Mpixel/s (%.1f ms wall for %d frames)\n", fps, mpix, wallMs, frames);
+    if (opts.dumpDir) printf("  %d frames written to %s\n", dumped, opts.dumpDir);
+
+    // one line for scripts
+    printf("RESULT frames=%d width=%d height=%d cpu_avg=%.3f cpu_p50=%.3f cpu_p95=%.3f cpu_p99=%.3f",
+        frames, (int)width, (int)height, average(cpuMs), Percentile(cpuMs, 0.50), Percentile(cpuMs, 0.95), Percentile(cpuMs, 0.99));
+    if (!gpuMs.empty()) {
+        printf(" gpu_avg=%.3f gpu_p50=%.3f gpu_p95=%.3f gpu_p99=%.3f",
+            average(gpuMs), Percentile(gpuMs, 0.50), Percentile(gpuMs, 0.95), Percentile(gpuMs, 0.99));
+    }
+    printf(" fps=%.2f mpix_s=%.2f\n", fps, mpix);
+    return 0;
 }
 
 void Cleanup()
 {
-    if (texAsphalt) glDeleteTextures(1, &texAsphalt);
-    if (texWall) glDeleteTextures(1, &texWall);
-    if (texSign) glDeleteTextures(1, &texSign);
-    if (texAsphaltN) glDeleteTextures(1, &texAsphaltN);
-    if (texWallN) glDeleteTextures(1, &texWallN);
+    if (CpuProfilerCapturing()) {
+        CpuProfilerStop();
+        CpuProfilerWriteTrace(CPU_TRACE_PATH);
+    }
+    gMaterials.Destroy();
+    gJobs.Shutdown();
+
+    glDeleteQueries(LIGHT_COUNT, ShadowTimeQuery);
+    glDeleteQueries(MAIN_QUERY_COUNT, MainTimeQuery);
+    glDeleteQueries(MAIN_QUERY_COUNT * SCENE_PASS_COUNT, &MainSampleQuery[0][0]);
+    gClusters.Destroy();
+    gFog.Destroy();
+    gPost.Destroy();
+    gGpuProfiler.Destroy();
+    gUniformRing.Destroy();
+    if (gOffscreenFbo) glDeleteFramebuffers(1, &gOffscreenFbo);
+    if (gOffscreenColor) glDeleteTextures(1, &gOffscreenColor);
+    gOffscreenFbo = gOffscreenColor = 0;
+    if (gCameraRecord) fclose(gCameraRecord);
+    gCameraRecord = nullptr;
 
     DestroyShadowMaps();
     DestroyShaders();
+    if (SteamNoiseTexId) glDeleteTextures(1, &SteamNoiseTexId);
+    SteamNoiseTexId = 0;
     DestroyScene();
+
+    // last: streaming textures, cached images and program binaries point into the mapping
+    gImages.Purge();
+    gMeshes.Purge();
+    ShaderCache_SetBlobSource(nullptr);
+    gPack.Close();
 }
 
 int main(int argc, char* argv[])
 {
+    gStartTime = Clock::now();
+
+    CpuProfilerThreadName("main");
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cpu-trace") == 0) CpuProfilerStart();
+    }
+    HeadlessOptions headless;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-pack") == 0) gUsePack = 0;
+        if (strcmp(argv[i], "--ttff") == 0) gExitAfterFirstFrame = 1;
+        bool more = i + 1 < argc;
+        if (strcmp(argv[i], "--headless") == 0 && more) {
+            gHeadless = true;
+            headless.frames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--camera-path") == 0 && more) headless.cameraPath = argv[++i];
+        else if (strcmp(argv[i], "--dump") == 0 && more) headless.dumpDir = argv[++i];
+        else if (strcmp(argv[i], "--dump-every") == 0 && more) headless.dumpEvery = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--size") == 0 && more) {
+            int w = 0, h = 0;
+            if (sscanf(argv[++i], "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+                width = (float)w;
+                height = (float)h;
+            }
+        }
+    }
+
+    if (gHeadless) {
+        // no window and no GLUT: EGL context, everything ends in an FBO
+        HeadlessContext context;
+        if (!context.Create()) return 1;
+        glewExperimental = GL_TRUE;
+        GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+        // GLEW built for GLX: the entry points load fine, only the GLX query fails
+        if (err == GLEW_ERROR_NO_GLX_DISPLAY) err = GLEW_OK;
+#endif
+        if (err != GLEW_OK) {
+            printf("Headless: glewInit failed: %s\n", (const char*)glewGetErrorString(err));
+            context.Destroy();
+            return 1;
+        }
+        printf("Headless: %s, OpenGL %s\n", (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+
+        Initialize();
+        int rc = CreateOffscreenTarget((int)width, (int)height) ? RunHeadless(headless) : 1;
+        Cleanup();
+        context.Destroy();
+        return rc;
+    }
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_RGBA | GLUT_DEPTH | GLUT_DOUBLE);
     glutInitWindowPosition(100, 100);
@@ -1236,8 +2851,34 @@ int main(int argc, char* argv[])
 
     Initialize();
 
-    glutIdleFunc(RenderFunction);
-    glutDisplayFunc(RenderFunction);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--gpu-csv") == 0 && gGpuProfiler.StartCsv(GPU_PROFILE_CSV_PATH)) {
+            printf("GPU profile: logging to %s\n", GPU_PROFILE_CSV_PATH);
+        }
+        if (strcmp(argv[i], "--bench-lights") == 0) {
+            BenchmarkLightCounts();
+            Cleanup();
+            return 0;
+        }
+        if (strcmp(argv[i], "--bench-vertex") == 0) {
+            BenchmarkVertexThroughput();
+            Cleanup();
+            return 0;
+        }
+        if (strcmp(argv[i], "--bench-jobs") == 0) {
+            BenchmarkJobs();
+            Cleanup();
+            return 0;
+        }
+        if (strcmp(argv[i], "--bench-steam") == 0) {
+            BenchmarkSteamFill();
+            Cleanup();
+            return 0;
+        }
+    }
+
+    glutIdleFunc(IdleFunction);
+    glutDisplayFunc(DisplayFunction);
     glutKeyboardFunc(processNormalKeys);
     glutSpecialFunc(processSpecialKeys);
     glutCloseFunc(Cleanup);
@@ -0,0 +1,385 @@
+// Material table + per-resolution texture arrays (see materials.hpp).
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "materials.hpp"
+#include "texture_compress.hpp"
+
+static double nowMs()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(high_resolution_clock::now().time_since_epoch()).count();
+}
+
+// bilinear RGBA8 resample, only used when there are more sizes than array groups
+static void resampleRGBA(const unsigned char* src, int sw, int sh,
+    std::vector<unsigned char>& dst, int dw, int dh)
+{
+    dst.resize((size_t)dw * dh * 4);
+    for (int y = 0; y < dh; y++) {
+        float fy = ((float)y + 0.5f) * (float)sh / (float)dh - 0.5f;
+        if (fy < 0.0f) fy = 0.0f;
+        int y0 = (int)fy;
+        int y1 = (y0 + 1 < sh) ? y0 + 1 : y0;
+        float ty = fy - (float)y0;
+
+        for (int x = 0; x < dw; x++) {
+            float fx = ((float)x + 0.5f) * (float)sw / (float)dw - 0.5f;
+            if (fx < 0.0f) fx = 0.0f;
+            int x0 = (int)fx;
+            int x1 = (x0 + 1 < sw) ? x0 + 1 : x0;
+            float tx = fx - (float)x0;
+
+            for (int c = 0; c < 4; c++) {
+                float a = src[((size_t)y0 * sw + x0) * 4 + c];
+                float b = src[((size_t)y0 * sw + x1) * 4 + c];
+                float d = src[((size_t)y1 * sw + x0) * 4 + c];
+                float e = src[((size_t)y1 * sw + x1) * 4 + c];
+                float top = a + (b - a) * tx;
+                float bot = d + (e - d) * tx;
+                dst[((size_t)y * dw + x) * 4 + c] = (unsigned char)(top + (bot - top) * ty + 0.5f);
+            }
+        }
+    }
+}
+
+int MaterialLibrary::AddImage(const std::string& path, bool normalMap)
+{
+    if (path.empty()) return -1;
+
+    for (size_t i = 0; i < images.size(); i++) {
+        if (images[i].path == path) return (int)i;
+    }
+
+    Image img;
+    img.path = path;
+    img.placeholderNormal = normalMap;
+    images.push_back(img);
+    return (int)images.size() - 1;
+}
+
+int MaterialLibrary::Add(const MaterialDesc& desc)
+{
+    Material m;
+    m.desc = desc;
+    m.albedoImage = AddImage(desc.albedo ? desc.albedo : "", false);
+    m.normalImage = AddImage(desc.normal ? desc.normal : "", true);
+    m.desc.albedo = nullptr; // paths live in images[]
+    m.desc.normal = nullptr;
+    materials.push_back(m);
+    return (int)materials.size() - 1;
+}
+
+// group 0: 4x4 layers shown while the real images stream in
+void MaterialLibrary::CreatePlaceholders()
+{
+    const int N = 4;
+    unsigned char px[2][N * N * 4];
+    for (int i = 0; i < N * N; i++) {
+        unsigned char* a = &px[0][i * 4];
+        unsigned char* n = &px[1][i * 4];
+        a[0] = a[1] = a[2] = 128; a[3] = 255; // mid grey, opaque
+        n[0] = n[1] = 128; n[2] = 255; n[3] = 255; // (0,0,1) tangent space
+    }
+
+    Group g;
+    g.width = g.height = N;
+    g.levels = 1;
+    g.layers = 2;
+
+    glGenTextures(1, &g.tex);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, g.tex);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, N, N, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, px);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    groups.push_back(g);
+}
+
+bool MaterialLibrary::Build(JobSystem& jobs, ImageCache& imageCache)
+{
+    startMs = nowMs();
+
+    CreatePlaceholders();
+
+    glGenBuffers(1, &tableBuf);
+    glGenTextures(1, &tableTex);
+    UploadTable();
+
+    glBindTexture(GL_TEXTURE_BUFFER, tableTex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tableBuf);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    uploader.Init(MATERIAL_UPLOAD_BUDGET);
+
+    cache = &imageCache;
+    for (auto& img : images) img.handle = cache->AcquireAsync(img.path, jobs);
+    state = DECODING;
+
+    printf("Materials: %d materials, %zu images decoding in background\n", Count(), images.size());
+    return true;
+}
+
+// all images are decoded: sizes are known, so the arrays can be allocated once
+void MaterialLibrary::CreateArrays()
+{
+    double decodeMs = 0.0, mipMs = 0.0;
+    for (size_t i = 0; i < images.size(); i++) {
+        const DecodedImage* d = cache->Get(images[i].handle);
+        if (!d) {
+            printf("Nu am putut incarca textura: %s\n", images[i].path.c_str());
+            continue;
+        }
+
+        for (size_t k = 0; k < i; k++) {
+            if (images[k].slot.group >= 0 && cache->Same(images[i].handle, images[k].handle)) {
+                images[i].sameAs = (int)k;
+                images[i].slot = images[k].slot;
+                break;
+            }
+        }
+        if (images[i].sameAs >= 0) {
+            printf("Textura OK: %s (same content as %s) -> array %d, layer %d\n", images[i].path.c_str(),
+                images[images[i].sameAs].path.c_str(), images[i].slot.group, images[i].slot.layer);
+            continue;
+        }
+
+        decodeMs += d->decodeMs;
+        mipMs += d->mipMs;
+
+        int g = -1;
+        for (size_t k = 1; k < groups.size(); k++) {
+            const Group& gr = groups[k];
+            if (gr.width == d->width && gr.height == d->height && gr.format == d->format &&
+                gr.levels == d->Levels()) { g = (int)k; break; }
+        }
+
+        if (g < 0 && (int)groups.size() < MATERIAL_ARRAY_GROUPS) {
+            Group ng;
+            ng.width = d->width;
+            ng.height = d->height;
+            ng.format = d->format;
+            ng.levels = d->Levels();
+            groups.push_back(ng);
+            g = (int)groups.size() - 1;
+        }
+
+        if (g < 0) {
+            // last RGBA8 group takes the overflow
+            for (int k = (int)groups.size() - 1; k > 0 && g < 0; k--) {
+                if (groups[k].format == GL_RGBA8) g = k;
+            }
+            if (g < 0 || d->format != GL_RGBA8) {
+                printf("WARN: %s dropped (only %d texture array groups)\n", d->path.c_str(), MATERIAL_ARRAY_GROUPS - 1);
+                continue;
+            }
+            printf("WARN: %s resampled %dx%d -> %dx%d (only %d texture array groups)\n", d->path.c_str(),
+                d->width, d->height, groups[g].width, groups[g].height, MATERIAL_ARRAY_GROUPS - 1);
+
+            // the cached image stays as loaded; the scaled copy lives until it is uploaded
+            resampled.emplace_back();
+            DecodedImage& r = resampled.back();
+            r.path = d->path;
+            r.ok = true;
+            r.width = groups[g].width;
+            r.height = groups[g].height;
+            r.mips.resize(1);
+            resampleRGBA(d->mips[0].data(), d->width, d->height, r.mips[0], r.width, r.height);
+            BuildMipChain(r);
+            d = &r;
+            images[i].resampled = (int)resampled.size() - 1;
+        }
+
+        images[i].slot.group = g;
+        images[i].slot.layer = groups[g].layers++;
+        images[i].levelsLeft = d->Levels();
+
+        for (int l = 0, w = d->width, h = d->height; l < d->Levels(); l++) {
+            vramBytes += d->LevelBytes(l);
+            rgbaBytes += (size_t)w * h * 4;
+            w = w > 1 ? w >> 1 : 1;
+            h = h > 1 ? h >> 1 : 1;
+        }
+
+        printf("Textura OK: %s (%dx%d, %s) -> array %d, layer %d\n", d->path.c_str(), d->width, d->height,
+            d->format == GL_RGBA8 ? "RGBA8" : "BC", images[i].slot.group, images[i].slot.layer);
+    }
+
+    for (size_t k = 1; k < groups.size(); k++) {
+        Group& g = groups[k];
+        glGenTextures(1, &g.tex);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, g.tex);
+
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, g.levels - 1);
+
+        // storage only; the data arrives through the uploader (also for compressed formats)
+        int w = g.width, h = g.height;
+        for (int l = 0; l < g.levels; l++) {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, l, g.format, w, h, g.layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            w = w > 1 ? w >> 1 : 1;
+            h = h > 1 ? h >> 1 : 1;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // one image after the other, so they turn resident progressively instead of all at the end
+    for (size_t i = 0; i < images.size(); i++) {
+        if (images[i].slot.group < 0 || images[i].sameAs >= 0) continue;
+        const DecodedImage& d = images[i].resampled >= 0 ? resampled[images[i].resampled] : *cache->Get(images[i].handle);
+
+        for (int l = d.Levels() - 1; l >= 0; l--) {
+            TextureUploader::Job j;
+            j.tex = groups[images[i].slot.group].tex;
+            j.level = l;
+            j.layer = images[i].slot.layer;
+            j.format = d.format;
+            j.width = d.width >> l ? d.width >> l : 1;
+            j.height = d.height >> l ? d.height >> l : 1;
+            j.data = d.LevelData(l);
+            j.tag = (int)i;
+            uploader.Enqueue(j);
+        }
+    }
+
+    printf("Textures decoded after %.1f ms (decode %.1f ms + mips %.1f ms summed over jobs)\n",
+        nowMs() - startMs, decodeMs, mipMs);
+}
+
+void MaterialLibrary::Update()
+{
+    if (state == DECODING) {
+        for (const auto& img : images) {
+            if (cache->State(img.handle) == RES_LOADING) return;
+        }
+        CreateArrays();
+        state = STREAMING;
+        UploadTable(); // images that failed to load drop their placeholder
+    }
+
+    if (state != STREAMING) return;
+
+    std::vector<int> finished;
+    streamedBytes += uploader.Pump(finished);
+
+    bool tableDirty = false;
+    for (int i : finished) {
+        // an image only switches over once all its levels are in (no sampling of undefined mips)
+        if (--images[i].levelsLeft == 0) {
+            for (auto& img : images) {
+                if (&img == &images[i] || img.sameAs == i) img.resident = true;
+            }
+            tableDirty = true;
+        }
+    }
+    if (tableDirty) UploadTable();
+
+    if (uploader.Idle()) {
+        // CPU copies are not needed anymore: back to the cache (evictable under its budget)
+        ReleaseImages();
+        state = READY;
+        printf("Textures resident after %.1f ms (%.1f MB streamed, %.1f MB/frame budget)\n",
+            nowMs() - startMs, streamedBytes / (1024.0 * 1024.0), uploader.Budget() / (1024.0 * 1024.0));
+        printf("Texture memory: %.1f MB (%.1f MB as RGBA8, %.1fx smaller)\n", vramBytes / (1024.0 * 1024.0),
+            rgbaBytes / (1024.0 * 1024.0), vramBytes ? (double)rgbaBytes / vramBytes : 1.0);
+    }
+}
+
+MaterialLibrary::Slot MaterialLibrary::TableSlot(int image) const
+{
+    Slot s;
+    if (image < 0) return s;
+
+    const Image& img = images[image];
+    if (img.resident) return img.slot;
+
+    // still loading => placeholder; failed to load => none (vertex color / geometric normal)
+    if (state == DECODING || img.slot.group >= 0) {
+        s.group = MATERIAL_PLACEHOLDER_GROUP;
+        s.layer = img.placeholderNormal ? 1 : 0;
+    }
+    return s;
+}
+
+void MaterialLibrary::UploadTable()
+{
+    std::vector<float> packed(materials.size() * 8);
+    for (size_t i = 0; i < materials.size(); i++) {
+        const Material& m = materials[i];
+        Slot albedo = TableSlot(m.albedoImage);
+        Slot normal = TableSlot(m.normalImage);
+
+        float* p = &packed[i * 8];
+        p[0] = (float)albedo.group;
+        p[1] = (float)albedo.layer;
+        p[2] = (float)normal.group;
+        p[3] = (float)normal.layer;
+        p[4] = m.desc.tiling;
+        p[5] = (float)m.desc.flags;
+        p[6] = m.desc.emissive;
+        p[7] = 0.0f;
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, tableBuf);
+    glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)(packed.size() * sizeof(float)), packed.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void MaterialLibrary::SetFlag(int id, unsigned int flag, bool on)
+{
+    if (id < 0 || id >= Count()) return;
+    unsigned int& f = materials[id].desc.flags;
+    f = on ? (f | flag) : (f & ~flag);
+    if (tableBuf) UploadTable();
+}
+
+void MaterialLibrary::SetTiling(int id, float tiling)
+{
+    if (id < 0 || id >= Count()) return;
+    materials[id].desc.tiling = tiling;
+    if (tableBuf) UploadTable();
+}
+
+void MaterialLibrary::Bind(int unitBase) const
+{
+    for (int i = 0; i < MATERIAL_ARRAY_GROUPS; i++) {
+        glActiveTexture(GL_TEXTURE0 + unitBase + i);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, i < GroupCount() ? groups[i].tex : 0);
+    }
+    glActiveTexture(GL_TEXTURE0 + unitBase + MATERIAL_ARRAY_GROUPS);
+    glBindTexture(GL_TEXTURE_BUFFER, tableTex);
+}
+
+void MaterialLibrary::ReleaseImages()
+{
+    for (auto& img : images) {
+        if (cache && !img.handle.IsNull()) cache->Release(img.handle);
+        img.handle = ImageCache::Handle();
+        img.resampled = -1;
+    }
+    resampled.clear();
+}
+
+void MaterialLibrary::Destroy()
+{
+    uploader.Destroy();
+    ReleaseImages();
+
+    for (auto& g : groups) {
+        if (g.tex) glDeleteTextures(1, &g.tex);
+    }
+    groups.clear();
+
+    if (tableTex) glDeleteTextures(1, &tableTex);
+    if (tableBuf) glDeleteBuffers(1, &tableBuf);
+    tableTex = 0;
+    tableBuf = 0;
+    state = EMPTY;
+}
@@ -0,0 +1,121 @@
+#ifndef MATERIALS_H
+#define MATERIALS_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <GL/glew.h>
+
+#include "texture_loader.hpp"
+#include "resources.hpp"
+
+// Material table + texture arrays.
+// Every image (albedo or normal map) becomes one layer of a GL_TEXTURE_2D_ARRAY; images of the
+// same resolution and format share an array ("group"). The shader gets at most MATERIAL_ARRAY_GROUPS
+// arrays; if there are more, extra RGBA8 images are resampled to the last RGBA8 group (precompressed
+// .ktx images cannot be, they fall back to vertex color with a warning).
+//
+// Loading is asynchronous: Build() only starts the image loads (image cache, resources.hpp) and
+// returns; images with identical content share one layer. Until an image
+// is resident its table entry points at the placeholder array (group 0: flat grey albedo and a
+// flat normal), so the first frame does not wait for any texture. Update() is called once per
+// frame and streams the decoded mip chains in under the upload budget.
+//
+// The table is a texture buffer (RGBA32F, 2 texels per material, indexed by the vertex material id):
+//  - texel 0: (albedo group, albedo layer, normal group, normal layer), group -1 = none
+//  - texel 1: (uv tiling, flags, emissive, 0)
+
+static const int MATERIAL_ARRAY_GROUPS = 6;
+static const int MATERIAL_PLACEHOLDER_GROUP = 0;
+static const size_t MATERIAL_UPLOAD_BUDGET = 4 * 1024 * 1024; // bytes per frame
+
+enum MaterialFlags {
+    MAT_ALPHA_TEST = 1 << 0,  // discard alpha < 0.5 (drawn in the alpha-tested pass, no blending)
+    MAT_BLACK_KEY = 1 << 1,   // near-black texels become transparent (old SIGN_BLACK_KEY)
+    MAT_STEAM = 1 << 2        // procedural steam billboard, no textures
+};
+
+struct MaterialDesc {
+    const char* albedo = nullptr;   // image path, or NULL for vertex color only
+    const char* normal = nullptr;   // tangent-space normal map, or NULL
+    float tiling = 1.0f;
+    unsigned int flags = 0;
+    float emissive = 0.0f;          // albedo * emissive is added unlit
+};
+
+class MaterialLibrary {
+public:
+    // returns the material id (== index in the table); call before Build
+    int Add(const MaterialDesc& desc);
+
+    // starts loading all images through `images` on `jobs` and uploads the table (placeholders
+    // until resident); the decoded copies are released back to the cache once uploaded
+    bool Build(JobSystem& jobs, ImageCache& images);
+    void Destroy();
+
+    // per frame, main thread: creates arrays once decoding is done, then streams mips
+    void Update();
+    bool Resident() const { return state == READY; }
+    void SetUploadBudget(size_t bytes) { uploader.SetBudget(bytes); }
+
+    // runtime edits re-upload the (tiny) table
+    void SetFlag(int id, unsigned int flag, bool on);
+    void SetTiling(int id, float tiling);
+    unsigned int Flags(int id) const { return materials[id].desc.flags; }
+
+    // arrays on units [unitBase, unitBase + MATERIAL_ARRAY_GROUPS), table on the next unit
+    void Bind(int unitBase) const;
+
+    int Count() const { return (int)materials.size(); }
+    int GroupCount() const { return (int)groups.size(); }
+
+private:
+    struct Slot { int group = -1, layer = -1; };
+
+    struct Image {
+        std::string path;
+        ImageCache::Handle handle;
+        int sameAs = -1;                // content duplicate of that image: shares its layer
+        int resampled = -1;             // index in resampled[], or -1: uploaded from the cache
+        Slot slot;
+        int levelsLeft = 0;
+        bool resident = false;
+        bool placeholderNormal = false; // which placeholder layer to show meanwhile
+    };
+
+    struct Material {
+        MaterialDesc desc;
+        int albedoImage = -1, normalImage = -1;
+    };
+
+    struct Group {
+        int width = 0, height = 0, levels = 1, layers = 0;
+        GLenum format = GL_RGBA8;
+        GLuint tex = 0;
+    };
+
+    enum State { EMPTY, DECODING, STREAMING, READY };
+
+    int AddImage(const std::string& path, bool normalMap);
+    Slot TableSlot(int image) const;
+    void CreatePlaceholders();
+    void CreateArrays();
+    void UploadTable();
+    void ReleaseImages();
+
+    std::vector<Material> materials;
+    std::vector<Image> images;  // unique paths (each file is loaded once)
+    std::deque<DecodedImage> resampled; // overflow images scaled to their group, until uploaded
+    std::vector<Group> groups;  // [0] = placeholders
+
+    ImageCache* cache = nullptr;
+    TextureUploader uploader;
+    State state = EMPTY;
+    double startMs = 0.0;
+    size_t streamedBytes = 0;
+    size_t vramBytes = 0, rgbaBytes = 0; // texture memory vs. the same images as RGBA8
+
+    GLuint tableBuf = 0, tableTex = 0;
+};
+
+#endif
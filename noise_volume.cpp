@@ -0,0 +1,134 @@
+// Tileable 3D value noise (see noise_volume.hpp).
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOISE_SSE 1
+#endif
+
+#include "noise_volume.hpp"
+
+// value noise fBm piles up around 0.5: stretch it so the steam gets real holes
+static const float NOISE_CONTRAST = 1.8f;
+
+struct NoiseOctave {
+    int cells;
+    float amplitude;
+    std::vector<float> lattice;     // cells^3 values in 0..1, x fastest
+};
+
+static unsigned int hashLattice(unsigned int x, unsigned int y, unsigned int z, unsigned int seed)
+{
+    unsigned int h = seed ^ (x * 0x8DA6B343u) ^ (y * 0xD8163841u) ^ (z * 0xCB1AB31Fu);
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline float smooth(float t)
+{
+    return t * t * (3.0f - 2.0f * t);
+}
+
+static void generateSlices(const std::vector<NoiseOctave>& octaves, int size, float norm,
+    int zBegin, int zEnd, unsigned char* out)
+{
+    std::vector<float> row(size);
+    std::vector<float> col(size + 1);   // cells <= size, + the wrapped one
+
+    for (int z = zBegin; z < zEnd; z++)
+    for (int y = 0; y < size; y++)
+    {
+        std::fill(row.begin(), row.end(), 0.0f);
+
+        for (const NoiseOctave& o : octaves) {
+            int n = o.cells;
+            float scale = (float)n / (float)size;
+
+            float fz = z * scale, fy = y * scale;
+            int z0 = (int)fz, y0 = (int)fy;
+            float tz = smooth(fz - z0), ty = smooth(fy - y0);
+            int z1 = (z0 + 1) % n, y1 = (y0 + 1) % n;
+
+            // y/z interpolation once per lattice column; x interpolates between columns
+            const float* l00 = &o.lattice[(size_t)(z0 * n + y0) * n];
+            const float* l01 = &o.lattice[(size_t)(z0 * n + y1) * n];
+            const float* l10 = &o.lattice[(size_t)(z1 * n + y0) * n];
+            const float* l11 = &o.lattice[(size_t)(z1 * n + y1) * n];
+            for (int i = 0; i < n; i++) {
+                float a = l00[i] + (l01[i] - l00[i]) * ty;
+                float b = l10[i] + (l11[i] - l10[i]) * ty;
+                col[i] = a + (b - a) * tz;
+            }
+            col[n] = col[0];    // wrap
+
+            int x = 0;
+#ifdef NOISE_SSE
+            __m128 vScale = _mm_set1_ps(scale), vAmp = _mm_set1_ps(o.amplitude);
+            __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+            __m128 three = _mm_set1_ps(3.0f), two = _mm_set1_ps(2.0f);
+            for (; x + 4 <= size; x += 4) {
+                __m128 fx = _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)x), lane), vScale);
+                __m128i xi = _mm_cvttps_epi32(fx);     // fx >= 0: truncation is floor
+                __m128 t = _mm_sub_ps(fx, _mm_cvtepi32_ps(xi));
+                t = _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(three, _mm_mul_ps(two, t)));
+
+                alignas(16) int xs[4];
+                _mm_store_si128((__m128i*)xs, xi);
+                __m128 a = _mm_set_ps(col[xs[3]], col[xs[2]], col[xs[1]], col[xs[0]]);
+                __m128 b = _mm_set_ps(col[xs[3] + 1], col[xs[2] + 1], col[xs[1] + 1], col[xs[0] + 1]);
+
+                __m128 v = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+                _mm_storeu_ps(&row[x], _mm_add_ps(_mm_loadu_ps(&row[x]), _mm_mul_ps(v, vAmp)));
+            }
+#endif
+            for (; x < size; x++) {
+                float fx = x * scale;
+                int x0 = (int)fx;
+                float t = smooth(fx - x0);
+                row[x] += (col[x0] + (col[x0 + 1] - col[x0]) * t) * o.amplitude;
+            }
+        }
+
+        unsigned char* dst = out + ((size_t)z * size + y) * size;
+        for (int x = 0; x < size; x++) {
+            float v = (row[x] / norm - 0.5f) * NOISE_CONTRAST + 0.5f;
+            v = std::min(std::max(v, 0.0f), 1.0f);
+            dst[x] = (unsigned char)(v * 255.0f + 0.5f);
+        }
+    }
+}
+
+void GenerateNoiseVolume(const NoiseVolumeHeader& params, std::vector<unsigned char>& out, JobSystem* jobs)
+{
+    int size = params.size;
+    out.resize((size_t)size * size * size);
+
+    // lattices are tiny (<= 16^3 at the defaults): built up front, shared read-only by the jobs
+    std::vector<NoiseOctave> octaves(params.octaves);
+    float amplitude = 1.0f, norm = 0.0f;
+    for (int k = 0; k < params.octaves; k++) {
+        NoiseOctave& o = octaves[k];
+        o.cells = std::min(params.period << k, size);
+        o.amplitude = amplitude;
+        norm += amplitude;
+        amplitude *= 0.5f;
+
+        o.lattice.resize((size_t)o.cells * o.cells * o.cells);
+        size_t i = 0;
+        for (int z = 0; z < o.cells; z++)
+        for (int y = 0; y < o.cells; y++)
+        for (int x = 0; x < o.cells; x++)
+            o.lattice[i++] = (hashLattice(x, y, z, params.seed + k * 0x9E3779B9u) >> 8) * (1.0f / 16777216.0f);
+    }
+
+    unsigned char* dst = out.data();
+    auto slices = [&](int begin, int end) { generateSlices(octaves, size, norm, begin, end, dst); };
+    if (jobs) jobs->ParallelFor("noise volume", size, NOISE_SLICES_PER_JOB, slices);
+    else slices(0, size);
+}
@@ -0,0 +1,33 @@
+#ifndef NOISE_VOLUME_H
+#define NOISE_VOLUME_H
+
+#include <vector>
+#include "job_system.hpp"
+
+// Tileable 3D value noise for the steam (alley.frag samples it as an R8 3D texture with GL_REPEAT,
+// scrolling through it over time), instead of hashing noise per fragment.
+//  - fBm of `octaves` layers; layer o has (period << o) lattice cells per volume edge, and the
+//    lattice wraps at that count, so the volume tiles seamlessly in all three axes
+//  - 4 voxels along x at a time with SSE (scalar fallback), z slices in parallel on the jobs
+//  - generated at startup (a few ms) unless the asset pack has a matching one (PACK_NOISE)
+
+static const int NOISE_VOLUME_SIZE = 64;      // voxels per edge, multiple of 4
+static const int NOISE_VOLUME_PERIOD = 4;     // lattice cells per edge of the first octave
+static const int NOISE_VOLUME_OCTAVES = 3;
+static const unsigned int NOISE_VOLUME_SEED = 0x5EA3u;
+static const int NOISE_SLICES_PER_JOB = 4;
+
+// PACK_NOISE section: this header, then size^3 bytes (x fastest)
+struct NoiseVolumeHeader {
+    int size;
+    int period;
+    int octaves;
+    unsigned int seed;
+};
+
+static_assert(sizeof(NoiseVolumeHeader) == 16, "pack noise header layout");
+
+// fills out with size^3 bytes; jobs may be null (runs on the calling thread)
+void GenerateNoiseVolume(const NoiseVolumeHeader& params, std::vector<unsigned char>& out, JobSystem* jobs);
+
+#endif
@@ -19,6 +19,7 @@
 
 #include "glm/glm.hpp"
 #include "objloader.hpp"
+#include "cpu_profiler.hpp"
 
 static inline int toIndex(int idx, int count)
 {
@@ -97,6 +98,7 @@ static bool parseFaceVert(const std::string& token, int& v, int& vt, int& vn)
 
 bool loadOBJ2(const char* path, ObjMesh& outMesh, bool computeTangents)
 {
+    CPU_ZONE("loadOBJ2");
     outMesh = ObjMesh{};
 
     printf("Loading OBJ file (robust) %s...\n", path);
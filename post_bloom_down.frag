@@ -0,0 +1,40 @@
+#version 330 core
+
+// Bloom, downsample step (dual filter): source level -> next level at half the size.
+// 4 bilinear taps on the corners of the target texel + the center, each averaging 2x2 source texels.
+// The first step also cuts the bloom threshold (soft knee) out of the HDR scene.
+
+uniform sampler2D source;
+uniform vec2 sourceTexel;   // 1 / source size
+uniform int prefilter;      // 1 = first step: source is the HDR scene
+uniform vec2 uvScale;       // used part of the source (the scene rendered at a lower resolution)
+uniform float threshold;
+uniform float knee;
+
+out vec4 out_Color;
+
+vec3 thresholdColor(vec3 c)
+{
+    float brightness = max(c.r, max(c.g, c.b));
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 1e-4);
+    float contribution = max(soft, brightness - threshold) / max(brightness, 1e-4);
+    return c * contribution;
+}
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy * 2.0 * sourceTexel * uvScale;  // center of the target texel, in source uv
+    vec2 d = sourceTexel * uvScale;
+
+    vec3 sum = texture(source, uv).rgb * 4.0;
+    sum += texture(source, uv + vec2(-1.0, -1.0) * d).rgb;
+    sum += texture(source, uv + vec2( 1.0, -1.0) * d).rgb;
+    sum += texture(source, uv + vec2(-1.0,  1.0) * d).rgb;
+    sum += texture(source, uv + vec2( 1.0,  1.0) * d).rgb;
+    sum *= 0.125;
+
+    if (prefilter != 0) sum = thresholdColor(sum);
+
+    out_Color = vec4(sum, 1.0);
+}
@@ -0,0 +1,27 @@
+#version 330 core
+
+// Bloom, upsample step (dual filter): smaller level -> next larger one, added on top of it
+// (additive blending). 8 bilinear taps on a tent around the target texel.
+
+uniform sampler2D source;
+uniform vec2 sourceTexel;   // 1 / source size
+uniform vec2 targetTexel;   // 1 / target size
+
+out vec4 out_Color;
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy * targetTexel;
+    vec2 o = sourceTexel * 0.5;
+
+    vec3 sum = texture(source, uv + vec2(-2.0, 0.0) * o).rgb;
+    sum += texture(source, uv + vec2(2.0, 0.0) * o).rgb;
+    sum += texture(source, uv + vec2(0.0, -2.0) * o).rgb;
+    sum += texture(source, uv + vec2(0.0, 2.0) * o).rgb;
+    sum += texture(source, uv + vec2(-1.0, -1.0) * o).rgb * 2.0;
+    sum += texture(source, uv + vec2(1.0, -1.0) * o).rgb * 2.0;
+    sum += texture(source, uv + vec2(-1.0, 1.0) * o).rgb * 2.0;
+    sum += texture(source, uv + vec2(1.0, 1.0) * o).rgb * 2.0;
+
+    out_Color = vec4(sum / 12.0, 1.0);
+}
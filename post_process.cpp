@@ -0,0 +1,369 @@
+// HDR target, TAA, bloom chain and tone mapping (see post_process.hpp).
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include "post_process.hpp"
+#include "gpu_profiler.hpp"
+
+static const char* POST_STAGE_NAMES[POST_STAGE_COUNT] = { "taa", "bloom down", "bloom up", "tone map" };
+
+static float halton(unsigned int i, unsigned int base)
+{
+    float f = 1.0f, r = 0.0f;
+    while (i > 0) {
+        f /= (float)base;
+        r += f * (float)(i % base);
+        i /= base;
+    }
+    return r;
+}
+
+glm::vec2 TaaJitter(unsigned int frame)
+{
+    unsigned int i = frame % 8 + 1;     // index 0 would be (0, 0) every cycle
+    return glm::vec2(halton(i, 2) - 0.5f, halton(i, 3) - 0.5f);
+}
+
+glm::mat4 JitterProjection(const glm::mat4& projection, glm::vec2 jitter, int renderW, int renderH)
+{
+    // ndc.x = (P00 x) / -z - P20: moving the image by +j pixels is P20 -= 2 j / w
+    glm::mat4 p = projection;
+    p[2][0] -= 2.0f * jitter.x / (float)renderW;
+    p[2][1] -= 2.0f * jitter.y / (float)renderH;
+    return p;
+}
+
+static GLuint createTarget(GLenum format, int w, int h, GLuint& fbo)
+{
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+    return tex;
+}
+
+bool PostPipeline::Init(int w, int h)
+{
+    width = w;
+    height = h;
+
+    sceneColor = createTarget(GL_RGBA16F, w, h, sceneFbo);
+    glGenTextures(1, &sceneDepth);
+    glBindTexture(GL_TEXTURE_2D, sceneDepth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, w, h, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+
+    bool ok = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (!ok) printf("Post: HDR target incomplete\n");
+
+    for (int i = 0; i < 2 && ok; i++) {
+        historyTex[i] = createTarget(GL_RGBA16F, w, h, historyFbo[i]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            printf("Post: taa history %d incomplete\n", i);
+            ok = false;
+        }
+    }
+    historyValid = false;
+
+    for (int i = 0; i < BLOOM_LEVELS && ok; i++) {
+        bloomW[i] = (i == 0 ? w : bloomW[i - 1]) / 2;
+        bloomH[i] = (i == 0 ? h : bloomH[i - 1]) / 2;
+        if (bloomW[i] < 1) bloomW[i] = 1;
+        if (bloomH[i] < 1) bloomH[i] = 1;
+
+        bloomTex[i] = createTarget(GL_R11F_G11F_B10F, bloomW[i], bloomH[i], bloomFbo[i]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            printf("Post: bloom level %d incomplete\n", i);
+            ok = false;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (!ok) {
+        Destroy();
+        return false;
+    }
+
+    glGenVertexArrays(1, &vao);
+    glGenQueries(QUERY_FRAMES * POST_STAGE_COUNT, &queries[0][0]);
+    return true;
+}
+
+void PostPipeline::Destroy()
+{
+    if (sceneFbo) glDeleteFramebuffers(1, &sceneFbo);
+    if (sceneColor) glDeleteTextures(1, &sceneColor);
+    if (sceneDepth) glDeleteTextures(1, &sceneDepth);
+    sceneFbo = sceneColor = sceneDepth = 0;
+
+    for (int i = 0; i < 2; i++) {
+        if (historyFbo[i]) glDeleteFramebuffers(1, &historyFbo[i]);
+        if (historyTex[i]) glDeleteTextures(1, &historyTex[i]);
+        historyFbo[i] = historyTex[i] = 0;
+    }
+    historyValid = false;
+
+    for (int i = 0; i < BLOOM_LEVELS; i++) {
+        if (bloomFbo[i]) glDeleteFramebuffers(1, &bloomFbo[i]);
+        if (bloomTex[i]) glDeleteTextures(1, &bloomTex[i]);
+        bloomFbo[i] = bloomTex[i] = 0;
+    }
+
+    ReleaseSavedScene();
+
+    if (vao) glDeleteVertexArrays(1, &vao);
+    if (queries[0][0]) glDeleteQueries(QUERY_FRAMES * POST_STAGE_COUNT, &queries[0][0]);
+    vao = 0;
+    for (int f = 0; f < QUERY_FRAMES; f++) {
+        pending[f] = false;
+        for (int s = 0; s < POST_STAGE_COUNT; s++) queries[f][s] = 0;
+    }
+}
+
+void PostPipeline::BeginScene(int renderW, int renderH) const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo ? sceneFbo : output);
+    if (!sceneFbo) return;
+    glViewport(0, 0, std::min(std::max(renderW, 1), width), std::min(std::max(renderH, 1), height));
+}
+
+void PostPipeline::SaveScene(int renderW, int renderH)
+{
+    if (!sceneFbo) return;
+    if (!savedFbo) {
+        savedColor = createTarget(GL_RGBA16F, width, height, savedFbo);
+        glGenRenderbuffers(1, &savedDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, savedDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, savedDepth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            printf("Post: saved scene target incomplete\n");
+            ReleaseSavedScene();
+            glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+            return;
+        }
+    }
+
+    savedW = std::min(std::max(renderW, 1), width);
+    savedH = std::min(std::max(renderH, 1), height);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, savedFbo);
+    glBlitFramebuffer(0, 0, savedW, savedH, 0, 0, savedW, savedH, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+}
+
+bool PostPipeline::RestoreScene(int x, int y, int w, int h) const
+{
+    if (!savedW) return false;
+    int x1 = std::min(x + w, savedW), y1 = std::min(y + h, savedH);
+    x = std::max(x, 0);
+    y = std::max(y, 0);
+    if (x1 > x && y1 > y) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, savedFbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFbo);
+        glBlitFramebuffer(x, y, x1, y1, x, y, x1, y1, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+    return true;
+}
+
+void PostPipeline::ReleaseSavedScene()
+{
+    if (savedFbo) glDeleteFramebuffers(1, &savedFbo);
+    if (savedColor) glDeleteTextures(1, &savedColor);
+    if (savedDepth) glDeleteRenderbuffers(1, &savedDepth);
+    savedFbo = savedColor = savedDepth = 0;
+    savedW = savedH = 0;
+}
+
+void PostPipeline::Run(const PostPrograms& programs, const PostFrame& frame)
+{
+    if (!sceneFbo) return;
+
+    int renderW = std::min(std::max(frame.renderW, 1), width);
+    int renderH = std::min(std::max(frame.renderH, 1), height);
+    lastRenderW = renderW;
+    lastRenderH = renderH;
+
+    // stage timings of earlier frames (never waits)
+    for (int f = 0; f < QUERY_FRAMES; f++) {
+        if (!pending[f]) continue;
+        GLint available = 0;
+        glGetQueryObjectiv(queries[f][POST_STAGE_TONEMAP], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        for (int s = 0; s < POST_STAGE_COUNT; s++) {
+            if (!stageTimed[f][s]) continue;
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(queries[f][s], GL_QUERY_RESULT, &ns);
+            float ms = (float)(ns / 1.0e6);
+            stageMs[s] = stageMs[s] > 0.0f ? stageMs[s] * 0.9f + 0.1f * ms : ms;
+        }
+        pending[f] = false;
+    }
+
+    int q = nextQuery;
+    bool timed = !pending[q];
+    auto begin = [&](int s) { stageTimed[q][s] = timed; if (timed) glBeginQuery(GL_TIME_ELAPSED, queries[q][s]); };
+    auto end = [&]() { if (timed) glEndQuery(GL_TIME_ELAPSED); };
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glBindVertexArray(vao);
+    glActiveTexture(GL_TEXTURE0);
+
+    // 0) temporal upsampling: scene (renderW x renderH) + history -> the other history texture
+    GLuint resolved = sceneColor;
+    glm::vec2 resolvedScale((float)renderW / width, (float)renderH / height);    // used corner of `resolved`
+    bool taa = frame.taa && programs.taa && historyTex[0];
+    if (!taa) {
+        stageTimed[q][POST_STAGE_TAA] = false;
+        historyValid = false;
+    }
+    else {
+        begin(POST_STAGE_TAA);
+        int src = historyIndex, dst = 1 - historyIndex;
+        glBindFramebuffer(GL_FRAMEBUFFER, historyFbo[dst]);
+        glViewport(0, 0, width, height);
+        glUseProgram(programs.taa);
+        glUniform1i(glGetUniformLocation(programs.taa, "scene"), 0);
+        glUniform1i(glGetUniformLocation(programs.taa, "sceneDepth"), 1);
+        glUniform1i(glGetUniformLocation(programs.taa, "history"), 2);
+        glUniform2f(glGetUniformLocation(programs.taa, "renderSize"), (float)renderW, (float)renderH);
+        glUniform2f(glGetUniformLocation(programs.taa, "jitter"), frame.jitter.x, frame.jitter.y);
+        glUniformMatrix4fv(glGetUniformLocation(programs.taa, "invViewProj"), 1, GL_FALSE, glm::value_ptr(frame.invViewProj));
+        glUniformMatrix4fv(glGetUniformLocation(programs.taa, "prevViewProj"), 1, GL_FALSE, glm::value_ptr(frame.prevViewProj));
+        glUniform1i(glGetUniformLocation(programs.taa, "historyValid"), historyValid ? 1 : 0);
+
+        glBindTexture(GL_TEXTURE_2D, sceneColor);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, sceneDepth);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, historyTex[src]);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        GpuCountDraw(3);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        end();
+
+        historyIndex = dst;
+        historyValid = true;
+        resolved = historyTex[dst];
+        resolvedScale = glm::vec2(1.0f);
+    }
+
+    bool useBloom = bloom && bloomStrength > 0.0f;
+    if (!useBloom) {
+        stageTimed[q][POST_STAGE_BLOOM_DOWN] = stageTimed[q][POST_STAGE_BLOOM_UP] = false;
+    }
+    else {
+        // 1) threshold + downsample: scene -> 0 -> 1 -> ... -> BLOOM_LEVELS - 1
+        begin(POST_STAGE_BLOOM_DOWN);
+        glUseProgram(programs.bloomDown);
+        GLint texelLoc = glGetUniformLocation(programs.bloomDown, "sourceTexel");
+        GLint prefilterLoc = glGetUniformLocation(programs.bloomDown, "prefilter");
+        GLint uvScaleLoc = glGetUniformLocation(programs.bloomDown, "uvScale");
+        glUniform1f(glGetUniformLocation(programs.bloomDown, "threshold"), bloomThreshold);
+        glUniform1f(glGetUniformLocation(programs.bloomDown, "knee"), bloomKnee);
+
+        for (int i = 0; i < BLOOM_LEVELS; i++) {
+            int srcW = i == 0 ? width : bloomW[i - 1];
+            int srcH = i == 0 ? height : bloomH[i - 1];
+            glBindFramebuffer(GL_FRAMEBUFFER, bloomFbo[i]);
+            glViewport(0, 0, bloomW[i], bloomH[i]);
+            glBindTexture(GL_TEXTURE_2D, i == 0 ? resolved : bloomTex[i - 1]);
+            glUniform2f(texelLoc, 1.0f / srcW, 1.0f / srcH);
+            glUniform1i(prefilterLoc, i == 0 ? 1 : 0);
+            if (i == 0) glUniform2f(uvScaleLoc, resolvedScale.x, resolvedScale.y);
+            else if (i == 1) glUniform2f(uvScaleLoc, 1.0f, 1.0f);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            GpuCountDraw(3);
+        }
+        end();
+
+        // 2) upsample, added onto the larger level: BLOOM_LEVELS - 1 -> ... -> 0
+        begin(POST_STAGE_BLOOM_UP);
+        glUseProgram(programs.bloomUp);
+        GLint srcTexelLoc = glGetUniformLocation(programs.bloomUp, "sourceTexel");
+        GLint dstTexelLoc = glGetUniformLocation(programs.bloomUp, "targetTexel");
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+
+        for (int i = BLOOM_LEVELS - 1; i > 0; i--) {
+            glBindFramebuffer(GL_FRAMEBUFFER, bloomFbo[i - 1]);
+            glViewport(0, 0, bloomW[i - 1], bloomH[i - 1]);
+            glBindTexture(GL_TEXTURE_2D, bloomTex[i]);
+            glUniform2f(srcTexelLoc, 1.0f / bloomW[i], 1.0f / bloomH[i]);
+            glUniform2f(dstTexelLoc, 1.0f / bloomW[i - 1], 1.0f / bloomH[i - 1]);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            GpuCountDraw(3);
+        }
+
+        glDisable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);    // the scene's transparent pass
+        end();
+    }
+
+    // 3) tone map + gamma into the output framebuffer
+    begin(POST_STAGE_TONEMAP);
+    glBindFramebuffer(GL_FRAMEBUFFER, output);
+    glViewport(0, 0, width, height);
+    glUseProgram(programs.tonemap);
+    glUniform1i(glGetUniformLocation(programs.tonemap, "scene"), 0);
+    glUniform1i(glGetUniformLocation(programs.tonemap, "bloom"), 1);
+    glUniform1f(glGetUniformLocation(programs.tonemap, "bloomStrength"), useBloom ? bloomStrength : 0.0f);
+    glUniform2f(glGetUniformLocation(programs.tonemap, "sceneScale"), resolvedScale.x, resolvedScale.y);
+    glBindTexture(GL_TEXTURE_2D, resolved);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, bloomTex[0]);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    GpuCountDraw(3);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    end();
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glEnable(GL_DEPTH_TEST);
+
+    if (timed) {
+        pending[q] = true;
+        nextQuery = (q + 1) % QUERY_FRAMES;
+    }
+}
+
+void PostPipeline::PrintStats() const
+{
+    int pixels = width * height;
+    int bloomPixels = 0;
+    for (int i = 0; i < BLOOM_LEVELS; i++) bloomPixels += bloomW[i] * bloomH[i];
+
+    printf("\nPost (%dx%d RGBA16F, scene %dx%d, bloom %s, %d levels = %.0f%% of the screen in pixels)\n", width, height,
+        lastRenderW, lastRenderH, bloom ? "on" : "off", BLOOM_LEVELS, 100.0 * bloomPixels / (pixels > 0 ? pixels : 1));
+    float total = 0.0f;
+    for (int s = 0; s < POST_STAGE_COUNT; s++) {
+        printf("  %-12s %7.3f ms\n", POST_STAGE_NAMES[s], stageMs[s]);
+        total += stageMs[s];
+    }
+    printf("  %-12s %7.3f ms (GPU, averaged)\n", "total", total);
+}
@@ -0,0 +1,116 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <GL/glew.h>
+#include "glm/glm.hpp"
+
+// HDR scene target + the passes that turn it into the frame (fullscreen.vert + post_*.frag):
+//  0) taa:         temporal upsampling of the scene (rendered at renderW x renderH, jittered)
+//                  into a full size history; reprojected by depth, clamped to the neighbourhood
+//  1) bloom down:  threshold (soft knee) + downsample into BLOOM_LEVELS levels, 1/2 .. 1/64 size
+//  2) bloom up:    dual-filter upsample, each level added onto the next larger one
+//  3) tone map:    scene + bloom -> exposure, Reinhard, gamma -> output (window or headless FBO)
+// The main pass renders linear color into an RGBA16F target (BeginScene); nothing per fragment
+// is tone mapped any more. Bloom works on R11G11B10F levels, the cost is bounded by the chain
+// (1/3 of the screen in pixels in total), whatever the number of emissive surfaces.
+// The scene target is allocated at full size; dynamic resolution only shrinks the viewport the
+// main pass renders into (lower left corner), so changing the scale never reallocates anything.
+// Without TAA the later stages read that corner and upscale it bilinearly.
+// Every stage has its own timer query (read back a few frames late, never waited on).
+
+static const int BLOOM_LEVELS = 6;
+
+enum PostStage {
+    POST_STAGE_TAA = 0,
+    POST_STAGE_BLOOM_DOWN,
+    POST_STAGE_BLOOM_UP,
+    POST_STAGE_TONEMAP,
+    POST_STAGE_COUNT
+};
+
+struct PostPrograms {
+    GLuint taa = 0;
+    GLuint bloomDown = 0;
+    GLuint bloomUp = 0;
+    GLuint tonemap = 0;     // FrameData block bound by the caller
+};
+
+// what the post passes need to know about the frame the main pass just rendered
+struct PostFrame {
+    int renderW = 0, renderH = 0;   // main pass viewport (<= the target size)
+    bool taa = false;
+    glm::vec2 jitter = glm::vec2(0.0f);     // image offset of this frame, in render pixels
+    glm::mat4 invViewProj = glm::mat4(1.0f);  // this frame, without jitter
+    glm::mat4 prevViewProj = glm::mat4(1.0f); // last frame, without jitter
+};
+
+// sub-pixel offset for frame n (Halton 2,3 over 8 frames), in pixels, -0.5..0.5
+glm::vec2 TaaJitter(unsigned int frame);
+
+// adds an image offset of `jitter` pixels (viewport renderW x renderH) to a perspective projection
+glm::mat4 JitterProjection(const glm::mat4& projection, glm::vec2 jitter, int renderW, int renderH);
+
+class PostPipeline {
+public:
+    ~PostPipeline() { Destroy(); }
+
+    bool Init(int width, int height);
+    void Destroy();
+
+    bool Available() const { return sceneFbo != 0; }
+
+    // binds the HDR target (RGBA16F + depth) and sets the viewport to renderW x renderH
+    // (clamped to the target size); the caller clears it. Without the target: binds `output`
+    void BeginScene(int renderW, int renderH) const;
+
+    // taa + bloom chain + tone map into `output`; leaves depth test on, blending off
+    void Run(const PostPrograms& programs, const PostFrame& frame);
+
+    // the next taa pass starts from the current frame only (camera cut, taa toggled)
+    void ResetHistory() { historyValid = false; }
+
+    // render on demand: SaveScene copies color + depth of the main pass so far (renderW x renderH)
+    // to a second target, created on first use; RestoreScene copies a rectangle of it back
+    // (render pixels). Both leave the HDR target bound.
+    void SaveScene(int renderW, int renderH);
+    bool RestoreScene(int x, int y, int w, int h) const;
+    bool SceneSaved() const { return savedW > 0; }
+    void ReleaseSavedScene();
+
+    GLuint output = 0;      // framebuffer the tone map writes: the window, or the headless target
+
+    float bloomThreshold = 1.0f;
+    float bloomKnee = 0.5f;
+    float bloomStrength = 0.05f;    // 0 skips the chain
+    bool bloom = true;
+
+    void PrintStats() const;
+
+private:
+    int width = 0, height = 0;
+    int lastRenderW = 0, lastRenderH = 0;   // for PrintStats
+
+    GLuint sceneFbo = 0, sceneColor = 0, sceneDepth = 0;  // depth is a texture: taa reprojects with it
+
+    GLuint savedFbo = 0, savedColor = 0, savedDepth = 0;  // SaveScene; depth is a renderbuffer
+    int savedW = 0, savedH = 0;
+
+    GLuint historyFbo[2] = {}, historyTex[2] = {};      // ping-pong, full size
+    int historyIndex = 0;                               // the one written last
+    bool historyValid = false;
+
+    GLuint bloomFbo[BLOOM_LEVELS] = {};
+    GLuint bloomTex[BLOOM_LEVELS] = {};
+    int bloomW[BLOOM_LEVELS] = {}, bloomH[BLOOM_LEVELS] = {};
+
+    GLuint vao = 0;     // empty, for the fullscreen triangle
+
+    static const int QUERY_FRAMES = 4;
+    GLuint queries[QUERY_FRAMES][POST_STAGE_COUNT] = {};
+    bool stageTimed[QUERY_FRAMES][POST_STAGE_COUNT] = {};
+    bool pending[QUERY_FRAMES] = {};
+    int nextQuery = 0;
+    float stageMs[POST_STAGE_COUNT] = {};
+};
+
+#endif
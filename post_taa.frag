@@ -0,0 +1,75 @@
+#version 330 core
+
+// Temporal upsampling: the main pass renders at renderSize (dynamic resolution) with a sub-pixel
+// jitter per frame; this pass accumulates those samples into a full resolution history.
+//  - history is reprojected with the camera only (scene depth + previous view-projection);
+//    steam and cables move slowly enough for the clamp below
+//  - the history is clamped to the 3x3 neighbourhood of the current samples (mean +- 1.25 sigma)
+//  - the current sample counts more the closer it actually landed to this output pixel
+//  - luminance weighted blend, so bright neon edges do not flicker
+
+uniform sampler2D scene;        // internal resolution, in the lower left renderSize texels
+uniform sampler2D sceneDepth;
+uniform sampler2D history;      // full resolution, last frame's output
+
+uniform vec2 renderSize;        // internal pixels
+uniform vec2 jitter;            // this frame's offset of the image, internal pixels
+uniform mat4 invViewProj;       // this frame, without jitter
+uniform mat4 prevViewProj;      // last frame, without jitter
+uniform int historyValid;       // 0 after a reset
+
+out vec4 out_Color;
+
+float luma(vec3 c)
+{
+    return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    vec2 outSize = vec2(textureSize(history, 0));
+    vec2 uv = gl_FragCoord.xy / outSize;
+    vec2 sceneTexel = 1.0 / vec2(textureSize(scene, 0));
+
+    vec2 pos = uv * renderSize;
+    ivec2 c = clamp(ivec2(pos), ivec2(0), ivec2(renderSize) - 1);
+    vec3 cur = texelFetch(scene, c, 0).rgb;
+
+    vec3 m1 = vec3(0.0), m2 = vec3(0.0);
+    for (int y = -1; y <= 1; y++)
+    for (int x = -1; x <= 1; x++)
+    {
+        vec3 s = texelFetch(scene, clamp(c + ivec2(x, y), ivec2(0), ivec2(renderSize) - 1), 0).rgb;
+        m1 += s;
+        m2 += s * s;
+    }
+    vec3 mean = m1 / 9.0;
+    vec3 sigma = sqrt(max(m2 / 9.0 - mean * mean, vec3(0.0)));
+    vec3 boxMin = mean - 1.25 * sigma;
+    vec3 boxMax = mean + 1.25 * sigma;
+
+    float depth = texelFetch(sceneDepth, c, 0).r;
+    vec4 world = invViewProj * vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 prev = prevViewProj * vec4(world.xyz / world.w, 1.0);
+    vec2 prevUV = prev.xy / prev.w * 0.5 + 0.5;
+
+    bool valid = historyValid != 0 && prev.w > 0.0 &&
+        all(greaterThanEqual(prevUV, vec2(0.0))) && all(lessThanEqual(prevUV, vec2(1.0)));
+
+    if (!valid) {
+        // nothing to accumulate: plain bilinear upscale
+        out_Color = vec4(texture(scene, pos * sceneTexel).rgb, 1.0);
+        return;
+    }
+
+    vec3 hist = clamp(texture(history, prevUV).rgb, boxMin, boxMax);
+
+    // the point texel c shows: the image moved by +jitter, so its center - jitter
+    vec2 d = pos - (vec2(c) + 0.5 - jitter);
+    float confidence = exp(-2.0 * dot(d, d));
+    float alpha = clamp(0.12 * confidence, 0.02, 1.0);
+
+    float wc = alpha / (1.0 + luma(cur));
+    float wh = (1.0 - alpha) / (1.0 + luma(hist));
+    out_Color = vec4((cur * wc + hist * wh) / (wc + wh), 1.0);
+}
@@ -0,0 +1,41 @@
+#version 330 core
+
+// Final post step, once per pixel: HDR scene + bloom -> exposure, Reinhard, gamma -> backbuffer.
+// (used to run in alley.frag for every shaded fragment, overdrawn ones included)
+
+layout(std140) uniform FrameData {
+    float timeSec;
+    float exposure;
+    float gammaValue;
+    float framePad0;
+};
+
+uniform sampler2D scene;
+uniform sampler2D bloom;
+uniform float bloomStrength;    // 0 = bloom off (the chain is skipped too)
+uniform vec2 sceneScale;        // used part of scene: < 1 = lower resolution, upscaled here (no taa)
+
+out vec4 out_Color;
+
+vec3 toneMapReinhard(vec3 c)
+{
+    c *= max(exposure, 0.0);
+    return c / (vec3(1.0) + c);
+}
+
+vec3 applyGamma(vec3 c)
+{
+    float g = max(gammaValue, 1e-4);
+    return pow(max(c, vec3(0.0)), vec3(1.0 / g));
+}
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(scene, 0));
+    vec3 c = texture(scene, uv * sceneScale).rgb;
+
+    if (bloomStrength > 0.0)
+        c += bloomStrength * texture(bloom, uv).rgb;
+
+    out_Color = vec4(applyGamma(toneMapReinhard(c)), 1.0);
+}
@@ -0,0 +1,73 @@
+// Parallel radix sort (see radix_sort.hpp).
+
+#include <string.h>
+#include <vector>
+#include <utility>
+
+#include "radix_sort.hpp"
+
+void RadixSort(JobSystem& jobs, unsigned int* keys, unsigned int* values, int count,
+    unsigned int* tmpKeys, unsigned int* tmpValues)
+{
+    if (count <= 1) return;
+
+    int blocks = (count + RADIX_SORT_GRAIN - 1) / RADIX_SORT_GRAIN;
+
+    // 256 counters per block; kept by the calling thread between sorts
+    static thread_local std::vector<unsigned int> hist;
+    hist.resize((size_t)blocks * 256);
+
+    unsigned int* srcK = keys;
+    unsigned int* srcV = values;
+    unsigned int* dstK = tmpKeys;
+    unsigned int* dstV = tmpValues;
+
+    for (int shift = 0; shift < 32; shift += 8) {
+        unsigned int* h = hist.data();
+        memset(h, 0, hist.size() * sizeof(unsigned int));
+
+        jobs.ParallelFor("radix histogram", count, RADIX_SORT_GRAIN, [=](int begin, int end)
+            {
+                unsigned int* bh = h + (size_t)(begin / RADIX_SORT_GRAIN) * 256;
+                for (int i = begin; i < end; i++) bh[(srcK[i] >> shift) & 0xFF]++;
+            });
+
+        // same digit everywhere: the order would not change
+        bool skip = false;
+        for (int d = 0; d < 256 && !skip; d++) {
+            unsigned int total = 0;
+            for (int b = 0; b < blocks; b++) total += h[b * 256 + d];
+            if (total == (unsigned int)count) skip = true;
+            else if (total != 0) break;
+        }
+        if (skip) continue;
+
+        // exclusive prefix, digit-major then block: block b writes after blocks 0..b-1
+        unsigned int sum = 0;
+        for (int d = 0; d < 256; d++) {
+            for (int b = 0; b < blocks; b++) {
+                unsigned int c = h[b * 256 + d];
+                h[b * 256 + d] = sum;
+                sum += c;
+            }
+        }
+
+        jobs.ParallelFor("radix scatter", count, RADIX_SORT_GRAIN, [=](int begin, int end)
+            {
+                unsigned int* bh = h + (size_t)(begin / RADIX_SORT_GRAIN) * 256;
+                for (int i = begin; i < end; i++) {
+                    unsigned int o = bh[(srcK[i] >> shift) & 0xFF]++;
+                    dstK[o] = srcK[i];
+                    dstV[o] = srcV[i];
+                }
+            });
+
+        std::swap(srcK, dstK);
+        std::swap(srcV, dstV);
+    }
+
+    if (srcK != keys) {
+        memcpy(keys, srcK, (size_t)count * sizeof(unsigned int));
+        memcpy(values, srcV, (size_t)count * sizeof(unsigned int));
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include "job_system.hpp"
+
+// Parallel LSD radix sort of 32-bit keys, each carrying a 32-bit value (an index); ascending, stable.
+// 4 passes of 8 bits; per pass: one histogram per block of RADIX_SORT_GRAIN keys (in parallel),
+// one prefix sum over (digit, block) on the calling thread, then every block scatters its keys
+// to their final slots (in parallel, stable because blocks are laid out in order).
+// A pass whose digit is the same for every key moves nothing and is skipped.
+//
+// keys/values and the two scratch arrays hold `count` items; the result ends up in keys/values.
+
+static const int RADIX_SORT_GRAIN = 8192;
+
+void RadixSort(JobSystem& jobs, unsigned int* keys, unsigned int* values, int count,
+    unsigned int* tmpKeys, unsigned int* tmpValues);
+
+#endif
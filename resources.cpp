@@ -0,0 +1,73 @@
+// Resource caches (see resources.hpp): the loaders of the concrete asset types.
+
+#include <stdio.h>
+
+#include "resources.hpp"
+
+const char* ResourceStateName(ResourceState s)
+{
+    switch (s) {
+    case RES_LOADING: return "loading";
+    case RES_READY: return "ready";
+    case RES_FAILED: return "failed";
+    default: return "unloaded";
+    }
+}
+
+// ---------------- Meshes ----------------
+template <typename V>
+static size_t vectorBytes(const std::vector<V>& v)
+{
+    return v.size() * sizeof(V);
+}
+
+static size_t meshBytes(const ObjMesh& m)
+{
+    return vectorBytes(m.positions) + vectorBytes(m.uvs) + vectorBytes(m.normals) +
+        vectorBytes(m.tangents) + vectorBytes(m.bitangents) + vectorBytes(m.indices);
+}
+
+// tangents/bitangents follow from the rest
+static unsigned long long meshHash(const ObjMesh& m)
+{
+    unsigned long long h = HashBytes(m.positions.data(), vectorBytes(m.positions));
+    h = HashBytes(m.uvs.data(), vectorBytes(m.uvs), h);
+    h = HashBytes(m.normals.data(), vectorBytes(m.normals), h);
+    return HashBytes(m.indices.data(), vectorBytes(m.indices), h);
+}
+
+void InitMeshCache(MeshCache& cache, size_t budgetBytes)
+{
+    cache.Init("Meshes",
+        [](const std::string& path, ObjMesh& mesh) { return loadOBJ2(path.c_str(), mesh, true); },
+        meshBytes, meshHash, budgetBytes);
+}
+
+// ---------------- Images ----------------
+// levels mapped from the asset pack are not counted: they cost no heap
+static size_t imageBytes(const DecodedImage& img)
+{
+    size_t bytes = 0;
+    for (const auto& level : img.mips) bytes += level.size();
+    return bytes;
+}
+
+// the top level decides the rest of the chain
+static unsigned long long imageHash(const DecodedImage& img)
+{
+    int header[3] = { img.width, img.height, (int)img.format };
+    unsigned long long h = HashBytes(header, sizeof(header));
+    return img.Levels() ? HashBytes(img.LevelData(0), img.LevelBytes(0), h) : h;
+}
+
+void InitImageCache(ImageCache& cache, const TextureDecoder& decoder, size_t budgetBytes)
+{
+    cache.Init("Images",
+        [&decoder](const std::string& path, DecodedImage& img)
+        {
+            img.path = path;
+            decoder.Decode(img);
+            return img.ok;
+        },
+        imageBytes, imageHash, budgetBytes);
+}
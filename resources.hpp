@@ -0,0 +1,361 @@
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <stdio.h>
+
+#include "job_system.hpp"
+#include "objloader.hpp"
+#include "texture_loader.hpp"
+
+// Resource caches: one per asset type, every loaded asset lives in exactly one slot.
+// - handles are (slot index, generation); a slot gets a new generation when it is evicted and
+//   reused, so a stale handle simply resolves to nothing instead of to another asset
+// - dedup by path (a second Acquire of the same path is a cache hit) and by content: once loaded,
+//   an asset whose hash matches one already resident drops its copy and aliases that one
+// - refcounted: Acquire/AddRef +1, Release -1; at 0 the asset stays cached (a later Acquire is
+//   free) but becomes evictable, least recently released first, whenever the cache is over
+//   its byte budget. Referenced assets are never evicted (the budget is soft)
+// - loads are synchronous (Acquire) or background jobs (AcquireAsync); State() tells
+//   UNLOADED / LOADING / READY / FAILED, Get() is non-null only when READY
+//
+// Thread safe; the data behind Get() does not change while a reference is held.
+
+enum ResourceState {
+    RES_UNLOADED = 0,   // null / stale handle
+    RES_LOADING,
+    RES_READY,
+    RES_FAILED
+};
+
+const char* ResourceStateName(ResourceState s);
+
+// FNV-1a, chained through `h` (content hashes)
+inline unsigned long long HashBytes(const void* data, size_t bytes, unsigned long long h = 1469598103934665603ULL)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < bytes; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+template <typename T>
+struct ResourceHandle {
+    unsigned int index = 0;
+    unsigned int generation = 0;    // 0 = null handle
+    bool IsNull() const { return generation == 0; }
+};
+
+template <typename T>
+class ResourceCache {
+public:
+    typedef ResourceHandle<T> Handle;
+    typedef std::function<bool(const std::string& path, T& out)> Loader;   // runs on any thread
+    typedef std::function<size_t(const T&)> SizeFn;                        // bytes held by the CPU copy
+    typedef std::function<unsigned long long(const T&)> HashFn;            // content hash
+
+    void Init(const char* cacheName, Loader l, SizeFn s, HashFn h, size_t budgetBytes)
+    {
+        name = cacheName;
+        loader = l;
+        sizeOf = s;
+        hashOf = h;
+        budget = budgetBytes;
+    }
+
+    // +1 reference; loads on this thread if needed (or waits for a load already running)
+    Handle Acquire(const std::string& path)
+    {
+        bool load = false;
+        Slot* s = nullptr;
+        Handle h = Lookup(path, load, s);
+        if (load) Load(s, path);
+        else WaitLoaded(s);
+        return h;
+    }
+
+    // +1 reference; a new path is loaded by a background job, State() is LOADING until then
+    Handle AcquireAsync(const std::string& path, JobSystem& js)
+    {
+        bool load = false;
+        Slot* s = nullptr;
+        Handle h = Lookup(path, load, s);
+        if (load) {
+            jobs = &js;
+            js.SpawnBackground("load resource", [this, s, path] { Load(s, path); }, &s->pending);
+        }
+        return h;
+    }
+
+    void AddRef(Handle h)
+    {
+        std::lock_guard<std::mutex> lk(m);
+        if (Slot* s = Resolve(h)) s->refs++;
+    }
+
+    void Release(Handle h)
+    {
+        std::lock_guard<std::mutex> lk(m);
+        Slot* s = Resolve(h);
+        if (!s || s->refs == 0) return;
+        if (--s->refs == 0) s->lastUse = ++tick;
+        EvictOverBudget();
+    }
+
+    ResourceState State(Handle h) const
+    {
+        std::lock_guard<std::mutex> lk(m);
+        const Slot* s = Resolve(h);
+        return s ? s->state : RES_UNLOADED;
+    }
+
+    // the loaded asset (the shared copy for content duplicates); nullptr unless READY
+    const T* Get(Handle h) const
+    {
+        std::lock_guard<std::mutex> lk(m);
+        const Slot* s = Resolve(h);
+        if (!s || s->state != RES_READY) return nullptr;
+        if (s->alias >= 0) s = slots[s->alias].get();
+        return &s->data;
+    }
+
+    // same data behind both handles (same path, or content duplicates)
+    bool Same(Handle a, Handle b) const
+    {
+        std::lock_guard<std::mutex> lk(m);
+        const Slot* sa = Resolve(a);
+        const Slot* sb = Resolve(b);
+        if (!sa || !sb || sa->state != RES_READY || sb->state != RES_READY) return false;
+        int ca = sa->alias >= 0 ? sa->alias : (int)a.index;
+        int cb = sb->alias >= 0 ? sb->alias : (int)b.index;
+        return ca == cb;
+    }
+
+    void SetBudget(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lk(m);
+        budget = bytes;
+        EvictOverBudget();
+    }
+    size_t Budget() const { return budget; }
+
+    size_t ResidentBytes() const
+    {
+        std::lock_guard<std::mutex> lk(m);
+        return resident;
+    }
+
+    // drops every unreferenced asset (loads still running are left alone)
+    int Purge()
+    {
+        std::lock_guard<std::mutex> lk(m);
+        int n = 0;
+        for (size_t i = 0; i < slots.size(); i++) {
+            const Slot& s = *slots[i];
+            if (s.refs == 0 && (s.state == RES_READY || s.state == RES_FAILED)) { Evict((unsigned int)i); n++; }
+        }
+        return n;
+    }
+
+    // one line per live slot + totals
+    void Print() const
+    {
+        std::lock_guard<std::mutex> lk(m);
+        printf("\n%s: %.2f / %.2f MB, %u loads, %u path hits, %u content hits, %u evictions\n", name,
+            resident / (1024.0 * 1024.0), budget / (1024.0 * 1024.0), loads, pathHits, contentHits, evictions);
+        for (size_t i = 0; i < slots.size(); i++) {
+            const Slot& s = *slots[i];
+            if (s.state == RES_UNLOADED) continue;
+            printf("  [%2zu:%u] %-8s refs %-3d %8.1f KB  %s", i, s.generation, ResourceStateName(s.state),
+                s.refs, s.bytes / 1024.0, s.path.c_str());
+            if (s.alias >= 0) printf("  (= %s)", slots[s.alias]->path.c_str());
+            printf("\n");
+        }
+    }
+
+private:
+    struct Slot {
+        std::string path;
+        unsigned int index = 0;
+        T data;
+        ResourceState state = RES_UNLOADED;
+        unsigned int generation = 1;
+        int refs = 0;
+        int alias = -1;                 // content duplicate of that slot (holds one ref on it)
+        size_t bytes = 0;
+        unsigned long long hash = 0;
+        unsigned long long lastUse = 0; // tick of the last release to 0
+        JobCounter pending;             // async load
+    };
+
+    // under m; nullptr for null / stale handles
+    Slot* Resolve(Handle h) const
+    {
+        if (h.IsNull() || h.index >= slots.size()) return nullptr;
+        Slot* s = slots[h.index].get();
+        return s->generation == h.generation ? s : nullptr;
+    }
+
+    Handle Lookup(const std::string& path, bool& load, Slot*& slot)
+    {
+        std::lock_guard<std::mutex> lk(m);
+        Handle h;
+
+        auto it = byPath.find(path);
+        if (it != byPath.end()) {
+            Slot& s = *slots[it->second];
+            s.refs++;
+            pathHits++;
+            h.index = it->second;
+            h.generation = s.generation;
+            load = false;
+            slot = &s;
+            return h;
+        }
+
+        unsigned int idx;
+        if (!freeSlots.empty()) {
+            idx = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else {
+            idx = (unsigned int)slots.size();
+            slots.emplace_back(new Slot());
+            slots[idx]->index = idx;
+        }
+
+        Slot& s = *slots[idx];
+        s.path = path;
+        s.state = RES_LOADING;
+        s.refs = 1;
+        byPath[path] = idx;
+
+        h.index = idx;
+        h.generation = s.generation;
+        load = true;
+        slot = &s;
+        return h;
+    }
+
+    // the slot is referenced by the caller, so it stays put while this runs unlocked
+    void Load(Slot* slot, const std::string& path)
+    {
+        T tmp;
+        bool ok = loader(path, tmp);
+        size_t bytes = ok ? sizeOf(tmp) : 0;
+        unsigned long long hash = ok ? hashOf(tmp) : 0;
+
+        {
+            std::lock_guard<std::mutex> lk(m);
+            Slot& s = *slot;
+            unsigned int idx = s.index;
+            loads++;
+            s.state = ok ? RES_READY : RES_FAILED;
+            s.hash = hash;
+
+            auto dup = ok ? byHash.find(hash) : byHash.end();
+            if (dup != byHash.end() && dup->second != idx) {
+                // same content under another path: keep a single copy
+                s.alias = (int)dup->second;
+                slots[dup->second]->refs++;
+                contentHits++;
+            }
+            else if (ok) {
+                s.data = std::move(tmp);
+                s.bytes = bytes;
+                resident += bytes;
+                byHash[hash] = idx;
+            }
+            EvictOverBudget();
+        }
+        loaded.notify_all();
+    }
+
+    void WaitLoaded(Slot* s)
+    {
+        if (JobSystem* js = jobs.load()) js->Wait(s->pending);  // helps with the queue instead of blocking a worker
+
+        std::unique_lock<std::mutex> lk(m);
+        loaded.wait(lk, [s] { return s->state != RES_LOADING; });
+    }
+
+    // under m; unreferenced assets, least recently released first
+    void EvictOverBudget()
+    {
+        while (resident > budget) {
+            int victim = -1;
+            for (size_t i = 0; i < slots.size(); i++) {
+                const Slot& s = *slots[i];
+                // aliases free nothing themselves but hold a ref on the copy they share
+                if (s.refs != 0 || s.state != RES_READY) continue;
+                if (victim < 0 || s.lastUse < slots[victim]->lastUse) victim = (int)i;
+            }
+            if (victim < 0) return;
+            Evict((unsigned int)victim);
+        }
+    }
+
+    // under m
+    void Evict(unsigned int idx)
+    {
+        Slot& s = *slots[idx];
+
+        byPath.erase(s.path);
+        auto it = byHash.find(s.hash);
+        if (it != byHash.end() && it->second == idx) byHash.erase(it);
+
+        if (s.alias >= 0) {
+            Slot& c = *slots[s.alias];
+            if (--c.refs == 0) c.lastUse = ++tick;
+        }
+
+        resident -= s.bytes;
+        s.data = T();
+        s.path.clear();
+        s.state = RES_UNLOADED;
+        s.alias = -1;
+        s.bytes = 0;
+        s.hash = 0;
+        if (++s.generation == 0) s.generation = 1;
+        freeSlots.push_back(idx);
+        evictions++;
+    }
+
+    const char* name = "resources";
+    Loader loader;
+    SizeFn sizeOf;
+    HashFn hashOf;
+    std::atomic<JobSystem*> jobs{ nullptr };   // set by the first AcquireAsync
+
+    mutable std::mutex m;
+    std::condition_variable loaded;
+    std::vector<std::unique_ptr<Slot> > slots;  // Slot never moves: Get() pointers stay valid
+    std::vector<unsigned int> freeSlots;
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::unordered_map<unsigned long long, unsigned int> byHash;
+
+    size_t budget = 0;
+    size_t resident = 0;
+    unsigned long long tick = 0;
+    unsigned int loads = 0, pathHits = 0, contentHits = 0, evictions = 0;
+};
+
+// the two asset types loaded from files: OBJ props and decoded texture images
+typedef ResourceCache<ObjMesh> MeshCache;
+typedef ResourceCache<DecodedImage> ImageCache;
+
+void InitMeshCache(MeshCache& cache, size_t budgetBytes);
+
+// images go through decoder.Decode (pack source, .ktx, SOIL + mips); decoder must outlive the cache
+void InitImageCache(ImageCache& cache, const TextureDecoder& decoder, size_t budgetBytes);
+
+#endif
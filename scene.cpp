@@ -0,0 +1,775 @@
+// Alley geometry (see scene.hpp). Moved out of main.cpp so the bundler can run it offline.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "scene.hpp"
+#include "objloader.hpp"
+#include "cpu_profiler.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+static const float PI = 3.1415926535f;
+
+const SceneTexture SCENE_TEXTURES[] = {
+    { "asphalt.jpg", false },
+    { "asphalt_n.jpg", true },
+    { "wall.jpg", false },
+    { "wall_n.jpg", true },
+    { "sign3.png", false }
+};
+const int SCENE_TEXTURE_COUNT = (int)(sizeof(SCENE_TEXTURES) / sizeof(SCENE_TEXTURES[0]));
+
+// unindexed triangles while building; BuildAlley welds them at the end
+// (per thread: streamed cells are built on several workers at once)
+static thread_local std::vector<Vtx> gVertices;
+
+// ---------------- Geometry helpers ----------------
+static void pushTri(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2,
+    const glm::vec3& n, const glm::vec3& col,
+    const glm::vec2& uv0, const glm::vec2& uv1, const glm::vec2& uv2,
+    float texId,
+    const glm::vec3& tan, const glm::vec3& bit)
+{
+    // only the handedness of the bitangent is stored
+    float w = (glm::dot(glm::cross(n, tan), bit) < 0.0f) ? -1.0f : 1.0f;
+    glm::vec4 t(tan, w);
+
+    gVertices.push_back({ glm::vec4(p0, 1.0f), col, n, uv0, texId, t });
+    gVertices.push_back({ glm::vec4(p1, 1.0f), col, n, uv1, texId, t });
+    gVertices.push_back({ glm::vec4(p2, 1.0f), col, n, uv2, texId, t });
+}
+
+static void computeTBN(
+    const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2,
+    const glm::vec2& uv0, const glm::vec2& uv1, const glm::vec2& uv2,
+    glm::vec3& outT, glm::vec3& outB)
+{
+    glm::vec3 e1 = p1 - p0;
+    glm::vec3 e2 = p2 - p0;
+    glm::vec2 dUV1 = uv1 - uv0;
+    glm::vec2 dUV2 = uv2 - uv0;
+
+    float denom = (dUV1.x * dUV2.y - dUV2.x * dUV1.y);
+    if (fabsf(denom) < 1e-20f) {
+        outT = glm::vec3(1, 0, 0);
+        outB = glm::vec3(0, 1, 0);
+        return;
+    }
+
+    float f = 1.0f / denom;
+    outT = f * (e1 * dUV2.y - e2 * dUV1.y);
+    outB = f * (-e1 * dUV2.x + e2 * dUV1.x);
+
+    outT = glm::normalize(outT);
+    outB = glm::normalize(outB);
+}
+
+static void appendQuad(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3,
+    const glm::vec3& n, const glm::vec3& col,
+    const glm::vec2& uv0, const glm::vec2& uv1, const glm::vec2& uv2, const glm::vec2& uv3,
+    float texId)
+{
+    glm::vec3 T1, B1;
+    computeTBN(p0, p1, p2, uv0, uv1, uv2, T1, B1);
+    pushTri(p0, p1, p2, n, col, uv0, uv1, uv2, texId, T1, B1);
+
+    glm::vec3 T2, B2;
+    computeTBN(p0, p2, p3, uv0, uv2, uv3, T2, B2);
+    pushTri(p0, p2, p3, n, col, uv0, uv2, uv3, texId, T2, B2);
+}
+
+// Steam billboards (texIdSteam = steam material)
+static void appendSteamPuff(const glm::vec3& center, float height, float radius, float texIdSteam, float intensity)
+{
+    glm::vec3 col(intensity, intensity, intensity); // intensity packed in vColor.r
+
+    auto addBillboard = [&](float ang)
+        {
+            glm::vec3 right = glm::vec3(cosf(ang), sinf(ang), 0.0f) * radius;
+            glm::vec3 up = glm::vec3(0.0f, 0.0f, height);
+
+            glm::vec3 p0 = center - right;
+            glm::vec3 p1 = center + right;
+            glm::vec3 p2 = center + right + up;
+            glm::vec3 p3 = center - right + up;
+
+            glm::vec3 n(0, 1, 0);
+            glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+
+            glm::vec3 T(1, 0, 0), B(0, 0, 1);
+
+            pushTri(p0, p1, p2, n, col, uv0, uv1, uv2, texIdSteam, T, B);
+            pushTri(p0, p2, p3, n, col, uv0, uv2, uv3, texIdSteam, T, B);
+        };
+
+    addBillboard(0.0f);
+    addBillboard(PI * 0.5f);
+    addBillboard(PI * 0.25f);
+}
+
+// OBJ mesh append
+static void appendObjMesh(const ObjMesh& m, const glm::mat4& M, const glm::vec3& col, float texId, bool forceUpNormals = false)
+{
+    glm::mat3 Nmat = glm::transpose(glm::inverse(glm::mat3(M)));
+
+    size_t triCount = m.positions.size() / 3;
+    for (size_t i = 0; i < triCount; i++) {
+        glm::vec3 p0 = glm::vec3(M * glm::vec4(m.positions[i * 3 + 0], 1.0f));
+        glm::vec3 p1 = glm::vec3(M * glm::vec4(m.positions[i * 3 + 1], 1.0f));
+        glm::vec3 p2 = glm::vec3(M * glm::vec4(m.positions[i * 3 + 2], 1.0f));
+
+        glm::vec3 n0 = glm::normalize(Nmat * m.normals[i * 3 + 0]);
+        glm::vec3 n1 = glm::normalize(Nmat * m.normals[i * 3 + 1]);
+        glm::vec3 n2 = glm::normalize(Nmat * m.normals[i * 3 + 2]);
+
+        if (forceUpNormals) {
+            n0 = n1 = n2 = glm::vec3(0, 0, 1);
+        }
+
+        glm::vec2 uv0(0, 0), uv1(0, 0), uv2(0, 0);
+        if (m.uvs.size() == m.positions.size()) {
+            uv0 = m.uvs[i * 3 + 0];
+            uv1 = m.uvs[i * 3 + 1];
+            uv2 = m.uvs[i * 3 + 2];
+        }
+
+        glm::vec3 t0(1, 0, 0), b0(0, 1, 0);
+        if (m.tangents.size() == m.positions.size() && m.bitangents.size() == m.positions.size()) {
+            t0 = glm::normalize(Nmat * m.tangents[i * 3 + 0]);
+            b0 = glm::normalize(Nmat * m.bitangents[i * 3 + 0]);
+        }
+
+        pushTri(p0, p1, p2, n0, col, uv0, uv1, uv2, texId, t0, b0);
+    }
+}
+
+// --- forward decls for wall/pipe/ladder/cable helpers ---
+static void appendThinPipePrism(
+    float xPlane, float yCenter, float z0, float z1, float r, bool onLeftWall,
+    const glm::vec3& col, float texIdWall);
+
+static void appendWallBox(
+    float xPlane, float yCenter, float zCenter,
+    float sx, float sy, float sz, bool onLeftWall,
+    const glm::vec3& col, float texIdWall);
+
+static void appendWallLadder(
+    float xPlane, float yCenter, float z0,
+    float height, float width, bool onLeftWall,
+    const glm::vec3& col, float texIdWall);
+
+static void appendWallVent(
+    float xPlane, float yCenter, float zCenter,
+    float w, float h, bool onLeftWall,
+    const glm::vec3& col, float texIdWall);
+
+static void appendCable(
+    const glm::vec3& pA, const glm::vec3& pB,
+    float sag, int segments, float halfWidth,
+    const glm::vec3& col, float texIdWall,
+    const glm::vec3& sway = glm::vec3(0.0f)); // mid-span displacement (wind), 0 at the ends
+
+// ----------------------------
+// Helpers implementations (same as your version)
+// ----------------------------
+static void appendThinPipePrism(
+    float xPlane,
+    float yCenter,
+    float z0, float z1,
+    float r,
+    bool onLeftWall,
+    const glm::vec3& col,
+    float texIdWall)
+{
+    float xIn = xPlane + (onLeftWall ? +0.01f : -0.01f);
+
+    float x0 = xIn - (onLeftWall ? 0.0f : r);
+    float x1 = xIn + (onLeftWall ? r : 0.0f);
+
+    float y0 = yCenter - r;
+    float y1 = yCenter + r;
+
+    glm::vec3 A(x0, y0, z0);
+    glm::vec3 B(x0, y1, z0);
+    glm::vec3 C(x0, y1, z1);
+    glm::vec3 D(x0, y0, z1);
+
+    glm::vec3 E(x1, y0, z0);
+    glm::vec3 F(x1, y1, z0);
+    glm::vec3 G(x1, y1, z1);
+    glm::vec3 H(x1, y0, z1);
+
+    glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+
+    appendQuad(A, B, C, D, glm::vec3(-1, 0, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+    appendQuad(E, H, G, F, glm::vec3(1, 0, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+
+    appendQuad(A, D, H, E, glm::vec3(0, -1, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+    appendQuad(B, F, G, C, glm::vec3(0, 1, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+
+    appendQuad(A, E, F, B, glm::vec3(0, 0, -1), col, uv0, uv1, uv2, uv3, texIdWall);
+    appendQuad(D, C, G, H, glm::vec3(0, 0, 1), col, uv0, uv1, uv2, uv3, texIdWall);
+}
+
+static void appendWallBox(
+    float xPlane,
+    float yCenter,
+    float zCenter,
+    float sx, float sy, float sz,
+    bool onLeftWall,
+    const glm::vec3& col,
+    float texIdWall)
+{
+    float xIn = xPlane + (onLeftWall ? +0.03f : -0.03f);
+
+    float x0 = xIn - (onLeftWall ? 0.0f : sx);
+    float x1 = xIn + (onLeftWall ? sx : 0.0f);
+
+    float y0 = yCenter - sy;
+    float y1 = yCenter + sy;
+    float z0 = zCenter - sz;
+    float z1 = zCenter + sz;
+
+    glm::vec3 A(x0, y0, z0);
+    glm::vec3 B(x0, y1, z0);
+    glm::vec3 C(x0, y1, z1);
+    glm::vec3 D(x0, y0, z1);
+
+    glm::vec3 E(x1, y0, z0);
+    glm::vec3 F(x1, y1, z0);
+    glm::vec3 G(x1, y1, z1);
+    glm::vec3 H(x1, y0, z1);
+
+    glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+
+    appendQuad(A, B, C, D, glm::vec3(-1, 0, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+    appendQuad(E, H, G, F, glm::vec3(1, 0, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+
+    appendQuad(A, D, H, E, glm::vec3(0, -1, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+    appendQuad(B, F, G, C, glm::vec3(0, 1, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+
+    appendQuad(A, E, F, B, glm::vec3(0, 0, -1), col, uv0, uv1, uv2, uv3, texIdWall);
+    appendQuad(D, C, G, H, glm::vec3(0, 0, 1), col, uv0, uv1, uv2, uv3, texIdWall);
+}
+
+static void appendWallLadder(
+    float xPlane,
+    float yCenter,
+    float z0,
+    float height,
+    float width,
+    bool onLeftWall,
+    const glm::vec3& col,
+    float texIdWall)
+{
+    float railR = 0.02f;
+    float stepR = 0.015f;
+
+    float yL = yCenter - width * 0.5f;
+    float yR = yCenter + width * 0.5f;
+
+    appendThinPipePrism(xPlane, yL, z0, z0 + height, railR, onLeftWall, col, texIdWall);
+    appendThinPipePrism(xPlane, yR, z0, z0 + height, railR, onLeftWall, col, texIdWall);
+
+    int steps = (int)(height / 0.35f);
+    if (steps < 3) steps = 3;
+
+    float xIn = xPlane + (onLeftWall ? +0.03f : -0.03f);
+    float x0 = xIn - (onLeftWall ? 0.0f : stepR);
+    float x1 = xIn + (onLeftWall ? stepR : 0.0f);
+
+    for (int i = 0; i <= steps; i++) {
+        float z = z0 + (height * (float)i / (float)steps);
+
+        float y0 = yL;
+        float y1 = yR;
+
+        float z0s = z - stepR;
+        float z1s = z + stepR;
+
+        glm::vec3 A(x0, y0, z0s);
+        glm::vec3 B(x0, y1, z0s);
+        glm::vec3 C(x0, y1, z1s);
+        glm::vec3 D(x0, y0, z1s);
+
+        glm::vec3 E(x1, y0, z0s);
+        glm::vec3 F(x1, y1, z0s);
+        glm::vec3 G(x1, y1, z1s);
+        glm::vec3 H(x1, y0, z1s);
+
+        glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+
+        appendQuad(A, B, C, D, glm::vec3(-1, 0, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+        appendQuad(E, H, G, F, glm::vec3(1, 0, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+
+        appendQuad(A, D, H, E, glm::vec3(0, -1, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+        appendQuad(B, F, G, C, glm::vec3(0, 1, 0), col, uv0, uv1, uv2, uv3, texIdWall);
+
+        appendQuad(A, E, F, B, glm::vec3(0, 0, -1), col, uv0, uv1, uv2, uv3, texIdWall);
+        appendQuad(D, C, G, H, glm::vec3(0, 0, 1), col, uv0, uv1, uv2, uv3, texIdWall);
+    }
+}
+
+static void appendWallVent(
+    float xPlane,
+    float yCenter,
+    float zCenter,
+    float w, float h,
+    bool onLeftWall,
+    const glm::vec3& col,
+    float texIdWall)
+{
+    float x = xPlane + (onLeftWall ? +0.02f : -0.02f);
+    glm::vec3 n = onLeftWall ? glm::vec3(1, 0, 0) : glm::vec3(-1, 0, 0);
+
+    glm::vec3 p0(x, yCenter - w * 0.5f, zCenter - h * 0.5f);
+    glm::vec3 p1(x, yCenter + w * 0.5f, zCenter - h * 0.5f);
+    glm::vec3 p2(x, yCenter + w * 0.5f, zCenter + h * 0.5f);
+    glm::vec3 p3(x, yCenter - w * 0.5f, zCenter + h * 0.5f);
+
+    glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+    appendQuad(p0, p1, p2, p3, n, col, uv0, uv1, uv2, uv3, texIdWall);
+
+    float r = 0.015f;
+    appendThinPipePrism(xPlane, yCenter - w * 0.5f, zCenter - h * 0.5f, zCenter + h * 0.5f, r, onLeftWall, col, texIdWall);
+    appendThinPipePrism(xPlane, yCenter + w * 0.5f, zCenter - h * 0.5f, zCenter + h * 0.5f, r, onLeftWall, col, texIdWall);
+}
+
+static void appendCable(
+    const glm::vec3& pA,
+    const glm::vec3& pB,
+    float sag,
+    int segments,
+    float halfWidth,
+    const glm::vec3& col,
+    float texIdWall,
+    const glm::vec3& sway)
+{
+    auto pointAt = [&](float t) -> glm::vec3 {
+        glm::vec3 p = (1.0f - t) * pA + t * pB;
+        float s = 4.0f * t * (1.0f - t);
+        p.z -= sag * s;
+        p += sway * s;
+        return p;
+        };
+
+    glm::vec3 up(0, 0, 1);
+
+    for (int i = 0; i < segments; i++) {
+        float t0 = (float)i / (float)segments;
+        float t1 = (float)(i + 1) / (float)segments;
+
+        glm::vec3 a = pointAt(t0);
+        glm::vec3 b = pointAt(t1);
+
+        glm::vec3 dir = b - a;
+        float len2 = glm::dot(dir, dir);
+        if (len2 < 1e-10f) continue;
+        dir = glm::normalize(dir);
+
+        glm::vec3 side = glm::cross(dir, up);
+        float s2 = glm::dot(side, side);
+        if (s2 < 1e-10f) side = glm::vec3(1, 0, 0);
+        else side = glm::normalize(side);
+
+        glm::vec3 o = side * halfWidth;
+
+        glm::vec3 p0 = a - o;
+        glm::vec3 p1 = a + o;
+        glm::vec3 p2 = b + o;
+        glm::vec3 p3 = b - o;
+
+        glm::vec3 n = glm::normalize(glm::cross(p1 - p0, p3 - p0));
+        if (glm::dot(n, n) < 1e-10f) n = glm::vec3(0, 1, 0);
+
+        glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+        appendQuad(p0, p1, p2, p3, n, col, uv0, uv1, uv2, uv3, texIdWall);
+
+        glm::vec3 side2 = glm::normalize(glm::cross(dir, side));
+        glm::vec3 o2 = side2 * halfWidth;
+
+        glm::vec3 q0 = a - o2;
+        glm::vec3 q1 = a + o2;
+        glm::vec3 q2 = b + o2;
+        glm::vec3 q3 = b - o2;
+
+        glm::vec3 n2 = glm::normalize(glm::cross(q1 - q0, q3 - q0));
+        if (glm::dot(n2, n2) < 1e-10f) n2 = glm::vec3(1, 0, 0);
+
+        appendQuad(q0, q1, q2, q3, n2, col, uv0, uv1, uv2, uv3, texIdWall);
+    }
+}
+
+// ---------------- Build scene ----------------
+void BuildAlley(SceneData& scene, MeshCache& meshes, bool animatedProps)
+{
+    CPU_ZONE("BuildAlley");
+    gVertices.clear();
+    gVertices.reserve(200000);
+    scene.instances.clear();
+    scene.batches.clear();
+    scene.cables.clear();
+    scene.steam.clear();
+
+    SceneRanges& r = scene.ranges;
+
+    float halfW = 2.2f;
+    float len = 10.0f;
+    float wallH = 6.0f;
+
+    glm::vec3 tint(1.0f, 1.0f, 1.0f);
+
+    const float TEX_ASPHALT = (float)SCENE_MAT_ASPHALT;
+    const float TEX_WALL = (float)SCENE_MAT_WALL;
+    const float TEX_SIGN = (float)SCENE_MAT_SIGN;
+    const float TEX_STEAM = (float)SCENE_MAT_STEAM;
+
+    // everything appended since the last call becomes one batch of `pass`
+    int batchFirst = 0;
+    auto closeBatch = [&](ScenePass pass)
+        {
+            int first = batchFirst;
+            int count = (int)gVertices.size() - first;
+            batchFirst = (int)gVertices.size();
+            if (count == 0) return;
+
+            glm::vec3 lo(gVertices[first].pos), hi(gVertices[first].pos);
+            for (int i = first + 1; i < first + count; i++) {
+                lo = glm::min(lo, glm::vec3(gVertices[i].pos));
+                hi = glm::max(hi, glm::vec3(gVertices[i].pos));
+            }
+            SceneBatch b;
+            b.first = first;
+            b.count = count;
+            b.pass = pass;
+            b.center = (lo + hi) * 0.5f;
+            b.radius = glm::length(hi - lo) * 0.5f;
+            scene.batches.push_back(b);
+        };
+
+    // ground
+    r.groundFirst = (int)gVertices.size();
+    {
+        glm::vec3 p0(-halfW, -len * 0.5f, 0.0f);
+        glm::vec3 p1(halfW, -len * 0.5f, 0.0f);
+        glm::vec3 p2(halfW, len * 0.5f, 0.0f);
+        glm::vec3 p3(-halfW, len * 0.5f, 0.0f);
+
+        glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+        appendQuad(p0, p1, p2, p3, glm::vec3(0, 0, 1), tint, uv0, uv1, uv2, uv3, TEX_ASPHALT);
+    }
+    r.groundCount = (int)gVertices.size() - r.groundFirst;
+    closeBatch(SCENE_PASS_OPAQUE);
+
+    // everything after this is considered "casters"
+    r.castersFirst = (int)gVertices.size();
+
+    // walls + end wall
+    {
+        glm::vec3 p0(-halfW, -len * 0.5f, 0.0f);
+        glm::vec3 p1(-halfW, len * 0.5f, 0.0f);
+        glm::vec3 p2(-halfW, len * 0.5f, wallH);
+        glm::vec3 p3(-halfW, -len * 0.5f, wallH);
+        glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+        appendQuad(p0, p1, p2, p3, glm::vec3(1, 0, 0), tint, uv0, uv1, uv2, uv3, TEX_WALL);
+    }
+    closeBatch(SCENE_PASS_OPAQUE);
+    {
+        glm::vec3 p0(halfW, len * 0.5f, 0.0f);
+        glm::vec3 p1(halfW, -len * 0.5f, 0.0f);
+        glm::vec3 p2(halfW, -len * 0.5f, wallH);
+        glm::vec3 p3(halfW, len * 0.5f, wallH);
+        glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+        appendQuad(p0, p1, p2, p3, glm::vec3(-1, 0, 0), tint, uv0, uv1, uv2, uv3, TEX_WALL);
+    }
+    closeBatch(SCENE_PASS_OPAQUE);
+    {
+        float y = len * 0.5f;
+        glm::vec3 p0(-halfW, y, 0.0f);
+        glm::vec3 p1(halfW, y, 0.0f);
+        glm::vec3 p2(halfW, y, wallH);
+        glm::vec3 p3(-halfW, y, wallH);
+        glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+        appendQuad(p0, p1, p2, p3, glm::vec3(0, -1, 0), tint, uv0, uv1, uv2, uv3, TEX_WALL);
+    }
+    closeBatch(SCENE_PASS_OPAQUE);
+
+    // props (trash + manhole), shared through the mesh cache (loaded once, reused by later builds)
+    MeshCache::Handle trashHandle = meshes.Acquire("trashcan.obj");
+    MeshCache::Handle manholeHandle = meshes.Acquire("manhole.obj");
+    const ObjMesh* trashMesh = meshes.Get(trashHandle);
+    const ObjMesh* manholeMesh = meshes.Get(manholeHandle);
+    if (!trashMesh) printf("WARN: could not load trashcan.obj\n");
+    if (!manholeMesh) printf("WARN: could not load manhole.obj\n");
+
+    const float TRASH_SCALE = 1.8f;
+
+    auto addInstance = [&](const char* mesh, const glm::mat4& M, int first)
+        {
+            SceneInstance inst = {};
+            snprintf(inst.mesh, sizeof(inst.mesh), "%s", mesh);
+            inst.model = M;
+            inst.first = first;
+            inst.count = (int)gVertices.size() - first;
+            scene.instances.push_back(inst);
+            closeBatch(SCENE_PASS_OPAQUE);
+        };
+
+    auto placeTrash = [&](glm::vec3 pos, float rotZ, glm::vec3 col)
+        {
+            if (!trashMesh || trashMesh->positions.empty()) return;
+            glm::mat4 M =
+                glm::translate(glm::mat4(1.0f), pos) *
+                glm::rotate(glm::mat4(1.0f), rotZ, glm::vec3(0, 0, 1)) *
+                glm::scale(glm::mat4(1.0f), glm::vec3(TRASH_SCALE));
+            int first = (int)gVertices.size();
+            appendObjMesh(*trashMesh, M, col, TEX_ASPHALT);
+            addInstance("trashcan.obj", M, first);
+        };
+
+    placeTrash(glm::vec3(-1.35f, -3.2f, 0.0f), 0.6f, glm::vec3(0.95f));
+    placeTrash(glm::vec3(1.25f, 1.3f, 0.0f), 2.9f, glm::vec3(0.95f));
+
+    auto placeManhole = [&](glm::vec3 pos, float rotZ)
+        {
+            if (!manholeMesh || manholeMesh->positions.empty()) return;
+            glm::mat4 M =
+                glm::translate(glm::mat4(1.0f), pos) *
+                glm::rotate(glm::mat4(1.0f), rotZ, glm::vec3(0, 0, 1)) *
+                glm::scale(glm::mat4(1.0f), glm::vec3(1.0f));
+            M = glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, 0.002f)) * M;
+            int first = (int)gVertices.size();
+            appendObjMesh(*manholeMesh, M, tint, TEX_ASPHALT, true);
+            addInstance("manhole.obj", M, first);
+        };
+
+    placeManhole(glm::vec3(0.2f, -2.6f, 0.0f), 0.4f);
+    placeManhole(glm::vec3(-0.6f, 0.2f, 0.0f), 1.0f);
+
+    meshes.Release(trashHandle);
+    meshes.Release(manholeHandle);
+
+    // ------------------------------------------------------------
+    // ADD ALL OTHER GEOMETRY THAT SHOULD CAST SHADOWS (including cables)
+    // ------------------------------------------------------------
+    {
+        glm::vec3 pipeCol(0.82f, 0.88f, 0.95f);
+
+        float rThin = 0.03f;
+        float rMed = 0.05f;
+
+        appendThinPipePrism(-halfW, -3.8f, 0.0f, 3.7f, rThin, true, pipeCol, TEX_WALL);
+        appendThinPipePrism(-halfW, -0.5f, 0.0f, 4.0f, rThin, true, pipeCol, TEX_WALL);
+        appendThinPipePrism(-halfW, 2.2f, 0.2f, 3.2f, rThin, true, pipeCol, TEX_WALL);
+
+        appendThinPipePrism(halfW, -2.4f, 0.0f, 3.6f, rThin, false, pipeCol, TEX_WALL);
+        appendThinPipePrism(halfW, 0.8f, 0.0f, 4.1f, rThin, false, pipeCol, TEX_WALL);
+
+        glm::vec3 boxCol(0.65f, 0.7f, 0.75f);
+        for (int i = 0; i < 6; i++) {
+            appendWallBox(-halfW, -1.5f + i * 0.35f, 3.2f, 0.04f, 0.12f, 0.04f, true, boxCol, TEX_WALL);
+        }
+        appendWallBox(-halfW, 0.7f, 3.2f, 0.06f, 0.10f, 0.06f, true, boxCol, TEX_WALL);
+
+        appendThinPipePrism(halfW, -0.8f, 0.3f, 3.9f, rMed, false, pipeCol, TEX_WALL);
+    }
+    closeBatch(SCENE_PASS_OPAQUE);
+
+    {
+        glm::vec3 boxCol(0.40f, 0.42f, 0.45f);
+        appendWallBox(-halfW, -3.0f, 2.8f, 0.10f, 0.18f, 0.16f, true, boxCol, TEX_WALL);
+        appendWallBox(-halfW, 1.1f, 2.2f, 0.09f, 0.15f, 0.14f, true, boxCol, TEX_WALL);
+
+        appendWallBox(halfW, -1.7f, 2.6f, 0.10f, 0.16f, 0.16f, false, boxCol, TEX_WALL);
+        appendWallBox(halfW, 2.0f, 2.9f, 0.08f, 0.14f, 0.12f, false, boxCol, TEX_WALL);
+    }
+    closeBatch(SCENE_PASS_OPAQUE);
+
+    {
+        glm::vec3 ventCol(0.55f, 0.55f, 0.58f);
+        appendWallVent(-halfW, -0.2f, 1.1f, 0.9f, 0.45f, true, ventCol, TEX_WALL);
+        appendWallVent(halfW, 1.5f, 1.4f, 0.7f, 0.35f, false, ventCol, TEX_WALL);
+
+        if (animatedProps) {
+            // vents blow out of the wall and a little upwards
+            scene.steam.push_back({ glm::vec3(-halfW + 0.06f, -0.2f, 1.1f), glm::normalize(glm::vec3(1.0f, 0.0f, 0.35f)), 1.2f, 0.16f, 0.6f, 0.7f });
+            scene.steam.push_back({ glm::vec3(halfW - 0.06f, 1.5f, 1.4f), glm::normalize(glm::vec3(-1.0f, 0.0f, 0.35f)), 1.0f, 0.13f, 0.5f, 3.3f });
+        }
+    }
+    closeBatch(SCENE_PASS_OPAQUE);
+
+    {
+        glm::vec3 ladderCol(0.35f, 0.37f, 0.40f);
+        appendWallLadder(-halfW, 3.4f, 0.4f, 3.3f, 0.55f, true, ladderCol, TEX_WALL);
+    }
+    closeBatch(SCENE_PASS_OPAQUE);
+
+    {
+        glm::vec3 metalCol(0.30f, 0.32f, 0.35f);
+        appendWallBox(halfW, 0.25f, 1.75f, 0.05f, 0.08f, 0.03f, false, metalCol, TEX_WALL);
+        appendWallBox(halfW, 0.75f, 1.75f, 0.05f, 0.08f, 0.03f, false, metalCol, TEX_WALL);
+        appendWallBox(halfW, 0.50f, 1.65f, 0.05f, 0.18f, 0.03f, false, metalCol, TEX_WALL);
+    }
+    closeBatch(SCENE_PASS_OPAQUE);
+
+    {
+        glm::vec3 cableCol(0.22f, 0.22f, 0.25f);
+        float xL = -halfW + 0.08f;
+        float xR = halfW - 0.08f;
+
+        float hw = 0.022f;
+
+        const SceneCable cables[] = {
+            { glm::vec3(xL, -1.8f, 3.3f), glm::vec3(xR, -1.2f, 3.1f), 0.55f, 18, hw, cableCol, 0.0f },
+            { glm::vec3(xL, 0.4f, 3.8f), glm::vec3(xR, 0.9f, 3.7f), 0.45f, 18, hw, cableCol, 1.7f },
+            { glm::vec3(xL, 2.6f, 3.0f), glm::vec3(xR, 2.2f, 3.2f), 0.40f, 16, hw, cableCol, 3.1f },
+
+            { glm::vec3(xL, -3.2f, 3.9f), glm::vec3(xR, -2.8f, 3.8f), 0.35f, 16, hw, cableCol, 4.4f },
+            { glm::vec3(xL, 1.8f, 3.95f), glm::vec3(xR, 1.5f, 3.9f), 0.30f, 14, hw, cableCol, 5.9f },
+
+            { glm::vec3(xL, -3.0f, 2.8f), glm::vec3(xL + 0.4f, -3.2f, 0.6f), 0.25f, 12, hw * 0.9f, cableCol, 0.8f },
+            { glm::vec3(xR, -1.7f, 2.6f), glm::vec3(xR - 0.35f, -1.9f, 0.7f), 0.25f, 12, hw * 0.9f, cableCol, 2.5f }
+        };
+        for (const SceneCable& c : cables) {
+            if (animatedProps) scene.cables.push_back(c);
+            else appendCable(c.a, c.b, c.sag, c.segments, c.halfWidth, c.col, TEX_WALL);
+        }
+    }
+    closeBatch(SCENE_PASS_OPAQUE);
+
+    // signs (alpha-tested; still shadow casters)
+    r.alphaTestFirst = (int)gVertices.size();
+    auto addSignLeft = [&](float y, float z, float w, float h)
+        {
+            float x = -halfW + 0.02f;
+            glm::vec3 p0(x, y - w * 0.5f, z - h * 0.5f);
+            glm::vec3 p1(x, y + w * 0.5f, z - h * 0.5f);
+            glm::vec3 p2(x, y + w * 0.5f, z + h * 0.5f);
+            glm::vec3 p3(x, y - w * 0.5f, z + h * 0.5f);
+            glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+            appendQuad(p0, p1, p2, p3, glm::vec3(1, 0, 0), tint, uv0, uv1, uv2, uv3, TEX_SIGN);
+            closeBatch(SCENE_PASS_ALPHA_TEST);
+        };
+
+    auto addSignRight = [&](float y, float z, float w, float h)
+        {
+            float x = halfW - 0.02f;
+            glm::vec3 p0(x, y + w * 0.5f, z - h * 0.5f);
+            glm::vec3 p1(x, y - w * 0.5f, z - h * 0.5f);
+            glm::vec3 p2(x, y - w * 0.5f, z + h * 0.5f);
+            glm::vec3 p3(x, y + w * 0.5f, z + h * 0.5f);
+            glm::vec2 uv0(0, 0), uv1(1, 0), uv2(1, 1), uv3(0, 1);
+            appendQuad(p0, p1, p2, p3, glm::vec3(-1, 0, 0), tint, uv0, uv1, uv2, uv3, TEX_SIGN);
+            closeBatch(SCENE_PASS_ALPHA_TEST);
+        };
+
+    addSignLeft(-2.0f, 2.6f, 1.6f, 0.7f);
+    addSignLeft(1.5f, 1.8f, 1.2f, 0.6f);
+    addSignRight(0.5f, 2.2f, 1.8f, 0.8f);
+    r.alphaTestCount = (int)gVertices.size() - r.alphaTestFirst;
+
+    // ------------------------------------------------------------
+    // NOW CLOSE SHADOW CASTERS RANGE (everything so far casts shadows)
+    // ------------------------------------------------------------
+    r.shadowCastersCount = (int)gVertices.size() - r.castersFirst;
+
+    // ------------------------------------------------------------
+    // Steam (excluded from shadow casters)
+    // ------------------------------------------------------------
+    r.steamFirst = (int)gVertices.size();
+    const SceneSteam puffs[] = {
+        { glm::vec3(0.2f, -2.6f, 0.03f), glm::vec3(0, 0, 1), 2.2f, 0.28f, 1.0f, 0.0f },
+        { glm::vec3(-0.6f, 0.2f, 0.03f), glm::vec3(0, 0, 1), 1.8f, 0.34f, 0.9f, 2.1f }
+    };
+    for (const SceneSteam& p : puffs) {
+        if (animatedProps) scene.steam.push_back(p);
+        else appendSteamPuff(p.center, p.height, p.radius, TEX_STEAM, p.intensity * 0.35f); // one sprite, not a plume
+        closeBatch(SCENE_PASS_TRANSPARENT);
+    }
+    r.steamCount = (int)gVertices.size() - r.steamFirst;
+
+    r.castersCount = (int)gVertices.size() - r.castersFirst;
+
+    WeldVertices(gVertices, scene.vertices, scene.indices);
+    std::vector<Vtx>().swap(gVertices);
+}
+
+// ---------------- Animated props ----------------
+// runs an append* helper on this thread's scratch list and copies exactly `count` vertices out;
+// skipped (degenerate) cable segments are padded with zero-area triangles so every prop
+// keeps a fixed slot in the ring
+template <typename F>
+static void writeVertices(Vtx* out, int count, F append)
+{
+    gVertices.clear();
+    append();
+
+    int n = (int)gVertices.size() < count ? (int)gVertices.size() : count;
+    if (n) memcpy(out, gVertices.data(), (size_t)n * sizeof(Vtx));
+    for (int i = n; i < count; i++) out[i] = n ? gVertices[0] : Vtx();
+}
+
+int CableVertexCount(const SceneCable& c)
+{
+    return c.segments * 12; // 2 crossed quads per segment
+}
+
+void WriteCable(const SceneCable& c, float t, Vtx* out)
+{
+    // two detuned sines: gusts rather than a metronome; slack cables swing more
+    glm::vec3 up(0, 0, 1);
+    glm::vec3 side = glm::cross(c.b - c.a, up);
+    side = glm::dot(side, side) < 1e-10f ? glm::vec3(1, 0, 0) : glm::normalize(side);
+
+    float gust = 0.6f * sinf(t * 1.3f + c.phase) + 0.4f * sinf(t * 2.9f + c.phase * 1.7f);
+    float bob = sinf(t * 2.1f + c.phase * 0.6f);
+    glm::vec3 sway = side * (0.35f * c.sag * gust) + up * (0.06f * c.sag * bob);
+
+    writeVertices(out, CableVertexCount(c), [&]
+        {
+            appendCable(c.a, c.b, c.sag, c.segments, c.halfWidth, c.col, (float)SCENE_MAT_WALL, sway);
+        });
+}
+
+// ---------------- Vertex welding ----------------
+static inline size_t hashVtx(const Vtx& v)
+{
+    // FNV-1a over the raw bytes (equality below is bitwise too)
+    const unsigned char* p = (const unsigned char*)&v;
+    size_t h = (size_t)1469598103934665603ull;
+    for (size_t i = 0; i < sizeof(Vtx); i++) { h ^= p[i]; h *= (size_t)1099511628211ull; }
+    return h;
+}
+
+void WeldVertices(const std::vector<Vtx>& in, std::vector<Vtx>& outVertices, std::vector<unsigned int>& outIndices)
+{
+    outVertices.clear();
+    outIndices.clear();
+    outVertices.reserve(in.size() / 2);
+    outIndices.reserve(in.size());
+
+    // open addressing table of vertex indices, at most half full
+    size_t cap = 16;
+    while (cap < in.size() * 2) cap <<= 1;
+    std::vector<unsigned int> table(cap, 0xFFFFFFFFu);
+
+    for (const Vtx& v : in) {
+        size_t slot = hashVtx(v) & (cap - 1);
+        for (;;) {
+            unsigned int idx = table[slot];
+            if (idx == 0xFFFFFFFFu) {
+                idx = (unsigned int)outVertices.size();
+                outVertices.push_back(v);
+                table[slot] = idx;
+                outIndices.push_back(idx);
+                break;
+            }
+            if (memcmp(&outVertices[idx], &v, sizeof(Vtx)) == 0) {
+                outIndices.push_back(idx);
+                break;
+            }
+            slot = (slot + 1) & (cap - 1);
+        }
+    }
+}
@@ -0,0 +1,131 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "resources.hpp"
+
+// Alley geometry: built on the CPU from code + OBJ props (BuildAlley), or read ready-made
+// from the asset pack (asset_pack.hpp), which stores exactly what BuildAlley produces.
+
+struct Vtx {
+    glm::vec4 pos;   // 0
+    glm::vec3 col;   // 1
+    glm::vec3 nrm;   // 2
+    glm::vec2 uv;    // 3
+    float texId;     // 4 material id (SceneMaterial)
+    glm::vec4 tan;   // 5 (xyz = tangent, w = handedness; bitangent = cross(n, tan) * w)
+};
+
+static_assert(sizeof(Vtx) == 68, "Vtx is written as is into the asset pack");
+
+// material ids stored in Vtx::texId; CreateMaterials (main.cpp) adds them in this order
+enum SceneMaterial {
+    SCENE_MAT_ASPHALT = 0,
+    SCENE_MAT_WALL = 1,
+    SCENE_MAT_SIGN = 2,
+    SCENE_MAT_STEAM = 3
+};
+
+// images used by the materials (texpack and the bundler compress these)
+struct SceneTexture {
+    const char* path;
+    bool normalMap;
+};
+extern const SceneTexture SCENE_TEXTURES[];
+extern const int SCENE_TEXTURE_COUNT;
+
+// draw ranges, in indices. Buffer order = pass order:
+// ground + opaque casters | alpha-tested signs | steam
+struct SceneRanges {
+    int groundFirst = 0, groundCount = 0;
+    int castersFirst = 0, castersCount = 0;    // everything after the ground (steam included)
+    int alphaTestFirst = 0, alphaTestCount = 0;
+    int steamFirst = 0, steamCount = 0;
+    int shadowCastersCount = 0;                 // casters without steam, from castersFirst
+};
+
+// render passes, in draw order
+enum ScenePass {
+    SCENE_PASS_OPAQUE = 0,      // blending off, front to back (early-z)
+    SCENE_PASS_ALPHA_TEST,      // discard, blending off, depth writes, front to back
+    SCENE_PASS_TRANSPARENT,     // blended, no depth writes, back to front
+    SCENE_PASS_COUNT
+};
+
+// the contiguous index range of a pass
+inline void ScenePassRange(const SceneRanges& r, int pass, int& first, int& count)
+{
+    switch (pass) {
+    case SCENE_PASS_OPAQUE: first = 0; count = r.alphaTestFirst; break;
+    case SCENE_PASS_ALPHA_TEST: first = r.alphaTestFirst; count = r.alphaTestCount; break;
+    default: first = r.steamFirst; count = r.steamCount; break;
+    }
+}
+
+// one object (wall, sign, prop, group of pipes, ...) inside a pass range, with its bounds,
+// so the passes can be sorted by distance every frame
+struct SceneBatch {
+    int first, count;   // indices
+    int pass;           // ScenePass
+    glm::vec3 center;
+    float radius;
+};
+
+// one placed OBJ prop; its triangles are already baked into the buffers
+struct SceneInstance {
+    char mesh[32];
+    glm::mat4 model;
+    int first, count;   // index range
+};
+
+// animated props: cables are rebuilt every frame (WriteCable), steam comes from particle
+// emitters (steam_particles.hpp), instead of being baked
+struct SceneCable {
+    glm::vec3 a, b;     // ends (fixed to the walls)
+    float sag;
+    int segments;
+    float halfWidth;
+    glm::vec3 col;
+    float phase;        // wind phase, so the cables do not swing in step
+};
+
+// steam emitter: a manhole (dir straight up) or a wall vent (dir out of the wall)
+struct SceneSteam {
+    glm::vec3 center;
+    glm::vec3 dir;      // unit
+    float height;       // how far the plume rises
+    float radius;       // spawn disc radius, also the start size of a particle
+    float intensity;    // opacity scale
+    float phase;
+};
+
+static_assert(sizeof(SceneCable) == 52, "SceneCable is written as is into the asset pack");
+static_assert(sizeof(SceneSteam) == 40, "SceneSteam is written as is into the asset pack");
+static_assert(sizeof(SceneBatch) == 28, "SceneBatch is written as is into the asset pack");
+
+struct SceneData {
+    std::vector<Vtx> vertices;
+    std::vector<unsigned int> indices;
+    SceneRanges ranges;
+    std::vector<SceneInstance> instances;
+    std::vector<SceneBatch> batches;    // in buffer order, together they cover every range
+    std::vector<SceneCable> cables;     // only with animatedProps
+    std::vector<SceneSteam> steam;
+};
+
+// builds the whole alley, indexed; the OBJ props come from `meshes`.
+// animatedProps: cables and steam go to scene.cables / scene.steam instead of the buffers
+// (steamCount is then 0; the wall vents get emitters too); without it they are baked at rest
+// (streamed blocks)
+void BuildAlley(SceneData& scene, MeshCache& meshes, bool animatedProps = false);
+
+// cable at time t (seconds), exactly CableVertexCount unindexed vertices;
+// no GL, any thread, no allocation once the thread's scratch list has grown
+int CableVertexCount(const SceneCable& c);
+void WriteCable(const SceneCable& c, float t, Vtx* out);
+
+// merges bit-identical vertices; triangle order (and so every index range) is unchanged
+void WeldVertices(const std::vector<Vtx>& in, std::vector<Vtx>& outVertices, std::vector<unsigned int>& outIndices);
+
+#endif
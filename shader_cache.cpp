@@ -0,0 +1,360 @@
+// Shader permutations + program binary cache (see shader_cache.hpp).
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "shader_cache.hpp"
+
+static std::string gCacheDir = "shader_cache";
+
+static const unsigned int CACHE_MAGIC = 0x31425053; // "SPB1"
+
+static ShaderBlobSource gBlobSource = nullptr;
+
+void ShaderCache_SetDirectory(const char* dir)
+{
+    gCacheDir = dir ? dir : "";
+}
+
+void ShaderCache_SetBlobSource(ShaderBlobSource source)
+{
+    gBlobSource = source;
+}
+
+static bool readTextFile(const char* path, std::string& out)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        printf("Nu am putut deschide shaderul: %s\n", path);
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    out.resize(size > 0 ? (size_t)size : 0);
+    if (size > 0 && fread(&out[0], 1, (size_t)size, f) != (size_t)size) {
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+    return true;
+}
+
+// insert defines after the #version line; #line keeps compiler messages pointing at the file
+static std::string injectDefines(const std::string& src, const std::string& defines)
+{
+    if (defines.empty()) return src;
+
+    size_t v = src.find("#version");
+    size_t eol = (v == std::string::npos) ? std::string::npos : src.find('\n', v);
+    if (eol == std::string::npos) return defines + src;
+
+    int lineNo = 2;
+    for (size_t i = 0; i < eol; i++) if (src[i] == '\n') lineNo++;
+
+    char lineDirective[32];
+    snprintf(lineDirective, sizeof(lineDirective), "#line %d\n", lineNo);
+
+    return src.substr(0, eol + 1) + defines + lineDirective + src.substr(eol + 1);
+}
+
+static unsigned long long fnv1a(const void* data, size_t n, unsigned long long h)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static unsigned long long hashString(const char* s, unsigned long long h)
+{
+    if (!s) s = "";
+    return fnv1a(s, strlen(s) + 1, h); // include terminator so "ab"+"c" != "a"+"bc"
+}
+
+static unsigned long long programKey(const std::string& vs, const std::string& fs)
+{
+    unsigned long long h = 14695981039346656037ull;
+    h = hashString((const char*)glGetString(GL_VENDOR), h);
+    h = hashString((const char*)glGetString(GL_RENDERER), h);
+    h = hashString((const char*)glGetString(GL_VERSION), h);
+    h = hashString(vs.c_str(), h);
+    h = hashString(fs.c_str(), h);
+    return h;
+}
+
+static std::string cachePath(unsigned long long key)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/%016llx.bin", key);
+    return gCacheDir + name;
+}
+
+static bool binaryCacheUsable()
+{
+    if (gCacheDir.empty() || !GLEW_ARB_get_program_binary) return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+// cache entry = { magic, binary format, length } + blob
+static GLuint programFromBlob(const unsigned char* data, size_t size)
+{
+    unsigned int header[3] = { 0, 0, 0 };
+    if (size < sizeof(header)) return 0;
+    memcpy(header, data, sizeof(header));
+    if (header[0] != CACHE_MAGIC || header[2] == 0 || header[2] > size - sizeof(header)) return 0;
+
+    GLuint prog = glCreateProgram();
+    glProgramBinary(prog, (GLenum)header[1], data + sizeof(header), (GLsizei)header[2]);
+
+    GLint linked = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // driver rejected it (e.g. format changed) => rebuild from source
+        glDeleteProgram(prog);
+        return 0;
+    }
+    return prog;
+}
+
+static GLuint loadFromCache(unsigned long long key)
+{
+    // a binary shipped in the asset pack is used in place, no file access
+    const unsigned char* packed = nullptr;
+    size_t packedSize = 0;
+    if (gBlobSource && gBlobSource(key, &packed, &packedSize)) {
+        GLuint prog = programFromBlob(packed, packedSize);
+        if (prog) return prog;
+    }
+
+    FILE* f = fopen(cachePath(key).c_str(), "rb");
+    if (!f) return 0;
+
+    std::vector<unsigned char> entry;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    bool ok = len > 0;
+    if (ok) {
+        entry.resize((size_t)len);
+        ok = fread(entry.data(), 1, entry.size(), f) == entry.size();
+    }
+    fclose(f);
+    if (!ok) return 0;
+
+    return programFromBlob(entry.data(), entry.size());
+}
+
+static void saveToCache(unsigned long long key, GLuint prog)
+{
+    GLint len = 0;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &len);
+    if (len <= 0) return;
+
+    std::vector<unsigned char> blob((size_t)len);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(prog, len, &written, &format, blob.data());
+    if (written <= 0) return;
+
+#ifdef _WIN32
+    _mkdir(gCacheDir.c_str());
+#else
+    mkdir(gCacheDir.c_str(), 0755);
+#endif
+
+    FILE* f = fopen(cachePath(key).c_str(), "wb");
+    if (!f) return;
+
+    unsigned int header[3] = { CACHE_MAGIC, (unsigned int)format, (unsigned int)written };
+    fwrite(header, sizeof(header), 1, f);
+    fwrite(blob.data(), 1, (size_t)written, f);
+    fclose(f);
+}
+
+static GLuint compileStage(GLenum type, const std::string& src, const char* path)
+{
+    GLuint sh = glCreateShader(type);
+    const char* p = src.c_str();
+    glShaderSource(sh, 1, &p, NULL);
+    glCompileShader(sh);
+
+    GLint ok = 0;
+    glGetShaderiv(sh, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[4096];
+        glGetShaderInfoLog(sh, sizeof(log), NULL, log);
+        printf("Eroare compilare %s:\n%s\n", path, log);
+        glDeleteShader(sh);
+        return 0;
+    }
+    return sh;
+}
+
+GLuint LoadProgramCached(const char* vertPath, const char* fragPath,
+    const std::string& defines, ProgramBuildInfo* info)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+
+    std::string vs, fs;
+    if (!readTextFile(vertPath, vs) || !readTextFile(fragPath, fs)) return 0;
+
+    vs = injectDefines(vs, defines);
+    fs = injectDefines(fs, defines);
+
+    bool useCache = binaryCacheUsable();
+    unsigned long long key = programKey(vs, fs);
+
+    ProgramBuildInfo local;
+    ProgramBuildInfo& bi = info ? *info : local;
+    bi = ProgramBuildInfo{};
+    bi.key = key;
+
+    if (useCache) {
+        auto t0 = Clock::now();
+        GLuint prog = loadFromCache(key);
+        if (prog) {
+            bi.fromCache = true;
+            bi.linkMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+            return prog;
+        }
+    }
+
+    auto t0 = Clock::now();
+    GLuint vsh = compileStage(GL_VERTEX_SHADER, vs, vertPath);
+    GLuint fsh = compileStage(GL_FRAGMENT_SHADER, fs, fragPath);
+    auto t1 = Clock::now();
+    bi.compileMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+    if (!vsh || !fsh) {
+        if (vsh) glDeleteShader(vsh);
+        if (fsh) glDeleteShader(fsh);
+        return 0;
+    }
+
+    GLuint prog = glCreateProgram();
+    glAttachShader(prog, vsh);
+    glAttachShader(prog, fsh);
+    if (useCache) glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(prog);
+
+    glDetachShader(prog, vsh);
+    glDetachShader(prog, fsh);
+    glDeleteShader(vsh);
+    glDeleteShader(fsh);
+
+    GLint linked = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+    bi.linkMs = std::chrono::duration<double, std::milli>(Clock::now() - t1).count();
+
+    if (!linked) {
+        char log[4096];
+        glGetProgramInfoLog(prog, sizeof(log), NULL, log);
+        printf("Eroare link %s + %s:\n%s\n", vertPath, fragPath, log);
+        glDeleteProgram(prog);
+        return 0;
+    }
+
+    if (useCache) saveToCache(key, prog);
+    return prog;
+}
+
+// ---------------- ShaderPermutations ----------------
+void ShaderPermutations::Init(const char* vp, const char* fp,
+    const std::vector<const char*>& defs, const std::string& common, SetupFn fn)
+{
+    vertPath = vp;
+    fragPath = fp;
+    featureDefines = defs;
+    commonDefines = common;
+    setup = fn;
+    variants.clear();
+}
+
+void ShaderPermutations::Destroy()
+{
+    for (auto& v : variants) {
+        if (v.program) glDeleteProgram(v.program);
+    }
+    variants.clear();
+}
+
+ShaderPermutations::Variant* ShaderPermutations::Find(unsigned int features)
+{
+    for (auto& v : variants) {
+        if (v.features == features) return &v;
+    }
+    return nullptr;
+}
+
+GLuint ShaderPermutations::Get(unsigned int features)
+{
+    if (Variant* v = Find(features)) return v->program;
+
+    std::string defines = commonDefines;
+    for (size_t i = 0; i < featureDefines.size(); i++) {
+        if (features & (1u << i)) {
+            defines += "#define ";
+            defines += featureDefines[i];
+            defines += "\n";
+        }
+    }
+
+    Variant v;
+    v.features = features;
+    v.program = LoadProgramCached(vertPath.c_str(), fragPath.c_str(), defines, &v.info);
+
+    printf("Shader variant 0x%02x: %s, compile %.2f ms, %s %.2f ms\n", features,
+        v.info.fromCache ? "binary cache" : "source",
+        v.info.compileMs, v.info.fromCache ? "load" : "link", v.info.linkMs);
+
+    if (v.program && setup) setup(v.program);
+
+    // failed builds are remembered too, so we do not retry every frame
+    variants.push_back(v);
+    return v.program;
+}
+
+void ShaderPermutations::ReportGpuMs(unsigned int features, float ms)
+{
+    if (Variant* v = Find(features)) {
+        v->gpuMsSum += ms;
+        v->gpuSamples++;
+    }
+}
+
+void ShaderPermutations::PrintReport() const
+{
+    printf("Shader variants (%s + %s):\n", vertPath.c_str(), fragPath.c_str());
+    for (const auto& v : variants) {
+        std::string names;
+        for (size_t i = 0; i < featureDefines.size(); i++) {
+            if (v.features & (1u << i)) {
+                if (!names.empty()) names += " ";
+                names += featureDefines[i];
+            }
+        }
+
+        double avg = v.gpuSamples ? v.gpuMsSum / v.gpuSamples : 0.0;
+        printf("  0x%02x [%s] %s compile=%.2fms link/load=%.2fms gpu=%.3fms (%d frames)\n",
+            v.features, names.c_str(), v.info.fromCache ? "cached" : "source",
+            v.info.compileMs, v.info.linkMs, avg, v.gpuSamples);
+    }
+}
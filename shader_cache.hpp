@@ -0,0 +1,71 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+// Program loading with #define injection and an on-disk program binary cache.
+// - defines are inserted right after the #version line of both stages
+// - the cache key hashes GL vendor/renderer/version, the defines and both sources,
+//   so a driver update or a shader edit simply misses the cache
+// - without ARB_get_program_binary everything still works, it just always compiles
+
+struct ProgramBuildInfo {
+    bool fromCache = false;
+    double compileMs = 0.0;     // both stages (0 when loaded from cache)
+    double linkMs = 0.0;        // link, or glProgramBinary when loaded from cache
+    unsigned long long key = 0;
+};
+
+// Sets the directory used for cached binaries (created on demand). Empty = no caching.
+void ShaderCache_SetDirectory(const char* dir);
+
+// Optional lookup asked before the cache directory: returns a cache entry (same bytes as a
+// <dir>/<key>.bin file) that stays valid for the program's lifetime, e.g. inside the asset pack.
+typedef bool (*ShaderBlobSource)(unsigned long long key, const unsigned char** data, size_t* size);
+void ShaderCache_SetBlobSource(ShaderBlobSource source);
+
+// Builds a program from two files with the given "#define ...\n" lines prepended.
+// Returns 0 on failure (errors are printed).
+GLuint LoadProgramCached(const char* vertPath, const char* fragPath,
+    const std::string& defines, ProgramBuildInfo* info = nullptr);
+
+// Compile-time permutations of one vertex/fragment pair.
+// A variant is identified by a feature bitmask; each bit maps to one #define name.
+class ShaderPermutations {
+public:
+    typedef void (*SetupFn)(GLuint prog); // called once per new program (block bindings, sampler units)
+
+    void Init(const char* vertPath, const char* fragPath,
+        const std::vector<const char*>& featureDefines,
+        const std::string& commonDefines, SetupFn setup);
+    void Destroy();
+
+    // returns the program for this feature mask, building (or loading) it on first use
+    GLuint Get(unsigned int features);
+
+    // per-variant GPU cost of the pass that used it (fed from timer queries)
+    void ReportGpuMs(unsigned int features, float ms);
+
+    void PrintReport() const;
+
+private:
+    struct Variant {
+        unsigned int features = 0;
+        GLuint program = 0;
+        ProgramBuildInfo info;
+        double gpuMsSum = 0.0;
+        int gpuSamples = 0;
+    };
+
+    Variant* Find(unsigned int features);
+
+    std::string vertPath, fragPath;
+    std::vector<const char*> featureDefines;
+    std::string commonDefines;
+    SetupFn setup = nullptr;
+    std::vector<Variant> variants;
+};
+
+#endif
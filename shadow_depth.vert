@@ -1,12 +1,44 @@
 #version 330 core
 
+// Position-only pass, two uses:
+//  - shadow maps: the light's matrix from ShadowPassData
+//  - DEPTH_PREPASS: the camera's, from ViewData; the main pass then shades opaque geometry with
+//    GL_EQUAL, so gl_Position must come out bit-identical to alley.vert's: same expression,
+//    invariant in both shaders
+
 layout(location=0) in vec4 in_Position;
 
-uniform mat4 myMatrix;
-uniform mat4 lampLightSpace;
+layout(std140) uniform ObjectData {
+    mat4 myMatrix;
+    mat3 normalMatrix;  // unused here, same layout as alley.vert
+};
+
+#ifdef DEPTH_PREPASS
+invariant gl_Position;
+
+// same layout as alley.vert, only the matrices are read
+layout(std140) uniform ViewData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    ivec3 clusterDims;
+    vec2 clusterTileSize;
+    vec2 clusterSlice;
+    vec2 fogSlice;
+};
+#else
+// matrix of the shadow map being rendered (one ring slice per pass)
+layout(std140) uniform ShadowPassData {
+    mat4 lampLightSpace;
+};
+#endif
 
 void main()
 {
     vec4 worldPos = myMatrix * in_Position;
+#ifdef DEPTH_PREPASS
+    gl_Position = projection * view * worldPos;
+#else
     gl_Position = lampLightSpace * worldPos;
-}
\ No newline at end of file
+#endif
+}
@@ -0,0 +1,69 @@
+#version 330 core
+
+// Prefiltered shadow maps (VSM / EVSM), run for each shadow map right after it is rendered
+// (RenderShadowPass in main.cpp), then mipmapped:
+//  pass 0: depth map -> moments, SHADOW_MOMENT_DOWNSAMPLE^2 depth texels averaged per moment texel,
+//          + horizontal Gaussian
+//  pass 1: vertical Gaussian of the result of pass 0
+// alley.frag then filters a shadow with one trilinear fetch.
+//
+// Defines (main.cpp): SHADOW_MOMENT_DOWNSAMPLE, SHADOW_EVSM
+#ifndef SHADOW_MOMENT_DOWNSAMPLE
+#define SHADOW_MOMENT_DOWNSAMPLE 2
+#endif
+
+// VSM: (z, z^2)
+// EVSM: warped depth, positive and negative: (p, p^2, n, n^2) with p = e^(c+ z'), n = -e^(-c- z'), z' = 2z - 1
+// (RGBA32F: the exponents must match alley.frag)
+const float EVSM_POS = 40.0;
+const float EVSM_NEG = 5.0;
+
+uniform sampler2D source;   // pass 0: depth map, pass 1: moments after pass 0
+uniform int blurPass;
+
+out vec4 out_Moments;
+
+// 9 taps, sigma ~ 2 texels
+const float WEIGHTS[5] = float[](0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162);
+
+vec4 moments(float z)
+{
+#ifdef SHADOW_EVSM
+    float d = 2.0 * z - 1.0;
+    float p = exp(EVSM_POS * d);
+    float n = -exp(-EVSM_NEG * d);
+    return vec4(p, p * p, n, n * n);
+#else
+    return vec4(z, z * z, 0.0, 0.0);
+#endif
+}
+
+// moments of one moment texel: averaged over its depth texels (moments first, then the average)
+vec4 depthMoments(ivec2 t)
+{
+    vec4 sum = vec4(0.0);
+    ivec2 base = t * SHADOW_MOMENT_DOWNSAMPLE;
+    for (int y = 0; y < SHADOW_MOMENT_DOWNSAMPLE; y++)
+    for (int x = 0; x < SHADOW_MOMENT_DOWNSAMPLE; x++)
+        sum += moments(texelFetch(source, base + ivec2(x, y), 0).r);
+    return sum / float(SHADOW_MOMENT_DOWNSAMPLE * SHADOW_MOMENT_DOWNSAMPLE);
+}
+
+void main()
+{
+    ivec2 t = ivec2(gl_FragCoord.xy);
+    vec4 sum = vec4(0.0);
+
+    if (blurPass == 0) {
+        int last = textureSize(source, 0).x / SHADOW_MOMENT_DOWNSAMPLE - 1;
+        for (int i = -4; i <= 4; i++)
+            sum += WEIGHTS[abs(i)] * depthMoments(ivec2(clamp(t.x + i, 0, last), t.y));
+    }
+    else {
+        int last = textureSize(source, 0).y - 1;
+        for (int i = -4; i <= 4; i++)
+            sum += WEIGHTS[abs(i)] * texelFetch(source, ivec2(t.x, clamp(t.y + i, 0, last)), 0);
+    }
+
+    out_Moments = sum;
+}
@@ -0,0 +1,146 @@
+// Shadow map update scheduler (time slicing under a per-frame budget).
+// - a light is stale when its light-space matrix differs from the one its map was rendered with
+// - stale lights are ranked by (motion + screen coverage) weighted by how long they have been stale
+// - lights are picked in rank order until the triangle / ms budget is used up
+// - at least one stale light is updated per frame so nothing starves
+// - lights that were never rendered (startup, InvalidateAll) are all updated at once, outside the budget
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+#include "shadow_scheduler.hpp"
+
+static float matrixDelta(const glm::mat4& a, const glm::mat4& b)
+{
+    float d = 0.0f;
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+            d = std::max(d, fabsf(a[c][r] - b[c][r]));
+    return d;
+}
+
+void ShadowScheduler::Init(int lightCount)
+{
+    rendered.assign(lightCount, glm::mat4(1.0f));
+    renderedPos.assign(lightCount, glm::vec3(0.0f));
+    stats.assign(lightCount, ShadowLightStats{});
+    frames = 0;
+    rrCursor = 0;
+}
+
+void ShadowScheduler::InvalidateAll()
+{
+    for (auto& s : stats) s.everRendered = false;
+}
+
+int ShadowScheduler::Plan(const glm::mat4* lightSpace, const glm::vec3* lightPos, const float* coverage,
+    int trianglesPerMap, int* outOrder)
+{
+    const int n = (int)stats.size();
+    if (n == 0) return 0;
+
+    frames++;
+
+    std::vector<int> candidates;
+    candidates.reserve(n);
+
+    for (int li = 0; li < n; li++) {
+        ShadowLightStats& s = stats[li];
+
+        float dm = s.everRendered ? matrixDelta(rendered[li], lightSpace[li]) : 1.0f;
+        s.stale = !s.everRendered || dm > 1e-5f;
+
+        s.lastCoverage = coverage ? coverage[li] : 1.0f;
+        s.lastMotion = glm::length(lightPos[li] - renderedPos[li]) + dm;
+
+        if (!s.stale) {
+            s.staleFrames = 0;
+            s.priority = 0.0f;
+            continue;
+        }
+
+        s.staleFrames++;
+        if (s.staleFrames > s.maxStaleFrames) s.maxStaleFrames = s.staleFrames;
+
+        if (!s.everRendered) {
+            s.priority = 1e9f; // no valid map yet => always first
+        }
+        else {
+            float importance = motionWeight * s.lastMotion + coverageWeight * s.lastCoverage + 0.05f;
+            s.priority = importance * (float)(1 + s.staleFrames);
+        }
+
+        candidates.push_back(li);
+    }
+
+    // round-robin tie breaking: lights closer (cyclically) to the cursor win ties
+    const int cursor = rrCursor;
+    std::sort(candidates.begin(), candidates.end(), [&](int a, int b) {
+        if (stats[a].priority != stats[b].priority) return stats[a].priority > stats[b].priority;
+        int da = (a - cursor + n) % n;
+        int db = (b - cursor + n) % n;
+        return da < db;
+        });
+    rrCursor = (rrCursor + 1) % n;
+
+    int picked = 0;
+    int trisSpent = 0;
+    float msSpent = 0.0f;
+
+    for (int li : candidates) {
+        float estMs = stats[li].avgGpuMs;
+
+        // a light without a valid map has nothing to fall back on: rendered whatever the budget
+        if (picked > 0 && stats[li].everRendered) {
+            if (budget.maxTriangles > 0 && trisSpent + trianglesPerMap > budget.maxTriangles) break;
+            if (budget.maxMs > 0.0f && estMs > 0.0f && msSpent + estMs > budget.maxMs) break;
+        }
+
+        outOrder[picked++] = li;
+        trisSpent += trianglesPerMap;
+        msSpent += estMs;
+    }
+
+    // accumulate staleness of the maps that stay out of date this frame
+    for (int li = 0; li < n; li++) {
+        bool updated = false;
+        for (int k = 0; k < picked; k++) if (outOrder[k] == li) updated = true;
+        if (!updated) stats[li].staleFrameSum += stats[li].staleFrames;
+    }
+
+    return picked;
+}
+
+void ShadowScheduler::MarkRendered(int li, const glm::mat4& lightSpace, const glm::vec3& lightPos)
+{
+    ShadowLightStats& s = stats[li];
+    rendered[li] = lightSpace;
+    renderedPos[li] = lightPos;
+
+    s.everRendered = true;
+    s.stale = false;
+    s.staleFrames = 0;
+    s.updates++;
+}
+
+void ShadowScheduler::ReportGpuMs(int li, float ms)
+{
+    ShadowLightStats& s = stats[li];
+    s.avgGpuMs = (s.avgGpuMs <= 0.0f) ? ms : (0.9f * s.avgGpuMs + 0.1f * ms);
+}
+
+void ShadowScheduler::PrintStats() const
+{
+    printf("Shadow scheduler: %lld frames, budget tris=%d ms=%.2f\n",
+        frames, budget.maxTriangles, budget.maxMs);
+
+    for (int li = 0; li < (int)stats.size(); li++) {
+        const ShadowLightStats& s = stats[li];
+        float avgStale = frames ? (float)s.staleFrameSum / (float)frames : 0.0f;
+        printf("  light %d: updates=%lld stale=%s staleFrames=%d maxStale=%d avgStale=%.2f "
+            "coverage=%.3f motion=%.3f gpu=%.3fms\n",
+            li, s.updates, s.stale ? "yes" : "no", s.staleFrames, s.maxStaleFrames, avgStale,
+            s.lastCoverage, s.lastMotion, s.avgGpuMs);
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef SHADOW_SCHEDULER_H
+#define SHADOW_SCHEDULER_H
+
+#include <vector>
+#include "glm/glm.hpp"
+
+// Time-sliced shadow map updates.
+// Every frame the caller hands in the light-space matrices it *would* render with.
+// Lights whose matrix changed since their map was rendered are "stale"; the scheduler
+// picks the most important stale lights that fit in the per-frame budget and the rest
+// keep their previous depth map together with the matrix it was rendered with.
+
+struct ShadowBudget {
+    int maxTriangles = 0;   // 0 = no triangle limit
+    float maxMs = 0.0f;     // 0 = no time limit (uses measured GPU cost per map)
+};
+
+struct ShadowLightStats {
+    bool everRendered = false;
+    bool stale = false;
+
+    int staleFrames = 0;        // frames the current map has been out of date
+    int maxStaleFrames = 0;     // worst staleness seen
+    long long updates = 0;      // how many times the map was re-rendered
+    long long staleFrameSum = 0;// sum of staleFrames over all frames (avg = sum / frames)
+
+    float priority = 0.0f;      // last computed priority
+    float lastCoverage = 0.0f;  // last screen coverage estimate (0..1)
+    float lastMotion = 0.0f;    // last motion estimate (world units)
+    float avgGpuMs = 0.0f;      // EMA of measured cost of one shadow pass
+};
+
+class ShadowScheduler {
+public:
+    void Init(int lightCount);
+
+    void SetBudget(const ShadowBudget& b) { budget = b; }
+    const ShadowBudget& GetBudget() const { return budget; }
+
+    // weights for the importance metric
+    float motionWeight = 4.0f;
+    float coverageWeight = 2.0f;
+
+    // Fills outOrder with the lights to re-render this frame (most important first).
+    // lightSpace/lightPos/coverage have lightCount entries; trianglesPerMap is the
+    // caster triangle count drawn by one shadow pass. Returns the number of lights picked.
+    int Plan(const glm::mat4* lightSpace, const glm::vec3* lightPos, const float* coverage,
+        int trianglesPerMap, int* outOrder);
+
+    // Call after a planned light was rendered with lightSpace (the matrix passed to Plan).
+    void MarkRendered(int li, const glm::mat4& lightSpace, const glm::vec3& lightPos);
+
+    // Feed back measured GPU time of a shadow pass (used by the ms budget).
+    void ReportGpuMs(int li, float ms);
+
+    // Forces every map to be re-rendered in the next frame, outside the budget (e.g. after the
+    // casters or the map format changed).
+    void InvalidateAll();
+
+    // Matrix the current depth map of light li was rendered with.
+    const glm::mat4& RenderedMatrix(int li) const { return rendered[li]; }
+
+    const ShadowLightStats& Stats(int li) const { return stats[li]; }
+    int LightCount() const { return (int)stats.size(); }
+    void PrintStats() const;
+
+private:
+    ShadowBudget budget;
+
+    std::vector<glm::mat4> rendered;
+    std::vector<glm::vec3> renderedPos;
+    std::vector<ShadowLightStats> stats;
+
+    long long frames = 0;
+    int rrCursor = 0; // round-robin tie breaker
+};
+
+#endif
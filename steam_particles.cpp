@@ -0,0 +1,413 @@
+// Steam particles (see steam_particles.hpp).
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define STEAM_SSE 1
+#endif
+
+#include "steam_particles.hpp"
+#include "gpu_profiler.hpp"
+#include "radix_sort.hpp"
+
+typedef std::chrono::steady_clock SteamClock;
+
+static const float STEAM_DRAG = 0.7f;       // 1/s, velocity relaxes towards the wind
+static const float STEAM_BUOYANCY = 0.35f;  // m/s^2 up
+static const float STEAM_GROWTH = 2.5f;     // size at the end of life = (1 + growth) x start
+
+static double MsSince(SteamClock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(SteamClock::now() - t0).count();
+}
+
+bool SteamParticles::Init(const std::vector<SceneSteam>& e, int maxParticles)
+{
+    Destroy();
+
+    emitters = e;
+    owed.assign(emitters.size(), 0.0f);
+
+    maxCount = maxParticles;
+    std::vector<float>* arrays[] = { &px, &py, &pz, &vx, &vy, &vz, &age, &life, &size, &opacity, &seed };
+    for (std::vector<float>* a : arrays) a->assign(maxCount, 0.0f);
+    keys.assign(maxCount, 0);
+    order.assign(maxCount, 0);
+    tmpKeys.assign(maxCount, 0);
+    tmpOrder.assign(maxCount, 0);
+
+    count = 0;
+    drawCount = 0;
+    lastT = -1.0f;
+    SetTarget(target);
+    cap = (float)target;
+
+    if (emitters.empty()) return true;
+
+    // one region holds every quad; a region starts on a whole vertex, so its offset is a base vertex
+    if (!ring.Init(GL_ARRAY_BUFFER, (size_t)maxCount * 4 * sizeof(ParticleVtx))) return false;
+
+    // quad k = vertices 4k .. 4k+3, the same for every frame
+    std::vector<unsigned int> idx((size_t)maxCount * 6);
+    for (int k = 0; k < maxCount; k++) {
+        unsigned int v = (unsigned int)k * 4;
+        unsigned int* q = &idx[(size_t)k * 6];
+        q[0] = v; q[1] = v + 1; q[2] = v + 2;
+        q[3] = v; q[4] = v + 2; q[5] = v + 3;
+    }
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, idx.size() * sizeof(unsigned int), idx.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    printf("Steam particles: %zu emitters, up to %d particles, %.1f MB/frame\n",
+        emitters.size(), maxCount, ring.FrameSize() / (1024.0 * 1024.0));
+    return true;
+}
+
+void SteamParticles::Destroy()
+{
+    ring.Destroy();
+    if (indexBuffer) glDeleteBuffers(1, &indexBuffer);
+    indexBuffer = 0;
+
+    count = 0;
+    drawCount = 0;
+    active = false;
+    frameData = nullptr;
+}
+
+void SteamParticles::SetTarget(int particles)
+{
+    if (particles < STEAM_MIN_PARTICLES) particles = STEAM_MIN_PARTICLES;
+    if (maxCount > 0 && particles > maxCount) particles = maxCount;
+    target = particles;
+    if (cap > (float)target) cap = (float)target;
+}
+
+float SteamParticles::Random()
+{
+    // xorshift32, only used by Spawn (one thread)
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (rng >> 8) * (1.0f / 16777216.0f);
+}
+
+// ---------------- Frame ----------------
+void SteamParticles::Begin(float t, const glm::mat4& view, JobSystem& jobs)
+{
+    active = false;
+    if (emitters.empty()) return;
+
+    float dt = lastT < 0.0f ? 0.0f : t - lastT;
+    if (dt < 0.0f) dt = 0.0f;
+    if (dt > 0.1f) dt = 0.1f;   // after a hitch, slow down instead of jumping
+    lastT = t;
+
+    ring.BeginFrame();
+    frameData = (ParticleVtx*)ring.Alloc(ring.FrameSize(), 4, frameOffset);
+
+    // camera basis from the rows of the view matrix
+    glm::vec3 right(view[0][0], view[1][0], view[2][0]);
+    glm::vec3 up(view[0][1], view[1][1], view[2][1]);
+    glm::vec3 fwd(-view[0][2], -view[1][2], -view[2][2]);
+    glm::vec3 eye = -(glm::transpose(glm::mat3(view)) * glm::vec3(view[3]));
+
+    jobs.Spawn("steam particles", [this, dt, t, eye, right, up, fwd, &jobs]
+        {
+            Update(dt, t, eye, right, up, fwd, jobs);
+        }, &done);
+    active = true;
+}
+
+void SteamParticles::Finish(JobSystem& jobs)
+{
+    jobs.Wait(done);
+    if (!active) return;
+
+    if (frameData && drawCount > 0) ring.Commit(frameOffset, (size_t)drawCount * 4 * sizeof(ParticleVtx));
+
+    frames++;
+    avgMs = frames == 1 ? frameMs : avgMs * 0.95 + frameMs * 0.05;
+    if (frameMs > worstMs) worstMs = frameMs;
+    AdjustCap(frameMs);
+}
+
+void SteamParticles::AdjustCap(double ms)
+{
+    if (budgetMs <= 0.0f) {
+        cap = (float)target;
+        return;
+    }
+    if (ms > budgetMs) {
+        // over: cut right away, roughly in proportion
+        overBudget++;
+        double f = budgetMs / ms * 0.9;
+        cap *= (float)(f < 0.5 ? 0.5 : f);
+    }
+    else if (ms < budgetMs * 0.75) {
+        cap *= 1.03f;
+    }
+
+    if (cap > (float)target) cap = (float)target;
+    if (cap < (float)STEAM_MIN_PARTICLES) cap = (float)STEAM_MIN_PARTICLES;
+}
+
+// on the job; the main thread does not touch the particles until Finish
+void SteamParticles::Update(float dt, float t, const glm::vec3& eye, const glm::vec3& right, const glm::vec3& up,
+    const glm::vec3& fwd, JobSystem& jobs)
+{
+    auto t0 = SteamClock::now();
+
+    Spawn(dt);
+    jobs.ParallelFor("steam integrate", count, STEAM_PARTICLES_PER_JOB, [&](int begin, int end)
+        {
+            Integrate(begin, end, dt, t);
+        });
+    Kill();
+    simMs = MsSince(t0);
+
+    // back to front = larger view depth first: key = ~(bits of a positive float), so an
+    // ascending sort puts the farthest first; particles behind the camera get the largest key
+    auto t1 = SteamClock::now();
+    std::atomic<int> visible{ 0 };
+    jobs.ParallelFor("steam keys", count, STEAM_PARTICLES_PER_JOB, [&](int begin, int end)
+        {
+            int n = 0;
+            for (int i = begin; i < end; i++) {
+                float d = (px[i] - eye.x) * fwd.x + (py[i] - eye.y) * fwd.y + (pz[i] - eye.z) * fwd.z;
+                if (d > 0.05f) {
+                    unsigned int bits;
+                    memcpy(&bits, &d, sizeof(bits));
+                    keys[i] = ~bits;
+                    n++;
+                }
+                else {
+                    keys[i] = 0xFFFFFFFFu;
+                }
+                order[i] = (unsigned int)i;
+            }
+            visible.fetch_add(n);
+        });
+    RadixSort(jobs, keys.data(), order.data(), count, tmpKeys.data(), tmpOrder.data());
+    drawCount = frameData ? visible.load() : 0;
+    sortMs = MsSince(t1);
+
+    auto t2 = SteamClock::now();
+    std::mutex boundsLock;
+    boundsLo = glm::vec3(1e30f);
+    boundsHi = glm::vec3(-1e30f);
+    jobs.ParallelFor("steam quads", drawCount, STEAM_PARTICLES_PER_JOB, [&](int begin, int end)
+        {
+            glm::vec3 lo(1e30f), hi(-1e30f);
+            WriteQuads(begin, end, right, up, lo, hi);
+            std::lock_guard<std::mutex> lock(boundsLock);
+            boundsLo = glm::min(boundsLo, lo);
+            boundsHi = glm::max(boundsHi, hi);
+        });
+    writeMs = MsSince(t2);
+
+    frameMs = MsSince(t0);
+}
+
+// ---------------- Simulation ----------------
+void SteamParticles::Spawn(float dt)
+{
+    if (dt <= 0.0f) return;
+
+    // steady state: cap particles alive, split between the emitters
+    float perEmitter = cap / (float)emitters.size();
+    float rate = perEmitter / STEAM_PARTICLE_LIFE;
+    // thinner particles when there are more of them
+    float alpha = 7.0f / sqrtf(perEmitter);
+    if (alpha > 0.5f) alpha = 0.5f;
+
+    int limit = (int)cap < maxCount ? (int)cap : maxCount;
+
+    for (size_t e = 0; e < emitters.size(); e++) {
+        const SceneSteam& em = emitters[e];
+
+        owed[e] += rate * dt;
+        int n = (int)owed[e];
+        owed[e] -= (float)n;
+
+        // disc across the emission direction
+        glm::vec3 a = fabsf(em.dir.z) > 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 0, 1);
+        glm::vec3 s1 = glm::normalize(glm::cross(em.dir, a));
+        glm::vec3 s2 = glm::cross(em.dir, s1);
+        float speed = 1.2f * em.height / STEAM_PARTICLE_LIFE;
+
+        for (int k = 0; k < n && count < limit; k++) {
+            float r = em.radius * sqrtf(Random());
+            float ang = 6.2831853f * Random();
+            glm::vec3 p = em.center + (s1 * cosf(ang) + s2 * sinf(ang)) * r;
+            glm::vec3 v = em.dir * (speed * (0.8f + 0.4f * Random()))
+                + (s1 * (Random() - 0.5f) + s2 * (Random() - 0.5f)) * (0.3f * speed);
+
+            int i = count++;
+            px[i] = p.x; py[i] = p.y; pz[i] = p.z;
+            vx[i] = v.x; vy[i] = v.y; vz[i] = v.z;
+            age[i] = 0.0f;
+            life[i] = STEAM_PARTICLE_LIFE * (0.7f + 0.6f * Random());
+            size[i] = em.radius * (0.6f + 0.5f * Random());
+            opacity[i] = em.intensity * alpha;
+            seed[i] = Random();
+        }
+    }
+}
+
+// v relaxes towards the wind (drag) while buoyancy lifts it; explicit Euler
+void SteamParticles::Integrate(int begin, int end, float dt, float t)
+{
+    float windX = 0.22f * sinf(0.5f * t) + 0.10f * sinf(1.3f * t + 0.4f);
+    float windY = 0.12f * sinf(0.37f * t + 1.0f);
+
+    float damp = 1.0f - STEAM_DRAG * dt;
+    if (damp < 0.0f) damp = 0.0f;
+    float ax = windX * STEAM_DRAG * dt;
+    float ay = windY * STEAM_DRAG * dt;
+    float az = STEAM_BUOYANCY * dt;
+
+    int i = begin;
+#ifdef STEAM_SSE
+    __m128 vDamp = _mm_set1_ps(damp);
+    __m128 vAx = _mm_set1_ps(ax), vAy = _mm_set1_ps(ay), vAz = _mm_set1_ps(az);
+    __m128 vDt = _mm_set1_ps(dt);
+
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&vx[i]), vDamp), vAx);
+        __m128 y = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&vy[i]), vDamp), vAy);
+        __m128 z = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&vz[i]), vDamp), vAz);
+        _mm_storeu_ps(&vx[i], x);
+        _mm_storeu_ps(&vy[i], y);
+        _mm_storeu_ps(&vz[i], z);
+
+        _mm_storeu_ps(&px[i], _mm_add_ps(_mm_loadu_ps(&px[i]), _mm_mul_ps(x, vDt)));
+        _mm_storeu_ps(&py[i], _mm_add_ps(_mm_loadu_ps(&py[i]), _mm_mul_ps(y, vDt)));
+        _mm_storeu_ps(&pz[i], _mm_add_ps(_mm_loadu_ps(&pz[i]), _mm_mul_ps(z, vDt)));
+        _mm_storeu_ps(&age[i], _mm_add_ps(_mm_loadu_ps(&age[i]), vDt));
+    }
+#endif
+
+    for (; i < end; i++) {
+        vx[i] = vx[i] * damp + ax;
+        vy[i] = vy[i] * damp + ay;
+        vz[i] = vz[i] * damp + az;
+        px[i] += vx[i] * dt;
+        py[i] += vy[i] * dt;
+        pz[i] += vz[i] * dt;
+        age[i] += dt;
+    }
+}
+
+// dead particles are replaced by the last one (order does not matter before the sort)
+void SteamParticles::Kill()
+{
+    std::vector<float>* arrays[] = { &px, &py, &pz, &vx, &vy, &vz, &age, &life, &size, &opacity, &seed };
+
+    for (int i = 0; i < count; ) {
+        if (age[i] < life[i]) {
+            i++;
+            continue;
+        }
+        int last = --count;
+        for (std::vector<float>* a : arrays) (*a)[i] = (*a)[last];
+    }
+}
+
+// sorted slots [begin, end): grows, fades in quickly and out slowly; lo/hi grow around the quads
+void SteamParticles::WriteQuads(int begin, int end, const glm::vec3& right, const glm::vec3& up,
+    glm::vec3& lo, glm::vec3& hi)
+{
+    for (int k = begin; k < end; k++) {
+        unsigned int i = order[k];
+
+        float a = age[i] / life[i];
+        float s = size[i] * (1.0f + STEAM_GROWTH * a);
+        float fadeIn = age[i] * 4.0f < 1.0f ? age[i] * 4.0f : 1.0f;
+        float alpha = opacity[i] * fadeIn * (1.0f - a) * (1.0f - a);
+
+        glm::vec3 c(px[i], py[i], pz[i]);
+        glm::vec3 r = right * s;
+        glm::vec3 u = up * s;
+        glm::vec2 col(alpha, seed[i]);
+
+        ParticleVtx* q = frameData + (size_t)k * 4;
+        q[0] = { c - r - u, col, glm::vec2(0, 0) };
+        q[1] = { c + r - u, col, glm::vec2(1, 0) };
+        q[2] = { c + r + u, col, glm::vec2(1, 1) };
+        q[3] = { c - r + u, col, glm::vec2(0, 1) };
+
+        glm::vec3 extent = glm::abs(r) + glm::abs(u);
+        lo = glm::min(lo, c - extent);
+        hi = glm::max(hi, c + extent);
+    }
+}
+
+// ---------------- Drawing ----------------
+GLuint SteamParticles::CreateVao() const
+{
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, ring.Buffer());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleVtx), (GLvoid*)offsetof(ParticleVtx, pos));
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleVtx), (GLvoid*)offsetof(ParticleVtx, col));
+
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleVtx), (GLvoid*)offsetof(ParticleVtx, uv));
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return vao;
+}
+
+void SteamParticles::Draw() const
+{
+    if (!active || drawCount == 0) return;
+
+    // inputs without an array: the same for every particle
+    glVertexAttrib3f(2, 0.0f, 0.0f, 1.0f);
+    glVertexAttrib1f(4, (float)SCENE_MAT_STEAM);
+    glVertexAttrib4f(5, 1.0f, 0.0f, 0.0f, 1.0f);
+
+    glDrawElementsBaseVertex(GL_TRIANGLES, drawCount * 6, GL_UNSIGNED_INT, 0,
+        (GLint)(frameOffset / sizeof(ParticleVtx)));
+    GpuCountDraw(drawCount * 6);
+}
+
+bool SteamParticles::Bounds(glm::vec3& lo, glm::vec3& hi) const
+{
+    if (!active || drawCount == 0) return false;
+    lo = boundsLo;
+    hi = boundsHi;
+    return true;
+}
+
+void SteamParticles::PrintStats() const
+{
+    printf("\nSteam particles: %d alive, %d drawn, cap %d / target %d (max %d), %zu emitters\n",
+        count, drawCount, (int)cap, target, maxCount, emitters.size());
+    printf("  CPU %.3f ms (sim %.3f, sort %.3f, quads %.3f), avg %.3f, worst %.3f, budget %.2f ms, %d / %d frames over\n",
+        frameMs, simMs, sortMs, writeMs, avgMs, worstMs, budgetMs, overBudget, frames);
+#ifdef STEAM_SSE
+    const char* simd = "SSE";
+#else
+    const char* simd = "scalar";
+#endif
+    printf("  integration: %s, vertex ring %.1f MB/frame (%s), %.2f ms waited on fences\n",
+        simd, ring.FrameSize() / (1024.0 * 1024.0), ring.IsPersistent() ? "persistent" : "fallback", ring.WaitMs());
+}
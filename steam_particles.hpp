@@ -0,0 +1,113 @@
+#ifndef STEAM_PARTICLES_H
+#define STEAM_PARTICLES_H
+
+#include <vector>
+#include <GL/glew.h>
+#include "glm/glm.hpp"
+
+#include "scene.hpp"
+#include "gpu_ring.hpp"
+#include "job_system.hpp"
+
+// Steam particles from the manholes and wall vents (SceneSteam emitters).
+// - SoA storage (one array per attribute), integrated 4 at a time with SSE where available
+// - per frame, in one job (Begin .. Finish, overlapping the shadow passes):
+//   spawn -> integrate (parallel) -> drop dead -> view depth keys (parallel) ->
+//   radix sort, back to front (radix_sort.hpp) -> camera-facing quads (parallel)
+//   written straight into a persistently mapped vertex ring, in draw order
+// - drawn after the opaque geometry as one sorted, blended batch (depth test on, no depth writes)
+// - fixed CPU budget: the live cap follows the measured cost, shrinking at once when a frame
+//   goes over STEAM_BUDGET_MS and growing back slowly towards the target count; spawn rates
+//   and per-particle opacity follow the cap, so the plumes look the same at any density
+//
+// Quads use a compact vertex (28 bytes) instead of Vtx; CreateVao maps it onto the alley
+// program's inputs and Draw sets the attributes that are constant for steam.
+
+struct ParticleVtx {
+    glm::vec3 pos;
+    glm::vec2 col;      // x = opacity, y = per-particle seed (noise offset in alley.frag)
+    glm::vec2 uv;
+};
+
+static_assert(sizeof(ParticleVtx) == 28, "ParticleVtx layout is set up by SteamParticles::CreateVao");
+
+static const int STEAM_MAX_PARTICLES = 100000;
+static const int STEAM_MIN_PARTICLES = 500;
+static const int STEAM_PARTICLES_PER_JOB = 4096;   // multiple of 4 (SIMD)
+static const float STEAM_BUDGET_MS = 1.5f;
+static const float STEAM_PARTICLE_LIFE = 2.4f;      // mean, seconds
+
+class SteamParticles {
+public:
+    ~SteamParticles() { Destroy(); }
+
+    bool Init(const std::vector<SceneSteam>& emitters, int maxParticles = STEAM_MAX_PARTICLES);
+    void Destroy();
+
+    // wanted population; the budget may keep the live cap below it
+    void SetTarget(int particles);
+    int Target() const { return target; }
+    // 0: no budget, the cap stays at the target (the count no longer depends on the CPU)
+    void SetBudgetMs(float ms) { budgetMs = ms; }
+
+    // main thread; t = time in seconds, view = this frame's camera
+    void Begin(float t, const glm::mat4& view, JobSystem& jobs);
+    void Finish(JobSystem& jobs);
+    void EndFrame() { ring.EndFrame(); }
+
+    // VAO over the vertex ring + the quad index buffer (call after Init)
+    GLuint CreateVao() const;
+
+    // caller binds that VAO and the program; blending on, depth writes off
+    void Draw() const;
+
+    int Alive() const { return count; }
+    int Drawn() const { return drawCount; }
+
+    // world space box around this frame's quads (after Finish); false when nothing is drawn
+    bool Bounds(glm::vec3& lo, glm::vec3& hi) const;
+    void PrintStats() const;
+
+private:
+    void Update(float dt, float t, const glm::vec3& eye, const glm::vec3& right, const glm::vec3& up,
+        const glm::vec3& fwd, JobSystem& jobs);
+    void Spawn(float dt);
+    void Integrate(int begin, int end, float dt, float t);
+    void Kill();
+    void WriteQuads(int begin, int end, const glm::vec3& right, const glm::vec3& up, glm::vec3& lo, glm::vec3& hi);
+    void AdjustCap(double ms);
+    float Random();
+
+    std::vector<SceneSteam> emitters;
+    std::vector<float> owed;        // fractional particles carried over, per emitter
+
+    // SoA, maxCount each; [0, count) alive
+    std::vector<float> px, py, pz;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> age, life, size, opacity, seed;
+    int count = 0, maxCount = 0;
+
+    int target = 20000;
+    float cap = 20000.0f;           // live cap under the budget
+    float budgetMs = STEAM_BUDGET_MS;
+    unsigned int rng = 0x9E3779B9u;
+    float lastT = -1.0f;
+
+    std::vector<unsigned int> keys, order, tmpKeys, tmpOrder;
+    int drawCount = 0;
+    glm::vec3 boundsLo = glm::vec3(0.0f), boundsHi = glm::vec3(0.0f);
+
+    GpuRing ring;
+    GLuint indexBuffer = 0;
+    ParticleVtx* frameData = nullptr;
+    GLintptr frameOffset = 0;
+    bool active = false;
+    JobCounter done;
+
+    // stats (written by the job, read after Finish)
+    double frameMs = 0.0, simMs = 0.0, sortMs = 0.0, writeMs = 0.0;
+    double avgMs = 0.0, worstMs = 0.0;
+    int frames = 0, overBudget = 0;
+};
+
+#endif
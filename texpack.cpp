@@ -0,0 +1,84 @@
+// texpack: offline texture compressor -> .ktx next to each image (loaded instead of the image at runtime).
+//  - albedo: BC1, or BC3 if any texel has alpha < 255
+//  - normal maps (*_n.* or --normal): BC5 (X,Y only)
+//  - the full mip chain is written, so the game does no decode and no mip generation
+//
+// Usage: texpack                       (all scene textures)
+//        texpack [--normal] img.png... (given files)
+//
+// Excluded from the game build (this file is empty without BUILD_TEXPACK):
+// Build (g++): g++ -DBUILD_TEXPACK -O2 texpack.cpp texture_compress.cpp texture_loader.cpp job_system.cpp scene.cpp objloader.cpp cpu_profiler.cpp -lSOIL -lGLEW -lGL -pthread -o texpack
+#ifdef BUILD_TEXPACK
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "texture_compress.hpp"
+#include "scene.hpp"
+
+static bool isNormalMapName(const std::string& path)
+{
+    size_t dot = path.find_last_of('.');
+    std::string base = path.substr(0, dot);
+    return base.size() >= 2 && base.compare(base.size() - 2, 2, "_n") == 0;
+}
+
+static bool packOne(const std::string& path, bool normalMap)
+{
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    KtxImage ktx;
+    BlockFormat bf = BLOCK_BC1;
+    if (!CompressImageFile(path, normalMap, ktx, &bf)) return false;
+
+    size_t rawBytes = 0, outBytes = 0;
+    int w = ktx.width, h = ktx.height;
+    for (size_t l = 0; l < ktx.levels.size(); l++) {
+        rawBytes += (size_t)w * h * 4;
+        outBytes += ktx.levels[l].size();
+        w = w > 1 ? w >> 1 : 1;
+        h = h > 1 ? h >> 1 : 1;
+    }
+
+    std::string out = KtxPathFor(path);
+    if (!WriteKTX(out.c_str(), ktx)) return false;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+    static const char* names[] = { "BC1", "BC3", "BC5" };
+    printf("%s -> %s: %dx%d %s, %zu mips, %.2f MB -> %.2f MB (%.1f ms)\n", path.c_str(), out.c_str(),
+        ktx.width, ktx.height, names[bf], ktx.levels.size(),
+        rawBytes / (1024.0 * 1024.0), outBytes / (1024.0 * 1024.0), ms);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::pair<std::string, bool> > files;
+    bool forceNormal = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--normal") == 0) { forceNormal = true; continue; }
+        files.push_back(std::make_pair(std::string(argv[i]), forceNormal || isNormalMapName(argv[i])));
+    }
+
+    if (files.empty()) {
+        for (int i = 0; i < SCENE_TEXTURE_COUNT; i++) {
+            files.push_back(std::make_pair(std::string(SCENE_TEXTURES[i].path), SCENE_TEXTURES[i].normalMap));
+        }
+    }
+
+    int failed = 0;
+    for (const auto& f : files) {
+        if (!packOne(f.first, f.second)) failed++;
+    }
+    return failed ? 1 : 0;
+}
+
+#endif // BUILD_TEXPACK
@@ -0,0 +1,410 @@
+// BC1/BC3/BC5 encoder + KTX 1.1 read/write (see texture_compress.hpp).
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BC_USE_SSE 1
+#endif
+
+#include "texture_compress.hpp"
+#include "texture_loader.hpp"
+#include "SOIL.h"
+
+GLenum BlockFormatGL(BlockFormat f)
+{
+    switch (f) {
+    case BLOCK_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BLOCK_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BLOCK_BC5: return GL_COMPRESSED_RG_RGTC2;
+    }
+    return 0;
+}
+
+int BlockBytes(GLenum glFormat)
+{
+    switch (glFormat) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return 16;
+    case GL_COMPRESSED_RG_RGTC2: return 16;
+    }
+    return 0;
+}
+
+size_t CompressedSize(GLenum glFormat, int w, int h)
+{
+    return (size_t)((w + 3) / 4) * (size_t)((h + 3) / 4) * (size_t)BlockBytes(glFormat);
+}
+
+// ---------------- block helpers ----------------
+// 4x4 RGBA texels, edges clamped
+static void loadBlock(const unsigned char* img, int w, int h, int bx, int by, unsigned char px[64])
+{
+    for (int y = 0; y < 4; y++) {
+        int sy = by * 4 + y; if (sy >= h) sy = h - 1;
+        for (int x = 0; x < 4; x++) {
+            int sx = bx * 4 + x; if (sx >= w) sx = w - 1;
+            memcpy(px + (y * 4 + x) * 4, img + ((size_t)sy * w + sx) * 4, 4);
+        }
+    }
+}
+
+// per-channel min/max over the 16 texels
+static void blockBounds(const unsigned char px[64], unsigned char mn[4], unsigned char mx[4])
+{
+#ifdef BC_USE_SSE
+    __m128i p0 = _mm_loadu_si128((const __m128i*)(px + 0));
+    __m128i p1 = _mm_loadu_si128((const __m128i*)(px + 16));
+    __m128i p2 = _mm_loadu_si128((const __m128i*)(px + 32));
+    __m128i p3 = _mm_loadu_si128((const __m128i*)(px + 48));
+
+    __m128i lo = _mm_min_epu8(_mm_min_epu8(p0, p1), _mm_min_epu8(p2, p3));
+    __m128i hi = _mm_max_epu8(_mm_max_epu8(p0, p1), _mm_max_epu8(p2, p3));
+
+    // reduce the 4 texels left in each register
+    lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+    lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+    hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    int l = _mm_cvtsi128_si32(lo), m = _mm_cvtsi128_si32(hi);
+    memcpy(mn, &l, 4);
+    memcpy(mx, &m, 4);
+#else
+    for (int c = 0; c < 4; c++) { mn[c] = 255; mx[c] = 0; }
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            unsigned char v = px[i * 4 + c];
+            if (v < mn[c]) mn[c] = v;
+            if (v > mx[c]) mx[c] = v;
+        }
+    }
+#endif
+}
+
+static unsigned short pack565(const int c[3])
+{
+    return (unsigned short)(((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255));
+}
+
+static void unpack565(unsigned short v, int c[3])
+{
+    int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+static void put16(unsigned char* p, unsigned int v) { p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); }
+
+// BC1 color block (always 4-color mode, also used by BC3)
+static void encodeColorBlock(const unsigned char px[64], const unsigned char mn[4], const unsigned char mx[4], unsigned char* out)
+{
+    int lo[3], hi[3];
+    for (int c = 0; c < 3; c++) {
+        int inset = (mx[c] - mn[c]) >> 4;
+        lo[c] = mn[c] + inset;
+        hi[c] = mx[c] - inset;
+    }
+
+    unsigned short c0 = pack565(hi), c1 = pack565(lo);
+    if (c0 < c1) { unsigned short t = c0; c0 = c1; c1 = t; }
+
+    put16(out + 0, c0);
+    put16(out + 2, c1);
+
+    unsigned int indices = 0;
+    if (c0 != c1) {
+        int pal[4][3];
+        unpack565(c0, pal[0]);
+        unpack565(c1, pal[1]);
+        for (int c = 0; c < 3; c++) {
+            pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+            pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            const unsigned char* p = px + i * 4;
+            int best = 0, bestErr = 0x7fffffff;
+            for (int k = 0; k < 4; k++) {
+                int dr = p[0] - pal[k][0], dg = p[1] - pal[k][1], db = p[2] - pal[k][2];
+                int e = dr * dr + dg * dg + db * db;
+                if (e < bestErr) { bestErr = e; best = k; }
+            }
+            indices |= (unsigned int)best << (i * 2);
+        }
+    }
+
+    put16(out + 4, indices & 0xffff);
+    put16(out + 6, indices >> 16);
+}
+
+// BC4 single channel block (BC3 alpha, BC5 red/green): 8-value mode
+static void encodeChannelBlock(const unsigned char px[64], int channel, unsigned char a0, unsigned char a1, unsigned char* out)
+{
+    out[0] = a0; // max
+    out[1] = a1; // min
+
+    unsigned long long bits = 0;
+    if (a0 != a1) {
+        int pal[8];
+        pal[0] = a0;
+        pal[1] = a1;
+        for (int j = 2; j < 8; j++) pal[j] = ((8 - j) * a0 + (j - 1) * a1 + 3) / 7;
+
+        for (int i = 0; i < 16; i++) {
+            int v = px[i * 4 + channel];
+            int best = 0, bestErr = 256;
+            for (int k = 0; k < 8; k++) {
+                int e = v > pal[k] ? v - pal[k] : pal[k] - v;
+                if (e < bestErr) { bestErr = e; best = k; }
+            }
+            bits |= (unsigned long long)best << (i * 3);
+        }
+    }
+
+    for (int b = 0; b < 6; b++) out[2 + b] = (unsigned char)(bits >> (b * 8));
+}
+
+static void encodeBlock(const unsigned char px[64], BlockFormat f, unsigned char* out)
+{
+    unsigned char mn[4], mx[4];
+    blockBounds(px, mn, mx);
+
+    switch (f) {
+    case BLOCK_BC1:
+        encodeColorBlock(px, mn, mx, out);
+        break;
+    case BLOCK_BC3:
+        encodeChannelBlock(px, 3, mx[3], mn[3], out);
+        encodeColorBlock(px, mn, mx, out + 8);
+        break;
+    case BLOCK_BC5:
+        encodeChannelBlock(px, 0, mx[0], mn[0], out);
+        encodeChannelBlock(px, 1, mx[1], mn[1], out + 8);
+        break;
+    }
+}
+
+void CompressImage(const unsigned char* rgba, int w, int h, BlockFormat f,
+    std::vector<unsigned char>& out, int threads)
+{
+    GLenum glf = BlockFormatGL(f);
+    int bw = (w + 3) / 4, bh = (h + 3) / 4;
+    int bytes = BlockBytes(glf);
+    out.resize(CompressedSize(glf, w, h));
+
+    // block rows are handed out one at a time
+    std::atomic<int> nextRow(0);
+    auto work = [&]() {
+        unsigned char px[64];
+        for (int by = nextRow.fetch_add(1); by < bh; by = nextRow.fetch_add(1)) {
+            for (int bx = 0; bx < bw; bx++) {
+                loadBlock(rgba, w, h, bx, by, px);
+                encodeBlock(px, f, out.data() + ((size_t)by * bw + bx) * bytes);
+            }
+        }
+    };
+
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    if (threads > bh) threads = bh;
+    if (threads <= 1) { work(); return; }
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads - 1; i++) pool.emplace_back(work);
+    work();
+    for (auto& t : pool) t.join();
+}
+
+// ---------------- KTX 1.1 ----------------
+static const unsigned char KTX_ID[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+static GLenum baseFormatOf(GLenum f)
+{
+    switch (f) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return GL_RGB;
+    case GL_COMPRESSED_RG_RGTC2: return GL_RG;
+    }
+    return GL_RGBA;
+}
+
+void SerializeKTX(const KtxImage& img, std::vector<unsigned char>& out)
+{
+    unsigned int hdr[13] = {
+        0x04030201,                 // endianness
+        0, 1, 0,                    // glType, glTypeSize, glFormat (compressed => 0, 1, 0)
+        (unsigned int)img.format,
+        (unsigned int)baseFormatOf(img.format),
+        (unsigned int)img.width, (unsigned int)img.height, 0,
+        0, 1,                       // array elements, faces
+        (unsigned int)img.levels.size(),
+        0                           // key/value bytes
+    };
+
+    auto put = [&out](const void* p, size_t n)
+        {
+            out.insert(out.end(), (const unsigned char*)p, (const unsigned char*)p + n);
+        };
+
+    out.clear();
+    put(KTX_ID, sizeof(KTX_ID));
+    put(hdr, sizeof(hdr));
+
+    for (const auto& lvl : img.levels) {
+        unsigned int size = (unsigned int)lvl.size();
+        put(&size, 4);
+        put(lvl.data(), lvl.size());
+        out.resize(out.size() + ((4 - (size & 3)) & 3), 0);
+    }
+}
+
+bool WriteKTX(const char* path, const KtxImage& img)
+{
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        printf("Nu am putut scrie: %s\n", path);
+        return false;
+    }
+
+    std::vector<unsigned char> bytes;
+    SerializeKTX(img, bytes);
+    fwrite(bytes.data(), 1, bytes.size(), f);
+
+    bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
+
+bool ParseKTX(const unsigned char* data, size_t size, KtxView& view)
+{
+    unsigned int hdr[13];
+    bool ok = size >= 12 + sizeof(hdr) && memcmp(data, KTX_ID, 12) == 0;
+    if (ok) {
+        memcpy(hdr, data + 12, sizeof(hdr));
+        // only what texpack writes: one compressed 2D image with its mip chain
+        ok = hdr[0] == 0x04030201 && hdr[1] == 0 && BlockBytes(hdr[4]) > 0 &&
+            hdr[8] == 0 && hdr[9] == 0 && hdr[10] == 1;
+    }
+
+    size_t pos = 12 + sizeof(hdr) + (ok ? hdr[12] : 0);
+    ok = ok && pos <= size;
+
+    if (ok) {
+        view.format = hdr[4];
+        view.width = (int)hdr[6];
+        view.height = (int)hdr[7];
+        view.levels.clear();
+        view.sizes.clear();
+
+        // no more levels than the full chain has (0xFFFFFFFF must not become -1)
+        ok = view.width > 0 && view.height > 0 && hdr[11] <= (unsigned int)MipCount(view.width, view.height);
+    }
+    if (ok) {
+        int levels = hdr[11] ? (int)hdr[11] : 1;
+        int w = view.width, h = view.height;
+        for (int l = 0; l < levels && ok; l++) {
+            unsigned int lsize = 0;
+            ok = pos + 4 <= size;
+            if (ok) memcpy(&lsize, data + pos, 4);
+            ok = ok && lsize == CompressedSize(view.format, w, h) && lsize <= size - pos - 4;
+            if (!ok) break;
+
+            view.levels.push_back(data + pos + 4);
+            view.sizes.push_back(lsize);
+            pos += 4 + lsize + ((4 - (lsize & 3)) & 3);
+
+            w = w > 1 ? w >> 1 : 1;
+            h = h > 1 ? h >> 1 : 1;
+        }
+    }
+    return ok && !view.levels.empty();
+}
+
+bool ReadKTX(const char* path, KtxImage& img)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+
+    std::vector<unsigned char> bytes;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    bool ok = len > 0;
+    if (ok) {
+        bytes.resize((size_t)len);
+        ok = fread(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    }
+    fclose(f);
+
+    KtxView view;
+    ok = ok && ParseKTX(bytes.data(), bytes.size(), view);
+    if (ok) {
+        img.format = view.format;
+        img.width = view.width;
+        img.height = view.height;
+        img.levels.resize(view.levels.size());
+        for (size_t l = 0; l < view.levels.size(); l++) {
+            img.levels[l].assign(view.levels[l], view.levels[l] + view.sizes[l]);
+        }
+    }
+
+    if (!ok) printf("WARN: %s is not a supported KTX file\n", path);
+    return ok;
+}
+
+bool CompressImageFile(const std::string& path, bool normalMap, KtxImage& out, BlockFormat* usedFormat)
+{
+    DecodedImage img;
+    int ch = 0;
+    unsigned char* px = SOIL_load_image(path.c_str(), &img.width, &img.height, &ch, SOIL_LOAD_RGBA);
+    if (!px) {
+        printf("Nu am putut incarca textura: %s\n", path.c_str());
+        return false;
+    }
+    img.mips.resize(1);
+    img.mips[0].assign(px, px + (size_t)img.width * img.height * 4);
+    SOIL_free_image_data(px);
+
+    BlockFormat bf = BLOCK_BC1;
+    if (normalMap) {
+        bf = BLOCK_BC5;
+    }
+    else {
+        const std::vector<unsigned char>& base = img.mips[0];
+        for (size_t i = 3; i < base.size(); i += 4) {
+            if (base[i] != 255) { bf = BLOCK_BC3; break; }
+        }
+    }
+
+    BuildMipChain(img);
+
+    out.format = BlockFormatGL(bf);
+    out.width = img.width;
+    out.height = img.height;
+    out.levels.resize(img.mips.size());
+
+    int w = img.width, h = img.height;
+    for (size_t l = 0; l < img.mips.size(); l++) {
+        CompressImage(img.mips[l].data(), w, h, bf, out.levels[l]);
+        w = w > 1 ? w >> 1 : 1;
+        h = h > 1 ? h >> 1 : 1;
+    }
+
+    if (usedFormat) *usedFormat = bf;
+    return true;
+}
+
+std::string KtxPathFor(const std::string& imagePath)
+{
+    size_t dot = imagePath.find_last_of('.');
+    size_t slash = imagePath.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return imagePath + ".ktx";
+    return imagePath.substr(0, dot) + ".ktx";
+}
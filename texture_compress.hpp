@@ -0,0 +1,61 @@
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+// CPU block compression (BC1 / BC3 / BC5) and a minimal KTX 1.1 container.
+// - endpoints: per-block bounding box (SSE2 min/max when available), inset by 1/16 of the range
+// - indices: nearest of the 4 palette colors / nearest of the 8 levels (alpha, BC4 channels)
+// - CompressImage splits the block rows over worker threads
+//
+// Formats (GL internal format names, the KTX file stores these):
+//  BC1 = GL_COMPRESSED_RGB_S3TC_DXT1_EXT   8 bytes / 4x4  (albedo without alpha)
+//  BC3 = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT  16 bytes / 4x4 (albedo with alpha)
+//  BC5 = GL_COMPRESSED_RG_RGTC2            16 bytes / 4x4 (normal maps: X,Y; Z rebuilt in the shader)
+
+enum BlockFormat {
+    BLOCK_BC1,
+    BLOCK_BC3,
+    BLOCK_BC5
+};
+
+GLenum BlockFormatGL(BlockFormat f);
+int BlockBytes(GLenum glFormat);            // 0 if not one of the formats above
+
+// bytes of one w x h level
+size_t CompressedSize(GLenum glFormat, int w, int h);
+
+// RGBA8 -> blocks; threads = 0 uses hardware threads
+void CompressImage(const unsigned char* rgba, int w, int h, BlockFormat f,
+    std::vector<unsigned char>& out, int threads = 0);
+
+// single level image or full mip chain
+struct KtxImage {
+    GLenum format = 0;
+    int width = 0, height = 0;
+    std::vector<std::vector<unsigned char> > levels;
+};
+
+// KTX file already in memory (e.g. a section of the asset pack): levels point into it
+struct KtxView {
+    GLenum format = 0;
+    int width = 0, height = 0;
+    std::vector<const unsigned char*> levels;
+    std::vector<size_t> sizes;
+};
+
+void SerializeKTX(const KtxImage& img, std::vector<unsigned char>& out);
+bool ParseKTX(const unsigned char* data, size_t size, KtxView& view);
+bool WriteKTX(const char* path, const KtxImage& img);
+bool ReadKTX(const char* path, KtxImage& img);
+
+// loads an image (SOIL), builds its mips and compresses them: BC5 for normal maps,
+// BC3 if any texel has alpha < 255, BC1 otherwise (used by texpack and the bundler)
+bool CompressImageFile(const std::string& path, bool normalMap, KtxImage& out, BlockFormat* usedFormat = nullptr);
+
+// "textures/wall.jpg" -> "textures/wall.ktx"
+std::string KtxPathFor(const std::string& imagePath);
+
+#endif
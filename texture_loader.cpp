@@ -0,0 +1,257 @@
+// Threaded texture decode + CPU mips + PBO streaming (see texture_loader.hpp).
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXLOAD_USE_SSE 1
+#endif
+
+#include "texture_loader.hpp"
+#include "texture_compress.hpp"
+#include "cpu_profiler.hpp"
+#include "SOIL.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+int MipCount(int w, int h)
+{
+    int m = w > h ? w : h;
+    int n = 1;
+    while (m > 1) { m >>= 1; n++; }
+    return n;
+}
+
+static inline void averageScalar(const unsigned char* src, int sw, int sh, unsigned char* dst, int dw, int x, int y)
+{
+    int x0 = x * 2, y0 = y * 2;
+    int x1 = (x0 + 1 < sw) ? x0 + 1 : x0;
+    int y1 = (y0 + 1 < sh) ? y0 + 1 : y0;
+
+    const unsigned char* a = src + ((size_t)y0 * sw + x0) * 4;
+    const unsigned char* b = src + ((size_t)y0 * sw + x1) * 4;
+    const unsigned char* c = src + ((size_t)y1 * sw + x0) * 4;
+    const unsigned char* d = src + ((size_t)y1 * sw + x1) * 4;
+    unsigned char* o = dst + ((size_t)y * dw + x) * 4;
+
+    for (int k = 0; k < 4; k++) o[k] = (unsigned char)((a[k] + b[k] + c[k] + d[k] + 2) >> 2);
+}
+
+void DownsampleRGBA8(const unsigned char* src, int sw, int sh, unsigned char* dst)
+{
+    int dw = sw > 1 ? sw >> 1 : 1;
+    int dh = sh > 1 ? sh >> 1 : 1;
+
+    for (int y = 0; y < dh; y++) {
+        int x = 0;
+
+#ifdef TEXLOAD_USE_SSE
+        // 8 source pixels of two rows -> 4 destination pixels
+        if (sw >= 2 && sh >= 2) {
+            const unsigned char* r0 = src + (size_t)(y * 2) * sw * 4;
+            const unsigned char* r1 = r0 + (size_t)sw * 4;
+            unsigned char* o = dst + (size_t)y * dw * 4;
+
+            for (; x + 4 <= dw; x += 4) {
+                __m128i a0 = _mm_loadu_si128((const __m128i*)(r0 + x * 8));
+                __m128i a1 = _mm_loadu_si128((const __m128i*)(r0 + x * 8 + 16));
+                __m128i b0 = _mm_loadu_si128((const __m128i*)(r1 + x * 8));
+                __m128i b1 = _mm_loadu_si128((const __m128i*)(r1 + x * 8 + 16));
+
+                // even/odd pixels of both rows (one pixel = one 32-bit lane)
+                __m128i ea = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a0), _mm_castsi128_ps(a1), _MM_SHUFFLE(2, 0, 2, 0)));
+                __m128i oa = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a0), _mm_castsi128_ps(a1), _MM_SHUFFLE(3, 1, 3, 1)));
+                __m128i eb = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(b0), _mm_castsi128_ps(b1), _MM_SHUFFLE(2, 0, 2, 0)));
+                __m128i ob = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(b0), _mm_castsi128_ps(b1), _MM_SHUFFLE(3, 1, 3, 1)));
+
+                // (a + b + c + d + 2) >> 2 in 16 bits, exactly like averageScalar
+                // (two _mm_avg_epu8 would round up twice)
+                __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+                __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(ea, zero), _mm_unpacklo_epi8(oa, zero)),
+                    _mm_add_epi16(_mm_unpacklo_epi8(eb, zero), _mm_unpacklo_epi8(ob, zero)));
+                __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(ea, zero), _mm_unpackhi_epi8(oa, zero)),
+                    _mm_add_epi16(_mm_unpackhi_epi8(eb, zero), _mm_unpackhi_epi8(ob, zero)));
+                lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+                hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+
+                _mm_storeu_si128((__m128i*)(o + x * 4), _mm_packus_epi16(lo, hi));
+            }
+        }
+#endif
+
+        for (; x < dw; x++) averageScalar(src, sw, sh, dst, dw, x, y);
+    }
+}
+
+void BuildMipChain(DecodedImage& img)
+{
+    int levels = MipCount(img.width, img.height);
+    img.mips.resize(levels);
+
+    int w = img.width, h = img.height;
+    for (int l = 1; l < levels; l++) {
+        int nw = w > 1 ? w >> 1 : 1;
+        int nh = h > 1 ? h >> 1 : 1;
+        img.mips[l].resize((size_t)nw * nh * 4);
+        DownsampleRGBA8(img.mips[l - 1].data(), w, h, img.mips[l].data());
+        w = nw;
+        h = nh;
+    }
+}
+
+// ---------------- TextureDecoder ----------------
+void TextureDecoder::Decode(DecodedImage& img) const
+{
+    CPU_ZONE("decode image");
+    auto t0 = Clock::now();
+    if (source && source(img.path, img)) {
+        img.ok = true;
+        img.decodeMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        return;
+    }
+
+    // precompressed version: read as is
+    KtxImage ktx;
+    std::string ktxPath = KtxPathFor(img.path);
+    FILE* probe = fopen(ktxPath.c_str(), "rb");
+    if (probe) {
+        fclose(probe);
+        if (ReadKTX(ktxPath.c_str(), ktx)) {
+            img.path = ktxPath;
+            img.format = ktx.format;
+            img.width = ktx.width;
+            img.height = ktx.height;
+            img.mips.swap(ktx.levels);
+            img.ok = true;
+            img.decodeMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+            return;
+        }
+    }
+
+    int ch = 0;
+    unsigned char* px = SOIL_load_image(img.path.c_str(), &img.width, &img.height, &ch, SOIL_LOAD_RGBA);
+    auto t1 = Clock::now();
+
+    if (px) {
+        img.mips.resize(1);
+        img.mips[0].assign(px, px + (size_t)img.width * img.height * 4);
+        SOIL_free_image_data(px);
+
+        BuildMipChain(img);
+        img.ok = true;
+    }
+    auto t2 = Clock::now();
+
+    img.decodeMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    img.mipMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+}
+
+// ---------------- TextureUploader ----------------
+// compressed levels are streamed in rows of 4x4 blocks
+size_t TextureUploader::RowBytes(const Job& j)
+{
+    int bb = BlockBytes(j.format);
+    return bb ? (size_t)((j.width + 3) / 4) * bb : (size_t)j.width * 4;
+}
+
+int TextureUploader::RowCount(const Job& j)
+{
+    return BlockBytes(j.format) ? (j.height + 3) / 4 : j.height;
+}
+
+bool TextureUploader::Init(size_t budgetBytes, int pboCount)
+{
+    budget = budgetBytes;
+    pbos.assign(pboCount > 0 ? pboCount : 1, 0);
+    glGenBuffers((GLsizei)pbos.size(), pbos.data());
+    return true;
+}
+
+void TextureUploader::Destroy()
+{
+    if (!pbos.empty()) glDeleteBuffers((GLsizei)pbos.size(), pbos.data());
+    pbos.clear();
+    queue.clear();
+    head = 0;
+    rowCursor = 0;
+}
+
+size_t TextureUploader::Pump(std::vector<int>& finished)
+{
+    if (Idle() || pbos.empty()) return 0;
+
+    // one PBO per frame, rotated, and orphaned so the driver never waits on the previous upload
+    GLuint pbo = pbos[pboIdx];
+    pboIdx = (pboIdx + 1) % (int)pbos.size();
+
+    // at least one row of the current level, even if the budget is smaller
+    size_t minBytes = RowBytes(queue[head]);
+    size_t capacity = budget > minBytes ? budget : minBytes;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)capacity, NULL, GL_STREAM_DRAW);
+    unsigned char* dst = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)capacity,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!dst) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return 0;
+    }
+
+    // pack row bands into the PBO, remember them, issue the copies after unmapping
+    struct Band { size_t job; int y0, rows; size_t offset; };
+    std::vector<Band> bands;
+    size_t used = 0;
+
+    while (!Idle()) {
+        const Job& j = queue[head];
+        size_t rowBytes = RowBytes(j);
+        int rowCount = RowCount(j);
+        int rowsLeft = rowCount - rowCursor;
+        int rowsFit = (int)((capacity - used) / rowBytes);
+        if (rowsFit <= 0) break;
+
+        int rows = rowsFit < rowsLeft ? rowsFit : rowsLeft;
+        memcpy(dst + used, j.data + (size_t)rowCursor * rowBytes, (size_t)rows * rowBytes);
+        bands.push_back({ head, rowCursor, rows, used });
+        used += (size_t)rows * rowBytes;
+
+        rowCursor += rows;
+        if (rowCursor < rowCount) break; // budget exhausted inside this level
+
+        rowCursor = 0;
+        head++;
+    }
+
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    for (const Band& b : bands) {
+        const Job& j = queue[b.job];
+        glBindTexture(GL_TEXTURE_2D_ARRAY, j.tex);
+
+        if (BlockBytes(j.format)) {
+            // block rows -> pixel rows (the last band may be shorter than 4 * rows)
+            int y0 = b.y0 * 4;
+            int h = b.rows * 4;
+            if (y0 + h > j.height) h = j.height - y0;
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, j.level, 0, y0, j.layer, j.width, h, 1,
+                j.format, (GLsizei)(b.rows * RowBytes(j)), (const GLvoid*)b.offset);
+        }
+        else {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, j.level, 0, b.y0, j.layer, j.width, b.rows, 1,
+                GL_RGBA, GL_UNSIGNED_BYTE, (const GLvoid*)b.offset);
+        }
+
+        if (b.y0 + b.rows == RowCount(j)) finished.push_back(j.tag);
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (Idle()) {
+        queue.clear();
+        head = 0;
+    }
+    return used;
+}
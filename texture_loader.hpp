@@ -0,0 +1,97 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <GL/glew.h>
+
+// Background texture loading, split in two halves:
+//  - TextureDecoder: decodes one image (SOIL, forced RGBA8) and builds the full mip chain on
+//    the CPU (2x2 box filter, SSE2 when available). No GL calls; the image cache
+//    (resources.hpp) runs it as one background job per image.
+//    If a .ktx made by texpack sits next to the image it is read instead: already
+//    block-compressed with all mips, so there is nothing to decode or downsample.
+//    An optional Source (the asset pack) is asked before any file is touched.
+//  - TextureUploader: main thread streams mip levels into GL textures through a small ring
+//    of pixel unpack buffers, never more than `budgetBytes` per frame (big levels are split
+//    into row bands), so a frame never stalls on a large glTexSubImage.
+
+struct DecodedImage {
+    std::string path;
+    bool ok = false;
+    int width = 0, height = 0;
+    GLenum format = GL_RGBA8;   // or a BC format (texture_compress.hpp)
+    std::vector<std::vector<unsigned char> > mips; // RGBA8 or blocks, mips[0] = full size
+    double decodeMs = 0.0, mipMs = 0.0;
+
+    // levels owned elsewhere (the mapped asset pack) instead of `mips`; must outlive the upload
+    std::vector<const unsigned char*> extLevels;
+    std::vector<size_t> extSizes;
+
+    int Levels() const { return extLevels.empty() ? (int)mips.size() : (int)extLevels.size(); }
+    const unsigned char* LevelData(int l) const { return extLevels.empty() ? mips[l].data() : extLevels[l]; }
+    size_t LevelBytes(int l) const { return extLevels.empty() ? mips[l].size() : extSizes[l]; }
+};
+
+// mip sizes follow GL: max(1, size >> level)
+int MipCount(int w, int h);
+
+// 2x2 box filter RGBA8 -> next level (odd sizes: last row/column is clamped)
+void DownsampleRGBA8(const unsigned char* src, int sw, int sh, unsigned char* dst);
+
+// fills img.mips[1..] from img.mips[0]
+void BuildMipChain(DecodedImage& img);
+
+class TextureDecoder {
+public:
+    // asked first for every path (from the worker threads); fills img and returns true
+    // if it has the image ready-made, e.g. in the asset pack
+    typedef std::function<bool(const std::string& path, DecodedImage& img)> Source;
+
+    void SetSource(const Source& s) { source = s; }
+
+    // decodes img.path into img (sets img.ok); no GL, called from the image cache's load jobs
+    void Decode(DecodedImage& img) const;
+
+private:
+    Source source;
+};
+
+class TextureUploader {
+public:
+    struct Job {
+        GLuint tex = 0;             // GL_TEXTURE_2D_ARRAY
+        int level = 0, layer = 0;
+        int width = 0, height = 0;
+        GLenum format = GL_RGBA8;   // BC formats go through glCompressedTexSubImage3D in 4-row bands
+        const unsigned char* data = nullptr; // must stay alive until the job finishes
+        int tag = 0;                // reported back when the whole level is uploaded
+    };
+
+    bool Init(size_t budgetBytes, int pboCount = 3);
+    void Destroy();
+
+    void SetBudget(size_t bytes) { budget = bytes; }
+    size_t Budget() const { return budget; }
+
+    void Enqueue(const Job& job) { queue.push_back(job); }
+    bool Idle() const { return head >= queue.size(); }
+
+    // uploads up to the budget; tags of fully uploaded jobs are appended to finished
+    size_t Pump(std::vector<int>& finished);
+
+private:
+    static size_t RowBytes(const Job& j);
+    static int RowCount(const Job& j);
+
+    std::vector<Job> queue;
+    size_t head = 0;        // first unfinished job
+    int rowCursor = 0;      // rows (block rows when compressed) of queue[head] already uploaded
+
+    std::vector<GLuint> pbos;
+    int pboIdx = 0;
+    size_t budget = 0;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#version 330 core
+
+// Used only by the vertex-throughput benchmark (GL_RASTERIZER_DISCARD, so this never runs).
+// It reads every varying of alley.vert so the linker cannot strip the work being measured.
+#ifndef SHADOW_LIGHT_COUNT
+#define SHADOW_LIGHT_COUNT 3
+#endif
+
+in vec3 vColor;
+in vec3 vFragPos;
+in vec2 vUV;
+flat in int vMaterialId;
+
+#ifndef LEGACY_VERTEX_PATH
+in vec3 vNormal;
+in vec4 vTangent;
+#else
+in mat3 vTBN;
+in vec4 vLightPosLS[SHADOW_LIGHT_COUNT];
+#endif
+
+out vec4 out_Color;
+
+void main()
+{
+    vec4 sum = vec4(vColor + vFragPos, float(vMaterialId)) + vUV.xyxy;
+#ifndef LEGACY_VERTEX_PATH
+    sum += vec4(vNormal, 0.0) + vTangent;
+#else
+    sum += vec4(vTBN[0] + vTBN[1] + vTBN[2], 0.0);
+    for (int i = 0; i < SHADOW_LIGHT_COUNT; i++) sum += vLightPosLS[i];
+#endif
+    out_Color = sum;
+}
@@ -0,0 +1,370 @@
+// World streaming around the camera (see world_stream.hpp).
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+
+#include "world_stream.hpp"
+#include "gpu_profiler.hpp"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double msSince(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+// ---------------- Cell content ----------------
+// neon lights along both walls, same palette and placement rules as the startup block
+static void generateCellLights(int cx, int cy, std::vector<PointLight>& out)
+{
+    static const glm::vec3 palette[5] = {
+        glm::vec3(1.00f, 0.15f, 0.60f),
+        glm::vec3(0.10f, 0.85f, 1.00f),
+        glm::vec3(0.65f, 0.20f, 1.00f),
+        glm::vec3(1.00f, 0.55f, 0.10f),
+        glm::vec3(0.30f, 1.00f, 0.35f)
+    };
+
+    unsigned int seed = (unsigned int)(cx * 73856093) ^ (unsigned int)(cy * 19349663) ^ 0x9E3779B9u;
+    auto rnd = [&]() -> float {
+        seed = seed * 1664525u + 1013904223u;
+        return (float)(seed >> 8) / 16777216.0f;
+        };
+
+    out.clear();
+    for (int i = 0; i < STREAM_CELL_LIGHTS; i++) {
+        PointLight L;
+        bool left = (i & 1) == 0;
+        L.pos = glm::vec3(left ? -2.05f : 2.05f, -4.8f + 9.6f * rnd(), 0.3f + 5.2f * rnd());
+        L.radius = 1.6f * (0.75f + 0.5f * rnd());
+        L.color = palette[((i + cx * 3 + cy) % 5 + 5) % 5] * 0.6f;
+        L.shadowIndex = -1;
+        out.push_back(L);
+    }
+}
+
+// block -> its place in the world; odd blocks are turned 180 degrees (a rotation, so
+// winding and tangent handedness stay as they are)
+static void placeCell(SceneData& d, std::vector<PointLight>& lights, int cx, int cy, float offX, float offY)
+{
+    float s = ((cx + cy) & 1) ? -1.0f : 1.0f;
+
+    for (Vtx& v : d.vertices) {
+        v.pos.x = v.pos.x * s + offX;
+        v.pos.y = v.pos.y * s + offY;
+        v.nrm.x *= s; v.nrm.y *= s;
+        v.tan.x *= s; v.tan.y *= s;
+    }
+
+    glm::mat4 M(1.0f);
+    M[0][0] = s; M[1][1] = s;
+    M[3][0] = offX; M[3][1] = offY;
+    for (SceneInstance& inst : d.instances) inst.model = M * inst.model;
+
+    for (PointLight& L : lights) {
+        L.pos.x = L.pos.x * s + offX;
+        L.pos.y = L.pos.y * s + offY;
+    }
+}
+
+// ---------------- WorldStreamer ----------------
+bool WorldStreamer::Init(JobSystem& js, MeshCache& meshCache, size_t vertexPoolBytes, size_t indexPoolBytes)
+{
+    Destroy();
+
+    jobs = &js;
+    meshes = &meshCache;
+    return vertexPool.Init(vertexPoolBytes) && indexPool.Init(indexPoolBytes);
+}
+
+void WorldStreamer::Destroy()
+{
+    // running builds write into their cells
+    for (auto& kv : cells) {
+        if (kv.second->state == CELL_BUILDING && jobs) jobs->Wait(kv.second->built);
+    }
+    cells.clear();
+    inFlight = 0;
+
+    vertexPool.Destroy();
+    indexPool.Destroy();
+}
+
+glm::vec2 WorldStreamer::CellCenter(int x, int y) const
+{
+    return glm::vec2((float)x * STREAM_CELL_SIZE_X, (float)y * STREAM_CELL_SIZE_Y);
+}
+
+void WorldStreamer::Update(const glm::vec3& eye, double lastFrameMs)
+{
+    if (!jobs) return;
+
+    if (lastFrameMs > 0.0) ScoreFrame(lastFrameMs);
+    streamedThisFrame = false;
+
+    auto t0 = Clock::now();
+    FinishBuilds();
+    Evict(eye);
+    StartBuilds(eye);
+    if (waitForBuilds) {
+        for (auto& it : cells) {
+            if (it.second->state == CELL_BUILDING) jobs->Wait(it.second->built);
+        }
+        FinishBuilds();
+    }
+    size_t bytes = Upload(eye);
+    vertexPool.EndFrame();
+    indexPool.EndFrame();
+
+    if (bytes) streamedThisFrame = true;
+    double ms = msSince(t0);
+    if (ms > updateMsWorst) updateMsWorst = ms;
+}
+
+// missing cells inside the load radius, nearest first, while there is room in flight
+void WorldStreamer::StartBuilds(const glm::vec3& eye)
+{
+    if (inFlight >= budget.buildsInFlight) return;
+
+    glm::vec2 e(eye.x, eye.y);
+    int x0 = (int)floorf((e.x - loadRadius) / STREAM_CELL_SIZE_X), x1 = (int)ceilf((e.x + loadRadius) / STREAM_CELL_SIZE_X);
+    int y0 = (int)floorf((e.y - loadRadius) / STREAM_CELL_SIZE_Y), y1 = (int)ceilf((e.y + loadRadius) / STREAM_CELL_SIZE_Y);
+
+    std::vector<std::pair<float, CellKey> > wanted;
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            if (x == 0 && y == 0) continue; // the startup block
+            float d = glm::length(CellCenter(x, y) - e);
+            if (d < loadRadius && cells.find(CellKey(x, y)) == cells.end()) wanted.push_back(std::make_pair(d, CellKey(x, y)));
+        }
+    }
+    std::sort(wanted.begin(), wanted.end());
+
+    for (size_t i = 0; i < wanted.size() && inFlight < budget.buildsInFlight; i++) {
+        Cell* c = new Cell();
+        c->x = wanted[i].second.first;
+        c->y = wanted[i].second.second;
+        cells[wanted[i].second].reset(c);
+        inFlight++;
+
+        glm::vec2 at = CellCenter(c->x, c->y);
+        MeshCache* m = meshes;
+        jobs->SpawnBackground("build cell", [c, at, m]
+            {
+                auto b0 = Clock::now();
+                BuildAlley(c->data, *m);
+                generateCellLights(c->x, c->y, c->lights);
+                placeCell(c->data, c->lights, c->x, c->y, at.x, at.y);
+                c->buildMs = msSince(b0);
+            }, &c->built);
+    }
+}
+
+void WorldStreamer::FinishBuilds()
+{
+    for (auto it = cells.begin(); it != cells.end();) {
+        Cell& c = *it->second;
+        if (c.state != CELL_BUILDING || !c.built.Done()) { ++it; continue; }
+
+        inFlight--;
+        streamedThisFrame = true;
+        if (c.dropped) {
+            it = cells.erase(it);
+            continue;
+        }
+
+        cellsBuilt++;
+        buildMsTotal += c.buildMs;
+        c.vertexBytes = c.data.vertices.size() * sizeof(Vtx);
+        c.indexBytes = c.data.indices.size() * sizeof(unsigned int);
+        c.indexCount = (GLsizei)c.data.indices.size();
+        c.state = CELL_UPLOADING;
+        ++it;
+    }
+}
+
+// nearest cells first, until the byte budget of this frame is used up
+size_t WorldStreamer::Upload(const glm::vec3& eye)
+{
+    std::vector<std::pair<float, Cell*> > order;
+    for (auto& kv : cells) {
+        Cell& c = *kv.second;
+        if (c.state == CELL_UPLOADING) order.push_back(std::make_pair(glm::length(CellCenter(c.x, c.y) - glm::vec2(eye.x, eye.y)), &c));
+    }
+    std::sort(order.begin(), order.end(), [](const std::pair<float, Cell*>& a, const std::pair<float, Cell*>& b) { return a.first < b.first; });
+
+    size_t left = budget.uploadBytesPerFrame ? budget.uploadBytesPerFrame : (size_t)-1;
+    size_t sent = 0;
+
+    for (auto& o : order) {
+        Cell& c = *o.second;
+        if (left == 0) break;
+
+        if (!c.allocated) {
+            // base vertex draws need the vertex offset to be a whole number of vertices
+            if (!vertexPool.Alloc(c.vertexBytes, sizeof(Vtx), c.vertexOffset)) continue;
+            if (!indexPool.Alloc(c.indexBytes, sizeof(unsigned int), c.indexOffset)) {
+                vertexPool.Free(c.vertexOffset);
+                continue;
+            }
+            c.allocated = true;
+        }
+
+        if (c.vertexDone < c.vertexBytes) {
+            size_t n = std::min(left, c.vertexBytes - c.vertexDone);
+            vertexPool.Upload(c.vertexOffset + c.vertexDone, (const unsigned char*)c.data.vertices.data() + c.vertexDone, n);
+            c.vertexDone += n;
+            left -= n;
+            sent += n;
+        }
+        if (left && c.indexDone < c.indexBytes) {
+            size_t n = std::min(left, c.indexBytes - c.indexDone);
+            indexPool.Upload(c.indexOffset + c.indexDone, (const unsigned char*)c.data.indices.data() + c.indexDone, n);
+            c.indexDone += n;
+            left -= n;
+            sent += n;
+        }
+
+        if (c.vertexDone == c.vertexBytes && c.indexDone == c.indexBytes) {
+            c.state = CELL_RESIDENT;
+            std::vector<Vtx>().swap(c.data.vertices);
+            std::vector<unsigned int>().swap(c.data.indices);
+        }
+    }
+
+    bytesUploaded += sent;
+    return sent;
+}
+
+void WorldStreamer::Evict(const glm::vec3& eye)
+{
+    for (auto it = cells.begin(); it != cells.end();) {
+        Cell& c = *it->second;
+        if (c.dropped || glm::length(CellCenter(c.x, c.y) - glm::vec2(eye.x, eye.y)) <= evictRadius) { ++it; continue; }
+
+        streamedThisFrame = true;
+        cellsEvicted++;
+        if (c.state == CELL_BUILDING) {
+            c.dropped = true; // erased when its job is done
+            ++it;
+            continue;
+        }
+        FreeCell(c);
+        it = cells.erase(it);
+    }
+}
+
+void WorldStreamer::FreeCell(Cell& c)
+{
+    if (!c.allocated) return;
+    vertexPool.Free(c.vertexOffset);
+    indexPool.Free(c.indexOffset);
+    c.allocated = false;
+}
+
+void WorldStreamer::ScoreFrame(double frameMs)
+{
+    frames++;
+    bool streamed = streamedThisFrame;
+    if (streamed) streamFrames++;
+
+    if (frameAvgMs <= 0.0) {
+        frameAvgMs = frameMs;
+        return;
+    }
+
+    double over = frameMs - frameAvgMs;
+    bool spike = frames > 30 && frameMs > frameAvgMs * STREAM_SPIKE_FACTOR && over > STREAM_SPIKE_MIN_MS;
+    if (!spike) {
+        // spikes stay out of the average, or a long hitch would hide the next one
+        frameAvgMs += (frameMs - frameAvgMs) * 0.05;
+        return;
+    }
+
+    spikes++;
+    if (streamed) {
+        streamSpikes++;
+        if (over > worstStreamSpikeMs) worstStreamSpikeMs = over;
+    }
+    else if (over > worstOtherSpikeMs) {
+        worstOtherSpikeMs = over;
+    }
+}
+
+void WorldStreamer::AppendLights(std::vector<PointLight>& out) const
+{
+    for (const auto& kv : cells) {
+        const Cell& c = *kv.second;
+        if (c.state == CELL_RESIDENT) out.insert(out.end(), c.lights.begin(), c.lights.end());
+    }
+}
+
+void WorldStreamer::Draw() const
+{
+    for (const auto& kv : cells) {
+        const Cell& c = *kv.second;
+        if (c.state != CELL_RESIDENT) continue;
+        glDrawElementsBaseVertex(GL_TRIANGLES, c.indexCount, GL_UNSIGNED_INT,
+            (const GLvoid*)c.indexOffset, (GLint)(c.vertexOffset / sizeof(Vtx)));
+        GpuCountDraw(c.indexCount);
+    }
+}
+
+void WorldStreamer::DrawPass(int pass, const glm::vec3& eye) const
+{
+    std::vector<std::pair<float, const Cell*> > order;
+    for (const auto& kv : cells) {
+        const Cell& c = *kv.second;
+        if (c.state != CELL_RESIDENT) continue;
+        glm::vec2 d = CellCenter(c.x, c.y) - glm::vec2(eye.x, eye.y);
+        order.push_back(std::make_pair(glm::dot(d, d), &c));
+    }
+
+    if (pass == SCENE_PASS_TRANSPARENT) std::sort(order.begin(), order.end(), std::greater<std::pair<float, const Cell*> >());
+    else std::sort(order.begin(), order.end());
+
+    for (const auto& o : order) {
+        const Cell& c = *o.second;
+        int first, count;
+        ScenePassRange(c.data.ranges, pass, first, count);
+        if (count == 0) continue;
+        glDrawElementsBaseVertex(GL_TRIANGLES, count, GL_UNSIGNED_INT,
+            (const GLvoid*)(c.indexOffset + (size_t)first * sizeof(unsigned int)), (GLint)(c.vertexOffset / sizeof(Vtx)));
+        GpuCountDraw(count);
+    }
+}
+
+int WorldStreamer::ResidentCells() const
+{
+    int n = 0;
+    for (const auto& kv : cells) {
+        if (kv.second->state == CELL_RESIDENT) n++;
+    }
+    return n;
+}
+
+void WorldStreamer::PrintStats() const
+{
+    int building = 0, uploading = 0;
+    for (const auto& kv : cells) {
+        if (kv.second->state == CELL_BUILDING) building++;
+        if (kv.second->state == CELL_UPLOADING) uploading++;
+    }
+
+    const double MB = 1024.0 * 1024.0;
+    printf("\nStreaming: %d cells resident, %d building, %d uploading (radius %.0f / evict %.0f)\n",
+        ResidentCells(), building, uploading, loadRadius, evictRadius);
+    printf("  budget: %d builds in flight, %.2f MB/frame upload\n", budget.buildsInFlight,
+        budget.uploadBytesPerFrame ? budget.uploadBytesPerFrame / MB : 0.0);
+    printf("  built %d (%.1f ms avg on a worker), evicted %d, uploaded %.1f MB, worst Update %.2f ms\n",
+        cellsBuilt, cellsBuilt ? buildMsTotal / cellsBuilt : 0.0, cellsEvicted, bytesUploaded / MB, updateMsWorst);
+    printf("  vertex pool %.1f / %.1f MB (peak %.1f, largest free %.1f), index pool %.1f / %.1f MB (peak %.1f), %d allocs waited\n",
+        vertexPool.Used() / MB, vertexPool.Capacity() / MB, vertexPool.Peak() / MB, vertexPool.LargestFree() / MB,
+        indexPool.Used() / MB, indexPool.Capacity() / MB, indexPool.Peak() / MB,
+        vertexPool.Failures() + indexPool.Failures());
+    printf("  frames %d (%d streamed), avg %.2f ms; spikes: %d while streaming (worst +%.2f ms), %d otherwise (worst +%.2f ms)\n",
+        frames, streamFrames, frameAvgMs, streamSpikes, worstStreamSpikeMs, spikes - streamSpikes, worstOtherSpikeMs);
+}
@@ -0,0 +1,131 @@
+#ifndef WORLD_STREAM_H
+#define WORLD_STREAM_H
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+#include "glm/glm.hpp"
+
+#include "scene.hpp"
+#include "gpu_pool.hpp"
+#include "clustered_lights.hpp"
+#include "job_system.hpp"
+#include "resources.hpp"
+
+// World streaming: the ground plane is a grid of cells, one alley block each, with its own
+// geometry, prop instances and neon lights. Cell (0, 0) is the startup scene (always resident,
+// drawn by main.cpp); the others are streamed around the camera:
+//  - a cell closer than the load radius is built by a background job (BuildAlley through the
+//    shared mesh cache, moved to its place; every other block is turned around for variety)
+//  - built cells are copied into two fixed GPU pools (vertices, indices) under a per-frame
+//    upload budget, nearest first; a cell is drawn only once all of it is in
+//  - a cell farther than the evict radius (> load radius: hysteresis, so a camera on the
+//    border does not load/evict every frame) gives its pool ranges back
+//  - "I/O" budget = cell builds in flight on the workers
+//
+// Frame-time spikes: a frame more than STREAM_SPIKE_FACTOR x the running average (and at least
+// STREAM_SPIKE_MIN_MS over it) is a spike; spikes in frames that streamed (finished a build,
+// uploaded or evicted) are counted apart, so the cost of streaming shows up on its own.
+
+static const float STREAM_CELL_SIZE_X = 6.0f;   // the alley is 4.4 wide
+static const float STREAM_CELL_SIZE_Y = 12.0f;  // and 10 long
+static const int STREAM_CELL_LIGHTS = 16;
+static const float STREAM_SPIKE_FACTOR = 1.5f;
+static const float STREAM_SPIKE_MIN_MS = 2.0f;
+
+struct StreamBudget {
+    int buildsInFlight = 2;                         // cells read/built on the workers at once
+    size_t uploadBytesPerFrame = 1024 * 1024;       // vertex + index bytes into the pools per frame
+};
+
+class WorldStreamer {
+public:
+    ~WorldStreamer() { Destroy(); }
+
+    bool Init(JobSystem& jobs, MeshCache& meshes, size_t vertexPoolBytes, size_t indexPoolBytes);
+    void Destroy();
+
+    void SetBudget(const StreamBudget& b) { budget = b; }
+    const StreamBudget& Budget() const { return budget; }
+    void SetRadii(float load, float evict) { loadRadius = load; evictRadius = evict; }
+    // builds started by an Update are finished in it (headless runs: what is resident then
+    // depends only on the camera path, not on how fast the workers are)
+    void SetWaitForBuilds(bool wait) { waitForBuilds = wait; }
+
+    // main thread, once per frame, before drawing. lastFrameMs = duration of the previous frame
+    // (0 for the first), scored against what Update did in that frame
+    void Update(const glm::vec3& eye, double lastFrameMs);
+
+    // neon lights of the resident cells
+    void AppendLights(std::vector<PointLight>& out) const;
+
+    // one indexed draw per resident cell; the caller binds a VAO over VertexBuffer/IndexBuffer
+    // (layout of Vtx) and the program
+    void Draw() const;
+
+    // only the ScenePass range of every resident cell; nearest cell first, farthest first for
+    // SCENE_PASS_TRANSPARENT
+    void DrawPass(int pass, const glm::vec3& eye) const;
+
+    GLuint VertexBuffer() const { return vertexPool.Buffer(); }
+    GLuint IndexBuffer() const { return indexPool.Buffer(); }
+    int ResidentCells() const;
+    // cells still building or uploading: the picture changes without the camera moving
+    bool Busy() const { return ResidentCells() < (int)cells.size(); }
+
+    void PrintStats() const;
+
+private:
+    enum CellState { CELL_BUILDING, CELL_UPLOADING, CELL_RESIDENT };
+
+    struct Cell {
+        int x = 0, y = 0;
+        CellState state = CELL_BUILDING;
+        bool dropped = false;   // evicted while its job was still running
+
+        SceneData data;         // CPU copy, freed once uploaded
+        std::vector<PointLight> lights;
+        JobCounter built;
+        double buildMs = 0.0;
+
+        bool allocated = false;
+        size_t vertexOffset = 0, indexOffset = 0;
+        size_t vertexBytes = 0, indexBytes = 0;
+        size_t vertexDone = 0, indexDone = 0;
+        GLsizei indexCount = 0;
+    };
+
+    typedef std::pair<int, int> CellKey;
+
+    glm::vec2 CellCenter(int x, int y) const;
+    void StartBuilds(const glm::vec3& eye);
+    void FinishBuilds();
+    size_t Upload(const glm::vec3& eye);
+    void Evict(const glm::vec3& eye);
+    void FreeCell(Cell& c);
+    void ScoreFrame(double frameMs);
+
+    JobSystem* jobs = nullptr;
+    MeshCache* meshes = nullptr;
+    GpuPool vertexPool, indexPool;
+    StreamBudget budget;
+    float loadRadius = 16.0f, evictRadius = 22.0f;
+
+    std::map<CellKey, std::unique_ptr<Cell> > cells;
+    int inFlight = 0;
+    bool waitForBuilds = false;
+    bool streamedThisFrame = false;
+
+    // stats
+    int cellsBuilt = 0, cellsEvicted = 0;
+    double buildMsTotal = 0.0;
+    size_t bytesUploaded = 0;
+    double updateMsWorst = 0.0;
+    int frames = 0, streamFrames = 0;
+    int spikes = 0, streamSpikes = 0;
+    double frameAvgMs = 0.0, worstStreamSpikeMs = 0.0, worstOtherSpikeMs = 0.0;
+};
+
+#endif